@@ -59,6 +59,10 @@ class AllocatorTestSuite {
         alloc_type_ = "hipc::TestAllocator";
         break;
       }
+      case AllocatorType::kTieredAllocator: {
+        alloc_type_ = "hipc::TieredAllocator";
+        break;
+      }
       default: {
         HELOG(kFatal, "Could not find this allocator type");
         break;
@@ -260,6 +264,9 @@ void FullAllocatorTestPerThread() {
   // Test allocator
   AllocatorTest<hipc::PosixShmMmap, hipc::TestAllocator>(
       AllocatorType::kTestAllocator, MemoryBackendType::kMallocBackend);
+  // Tiered allocator
+  AllocatorTest<hipc::PosixTieredMmap, hipc::TieredAllocator>(
+      AllocatorType::kTieredAllocator, MemoryBackendType::kPosixTieredMmap);
   // Stack allocator
   //  AllocatorTest<hipc::PosixShmMmap, hipc::StackAllocator>(
   //    AllocatorType::kStackAllocator,
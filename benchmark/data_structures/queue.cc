@@ -19,11 +19,15 @@
 #include <string>
 
 // hermes
+#include "hermes_shm/data_structures/ipc/dynamic_queue.h"
+#include "hermes_shm/data_structures/ipc/mpmc_queue.h"
 #include "hermes_shm/data_structures/ipc/ring_ptr_queue.h"
 #include "hermes_shm/data_structures/ipc/ring_queue.h"
 #include "hermes_shm/data_structures/ipc/split_ticket_queue.h"
+#include "hermes_shm/data_structures/ipc/spsc_ring.h"
 #include "hermes_shm/data_structures/ipc/string.h"
 #include "hermes_shm/data_structures/ipc/ticket_queue.h"
+#include "hermes_shm/data_structures/ipc/ws_deque.h"
 
 /**
  * A series of performance tests for vectors
@@ -55,10 +59,16 @@ class QueueTest {
       queue_type_ = "hipc::mpsc_ptr_queue";
     } else if constexpr (std::is_same_v<hipc::spsc_queue<T>, QueueT>) {
       queue_type_ = "hipc::spsc_queue";
+    } else if constexpr (std::is_same_v<hipc::spsc_ring<T>, QueueT>) {
+      queue_type_ = "hipc::spsc_ring";
     } else if constexpr (std::is_same_v<hipc::ticket_queue<T>, QueueT>) {
       queue_type_ = "hipc::ticket_queue";
     } else if constexpr (std::is_same_v<hipc::split_ticket_queue<T>, QueueT>) {
       queue_type_ = "hipc::split_ticket_queue";
+    } else if constexpr (std::is_same_v<hipc::mpmc_queue<T>, QueueT>) {
+      queue_type_ = "hipc::mpmc_queue";
+    } else if constexpr (std::is_same_v<hipc::dynamic_queue<T>, QueueT>) {
+      queue_type_ = "hipc::dynamic_queue";
     } else {
       HELOG(kFatal, "none of the queue tests matched");
     }
@@ -73,6 +83,17 @@ class QueueTest {
     DequeueTest(count_per_rank, nthreads);
   }
 
+  /** Run the batched tests (ring queues only) */
+  void TestBatch(size_t count_per_rank = 100000, int nthreads = 1,
+                 size_t burst = 32) {
+    BatchTest(count_per_rank, nthreads, burst);
+  }
+
+  /** Run the contention test (MPMC queues only) */
+  void TestContention(size_t count_per_rank = 100000, int nthreads = 2) {
+    ContentionTest(count_per_rank, nthreads);
+  }
+
   /**====================================
    * Tests
    * ===================================*/
@@ -121,6 +142,81 @@ class QueueTest {
     Destroy();
   }
 
+  /** Enqueue and dequeue in bursts with push_n and pop_n */
+  void BatchTest(size_t count_per_rank, int nthreads, size_t burst) {
+    Timer t_push, t_pop;
+    size_t count = count_per_rank * nthreads;
+    Allocate(count, count_per_rank, nthreads);
+
+    omp_set_dynamic(0);
+#pragma omp parallel num_threads(nthreads)
+    {
+      StringOrInt<T> var(124);
+      std::vector<T> vals(burst, var.Get());
+#pragma omp barrier
+#pragma omp master
+      t_push.Resume();
+      for (size_t i = 0; i < count_per_rank;) {
+        size_t n = std::min(burst, count_per_rank - i);
+        i += queue_->push_n(vals.data(), n);
+      }
+#pragma omp barrier
+#pragma omp master
+      {
+        t_push.Pause();
+        t_pop.Resume();
+      }
+#pragma omp barrier
+      for (size_t i = 0; i < count_per_rank;) {
+        i += queue_->pop_n(vals.data(), std::min(burst, count_per_rank - i));
+      }
+      USE(vals);
+#pragma omp barrier
+#pragma omp master
+      t_pop.Pause();
+    }
+
+    TestOutput("EnqueueBatch", t_push, count, nthreads);
+    TestOutput("DequeueBatch", t_pop, count, nthreads);
+    Destroy();
+  }
+
+  /**
+   * Half of the threads produce while the other half consume, all on a
+   * small queue, so both ends of the queue are contended.
+   * */
+  void ContentionTest(size_t count_per_rank, int nthreads) {
+    Timer t;
+    int nproducers = nthreads / 2;
+    size_t count = count_per_rank * nproducers;
+    Allocate(1024, count_per_rank, nthreads);
+
+    t.Resume();
+    omp_set_dynamic(0);
+#pragma omp parallel num_threads(nthreads)
+    {
+      int rank = omp_get_thread_num();
+      StringOrInt<T> var(124);
+      T x;
+      for (size_t i = 0; i < count_per_rank; ++i) {
+        if (rank < nproducers) {
+          while (queue_->emplace(var.Get()).IsNull()) {
+            HSHM_THREAD_MODEL->Yield();
+          }
+        } else {
+          while (queue_->pop(x).IsNull()) {
+            HSHM_THREAD_MODEL->Yield();
+          }
+          USE(x);
+        }
+      }
+    }
+    t.Pause();
+
+    TestOutput("Contention", t, count, nthreads);
+    Destroy();
+  }
+
  private:
   /**====================================
    * Helpers
@@ -150,11 +246,17 @@ class QueueTest {
           queue_->emplace(var.Get());
         } else if constexpr (std::is_same_v<QueueT, hipc::spsc_queue<T>>) {
           queue_->emplace(var.Get());
+        } else if constexpr (std::is_same_v<QueueT, hipc::spsc_ring<T>>) {
+          queue_->emplace(var.Get());
         } else if constexpr (std::is_same_v<QueueT, hipc::ticket_queue<T>>) {
           queue_->emplace(var.Get());
         } else if constexpr (std::is_same_v<QueueT,
                                             hipc::split_ticket_queue<T>>) {
           queue_->emplace(var.Get());
+        } else if constexpr (std::is_same_v<QueueT, hipc::mpmc_queue<T>>) {
+          queue_->emplace(var.Get());
+        } else if constexpr (std::is_same_v<QueueT, hipc::dynamic_queue<T>>) {
+          queue_->emplace(var.Get());
         }
       }
     }
@@ -181,11 +283,18 @@ class QueueTest {
         } else if constexpr (std::is_same_v<QueueT, hipc::spsc_queue<T>>) {
           queue_->pop(x_);
           USE(x_);
+        } else if constexpr (std::is_same_v<QueueT, hipc::spsc_ring<T>>) {
+          queue_->pop(x_);
+          USE(x_);
         } else if constexpr (std::is_same_v<QueueT, hipc::ticket_queue<T>>) {
           while (queue_->pop(x_).IsNull());
         } else if constexpr (std::is_same_v<QueueT,
                                             hipc::split_ticket_queue<T>>) {
           while (queue_->pop(x_).IsNull());
+        } else if constexpr (std::is_same_v<QueueT, hipc::mpmc_queue<T>>) {
+          while (queue_->pop(x_).IsNull());
+        } else if constexpr (std::is_same_v<QueueT, hipc::dynamic_queue<T>>) {
+          while (queue_->pop(x_).IsNull());
         }
       }
     }
@@ -207,12 +316,21 @@ class QueueTest {
     } else if constexpr (std::is_same_v<QueueT, hipc::spsc_queue<T>>) {
       queue_ =
           alloc->template NewObjLocal<QueueT>(HSHM_DEFAULT_MEM_CTX, count).ptr_;
+    } else if constexpr (std::is_same_v<QueueT, hipc::spsc_ring<T>>) {
+      queue_ =
+          alloc->template NewObjLocal<QueueT>(HSHM_DEFAULT_MEM_CTX, count).ptr_;
     } else if constexpr (std::is_same_v<QueueT, hipc::ticket_queue<T>>) {
       queue_ =
           alloc->template NewObjLocal<QueueT>(HSHM_DEFAULT_MEM_CTX, count).ptr_;
     } else if constexpr (std::is_same_v<QueueT, hipc::split_ticket_queue<T>>) {
+      queue_ = alloc->template NewObjLocal<QueueT>(HSHM_DEFAULT_MEM_CTX,
+                                                   count_per_rank, nthreads)
+                   .ptr_;
+    } else if constexpr (std::is_same_v<QueueT, hipc::mpmc_queue<T>>) {
       queue_ =
-          alloc->template NewObjLocal<QueueT>(count_per_rank, nthreads).ptr_;
+          alloc->template NewObjLocal<QueueT>(HSHM_DEFAULT_MEM_CTX, count).ptr_;
+    } else if constexpr (std::is_same_v<QueueT, hipc::dynamic_queue<T>>) {
+      queue_ = alloc->template NewObjLocal<QueueT>(HSHM_DEFAULT_MEM_CTX).ptr_;
     }
   }
 
@@ -227,14 +345,71 @@ class QueueTest {
       HSHM_DEFAULT_ALLOC->DelObj(HSHM_DEFAULT_MEM_CTX, queue_);
     } else if constexpr (std::is_same_v<QueueT, hipc::spsc_queue<T>>) {
       HSHM_DEFAULT_ALLOC->DelObj(HSHM_DEFAULT_MEM_CTX, queue_);
+    } else if constexpr (std::is_same_v<QueueT, hipc::spsc_ring<T>>) {
+      HSHM_DEFAULT_ALLOC->DelObj(HSHM_DEFAULT_MEM_CTX, queue_);
     } else if constexpr (std::is_same_v<QueueT, hipc::ticket_queue<T>>) {
       HSHM_DEFAULT_ALLOC->DelObj(HSHM_DEFAULT_MEM_CTX, queue_);
     } else if constexpr (std::is_same_v<QueueT, hipc::split_ticket_queue<T>>) {
       HSHM_DEFAULT_ALLOC->DelObj(HSHM_DEFAULT_MEM_CTX, queue_);
+    } else if constexpr (std::is_same_v<QueueT, hipc::mpmc_queue<T>>) {
+      HSHM_DEFAULT_ALLOC->DelObj(HSHM_DEFAULT_MEM_CTX, queue_);
+    } else if constexpr (std::is_same_v<QueueT, hipc::dynamic_queue<T>>) {
+      HSHM_DEFAULT_ALLOC->DelObj(HSHM_DEFAULT_MEM_CTX, queue_);
     }
   }
 };
 
+/**
+ * One owner pushes tasks in bursts and pops part of each burst back,
+ * while \a nthieves threads steal, as in a task-parallel runtime.
+ * OUTPUT:
+ * Steal,hipc::ws_deque,[internal_type],[nthreads],[time_ms],[MOps]
+ * */
+void WsDequeStealTest(size_t count, int nthieves) {
+  auto alloc = HSHM_DEFAULT_ALLOC;
+  auto *deque = alloc->template NewObjLocal<hipc::ws_deque<size_t>>(
+                         HSHM_DEFAULT_MEM_CTX, 1024)
+                    .ptr_;
+  hipc::atomic<bool> done(false);
+  Timer t;
+
+  t.Resume();
+  omp_set_dynamic(0);
+#pragma omp parallel num_threads(nthieves + 1)
+  {
+    int rank = omp_get_thread_num();
+    size_t x;
+    if (rank == 0) {
+      for (size_t i = 0; i < count;) {
+        for (size_t j = 0; j < 64 && i < count; ++j, ++i) {
+          deque->push(i);
+        }
+        for (int j = 0; j < 16 && !deque->pop(x).IsNull(); ++j) {
+        }
+      }
+      while (!deque->pop(x).IsNull()) {
+      }
+      done = true;
+    } else {
+      while (true) {
+        if (!deque->steal(x).IsNull()) {
+          continue;
+        }
+        if (done.load()) {
+          break;
+        }
+        HSHM_THREAD_MODEL->Yield();
+      }
+    }
+  }
+  t.Pause();
+
+  HIPRINT("{},{},{},{},{}ms,{}MOps\n", "Steal", "hipc::ws_deque",
+          InternalTypeName<size_t>::Get(), nthieves + 1, t.GetMsec(),
+          (float)count / t.GetUsec());
+  alloc->DelObj(HSHM_DEFAULT_MEM_CTX, deque);
+}
+
 void FullQueueTest() {
   const size_t count_per_rank = (1 << 20);
   //  // std::queue tests
@@ -270,6 +445,50 @@ void FullQueueTest() {
   QueueTest<size_t, hipc::spsc_queue<size_t>>().Test(count_per_rank, 1);
   QueueTest<std::string, hipc::spsc_queue<std::string>>().Test();
   QueueTest<hipc::string, hipc::spsc_queue<hipc::string>>().Test();
+
+  // hipc::spsc_ring tests
+  QueueTest<size_t, hipc::spsc_ring<size_t>>().Test(count_per_rank, 1);
+  QueueTest<hipc::string, hipc::spsc_ring<hipc::string>>().Test();
+
+  // hipc::mpmc_queue tests
+  QueueTest<size_t, hipc::mpmc_queue<size_t>>().Test(count_per_rank, 1);
+  QueueTest<size_t, hipc::mpmc_queue<size_t>>().Test(count_per_rank, 8);
+
+  // Batched push_n / pop_n with bursts of 32
+  QueueTest<size_t, hipc::spsc_queue<size_t>>().TestBatch(count_per_rank, 1);
+  QueueTest<size_t, hipc::spsc_ring<size_t>>().TestBatch(count_per_rank, 1);
+  QueueTest<size_t, hipc::mpsc_queue<size_t>>().TestBatch(count_per_rank, 1);
+  QueueTest<size_t, hipc::mpmc_queue<size_t>>().TestBatch(count_per_rank, 1);
+  QueueTest<size_t, hipc::mpmc_queue<size_t>>().TestBatch(count_per_rank, 8);
+  QueueTest<hipc::string, hipc::mpsc_queue<hipc::string>>().TestBatch();
+
+  // hipc::dynamic_queue tests
+  QueueTest<size_t, hipc::dynamic_queue<size_t>>().Test(count_per_rank, 1);
+  QueueTest<size_t, hipc::dynamic_queue<size_t>>().Test(count_per_rank, 8);
+
+  // Streaming: one producer and one consumer on a small ring
+  QueueTest<size_t, hipc::spsc_queue<size_t>>().TestContention(count_per_rank,
+                                                               2);
+  QueueTest<size_t, hipc::spsc_ring<size_t>>().TestContention(count_per_rank,
+                                                              2);
+
+  // Contention: mpmc_queue, dynamic_queue and the per-CPU lanes of
+  // split_ticket_queue vs. the mutex-based ticket_queue
+  for (int nthreads : {2, 4, 8, 16}) {
+    QueueTest<size_t, hipc::mpmc_queue<size_t>>().TestContention(
+        count_per_rank / 4, nthreads);
+    QueueTest<size_t, hipc::split_ticket_queue<size_t>>().TestContention(
+        count_per_rank / 4, nthreads);
+    QueueTest<size_t, hipc::dynamic_queue<size_t>>().TestContention(
+        count_per_rank / 4, nthreads);
+    QueueTest<size_t, hipc::ticket_queue<size_t>>().TestContention(
+        count_per_rank / 4, nthreads);
+  }
+
+  // Work stealing: one owner and 1-64 thieves
+  for (int nthieves : {1, 2, 4, 8, 16, 32, 64}) {
+    WsDequeStealTest(count_per_rank, nthieves);
+  }
 }
 
 TEST_CASE("QueueBenchmark") { FullQueueTest(); }
@@ -17,10 +17,12 @@
 #include <boost/unordered_map.hpp>
 
 // Std
+#include <random>
 #include <string>
 #include <unordered_map>
 
 // hermes
+#include "hermes_shm/data_structures/ipc/flat_map.h"
 #include "hermes_shm/data_structures/ipc/string.h"
 #include "hermes_shm/data_structures/ipc/unordered_map.h"
 
@@ -52,6 +54,8 @@ class UnorderedMapTest {
       map_type_ = "std::unordered_map";
     } else if constexpr (std::is_same_v<hipc::unordered_map<size_t, T>, MapT>) {
       map_type_ = "hipc::unordered_map";
+    } else if constexpr (std::is_same_v<hipc::flat_map<size_t, T>, MapT>) {
+      map_type_ = "hipc::flat_map";
     } else if constexpr (std::is_same_v<bipc_unordered_map<size_t, T>, MapT>) {
       map_type_ = "bipc::unordered_map";
     } else {
@@ -67,7 +71,10 @@ class UnorderedMapTest {
     size_t count = 100000;
     // AllocateTest(count);
     EmplaceTest(count);
+    EmplaceLatencyTest(count);
     GetTest(count);
+    RandomGetTest(count);
+    BatchGetTest(count);
     ForwardIteratorTest(count);
     // CopyTest(count);
     // MoveTest(count);
@@ -103,6 +110,26 @@ class UnorderedMapTest {
     Destroy();
   }
 
+  /** Tail latency of emplace, which is dominated by table growth */
+  void EmplaceLatencyTest(size_t count) {
+    StringOrInt<T> var(124);
+    std::vector<double> lat(count);
+    Allocate();
+    for (size_t i = 0; i < count; ++i) {
+      hshm::Timepoint start;
+      start.Now();
+      EmplaceOne(i, var);
+      lat[i] = start.GetUsecFromStart();
+    }
+    Destroy();
+
+    std::sort(lat.begin(), lat.end());
+    HIPRINT("{},{},{},{}\n", "EmplaceP99Usec", map_type_, internal_type_,
+            lat[count * 99 / 100]);
+    HIPRINT("{},{},{},{}\n", "EmplaceMaxUsec", map_type_, internal_type_,
+            lat[count - 1]);
+  }
+
   /** Get performance */
   void GetTest(size_t count) {
     Timer t;
@@ -121,6 +148,50 @@ class UnorderedMapTest {
     Destroy();
   }
 
+  /** Get performance with keys in a random order */
+  void RandomGetTest(size_t count) {
+    Timer t;
+    std::vector<size_t> keys = RandomKeys(count);
+
+    Allocate();
+    Emplace(count);
+
+    t.Resume();
+    for (size_t i = 0; i < count; ++i) {
+      Get(keys[i]);
+    }
+    t.Pause();
+
+    TestOutput("RandomGet", t);
+    Destroy();
+  }
+
+  /** Get performance of random keys with batched lookups (find_many) */
+  void BatchGetTest(size_t count) {
+    if constexpr (std::is_same_v<MapT, hipc::unordered_map<size_t, T>>) {
+      constexpr size_t kBatch = 256;
+      Timer t;
+      std::vector<size_t> keys = RandomKeys(count);
+      std::vector<typename MapT::iterator_t> iters(kBatch);
+
+      Allocate();
+      Emplace(count);
+
+      t.Resume();
+      for (size_t off = 0; off < count; off += kBatch) {
+        size_t n = std::min(kBatch, count - off);
+        map_->find_many(keys.data() + off, n, iters.data());
+        for (size_t i = 0; i < n; ++i) {
+          USE(*iters[i]);
+        }
+      }
+      t.Pause();
+
+      TestOutput("BatchGet", t);
+      Destroy();
+    }
+  }
+
   /** Iterator performance */
   void ForwardIteratorTest(size_t count) {
     Timer t;
@@ -181,6 +252,16 @@ class UnorderedMapTest {
     HIPRINT("{},{},{},{}\n", test_name, map_type_, internal_type_, t.GetMsec());
   }
 
+  /** The keys [0, count) in a fixed random order */
+  std::vector<size_t> RandomKeys(size_t count) {
+    std::vector<size_t> keys(count);
+    for (size_t i = 0; i < count; ++i) {
+      keys[i] = i;
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    return keys;
+  }
+
   /** Get element at position i */
   void Get(size_t i) {
     if constexpr (std::is_same_v<MapT, std::unordered_map<size_t, T>>) {
@@ -192,6 +273,9 @@ class UnorderedMapTest {
     } else if constexpr (std::is_same_v<MapT, hipc::unordered_map<size_t, T>>) {
       T &x = (*map_)[i];
       USE(x);
+    } else if constexpr (std::is_same_v<MapT, hipc::flat_map<size_t, T>>) {
+      T &x = (*map_)[i];
+      USE(x);
     }
   }
 
@@ -199,15 +283,21 @@ class UnorderedMapTest {
   void Emplace(size_t count) {
     StringOrInt<T> var(124);
     for (size_t i = 0; i < count; ++i) {
-      if constexpr (std::is_same_v<MapT, std::unordered_map<size_t, T>>) {
-        map_->emplace(i, var.Get());
-      } else if constexpr (std::is_same_v<MapT,
-                                          bipc_unordered_map<size_t, T>>) {
-        map_->emplace(i, var.Get());
-      } else if constexpr (std::is_same_v<MapT,
-                                          hipc::unordered_map<size_t, T>>) {
-        map_->emplace(i, var.Get());
-      }
+      EmplaceOne(i, var);
+    }
+  }
+
+  /** Emplace a single element into the unordered_map */
+  void EmplaceOne(size_t i, StringOrInt<T> &var) {
+    if constexpr (std::is_same_v<MapT, std::unordered_map<size_t, T>>) {
+      map_->emplace(i, var.Get());
+    } else if constexpr (std::is_same_v<MapT, bipc_unordered_map<size_t, T>>) {
+      map_->emplace(i, var.Get());
+    } else if constexpr (std::is_same_v<MapT,
+                                        hipc::unordered_map<size_t, T>>) {
+      map_->emplace(i, var.Get());
+    } else if constexpr (std::is_same_v<MapT, hipc::flat_map<size_t, T>>) {
+      map_->emplace(i, var.Get());
     }
   }
 
@@ -216,6 +306,8 @@ class UnorderedMapTest {
     auto alloc = HSHM_DEFAULT_ALLOC;
     if constexpr (std::is_same_v<MapT, hipc::unordered_map<size_t, T>>) {
       map_ = alloc->template NewObjLocal<MapT>(HSHM_DEFAULT_MEM_CTX, 5000).ptr_;
+    } else if constexpr (std::is_same_v<MapT, hipc::flat_map<size_t, T>>) {
+      map_ = alloc->template NewObjLocal<MapT>(HSHM_DEFAULT_MEM_CTX, 5000).ptr_;
     } else if constexpr (std::is_same_v<MapT, std::unordered_map<size_t, T>>) {
       map_ = new std::unordered_map<size_t, T>();
     } else if constexpr (std::is_same_v<MapT, bipc_unordered_map<size_t, T>>) {
@@ -229,6 +321,8 @@ class UnorderedMapTest {
     auto alloc = HSHM_DEFAULT_ALLOC;
     if constexpr (std::is_same_v<MapT, hipc::unordered_map<size_t, T>>) {
       alloc->DelObj(HSHM_DEFAULT_MEM_CTX, map_);
+    } else if constexpr (std::is_same_v<MapT, hipc::flat_map<size_t, T>>) {
+      alloc->DelObj(HSHM_DEFAULT_MEM_CTX, map_);
     } else if constexpr (std::is_same_v<MapT, std::unordered_map<size_t, T>>) {
       delete map_;
     } else if constexpr (std::is_same_v<MapT, bipc_unordered_map<size_t, T>>) {
@@ -256,6 +350,12 @@ void FullUnorderedMapTest() {
       .Test();
   UnorderedMapTest<hipc::string, hipc::unordered_map<size_t, hipc::string>>()
       .Test();
+
+  // hipc::flat_map tests
+  UnorderedMapTest<size_t, hipc::flat_map<size_t, size_t>>().Test();
+  UnorderedMapTest<std::string, hipc::flat_map<size_t, std::string>>().Test();
+  UnorderedMapTest<hipc::string, hipc::flat_map<size_t, hipc::string>>()
+      .Test();
 }
 
 TEST_CASE("UnorderedMapBenchmark") { FullUnorderedMapTest(); }
@@ -175,6 +175,18 @@
 /** Test cross functions */
 #define HSHM_NO_INLINE_CROSS_FUN HSHM_NO_INLINE HSHM_CROSS_FUN HSHM_FUNC_IS_USED
 
+/** Hint that the cache line at \a ADDR will be read soon */
+#if defined(HSHM_IS_GPU) || defined(HSHM_COMPILER_MSVC)
+#define HSHM_PREFETCH(ADDR)
+#else
+#define HSHM_PREFETCH(ADDR) __builtin_prefetch((const void *)(ADDR), 0, 3)
+#endif
+
+/** The size of a cache line. Shared counters are padded to this size. */
+#ifndef HSHM_CACHE_LINE_SIZE
+#define HSHM_CACHE_LINE_SIZE 64
+#endif
+
 /** Bitfield macros */
 #define MARK_FIRST_BIT_MASK(T) ((T)1 << (sizeof(T) * 8 - 1))
 #define MARK_FIRST_BIT(T, X) ((X) | MARK_FIRST_BIT_MASK(T))
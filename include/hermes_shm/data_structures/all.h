@@ -15,25 +15,43 @@
 
 #include "hermes_shm/memory/memory_manager.h"
 #include "internal/shm_internal.h"
+#include "ipc/bitset.h"
+#include "ipc/bloom_filter.h"
+#include "ipc/broadcast_ring.h"
+#include "ipc/btree_map.h"
 #include "ipc/charwrap.h"
 #include "ipc/chararr.h"
+#include "ipc/concurrent_priority_queue.h"
+#include "ipc/concurrent_unordered_map.h"
+#include "ipc/cuckoo_filter.h"
 #include "ipc/dynamic_queue.h"
+#include "ipc/epoch_manager.h"
+#include "ipc/flat_map.h"
 #include "ipc/functional.h"
 #include "ipc/key_set.h"
 #include "ipc/lifo_list_queue.h"
 #include "ipc/list.h"
+#include "ipc/lru_cache.h"
+#include "ipc/mpmc_queue.h"
+#include "ipc/msg_ring.h"
 #include "ipc/mpsc_lifo_list_queue.h"
 #include "ipc/pair.h"
+#include "ipc/priority_queue.h"
+#include "ipc/radix_tree.h"
 #include "ipc/ring_ptr_queue.h"
 #include "ipc/ring_queue.h"
+#include "ipc/skiplist_map.h"
+#include "ipc/slot_map.h"
 #include "ipc/slist.h"
 #include "ipc/split_ticket_queue.h"
 #include "ipc/spsc_fifo_list_queue.h"
+#include "ipc/spsc_ring.h"
 #include "ipc/string.h"
 #include "ipc/ticket_queue.h"
 #include "ipc/tuple_base.h"
 #include "ipc/unordered_map.h"
 #include "ipc/vector.h"
+#include "ipc/ws_deque.h"
 #include "serialization/local_serialize.h"
 #include "serialization/serialize_common.h"
 
@@ -73,6 +91,25 @@
   using circular_spsc_queue = HSHM_NS::circular_spsc_queue<T, ALLOC_T>;      \
   template <typename T>                                                      \
   using ext_ring_buffer = HSHM_NS::ext_ring_buffer<T, ALLOC_T>;              \
+  template <typename T>                                                      \
+  using mpsc_wait_queue = HSHM_NS::mpsc_wait_queue<T, ALLOC_T>;              \
+  template <typename T>                                                      \
+  using spsc_wait_queue = HSHM_NS::spsc_wait_queue<T, ALLOC_T>;              \
+  template <typename T>                                                      \
+  using fixed_mpsc_wait_queue = HSHM_NS::fixed_mpsc_wait_queue<T, ALLOC_T>;  \
+  template <typename T>                                                      \
+  using mpmc_queue = HSHM_NS::mpmc_queue<T, ALLOC_T>;                        \
+  template <typename T>                                                      \
+  using spsc_ring = HSHM_NS::spsc_ring<T, ALLOC_T>;                          \
+  using spsc_msg_ring = HSHM_NS::spsc_msg_ring<ALLOC_T>;                     \
+  using mpsc_msg_ring = HSHM_NS::mpsc_msg_ring<ALLOC_T>;                     \
+  template <typename T>                                                      \
+  using broadcast_ring = HSHM_NS::broadcast_ring<T, ALLOC_T>;                \
+  template <typename T>                                                      \
+  using circular_broadcast_ring =                                            \
+      HSHM_NS::circular_broadcast_ring<T, ALLOC_T>;                          \
+  template <typename T>                                                      \
+  using ws_deque = HSHM_NS::ws_deque<T, ALLOC_T>;                            \
                                                                              \
   template <typename T>                                                      \
   using spsc_ptr_queue = HSHM_NS::spsc_ptr_queue<T, ALLOC_T>;                \
@@ -109,6 +146,42 @@
   template <typename Key, typename T, class Hash = hshm::hash<Key>>          \
   using unordered_map = HSHM_NS::unordered_map<Key, T, Hash, ALLOC_T>;       \
                                                                              \
+  template <typename Key, typename T, class Hash = hshm::hash<Key>>          \
+  using flat_map = HSHM_NS::flat_map<Key, T, Hash, ALLOC_T>;                 \
+                                                                             \
+  template <typename Key, typename T, class Hash = hshm::hash<Key>>          \
+  using concurrent_unordered_map =                                           \
+      HSHM_NS::concurrent_unordered_map<Key, T, Hash, ALLOC_T>;              \
+                                                                             \
+  template <typename T, class Hash = hshm::hash<T>>                          \
+  using bloom_filter = HSHM_NS::bloom_filter<T, Hash, ALLOC_T>;              \
+                                                                             \
+  template <typename T, class Hash = hshm::hash<T>>                          \
+  using cuckoo_filter = HSHM_NS::cuckoo_filter<T, Hash, ALLOC_T>;            \
+                                                                             \
+  template <typename Key, typename T, class Hash = hshm::hash<Key>,          \
+            class OnEvict = hshm::ipc::lru_cache_no_evict>                   \
+  using lru_cache = HSHM_NS::lru_cache<Key, T, Hash, OnEvict, ALLOC_T>;      \
+                                                                             \
+  template <typename PointerT = hshm::ipc::Pointer>                          \
+  using epoch_manager = HSHM_NS::epoch_manager<PointerT, ALLOC_T>;           \
+                                                                             \
+  template <typename Key, typename T, class Compare = hshm::less<Key>>       \
+  using btree_map = HSHM_NS::btree_map<Key, T, Compare, ALLOC_T>;            \
+                                                                             \
+  template <typename T>                                                      \
+  using radix_tree = HSHM_NS::radix_tree<T, ALLOC_T>;                        \
+                                                                             \
+  template <typename Key, typename T, class Compare = hshm::less<Key>>       \
+  using skiplist_map = HSHM_NS::skiplist_map<Key, T, Compare, ALLOC_T>;      \
+                                                                             \
+  template <typename T, class Compare = hshm::less<T>>                       \
+  using priority_queue = HSHM_NS::priority_queue<T, Compare, 4, ALLOC_T>;    \
+                                                                             \
+  template <typename T, class Compare = hshm::less<T>>                       \
+  using concurrent_priority_queue =                                          \
+      HSHM_NS::concurrent_priority_queue<T, Compare, 4, ALLOC_T>;            \
+                                                                             \
   template <typename T>                                                      \
   using vector = HSHM_NS::vector<T, ALLOC_T>;                                \
                                                                              \
@@ -119,6 +192,13 @@
   using mpmc_key_set = HSHM_NS::mpmc_key_set<T, ALLOC_T>;                    \
                                                                              \
   template <typename T>                                                      \
+  using slot_map = HSHM_NS::slot_map<T, ALLOC_T>;                            \
+                                                                             \
+  template <bool ATOMIC>                                                     \
+  using bitset_templ = HSHM_NS::bitset_templ<ATOMIC, ALLOC_T>;               \
+  using bitset = HSHM_NS::bitset<ALLOC_T>;                                   \
+                                                                             \
+  template <typename T>                                                      \
   using dynamic_queue = HSHM_NS::dynamic_queue<T, ALLOC_T>;                  \
   }  // namespace NS
 
@@ -15,6 +15,12 @@
 
 #include <hermes_shm/constants/macros.h>
 #include <hermes_shm/types/numbers.h>
+#include <hermes_shm/util/errors.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <utility>
 
 namespace hshm {
 
@@ -26,13 +32,13 @@ using iterator_type_v =
 /** Swap two values */
 template <typename T>
 HSHM_CROSS_FUN void swap(T &a, T &b) {
-  T tmp = a;
-  a = b;
-  b = tmp;
+  T tmp(std::move(a));
+  a = std::move(b);
+  b = std::move(tmp);
 }
 
 /** Default sorting algorithm */
-#define HSHM_DEFAULT_SORT_CMP hshm ::less_than<iterator_type_v<IterT>>
+#define HSHM_DEFAULT_SORT_CMP hshm ::LessThan<iterator_type_v<IterT>>()
 
 /** Greater than comparison */
 template <typename IterT>
@@ -50,8 +56,19 @@ HSHM_CROSS_FUN bool less_than(const IterT &a, const IterT &b) {
 template <typename T>
 using Comparitor = bool (*)(const T &a, const T &b);
 
+/**
+ * Default comparitor. A functor rather than a Comparitor, so the
+ * comparison inlines into the sort loops.
+ * */
+template <typename T>
+struct LessThan {
+  HSHM_INLINE_CROSS_FUN bool operator()(const T &a, const T &b) const {
+    return a < b;
+  }
+};
+
 /** Check if a set of values is sorted */
-template <typename IterT, typename CmpT = Comparitor<iterator_type_v<IterT>>>
+template <typename IterT, typename CmpT = LessThan<iterator_type_v<IterT>>>
 HSHM_CROSS_FUN bool is_sorted(IterT start, const IterT &end,
                               CmpT &&cmp = HSHM_DEFAULT_SORT_CMP) {
   if (start == end) {
@@ -60,7 +77,7 @@ HSHM_CROSS_FUN bool is_sorted(IterT start, const IterT &end,
   auto prev = start;
   ++start;
   for (; start != end; ++start) {
-    if (!cmp(*prev, *start)) {
+    if (cmp(*start, *prev)) {
       return false;
     }
     ++prev;
@@ -69,34 +86,40 @@ HSHM_CROSS_FUN bool is_sorted(IterT start, const IterT &end,
 }
 
 /** General sort forward declaration */
-template <typename IterT, typename CmpT = Comparitor<iterator_type_v<IterT>>,
-          int INSERT_SORT_CUTOFF = 32>
+template <typename IterT, typename CmpT = LessThan<iterator_type_v<IterT>>,
+          int INSERT_SORT_CUTOFF = 24>
 HSHM_CROSS_FUN void sort(IterT start, const IterT &end,
                          CmpT &&cmp = HSHM_DEFAULT_SORT_CMP);
 
 /** Insertion sort forward declaration */
-template <typename IterT, typename CmpT = Comparitor<iterator_type_v<IterT>>>
+template <typename IterT, typename CmpT = LessThan<iterator_type_v<IterT>>>
 HSHM_CROSS_FUN void insertion_sort(IterT start, const IterT &end,
                                    CmpT &&cmp = HSHM_DEFAULT_SORT_CMP);
 
 /** heap_sort forward declaration */
-template <typename IterT, typename CmpT = Comparitor<iterator_type_v<IterT>>>
+template <typename IterT, typename CmpT = LessThan<iterator_type_v<IterT>>>
 HSHM_CROSS_FUN void heap_sort(IterT start, const IterT &end,
                               CmpT &&cmp = HSHM_DEFAULT_SORT_CMP);
 
 /** Quicksort forward declaration */
-template <typename IterT, typename CmpT = Comparitor<iterator_type_v<IterT>>>
+template <typename IterT, typename CmpT = LessThan<iterator_type_v<IterT>>>
 HSHM_CROSS_FUN void quick_sort(IterT start, const IterT &end,
                                CmpT &&cmp = HSHM_DEFAULT_SORT_CMP);
 
-/** Sort using either insertion sort of quick_sort */
+/** Pattern-defeating quicksort forward declaration */
+template <typename IterT, typename CmpT = LessThan<iterator_type_v<IterT>>,
+          int INSERT_SORT_CUTOFF = 24>
+HSHM_CROSS_FUN void pdq_sort(IterT start, const IterT &end,
+                             CmpT &&cmp = HSHM_DEFAULT_SORT_CMP);
+
+/**
+ * Sort a set of values. Uses pdq_sort, which is O(n log n) in the worst
+ * case and linear on sorted, reversed and all-equal inputs.
+ * */
 template <typename IterT, typename CmpT, int INSERT_SORT_CUTOFF>
 HSHM_CROSS_FUN void sort(IterT start, const IterT &end, CmpT &&cmp) {
-  if (end - start < INSERT_SORT_CUTOFF) {
-    insertion_sort(start, end, cmp);
-  } else {
-    quick_sort(start, end, cmp);
-  }
+  pdq_sort<IterT, CmpT, INSERT_SORT_CUTOFF>(start, end,
+                                            std::forward<CmpT>(cmp));
 }
 
 /** Sort a set of values using insertion sort */
@@ -105,29 +128,38 @@ HSHM_CROSS_FUN void insertion_sort(IterT start, const IterT &end, CmpT &&cmp) {
   if (start == end) {
     return;
   }
-  for (auto i = start; i != end; ++i) {
-    auto j = i;
-    while (j != start && cmp(*(j), *(j - 1))) {
-      swap(*j, *(j - 1));
-      --j;
+  for (IterT cur = start + 1; cur != end; ++cur) {
+    IterT sift = cur;
+    IterT sift_1 = cur - 1;
+    if (cmp(*sift, *sift_1)) {
+      iterator_type_v<IterT> tmp(std::move(*sift));
+      do {
+        *sift = std::move(*sift_1);
+        --sift;
+      } while (sift != start && cmp(tmp, *(--sift_1)));
+      *sift = std::move(tmp);
     }
   }
 }
 
-/** Build a hepa from a vector */
+/** Sift the value at \a i down a heap of \a n values */
 template <typename IterT, typename CmpT>
 HSHM_CROSS_FUN void heapify(IterT start, size_t n, size_t i, CmpT &&cmp) {
-  size_t largest = i;
-  size_t left = 2 * i + 1;
-  size_t right = 2 * i + 2;
-
-  if (left < n && cmp(*(start + largest), *(start + left))) largest = left;
-
-  if (right < n && cmp(*(start + largest), *(start + right))) largest = right;
-
-  if (largest != i) {
-    swap(*(start + i), *(start + largest));
-    heapify(start, n, largest, cmp);
+  while (true) {
+    size_t largest = i;
+    size_t left = 2 * i + 1;
+    size_t right = 2 * i + 2;
+    if (left < n && cmp(*(start + largest), *(start + left))) {
+      largest = left;
+    }
+    if (right < n && cmp(*(start + largest), *(start + right))) {
+      largest = right;
+    }
+    if (largest == i) {
+      return;
+    }
+    hshm::swap(*(start + i), *(start + largest));
+    i = largest;
   }
 }
 
@@ -137,12 +169,14 @@ HSHM_CROSS_FUN void heap_sort(IterT start, const IterT &end, CmpT &&cmp) {
   size_t n = end - start;
 
   // Build heap
-  for (int i = n / 2 - 1; i >= 0; i--) heapify(start, n, i, cmp);
+  for (size_t i = n / 2; i > 0; --i) {
+    heapify(start, n, i - 1, cmp);
+  }
 
   // Extract elements from heap one by one
-  for (int i = n - 1; i > 0; i--) {
-    swap(*start, *(start + i));
-    heapify(start, i, 0, cmp);
+  for (size_t i = n; i > 1; --i) {
+    hshm::swap(*start, *(start + (i - 1)));
+    heapify(start, i - 1, 0, cmp);
   }
 }
 
@@ -154,17 +188,390 @@ HSHM_CROSS_FUN void quick_sort(IterT start, const IterT &end, CmpT &&cmp) {
   }
   auto pivot = start + (end - start) / 2;
   auto pivot_val = *pivot;
-  swap(*pivot, *(end - 1));
+  hshm::swap(*pivot, *(end - 1));
   auto store = start;
   for (auto i = start; i < end - 1; ++i) {
     if (cmp(*(i), *(end - 1))) {
-      swap(*store, *i);
+      hshm::swap(*store, *i);
       ++store;
     }
   }
-  swap(*store, *(end - 1));
-  sort(start, store, cmp);
-  sort(store + 1, end, cmp);
+  hshm::swap(*store, *(end - 1));
+  hshm::sort(start, store, cmp);
+  hshm::sort(store + 1, end, cmp);
+}
+
+/**====================================
+ * Pattern-defeating quicksort
+ *
+ * Follows Orson Peters' pdqsort: median-of-3 (ninther for large ranges)
+ * pivots, runs of keys equal to the previous pivot are split off in one
+ * pass, partitions that swapped nothing are finished with a bounded
+ * insertion sort, and too many unbalanced partitions fall back to
+ * heap_sort.
+ * ===================================*/
+
+/** Ranges larger than this pick the pivot with Tukey's ninther */
+static const size_t kPdqNintherThreshold = 128;
+
+/** partial_insertion_sort gives up after moving this many elements */
+static const size_t kPdqPartialInsertionLimit = 8;
+
+/**
+ * Insertion sort for a range whose predecessor is no greater than any of
+ * its values, which lets the inner loop skip the bounds check.
+ * */
+template <typename IterT, typename CmpT>
+HSHM_CROSS_FUN void unguarded_insertion_sort(IterT start, const IterT &end,
+                                             CmpT &&cmp) {
+  if (start == end) {
+    return;
+  }
+  for (IterT cur = start + 1; cur != end; ++cur) {
+    IterT sift = cur;
+    IterT sift_1 = cur - 1;
+    if (cmp(*sift, *sift_1)) {
+      iterator_type_v<IterT> tmp(std::move(*sift));
+      do {
+        *sift = std::move(*sift_1);
+        --sift;
+      } while (cmp(tmp, *(--sift_1)));
+      *sift = std::move(tmp);
+    }
+  }
+}
+
+/**
+ * Insertion sort that gives up once it has moved more than
+ * kPdqPartialInsertionLimit elements. Returns whether the range is sorted.
+ * */
+template <typename IterT, typename CmpT>
+HSHM_CROSS_FUN bool partial_insertion_sort(IterT start, const IterT &end,
+                                           CmpT &&cmp) {
+  if (start == end) {
+    return true;
+  }
+  size_t moved = 0;
+  for (IterT cur = start + 1; cur != end; ++cur) {
+    IterT sift = cur;
+    IterT sift_1 = cur - 1;
+    if (cmp(*sift, *sift_1)) {
+      iterator_type_v<IterT> tmp(std::move(*sift));
+      do {
+        *sift = std::move(*sift_1);
+        --sift;
+      } while (sift != start && cmp(tmp, *(--sift_1)));
+      *sift = std::move(tmp);
+      moved += cur - sift;
+    }
+    if (moved > kPdqPartialInsertionLimit) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Order two values */
+template <typename IterT, typename CmpT>
+HSHM_INLINE_CROSS_FUN void pdq_sort2(IterT a, IterT b, CmpT &&cmp) {
+  if (cmp(*b, *a)) {
+    hshm::swap(*a, *b);
+  }
+}
+
+/** Order three values */
+template <typename IterT, typename CmpT>
+HSHM_INLINE_CROSS_FUN void pdq_sort3(IterT a, IterT b, IterT c, CmpT &&cmp) {
+  pdq_sort2(a, b, cmp);
+  pdq_sort2(b, c, cmp);
+  pdq_sort2(a, b, cmp);
+}
+
+/**
+ * Partition around the pivot at \a start: smaller values to the left,
+ * values not smaller to the right. Requires a value not smaller than the
+ * pivot at end - 1. Returns the final pivot position, and sets
+ * \a already_partitioned if no swaps were needed.
+ * */
+template <typename IterT, typename CmpT>
+HSHM_CROSS_FUN IterT pdq_partition_right(IterT start, const IterT &end,
+                                         CmpT &&cmp,
+                                         bool &already_partitioned) {
+  iterator_type_v<IterT> pivot(std::move(*start));
+  IterT first = start;
+  IterT last = end;
+  // Find the first value not smaller than the pivot
+  do {
+    ++first;
+  } while (cmp(*first, pivot));
+  // Find the last value smaller than the pivot. Unguarded unless no
+  // value was skipped above.
+  if (first - 1 == start) {
+    while (first < last) {
+      --last;
+      if (cmp(*last, pivot)) {
+        break;
+      }
+    }
+  } else {
+    do {
+      --last;
+    } while (!cmp(*last, pivot));
+  }
+  already_partitioned = first >= last;
+  while (first < last) {
+    hshm::swap(*first, *last);
+    do {
+      ++first;
+    } while (cmp(*first, pivot));
+    do {
+      --last;
+    } while (!cmp(*last, pivot));
+  }
+  IterT pivot_pos = first - 1;
+  *start = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+  return pivot_pos;
+}
+
+/**
+ * Partition around the pivot at \a start, with values equal to the
+ * pivot to the left. Used when the pivot equals the predecessor of the
+ * range, so the left part is all equal and needs no further sorting.
+ * */
+template <typename IterT, typename CmpT>
+HSHM_CROSS_FUN IterT pdq_partition_left(IterT start, const IterT &end,
+                                        CmpT &&cmp) {
+  iterator_type_v<IterT> pivot(std::move(*start));
+  IterT first = start;
+  IterT last = end;
+  do {
+    --last;
+  } while (cmp(pivot, *last));
+  if (last + 1 == end) {
+    while (first < last) {
+      ++first;
+      if (cmp(pivot, *first)) {
+        break;
+      }
+    }
+  } else {
+    do {
+      ++first;
+    } while (!cmp(pivot, *first));
+  }
+  while (first < last) {
+    hshm::swap(*first, *last);
+    do {
+      --last;
+    } while (cmp(pivot, *last));
+    do {
+      ++first;
+    } while (!cmp(pivot, *first));
+  }
+  IterT pivot_pos = last;
+  *start = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+  return pivot_pos;
+}
+
+/** The main pdq_sort loop. Recurses on the left part and loops on the right. */
+template <typename IterT, typename CmpT, int INSERT_SORT_CUTOFF>
+HSHM_CROSS_FUN void pdq_sort_loop(IterT start, IterT end, CmpT &&cmp,
+                                  int bad_allowed, bool leftmost) {
+  while (true) {
+    size_t size = end - start;
+    if (size < (size_t)INSERT_SORT_CUTOFF) {
+      if (leftmost) {
+        insertion_sort(start, end, cmp);
+      } else {
+        unguarded_insertion_sort(start, end, cmp);
+      }
+      return;
+    }
+
+    // Move the pivot to start
+    size_t half = size / 2;
+    if (size > kPdqNintherThreshold) {
+      pdq_sort3(start, start + half, end - 1, cmp);
+      pdq_sort3(start + 1, start + (half - 1), end - 2, cmp);
+      pdq_sort3(start + 2, start + (half + 1), end - 3, cmp);
+      pdq_sort3(start + (half - 1), start + half, start + (half + 1), cmp);
+      hshm::swap(*start, *(start + half));
+    } else {
+      pdq_sort3(start + half, start, end - 1, cmp);
+    }
+
+    // A pivot equal to the predecessor starts a run of equal values
+    if (!leftmost && !cmp(*(start - 1), *start)) {
+      start = pdq_partition_left(start, end, cmp) + 1;
+      continue;
+    }
+
+    bool already_partitioned;
+    IterT pivot_pos = pdq_partition_right(start, end, cmp,
+                                          already_partitioned);
+    size_t l_size = pivot_pos - start;
+    size_t r_size = end - (pivot_pos + 1);
+    if (l_size < size / 8 || r_size < size / 8) {
+      // Unbalanced: give up after too many, otherwise break up patterns
+      if (--bad_allowed == 0) {
+        heap_sort(start, end, cmp);
+        return;
+      }
+      if (l_size >= (size_t)INSERT_SORT_CUTOFF) {
+        hshm::swap(*start, *(start + l_size / 4));
+        hshm::swap(*(pivot_pos - 1), *(pivot_pos - l_size / 4));
+        if (l_size > kPdqNintherThreshold) {
+          hshm::swap(*(start + 1), *(start + (l_size / 4 + 1)));
+          hshm::swap(*(start + 2), *(start + (l_size / 4 + 2)));
+          hshm::swap(*(pivot_pos - 2), *(pivot_pos - (l_size / 4 + 1)));
+          hshm::swap(*(pivot_pos - 3), *(pivot_pos - (l_size / 4 + 2)));
+        }
+      }
+      if (r_size >= (size_t)INSERT_SORT_CUTOFF) {
+        hshm::swap(*(pivot_pos + 1), *(pivot_pos + (1 + r_size / 4)));
+        hshm::swap(*(end - 1), *(end - r_size / 4));
+        if (r_size > kPdqNintherThreshold) {
+          hshm::swap(*(pivot_pos + 2), *(pivot_pos + (2 + r_size / 4)));
+          hshm::swap(*(pivot_pos + 3), *(pivot_pos + (3 + r_size / 4)));
+          hshm::swap(*(end - 2), *(end - (1 + r_size / 4)));
+          hshm::swap(*(end - 3), *(end - (2 + r_size / 4)));
+        }
+      }
+    } else if (already_partitioned &&
+               partial_insertion_sort(start, pivot_pos, cmp) &&
+               partial_insertion_sort(pivot_pos + 1, end, cmp)) {
+      // The input was (nearly) sorted
+      return;
+    }
+
+    pdq_sort_loop<IterT, CmpT, INSERT_SORT_CUTOFF>(start, pivot_pos, cmp,
+                                                   bad_allowed, leftmost);
+    start = pivot_pos + 1;
+    leftmost = false;
+  }
+}
+
+/** Sort a set of values using pattern-defeating quicksort */
+template <typename IterT, typename CmpT, int INSERT_SORT_CUTOFF>
+HSHM_CROSS_FUN void pdq_sort(IterT start, const IterT &end, CmpT &&cmp) {
+  size_t size = end - start;
+  if (size < 2) {
+    return;
+  }
+  int log2 = 0;
+  while (size >>= 1) {
+    ++log2;
+  }
+  pdq_sort_loop<IterT, CmpT &, INSERT_SORT_CUTOFF>(start, end, cmp, log2,
+                                                   true);
+}
+
+/**====================================
+ * Radix sort
+ * ===================================*/
+
+/**
+ * Map an integral or floating-point key to an unsigned integer with the
+ * same order: signed integers flip the sign bit, and negative floats flip
+ * every bit.
+ * */
+template <typename KeyT>
+HSHM_INLINE_CROSS_FUN auto radix_key(const KeyT &key) {
+  static_assert(std::is_arithmetic_v<KeyT>,
+                "radix keys must be integral or floating point");
+  if constexpr (sizeof(KeyT) == 1) {
+    u8 bits;
+    memcpy(&bits, &key, 1);
+    return std::is_same_v<KeyT, bool> || std::is_unsigned_v<KeyT>
+               ? bits
+               : (u8)(bits ^ 0x80);
+  } else if constexpr (std::is_floating_point_v<KeyT>) {
+    using UintT = std::conditional_t<sizeof(KeyT) == 4, u32, u64>;
+    UintT bits;
+    memcpy(&bits, &key, sizeof(KeyT));
+    UintT sign = (UintT)1 << (8 * sizeof(KeyT) - 1);
+    return (UintT)((bits & sign) ? ~bits : (bits | sign));
+  } else {
+    using UintT = std::make_unsigned_t<KeyT>;
+    UintT bits = (UintT)key;
+    if constexpr (std::is_signed_v<KeyT>) {
+      bits ^= (UintT)1 << (8 * sizeof(KeyT) - 1);
+    }
+    return bits;
+  }
+}
+
+/**
+ * Stable LSD radix sort on the key \a get_key(value), which must be
+ * integral or floating point. Sorts 8 bits per pass and skips passes in
+ * which every key has the same digit, so narrow key ranges cost fewer
+ * passes. Values must be trivially copyable; they are sorted in a
+ * private scratch buffer of the same size as the range. Throws
+ * OUT_OF_MEMORY if the buffer cannot be allocated.
+ * */
+template <typename IterT, typename KeyFn>
+HSHM_HOST_FUN void radix_sort(IterT start, const IterT &end,
+                              KeyFn &&get_key) {
+  using T = std::remove_cv_t<iterator_type_v<IterT>>;
+  using KeyT = decltype(radix_key(get_key(std::declval<const T &>())));
+  static_assert(std::is_trivially_copyable_v<T>,
+                "radix_sort values must be trivially copyable");
+  constexpr size_t kDigits = sizeof(KeyT);
+  size_t n = end - start;
+  if (n < 2) {
+    return;
+  }
+  size_t size = 2 * n * sizeof(T);
+  T *buf = (T *)malloc(size);
+  if (buf == nullptr) {
+    HSHM_THROW_ERROR(OUT_OF_MEMORY, size, (size_t)0);
+  }
+  T *src = buf;
+  T *dst = buf + n;
+  // One pass counts the digits of every byte of the key
+  size_t counts[kDigits][256] = {};
+  IterT it = start;
+  for (size_t i = 0; i < n; ++i, ++it) {
+    src[i] = *it;
+    KeyT key = radix_key(get_key(src[i]));
+    for (size_t d = 0; d < kDigits; ++d) {
+      ++counts[d][(key >> (8 * d)) & 0xff];
+    }
+  }
+  for (size_t d = 0; d < kDigits; ++d) {
+    size_t *count = counts[d];
+    KeyT first_key = radix_key(get_key(src[0]));
+    if (count[(first_key >> (8 * d)) & 0xff] == n) {
+      continue;
+    }
+    size_t offset = 0;
+    for (size_t b = 0; b < 256; ++b) {
+      size_t c = count[b];
+      count[b] = offset;
+      offset += c;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      KeyT key = radix_key(get_key(src[i]));
+      dst[count[(key >> (8 * d)) & 0xff]++] = src[i];
+    }
+    T *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  it = start;
+  for (size_t i = 0; i < n; ++i, ++it) {
+    *it = src[i];
+  }
+  free(buf);
+}
+
+/** Stable LSD radix sort of integral or floating-point values */
+template <typename IterT>
+HSHM_HOST_FUN void radix_sort(IterT start, const IterT &end) {
+  using T = std::remove_cv_t<iterator_type_v<IterT>>;
+  radix_sort(start, end, [](const T &val) -> const T & { return val; });
 }
 
 }  // namespace hshm
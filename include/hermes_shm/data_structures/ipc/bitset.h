@@ -0,0 +1,700 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_BITSET_H_
+#define HSHM_DATA_STRUCTURES_IPC_BITSET_H_
+
+#include "hermes_shm/constants/macros.h"
+#if defined(HSHM_IS_HOST) && defined(__AVX2__)
+#include <immintrin.h>
+#define HSHM_BITSET_AVX2
+#elif defined(HSHM_IS_HOST) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define HSHM_BITSET_SSE2
+#endif
+
+#include <cstring>
+#include <vector>
+
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/thread/thread_model_manager.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/numbers.h"
+
+namespace hshm::ipc {
+
+/** Index of the lowest set bit of a nonzero word */
+HSHM_INLINE_CROSS_FUN static u32 BitsetLowestBit(u64 word) {
+#if defined(HSHM_IS_GPU)
+  return __ffsll(word) - 1;
+#elif defined(HSHM_COMPILER_MSVC)
+  unsigned long idx;
+  _BitScanForward64(&idx, word);
+  return (u32)idx;
+#else
+  return (u32)__builtin_ctzll(word);
+#endif
+}
+
+/** The number of set bits in a word */
+HSHM_INLINE_CROSS_FUN static u32 BitsetPopcount(u64 word) {
+#if defined(HSHM_IS_GPU)
+  return __popcll(word);
+#elif defined(HSHM_COMPILER_MSVC)
+  return (u32)__popcnt64(word);
+#else
+  return (u32)__builtin_popcountll(word);
+#endif
+}
+
+/** Forward declaration of bitset_templ */
+template <bool ATOMIC, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class bitset_templ;
+
+/**
+ * MACROS used to simplify the bitset namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME bitset_templ
+#define CLASS_NEW_ARGS ATOMIC
+
+/**
+ * A fixed-size array of bits, meant for large occupancy maps (free-page
+ * maps, slot masks) that live in shared memory.
+ *
+ * Single-bit operations (set, clear, test_and_set, ...) are atomic RMWs
+ * on the containing word when ATOMIC is true, so many threads or
+ * processes may claim bits at once.
+ *
+ * Scans (find_first_set, find_first_clear, popcount) read 256 bits at a
+ * time with AVX2, or 128 with SSE2, and skip blocks that are all zero or
+ * all one. Under concurrent updates a scan sees each word at some point
+ * during the call, not a single snapshot of the whole set.
+ *
+ * Words are padded to a whole SIMD block. Bits past size() are always
+ * zero.
+ * */
+template <bool ATOMIC, HSHM_CLASS_TEMPL>
+class bitset_templ : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef opt_atomic<u64, ATOMIC> word_t;
+  static_assert(sizeof(word_t) == sizeof(u64),
+                "bitset words must be plain 64-bit words");
+  /** The number of bits in a word */
+  static const size_t kWordBits = 64;
+  /** The number of words scanned together */
+  static const size_t kBlockWords = 4;
+  /** The number of words in a cache line */
+  static const size_t kLineWords = 8;
+  /** Returned by the find methods when no bit matches */
+  static const size_t npos = (size_t)-1;
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer words_;
+  size_t nbits_;
+  size_t nwords_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit bitset_templ(size_t nbits = 0) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), nbits);
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit bitset_templ(const hipc::CtxAllocator<AllocT> &alloc,
+                        size_t nbits = 0) {
+    shm_init(alloc, nbits);
+  }
+
+  /** SHM constructor. All bits start clear. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc, size_t nbits = 0) {
+    init_shm_container(alloc);
+    SetNull();
+    resize(nbits);
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit bitset_templ(const bitset_templ &other) {
+    init_shm_container(other.GetCtxAllocator());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit bitset_templ(const hipc::CtxAllocator<AllocT> &alloc,
+                        const bitset_templ &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  bitset_templ &operator=(const bitset_templ &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** SHM copy constructor + operator main. Not safe under modification. */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const bitset_templ &other) {
+    resize(other.nbits_);
+    if (nwords_) {
+      memcpy((void *)GetRawWords(), (const void *)other.GetRawWords(),
+             nwords_ * sizeof(u64));
+    }
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  bitset_templ(bitset_templ &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  bitset_templ(const hipc::CtxAllocator<AllocT> &alloc,
+               bitset_templ &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  bitset_templ &operator=(bitset_templ &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  bitset_templ &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      words_ = other.words_;
+      nbits_ = other.nbits_;
+      nwords_ = other.nwords_;
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    alloc->Free(alloc.ctx_, words_);
+  }
+
+  /** Check if the bitset has no storage */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return words_.IsNull(); }
+
+  /** Sets this bitset as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {
+    words_.SetNull();
+    nbits_ = 0;
+    nwords_ = 0;
+  }
+
+  /**====================================
+   * Single Bit Methods
+   * ===================================*/
+
+  /** Check whether bit \a pos is set */
+  HSHM_INLINE_CROSS_FUN
+  bool test(size_t pos) const {
+    return (GetWord(pos).load() >> (pos % kWordBits)) & 1;
+  }
+
+  /** Check whether bit \a pos is set (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  bool operator[](size_t pos) const { return test(pos); }
+
+  /** Set bit \a pos */
+  HSHM_INLINE_CROSS_FUN
+  void set(size_t pos) { GetWord(pos).fetch_or(BitMask(pos)); }
+
+  /** Clear bit \a pos */
+  HSHM_INLINE_CROSS_FUN
+  void clear(size_t pos) { GetWord(pos).fetch_and(~BitMask(pos)); }
+
+  /** Set bit \a pos and return whether it was already set */
+  HSHM_INLINE_CROSS_FUN
+  bool test_and_set(size_t pos) {
+    u64 mask = BitMask(pos);
+    return (GetWord(pos).fetch_or(mask) & mask) != 0;
+  }
+
+  /** Clear bit \a pos and return whether it was set */
+  HSHM_INLINE_CROSS_FUN
+  bool test_and_clear(size_t pos) {
+    u64 mask = BitMask(pos);
+    return (GetWord(pos).fetch_and(~mask) & mask) != 0;
+  }
+
+  /**====================================
+   * Range Methods
+   * ===================================*/
+
+  /** Set the bits in [begin, end). Atomic per word, not per range. */
+  HSHM_CROSS_FUN
+  void set_range(size_t begin, size_t end) {
+    ForEachRangeWord(begin, end, [](word_t &word, u64 mask) {
+      word.fetch_or(mask);
+    });
+  }
+
+  /** Clear the bits in [begin, end). Atomic per word, not per range. */
+  HSHM_CROSS_FUN
+  void clear_range(size_t begin, size_t end) {
+    ForEachRangeWord(begin, end, [](word_t &word, u64 mask) {
+      word.fetch_and(~mask);
+    });
+  }
+
+  /** Set every bit */
+  HSHM_CROSS_FUN
+  void set_all() { set_range(0, nbits_); }
+
+  /** Clear every bit */
+  HSHM_CROSS_FUN
+  void clear_all() { clear_range(0, nbits_); }
+
+  /**====================================
+   * Scan Methods
+   * ===================================*/
+
+  /** Index of the first set bit at or after \a from, or npos */
+  HSHM_CROSS_FUN
+  size_t find_first_set(size_t from = 0) const {
+    return FindFirst<true>(from);
+  }
+
+  /** Index of the first clear bit at or after \a from, or npos */
+  HSHM_CROSS_FUN
+  size_t find_first_clear(size_t from = 0) const {
+    return FindFirst<false>(from);
+  }
+
+  /** The number of set bits */
+  HSHM_CROSS_FUN
+  size_t popcount() const { return PopcountWords(0, nwords_); }
+
+  /** The number of set bits in [begin, end) */
+  HSHM_CROSS_FUN
+  size_t popcount(size_t begin, size_t end) const {
+    if (end > nbits_) {
+      end = nbits_;
+    }
+    if (begin >= end) {
+      return 0;
+    }
+    const u64 *raw = GetRawWords();
+    size_t first = begin / kWordBits;
+    size_t last = (end - 1) / kWordBits;
+    if (first == last) {
+      return BitsetPopcount(raw[first] & RangeMask(begin % kWordBits,
+                                                   end - first * kWordBits));
+    }
+    size_t count =
+        BitsetPopcount(raw[first] & RangeMask(begin % kWordBits, kWordBits));
+    count += PopcountWords(first + 1, last);
+    count += BitsetPopcount(raw[last] & RangeMask(0, end - last * kWordBits));
+    return count;
+  }
+
+  /** The number of set bits (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t count() const { return popcount(); }
+
+  /** Check whether any bit is set */
+  HSHM_INLINE_CROSS_FUN
+  bool any() const { return find_first_set() != npos; }
+
+  /** Check whether no bit is set */
+  HSHM_INLINE_CROSS_FUN
+  bool none() const { return !any(); }
+
+  /**====================================
+   * Bulk Methods
+   * ===================================*/
+
+  /**
+   * this &= other. Bits of this past other.size() are cleared. The words
+   * are split into whole cache lines across \a nthreads threads.
+   * Not safe under concurrent modification of either bitset.
+   * */
+  HSHM_CROSS_FUN
+  void and_with(const bitset_templ &other, int nthreads = 1) {
+    size_t nwords = nwords_ < other.nwords_ ? nwords_ : other.nwords_;
+    BulkOp<true>(other, nwords, nthreads);
+    if (nwords < nwords_) {
+      memset((void *)(GetRawWords() + nwords), 0,
+             (nwords_ - nwords) * sizeof(u64));
+    }
+  }
+
+  /**
+   * this |= other. Bits of other past size() are dropped. The words are
+   * split into whole cache lines across \a nthreads threads.
+   * Not safe under concurrent modification of either bitset.
+   * */
+  HSHM_CROSS_FUN
+  void or_with(const bitset_templ &other, int nthreads = 1) {
+    size_t nwords = nwords_ < other.nwords_ ? nwords_ : other.nwords_;
+    BulkOp<false>(other, nwords, nthreads);
+    ClearTail();
+  }
+
+  /**====================================
+   * Size Methods
+   * ===================================*/
+
+  /**
+   * Change the number of bits. Existing bits below \a nbits are kept and
+   * new bits are clear. Not safe under concurrent access.
+   * */
+  HSHM_CROSS_FUN
+  void resize(size_t nbits) {
+    size_t nwords = (nbits + kWordBits - 1) / kWordBits;
+    nwords = (nwords + kBlockWords - 1) / kBlockWords * kBlockWords;
+    if (nwords != nwords_) {
+      OffsetPointer new_words = OffsetPointer::GetNull();
+      CtxAllocator<AllocT> alloc = GetCtxAllocator();
+      if (nwords) {
+        size_t size = nwords * sizeof(u64);
+        new_words = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+        if (new_words.IsNull()) {
+          HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                           alloc->GetCurrentlyAllocatedSize());
+        }
+        u64 *raw = alloc->template Convert<u64>(new_words);
+        size_t keep = nwords < nwords_ ? nwords : nwords_;
+        if (keep) {
+          memcpy((void *)raw, (const void *)GetRawWords(), keep * sizeof(u64));
+        }
+        memset((void *)(raw + keep), 0, (nwords - keep) * sizeof(u64));
+      }
+      if (!words_.IsNull()) {
+        alloc->Free(alloc.ctx_, words_);
+      }
+      words_ = new_words;
+      nwords_ = nwords;
+    }
+    nbits_ = nbits;
+    ClearTail();
+  }
+
+  /** The number of bits */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() const { return nbits_; }
+
+  /** The number of bits (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetSize() const { return nbits_; }
+
+  /** The number of 64-bit words backing the bits, including padding */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetNumWords() const { return nwords_; }
+
+ private:
+  /** The mask of bit \a pos in its word */
+  HSHM_INLINE_CROSS_FUN static u64 BitMask(size_t pos) {
+    return (u64)1 << (pos % kWordBits);
+  }
+
+  /** The mask of bits [begin, end) of a word, with end <= 64 */
+  HSHM_INLINE_CROSS_FUN static u64 RangeMask(size_t begin, size_t end) {
+    u64 hi = end >= kWordBits ? ~(u64)0 : ((u64)1 << end) - 1;
+    return hi & ~(((u64)1 << begin) - 1);
+  }
+
+  /** Get the words */
+  HSHM_INLINE_CROSS_FUN word_t *GetWords() const {
+    return GetAllocator()->template Convert<word_t>(words_);
+  }
+
+  /** Get the words for plain (SIMD) loads and stores */
+  HSHM_INLINE_CROSS_FUN u64 *GetRawWords() const {
+    return reinterpret_cast<u64 *>(GetWords());
+  }
+
+  /** Get the word holding bit \a pos */
+  HSHM_INLINE_CROSS_FUN word_t &GetWord(size_t pos) const {
+    return GetWords()[pos / kWordBits];
+  }
+
+  /** Call func(word, mask) for each word overlapping [begin, end) */
+  template <typename FUNC>
+  HSHM_CROSS_FUN void ForEachRangeWord(size_t begin, size_t end,
+                                       FUNC &&func) {
+    if (end > nbits_) {
+      end = nbits_;
+    }
+    if (begin >= end) {
+      return;
+    }
+    word_t *words = GetWords();
+    size_t first = begin / kWordBits;
+    size_t last = (end - 1) / kWordBits;
+    if (first == last) {
+      func(words[first], RangeMask(begin % kWordBits, end - first * kWordBits));
+      return;
+    }
+    func(words[first], RangeMask(begin % kWordBits, kWordBits));
+    for (size_t i = first + 1; i < last; ++i) {
+      func(words[i], ~(u64)0);
+    }
+    func(words[last], RangeMask(0, end - last * kWordBits));
+  }
+
+  /** Zero the bits of the last word that lie past nbits_ */
+  HSHM_INLINE_CROSS_FUN void ClearTail() {
+    size_t used = (nbits_ + kWordBits - 1) / kWordBits;
+    u64 *raw = GetRawWords();
+    if (nbits_ % kWordBits) {
+      raw[used - 1] &= RangeMask(0, nbits_ % kWordBits);
+    }
+    for (size_t i = used; i < nwords_; ++i) {
+      raw[i] = 0;
+    }
+  }
+
+  /**
+   * Whether a word holds a match: a set bit when SET, a clear bit
+   * otherwise.
+   * */
+  template <bool SET>
+  HSHM_INLINE_CROSS_FUN static u64 MatchBits(u64 word) {
+    return SET ? word : ~word;
+  }
+
+  /** Whether the block of words at \a raw holds a match */
+  template <bool SET>
+  HSHM_INLINE_CROSS_FUN static bool BlockHasMatch(const u64 *raw) {
+#if defined(HSHM_BITSET_AVX2)
+    __m256i block = _mm256_loadu_si256((const __m256i *)raw);
+    if constexpr (SET) {
+      return !_mm256_testz_si256(block, block);
+    } else {
+      return !_mm256_testc_si256(block, _mm256_set1_epi64x(-1));
+    }
+#elif defined(HSHM_BITSET_SSE2)
+    __m128i fill = SET ? _mm_setzero_si128() : _mm_set1_epi32(-1);
+    __m128i lo = _mm_loadu_si128((const __m128i *)raw);
+    __m128i hi = _mm_loadu_si128((const __m128i *)(raw + 2));
+    __m128i same = _mm_and_si128(_mm_cmpeq_epi8(lo, fill),
+                                 _mm_cmpeq_epi8(hi, fill));
+    return _mm_movemask_epi8(same) != 0xFFFF;
+#else
+    return (MatchBits<SET>(raw[0]) | MatchBits<SET>(raw[1]) |
+            MatchBits<SET>(raw[2]) | MatchBits<SET>(raw[3])) != 0;
+#endif
+  }
+
+  /** Index of the first matching bit at or after \a from, or npos */
+  template <bool SET>
+  HSHM_CROSS_FUN size_t FindFirst(size_t from) const {
+    if (from >= nbits_) {
+      return npos;
+    }
+    const u64 *raw = GetRawWords();
+    size_t w = from / kWordBits;
+    // Scan word by word up to the next block boundary
+    u64 match = MatchBits<SET>(raw[w]) & ~(BitMask(from) - 1);
+    while (!match) {
+      ++w;
+      if (w % kBlockWords == 0) {
+        break;
+      }
+      match = MatchBits<SET>(raw[w]);
+    }
+    if (!match) {
+      // Skip whole blocks with no match
+      while (w < nwords_ && !BlockHasMatch<SET>(raw + w)) {
+        w += kBlockWords;
+      }
+      if (w >= nwords_) {
+        return npos;
+      }
+      while (!(match = MatchBits<SET>(raw[w]))) {
+        ++w;
+      }
+    }
+    size_t pos = w * kWordBits + BitsetLowestBit(match);
+    return pos < nbits_ ? pos : npos;
+  }
+
+  /** The number of set bits in words [first, last) */
+  HSHM_CROSS_FUN size_t PopcountWords(size_t first, size_t last) const {
+    const u64 *raw = GetRawWords();
+    size_t count = 0;
+    size_t w = first;
+#if defined(HSHM_BITSET_AVX2)
+    // Count bits per nibble with a shuffle lookup (Mula's method)
+    const __m256i lookup =
+        _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                         1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    for (; w + kBlockWords <= last; w += kBlockWords) {
+      __m256i block = _mm256_loadu_si256((const __m256i *)(raw + w));
+      __m256i lo = _mm256_and_si256(block, low_mask);
+      __m256i hi = _mm256_and_si256(_mm256_srli_epi16(block, 4), low_mask);
+      __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                      _mm256_shuffle_epi8(lookup, hi));
+      total = _mm256_add_epi64(
+          total, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+    }
+    alignas(32) u64 lanes[4];
+    _mm256_store_si256((__m256i *)lanes, total);
+    count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; w < last; ++w) {
+      count += BitsetPopcount(raw[w]);
+    }
+    return count;
+  }
+
+  /** AND (or OR) the words [first, last) of \a src into \a dst */
+  template <bool AND>
+  HSHM_INLINE_CROSS_FUN static void BulkOpWords(u64 *dst, const u64 *src,
+                                                size_t first, size_t last) {
+    size_t w = first;
+#if defined(HSHM_BITSET_AVX2)
+    for (; w + kBlockWords <= last; w += kBlockWords) {
+      __m256i a = _mm256_loadu_si256((const __m256i *)(dst + w));
+      __m256i b = _mm256_loadu_si256((const __m256i *)(src + w));
+      __m256i c = AND ? _mm256_and_si256(a, b) : _mm256_or_si256(a, b);
+      _mm256_storeu_si256((__m256i *)(dst + w), c);
+    }
+#elif defined(HSHM_BITSET_SSE2)
+    for (; w + 2 <= last; w += 2) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(dst + w));
+      __m128i b = _mm_loadu_si128((const __m128i *)(src + w));
+      __m128i c = AND ? _mm_and_si128(a, b) : _mm_or_si128(a, b);
+      _mm_storeu_si128((__m128i *)(dst + w), c);
+    }
+#endif
+    for (; w < last; ++w) {
+      dst[w] = AND ? (dst[w] & src[w]) : (dst[w] | src[w]);
+    }
+  }
+
+  /**
+   * Apply BulkOpWords to the first \a nwords words. Each thread gets a
+   * run of whole cache lines so no two threads write the same line.
+   * */
+  template <bool AND>
+  HSHM_CROSS_FUN void BulkOp(const bitset_templ &other, size_t nwords,
+                             int nthreads) {
+    u64 *dst = GetRawWords();
+    const u64 *src = other.GetRawWords();
+    size_t nlines = (nwords + kLineWords - 1) / kLineWords;
+    if (nthreads <= 1 || nlines <= 1) {
+      BulkOpWords<AND>(dst, src, 0, nwords);
+      return;
+    }
+#if defined(HSHM_IS_HOST)
+    if ((size_t)nthreads > nlines) {
+      nthreads = (int)nlines;
+    }
+    size_t per_thread = (nlines + nthreads - 1) / nthreads * kLineWords;
+    auto *thread_model = HSHM_THREAD_MODEL;
+    ThreadGroup group = thread_model->CreateThreadGroup({});
+    std::vector<hshm::thread::Thread> threads;
+    threads.reserve(nthreads - 1);
+    for (int rank = 1; rank < nthreads; ++rank) {
+      size_t first = rank * per_thread;
+      size_t last = first + per_thread < nwords ? first + per_thread : nwords;
+      if (first >= last) {
+        break;
+      }
+      threads.emplace_back(thread_model->Spawn(
+          group, [dst, src, first, last]() {
+            BulkOpWords<AND>(dst, src, first, last);
+          }));
+    }
+    BulkOpWords<AND>(dst, src, 0,
+                     per_thread < nwords ? per_thread : nwords);
+    for (hshm::thread::Thread &thread : threads) {
+      thread_model->Join(thread);
+    }
+#else
+    BulkOpWords<AND>(dst, src, 0, nwords);
+#endif
+  }
+};
+
+/** A bitset whose single-bit operations are atomic */
+template <HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+using bitset = bitset_templ<true, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <bool ATOMIC, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using bitset_templ = hipc::bitset_templ<ATOMIC, HSHM_CLASS_TEMPL_ARGS>;
+
+template <HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using bitset = hipc::bitset_templ<true, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_BITSET_H_
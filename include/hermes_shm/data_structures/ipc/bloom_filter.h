@@ -0,0 +1,411 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_BLOOM_FILTER_H_
+#define HSHM_DATA_STRUCTURES_IPC_BLOOM_FILTER_H_
+
+#include <cmath>
+#include <cstring>
+
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/striped_counter.h"
+#include "hash.h"
+
+namespace hshm::ipc {
+
+/** Forward declaration of bloom_filter */
+template <typename T, class Hash = hshm::hash<T>,
+          HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class bloom_filter;
+
+/**
+ * MACROS used to simplify the bloom_filter namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME bloom_filter
+#define CLASS_NEW_ARGS T, Hash
+
+/**
+ * A blocked Bloom filter. A key hashes to one 512-bit block (a cache
+ * line), and all of its bits are set and tested within that block, so
+ * insert and contains touch a single line.
+ *
+ * insert sets bits with atomic fetch_or, so it is lock-free and safe to
+ * call from any thread or process alongside contains. Keys can not be
+ * removed; use cuckoo_filter when deletion is needed.
+ *
+ * The filter is sized from the expected number of keys and the target
+ * false-positive rate. Keys spread unevenly over blocks, so a blocked
+ * filter needs more bits per key than a classic one; the sizing
+ * estimates the blocked rate directly instead of using the classic
+ * formula.
+ * */
+template <typename T, class Hash, HSHM_CLASS_TEMPL>
+class bloom_filter : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  /** The number of bits in a block */
+  CLS_CONST size_t kBlockBits = 512;
+  /** The number of 64-bit words in a block */
+  CLS_CONST size_t kBlockWords = kBlockBits / 64;
+  /** The size of a block in bytes */
+  CLS_CONST size_t kBlockBytes = kBlockBits / 8;
+  /** The most bits set per key */
+  CLS_CONST u32 kMaxHashes = 16;
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  /** The allocation backing the blocks */
+  OffsetPointer alloc_p_;
+  /** The first block, rounded up to a cache line within alloc_p_ */
+  OffsetPointer blocks_;
+  size_t num_blocks_;
+  u32 num_hashes_;
+  /** Striped by hash, so concurrent inserts do not share one line */
+  striped_counter<> count_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit bloom_filter(size_t num_keys = 1024, double fpr = .01) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), num_keys,
+             fpr);
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit bloom_filter(const hipc::CtxAllocator<AllocT> &alloc,
+                        size_t num_keys = 1024, double fpr = .01) {
+    shm_init(alloc, num_keys, fpr);
+  }
+
+  /**
+   * SHM constructor.
+   *
+   * @param num_keys the number of keys expected to be inserted
+   * @param fpr the target false-positive rate once \a num_keys keys are in
+   * */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc,
+                size_t num_keys = 1024, double fpr = .01) {
+    init_shm_container(alloc);
+    SetNull();
+    if (num_keys == 0) {
+      num_keys = 1;
+    }
+    if (fpr <= 0 || fpr >= 1) {
+      fpr = .01;
+    }
+    // Start from the classic sizing, m / n = -ln(p) / ln(2)^2, and add
+    // bits until the blocked estimate meets the target
+    double ln2 = 0.6931471805599453;
+    double bits_per_key = -log(fpr) / (ln2 * ln2);
+    while (true) {
+      num_hashes_ = (u32)(bits_per_key * ln2 + .5);
+      num_hashes_ = num_hashes_ < 1 ? 1 : num_hashes_;
+      num_hashes_ = num_hashes_ > kMaxHashes ? kMaxHashes : num_hashes_;
+      if (EstimateFpr(bits_per_key, num_hashes_) <= fpr) {
+        break;
+      }
+      bits_per_key += .5;
+    }
+    num_blocks_ = (size_t)(bits_per_key * (double)num_keys / kBlockBits) + 1;
+    AllocateBlocks();
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit bloom_filter(const bloom_filter &other) {
+    init_shm_container(other.GetCtxAllocator());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit bloom_filter(const hipc::CtxAllocator<AllocT> &alloc,
+                        const bloom_filter &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  bloom_filter &operator=(const bloom_filter &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** SHM copy constructor + operator main. Not safe under modification. */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const bloom_filter &other) {
+    num_blocks_ = other.num_blocks_;
+    num_hashes_ = other.num_hashes_;
+    AllocateBlocks();
+    memcpy((void *)GetBlocks(), (const void *)other.GetBlocks(),
+           num_blocks_ * kBlockBytes);
+    count_ = other.count_;
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  bloom_filter(bloom_filter &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  bloom_filter(const hipc::CtxAllocator<AllocT> &alloc,
+               bloom_filter &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  bloom_filter &operator=(bloom_filter &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  bloom_filter &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      alloc_p_ = other.alloc_p_;
+      blocks_ = other.blocks_;
+      num_blocks_ = other.num_blocks_;
+      num_hashes_ = other.num_hashes_;
+      count_ = other.count_;
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    alloc->Free(alloc.ctx_, alloc_p_);
+  }
+
+  /** Check if the filter has no storage */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return alloc_p_.IsNull(); }
+
+  /** Sets this filter as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {
+    alloc_p_.SetNull();
+    blocks_.SetNull();
+    num_blocks_ = 0;
+    num_hashes_ = 0;
+    count_.clear();
+  }
+
+  /**====================================
+   * Bloom Filter Methods
+   * ===================================*/
+
+  /** Add \a key to the filter */
+  HSHM_INLINE_CROSS_FUN
+  void insert(const T &key) { insert_hash(HashKey(key)); }
+
+  /** Check whether \a key may have been inserted. No false negatives. */
+  HSHM_INLINE_CROSS_FUN
+  bool contains(const T &key) const { return contains_hash(HashKey(key)); }
+
+  /**
+   * Add a key by its 64-bit hash. Lets callers that already hashed a key
+   * (e.g., for an unordered_map lookup) skip hashing it twice.
+   * */
+  HSHM_CROSS_FUN
+  void insert_hash(u64 hash) {
+    u64 masks[kBlockWords];
+    ipc::atomic<u64> *block = GetBlockMasks(hash, masks);
+    for (size_t i = 0; i < kBlockWords; ++i) {
+      // Skip the RMW when the bits are already set
+      if (masks[i] && (block[i].load(std::memory_order_relaxed) & masks[i]) !=
+                          masks[i]) {
+        block[i].fetch_or(masks[i]);
+      }
+    }
+    count_.add(hash);
+  }
+
+  /** Check whether a key with this 64-bit hash may have been inserted */
+  HSHM_CROSS_FUN
+  bool contains_hash(u64 hash) const {
+    u64 masks[kBlockWords];
+    ipc::atomic<u64> *block = GetBlockMasks(hash, masks);
+    u64 missing = 0;
+    for (size_t i = 0; i < kBlockWords; ++i) {
+      missing |= masks[i] & ~block[i].load(std::memory_order_relaxed);
+    }
+    return missing == 0;
+  }
+
+  /** Reset the filter to empty. Not safe under concurrent inserts. */
+  HSHM_CROSS_FUN
+  void clear() {
+    memset((void *)GetBlocks(), 0, num_blocks_ * kBlockBytes);
+    count_.clear();
+  }
+
+  /**
+   * The number of inserts so far. Repeated keys count each time.
+   * Approximate under concurrent inserts.
+   * */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() const { return count_.load(); }
+
+  /** The number of inserts so far (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetSize() const { return size(); }
+
+  /** The number of bits in the filter */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetNumBits() const { return num_blocks_ * kBlockBits; }
+
+  /** The number of bits set per key */
+  HSHM_INLINE_CROSS_FUN
+  u32 GetNumHashes() const { return num_hashes_; }
+
+ private:
+  /**
+   * Estimate the false-positive rate at \a bits_per_key with \a k bits
+   * per key. The number of keys in a block is Poisson with mean
+   * kBlockBits / bits_per_key, and a block holding i keys gives a false
+   * positive with the classic rate (1 - (1 - 1/kBlockBits)^(k i))^k.
+   * */
+  HSHM_CROSS_FUN static double EstimateFpr(double bits_per_key, u32 k) {
+    double mean = kBlockBits / bits_per_key;
+    double prob = exp(-mean);
+    double fpr = 0;
+    size_t max_keys = (size_t)(mean + 10 * sqrt(mean) + 10);
+    for (size_t i = 1; i <= max_keys; ++i) {
+      prob *= mean / (double)i;
+      double unset = pow(1 - 1.0 / kBlockBits, (double)(k * i));
+      fpr += prob * pow(1 - unset, (double)k);
+    }
+    return fpr;
+  }
+
+  /** Hash a key. Hashes that are not already mixed get fmix64. */
+  HSHM_INLINE_CROSS_FUN static u64 HashKey(const T &key) {
+    return (u64)mixed_hash<Hash>(key);
+  }
+
+  /** Get the blocks */
+  HSHM_INLINE_CROSS_FUN ipc::atomic<u64> *GetBlocks() const {
+    return GetAllocator()->template Convert<ipc::atomic<u64>>(blocks_);
+  }
+
+  /**
+   * Get the block of \a hash and the bits of each word to test. The
+   * block comes from the high bits of the hash. Each bit position takes
+   * its own 9 bits of a remixed hash; double hashing within a block this
+   * small yields too few distinct patterns.
+   * */
+  HSHM_INLINE_CROSS_FUN ipc::atomic<u64> *GetBlockMasks(u64 hash,
+                                                        u64 *masks) const {
+    size_t block = hash_reduce(hash, num_blocks_);
+    u64 bits = hash_mix(hash, kHashSecret2);
+    u32 avail = 64;
+    for (size_t i = 0; i < kBlockWords; ++i) {
+      masks[i] = 0;
+    }
+    for (u32 i = 0; i < num_hashes_; ++i) {
+      if (avail < 9) {
+        bits = hash_mix(bits, kHashSecret3);
+        avail = 64;
+      }
+      u32 bit = (u32)(bits % kBlockBits);
+      masks[bit / 64] |= (u64)1 << (bit % 64);
+      bits >>= 9;
+      avail -= 9;
+    }
+    return GetBlocks() + block * kBlockWords;
+  }
+
+  /**
+   * Allocate num_blocks_ zeroed blocks. The allocators do not all
+   * support aligned allocation, so allocate an extra line and round the
+   * blocks up to a line boundary.
+   * */
+  HSHM_CROSS_FUN void AllocateBlocks() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = (num_blocks_ + 1) * kBlockBytes;
+    alloc_p_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (alloc_p_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    char *base = alloc->template Convert<char>(alloc_p_);
+    size_t pad = (kBlockBytes - ((size_t)base % kBlockBytes)) % kBlockBytes;
+    blocks_ = OffsetPointer(alloc_p_.off_.load() + pad);
+    memset((void *)(base + pad), 0, num_blocks_ * kBlockBytes);
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename T, class Hash = hshm::hash<T>,
+          HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using bloom_filter = hipc::bloom_filter<T, Hash, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_BLOOM_FILTER_H_
@@ -0,0 +1,553 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_BROADCAST_RING_H_
+#define HSHM_DATA_STRUCTURES_IPC_BROADCAST_RING_H_
+
+#include <type_traits>
+
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/qtok.h"
+#include "ring_queue_flags.h"
+
+namespace hshm::ipc {
+
+/** Forward declaration of broadcast_ring_base */
+template <typename T, RingQueueFlag RQ_FLAGS, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class broadcast_ring_base;
+
+/**
+ * A slot of the broadcast_ring. \a seq_ is pos + 1 once the value of
+ * position pos is published, and 0 while the slot is being rewritten.
+ * */
+template <typename T>
+struct broadcast_ring_cell {
+  ipc::atomic<hshm::u64> seq_;
+  delay_ar<T> val_;
+};
+
+/** A subscriber of the broadcast_ring, on its own cache line */
+struct broadcast_ring_sub {
+  ipc::atomic<hshm::u64> active_;
+  ipc::atomic<hshm::u64> cursor_;
+  ipc::atomic<hshm::u64> lost_;
+  char pad_[HSHM_CACHE_LINE_SIZE - 3 * sizeof(ipc::atomic<hshm::u64>)];
+
+  /** The slot has no subscriber */
+  CLS_CONST hshm::u64 kFree = 0;
+  /** The slot is claimed, but its cursor is not yet set */
+  CLS_CONST hshm::u64 kJoining = 1;
+  /** The subscriber's cursor holds back the producer */
+  CLS_CONST hshm::u64 kActive = 2;
+};
+
+/**
+ * MACROS used to simplify the broadcast_ring namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME broadcast_ring_base
+#define CLASS_NEW_ARGS T, RQ_FLAGS
+
+/**
+ * A ring with one producer where every subscriber sees every element.
+ *
+ * The producer writes each element once. Each subscriber keeps its own
+ * cursor in the ring, so subscribers in different processes read at
+ * their own pace. Subscribers join() and leave() at runtime; a new
+ * subscriber starts at the current tail.
+ *
+ * With kErrorOnNoSpace or kWaitForSpace, the producer never overwrites
+ * an element an active subscriber has not read: push fails or waits.
+ * The producer keeps a cached copy of the slowest cursor and only scans
+ * the subscribers when the cache says the ring is full.
+ *
+ * Otherwise the producer overwrites the oldest elements. Slots are read
+ * like a seqlock and a subscriber that was lapped skips to the oldest
+ * element still in the ring, counting what it lost. The positions
+ * returned by pop also reveal the gap. T must be trivially copyable in
+ * this mode, since a slot may be rewritten while it is copied.
+ * */
+template <typename T, RingQueueFlag RQ_FLAGS, HSHM_CLASS_TEMPL>
+class broadcast_ring_base : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+  RING_QUEUE_DEFS
+  CLS_CONST bool IsLossy = !(ErrorOnNoSpace || WaitForSpace);
+  static_assert(!IsLossy || std::is_trivially_copyable_v<T>,
+                "An overwriting broadcast_ring needs a trivially copyable T");
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef broadcast_ring_cell<T> cell_t;
+  typedef broadcast_ring_sub sub_t;
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer cells_;
+  OffsetPointer subs_;
+  hshm::u64 mask_;
+  hshm::u64 max_subs_;
+  char pad0_[HSHM_CACHE_LINE_SIZE];
+  /** Producer line: the tail and a copy of the slowest cursor */
+  ipc::atomic<hshm::u64> tail_;
+  hshm::u64 min_cache_;
+  char pad1_[HSHM_CACHE_LINE_SIZE - sizeof(ipc::atomic<hshm::u64>) -
+             sizeof(hshm::u64)];
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit broadcast_ring_base(size_t depth = 1024, size_t max_subs = 16) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), depth,
+             max_subs);
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit broadcast_ring_base(const hipc::CtxAllocator<AllocT> &alloc,
+                               size_t depth = 1024, size_t max_subs = 16) {
+    shm_init(alloc, depth, max_subs);
+  }
+
+  /** SHM Constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc, size_t depth = 1024,
+                size_t max_subs = 16) {
+    init_shm_container(alloc);
+    SetNull();
+    Allocate(depth, max_subs);
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit broadcast_ring_base(const broadcast_ring_base &other) {
+    init_shm_container(other.GetCtxAllocator());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit broadcast_ring_base(const hipc::CtxAllocator<AllocT> &alloc,
+                               const broadcast_ring_base &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  broadcast_ring_base &operator=(const broadcast_ring_base &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /**
+   * SHM copy constructor + operator main. Copies the elements and the
+   * subscribers' cursors. Not safe under modification.
+   * */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const broadcast_ring_base &other) {
+    Allocate(other.GetDepth(), other.GetMaxSubscribers());
+    cell_t *cells = GetCells();
+    cell_t *other_cells = other.GetCells();
+    for (size_t i = 0; i < GetDepth(); ++i) {
+      hshm::u64 seq = other_cells[i].seq_.load();
+      if (seq != 0) {
+        HSHM_MAKE_AR(cells[i].val_, GetCtxAllocator(),
+                     other_cells[i].val_.get_ref())
+        cells[i].seq_ = seq;
+      }
+    }
+    sub_t *subs = GetSubs();
+    sub_t *other_subs = other.GetSubs();
+    for (size_t i = 0; i < max_subs_; ++i) {
+      subs[i].cursor_ = other_subs[i].cursor_.load();
+      subs[i].lost_ = other_subs[i].lost_.load();
+      subs[i].active_ = other_subs[i].active_.load();
+    }
+    tail_ = other.tail_.load();
+    min_cache_ = other.min_cache_;
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  broadcast_ring_base(broadcast_ring_base &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  broadcast_ring_base(const hipc::CtxAllocator<AllocT> &alloc,
+                      broadcast_ring_base &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  broadcast_ring_base &operator=(broadcast_ring_base &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  broadcast_ring_base &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      cells_ = other.cells_;
+      subs_ = other.subs_;
+      mask_ = other.mask_;
+      max_subs_ = other.max_subs_;
+      tail_ = other.tail_.load();
+      min_cache_ = other.min_cache_;
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. Destroys the values still in the ring. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() {
+    cell_t *cells = GetCells();
+    for (size_t i = 0; i < GetDepth(); ++i) {
+      if (cells[i].seq_.load() != 0) {
+        cells[i].val_.shm_destroy();
+      }
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    alloc->Free(alloc.ctx_, cells_);
+    alloc->Free(alloc.ctx_, subs_);
+  }
+
+  /** Check if the ring is empty */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return cells_.IsNull(); }
+
+  /** Sets this ring as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {
+    cells_.SetNull();
+    subs_.SetNull();
+    mask_ = 0;
+    max_subs_ = 0;
+    tail_ = 0;
+    min_cache_ = 0;
+  }
+
+  /**====================================
+   * Subscriber Methods
+   * ===================================*/
+
+  /**
+   * Join the ring as a new subscriber, starting at the current tail.
+   *
+   * @return the subscriber id, or -1 if the ring has no free subscriber
+   * */
+  HSHM_CROSS_FUN
+  int join() {
+    sub_t *subs = GetSubs();
+    for (size_t i = 0; i < max_subs_; ++i) {
+      sub_t &sub = subs[i];
+      if (sub.active_.load() != sub_t::kFree) {
+        continue;
+      }
+      hshm::u64 expected = sub_t::kFree;
+      if (!sub.active_.compare_exchange_strong(expected, sub_t::kJoining)) {
+        continue;
+      }
+      // The cursor is set before the producer can see the subscriber, so
+      // it never reads the cursor a previous subscriber left behind. The
+      // producer may have scanned the cursors before we became active.
+      // Its cached minimum is then at most the tail read here, so nothing
+      // from here on can be overwritten before we are seen.
+      sub.lost_ = 0;
+      sub.cursor_.store(tail_.load(), std::memory_order_relaxed);
+      sub.active_.store(sub_t::kActive, std::memory_order_release);
+      return (int)i;
+    }
+    return -1;
+  }
+
+  /** Leave the ring. The subscriber no longer holds back the producer. */
+  HSHM_CROSS_FUN
+  void leave(int sub) { GetSubs()[sub].active_.store(sub_t::kFree); }
+
+  /**
+   * Pop the next element for subscriber \a sub. The element stays in the
+   * ring for the other subscribers.
+   *
+   * @return the position of the element, or a null qtok if \a sub has
+   * read everything
+   * */
+  HSHM_CROSS_FUN
+  qtok_t pop(int sub_id, T &val) {
+    sub_t &sub = GetSubs()[sub_id];
+    cell_t *cells = GetCells();
+    hshm::u64 pos = sub.cursor_.load(std::memory_order_relaxed);
+    while (true) {
+      cell_t &cell = cells[pos & mask_];
+      hshm::u64 seq = cell.seq_.load(std::memory_order_acquire);
+      if (seq == pos + 1) {
+        val = cell.val_.get_ref();
+        if constexpr (!IsLossy) {
+          break;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (cell.seq_.load(std::memory_order_relaxed) == pos + 1) {
+          break;
+        }
+      } else if (seq <= pos) {
+        if (seq != 0 || tail_.load(std::memory_order_acquire) <= pos) {
+          return qtok_t::GetNull();
+        }
+      }
+      // The producer lapped this subscriber: skip to the oldest element
+      pos = SkipOverrun(sub, pos);
+    }
+    sub.cursor_.store(pos + 1, std::memory_order_release);
+    return qtok_t(pos);
+  }
+
+  /** Get the number of elements \a sub lost by being lapped */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetLost(int sub) const {
+    return (size_t)GetSubs()[sub].lost_.load();
+  }
+
+  /** Get the number of elements \a sub has yet to read */
+  HSHM_CROSS_FUN
+  size_t GetSize(int sub) const {
+    hshm::u64 cursor = GetSubs()[sub].cursor_.load();
+    hshm::u64 tail = tail_.load();
+    if (tail < cursor) {
+      return 0;
+    }
+    return (size_t)(tail - cursor);
+  }
+
+  /** Get the number of active subscribers at this moment */
+  HSHM_CROSS_FUN
+  size_t GetNumSubscribers() const {
+    sub_t *subs = GetSubs();
+    size_t count = 0;
+    for (size_t i = 0; i < max_subs_; ++i) {
+      count += subs[i].active_.load() == sub_t::kActive;
+    }
+    return count;
+  }
+
+  /**====================================
+   * Producer Methods
+   * ===================================*/
+
+  /**
+   * Construct an element at the tail of the ring. Producer only.
+   *
+   * @return the position of the element, or a null qtok if a subscriber
+   * has yet to read the slot and the ring does not wait for space
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN qtok_t emplace(Args &&...args) {
+    hshm::u64 tail = tail_.load(std::memory_order_relaxed);
+    if constexpr (!IsLossy) {
+      while (tail - min_cache_ > mask_) {
+        min_cache_ = GetMinCursor(tail);
+        if (tail - min_cache_ <= mask_) {
+          break;
+        }
+        if constexpr (ErrorOnNoSpace) {
+          return qtok_t::GetNull();
+        } else {
+          HSHM_THREAD_MODEL->Yield();
+        }
+      }
+    }
+    cell_t &cell = GetCells()[tail & mask_];
+    if (tail > mask_) {
+      if constexpr (IsLossy) {
+        cell.seq_.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+      }
+      cell.val_.shm_destroy();
+    }
+    HSHM_MAKE_AR(cell.val_, GetCtxAllocator(), std::forward<Args>(args)...)
+    cell.seq_.store(tail + 1, std::memory_order_release);
+    tail_.store(tail + 1);
+    return qtok_t(tail);
+  }
+
+  /** Push an element in the ring (wrapper) */
+  template <typename... Args>
+  HSHM_INLINE_CROSS_FUN qtok_t push(Args &&...args) {
+    return emplace(std::forward<Args>(args)...);
+  }
+
+  /**====================================
+   * Getters
+   * ===================================*/
+
+  /** Get ring depth */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetDepth() const { return (size_t)(mask_ + 1); }
+
+  /** Get the maximum number of subscribers */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetMaxSubscribers() const { return (size_t)max_subs_; }
+
+  /** Get the number of elements pushed so far */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetTail() const { return (size_t)tail_.load(); }
+
+ private:
+  /** Get the slots */
+  HSHM_INLINE_CROSS_FUN cell_t *GetCells() const {
+    return GetAllocator()->template Convert<cell_t>(cells_);
+  }
+
+  /** Get the subscribers */
+  HSHM_INLINE_CROSS_FUN sub_t *GetSubs() const {
+    return GetAllocator()->template Convert<sub_t>(subs_);
+  }
+
+  /** Get the slowest active cursor, or \a tail if nobody subscribes */
+  HSHM_CROSS_FUN hshm::u64 GetMinCursor(hshm::u64 tail) const {
+    sub_t *subs = GetSubs();
+    hshm::u64 min = tail;
+    for (size_t i = 0; i < max_subs_; ++i) {
+      if (subs[i].active_.load(std::memory_order_acquire) !=
+          sub_t::kActive) {
+        continue;
+      }
+      hshm::u64 cursor = subs[i].cursor_.load(std::memory_order_acquire);
+      if (cursor < min) {
+        min = cursor;
+      }
+    }
+    return min;
+  }
+
+  /** Move a lapped cursor to the oldest element that is safe to read */
+  HSHM_CROSS_FUN hshm::u64 SkipOverrun(sub_t &sub, hshm::u64 pos) {
+    hshm::u64 tail = tail_.load(std::memory_order_acquire);
+    // The slot of tail - depth may be being rewritten for tail
+    hshm::u64 oldest = tail > mask_ ? tail - mask_ : 0;
+    if (oldest > pos) {
+      sub.lost_.fetch_add(oldest - pos);
+      return oldest;
+    }
+    HSHM_THREAD_MODEL->Yield();
+    return pos;
+  }
+
+  /** Allocate the slots and the subscribers */
+  HSHM_CROSS_FUN void Allocate(size_t depth, size_t max_subs) {
+    size_t pow2 = 1;
+    while (pow2 < depth) {
+      pow2 <<= 1;
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = pow2 * sizeof(cell_t);
+    cells_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (cells_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    size_t subs_size = max_subs * sizeof(sub_t);
+    subs_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, subs_size);
+    if (subs_.IsNull()) {
+      alloc->Free(alloc.ctx_, cells_);
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, subs_size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    cell_t *cells = GetCells();
+    for (size_t i = 0; i < pow2; ++i) {
+      new (&cells[i]) cell_t();
+      cells[i].seq_ = 0;
+    }
+    sub_t *subs = GetSubs();
+    for (size_t i = 0; i < max_subs; ++i) {
+      new (&subs[i]) sub_t();
+      subs[i].active_ = sub_t::kFree;
+      subs[i].cursor_ = 0;
+      subs[i].lost_ = 0;
+    }
+    mask_ = pow2 - 1;
+    max_subs_ = max_subs;
+    tail_ = 0;
+    min_cache_ = 0;
+  }
+};
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+using broadcast_ring =
+    broadcast_ring_base<T, RING_BUFFER_FIXED_SPSC_FLAGS, HSHM_CLASS_TEMPL_ARGS>;
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+using circular_broadcast_ring =
+    broadcast_ring_base<T, RING_BUFFER_CIRCULAR_SPSC_FLAGS,
+                        HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using broadcast_ring =
+    hipc::broadcast_ring_base<T, RING_BUFFER_FIXED_SPSC_FLAGS,
+                              HSHM_CLASS_TEMPL_ARGS>;
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using circular_broadcast_ring =
+    hipc::broadcast_ring_base<T, RING_BUFFER_CIRCULAR_SPSC_FLAGS,
+                              HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_BROADCAST_RING_H_
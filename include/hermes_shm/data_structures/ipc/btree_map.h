@@ -0,0 +1,1215 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_BTREE_MAP_H_
+#define HSHM_DATA_STRUCTURES_BTREE_MAP_H_
+
+#include <cstring>
+#include <type_traits>
+
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/data_structures/ipc/functional.h"
+#include "hermes_shm/thread/lock/rwlock.h"
+#include "hermes_shm/thread/thread_model_manager.h"
+#include "hermes_shm/types/atomic.h"
+
+namespace hshm::ipc {
+
+/** forward pointer for btree_map */
+template <typename Key, typename T, class Compare = hshm::less<Key>,
+          HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class btree_map;
+
+/**
+ * The header of a btree_map node. The keys follow the header, and then
+ * either the values (leaves) or the child offsets (inner nodes).
+ *
+ * \a version_ is an optimistic lock: bit 1 is set while a writer holds
+ * the node and every unlock advances the version. Readers record the
+ * version, read the node without locking, and validate that the version
+ * did not change. Nodes are never freed while the tree is alive, so a
+ * reader that follows a stale offset still lands on a node.
+ * */
+struct btree_map_node {
+  CLS_CONST hshm::u64 kLocked = 2;
+
+  ipc::atomic<hshm::u64> version_;
+  hshm::u32 count_;   /**< The number of keys in the node */
+  hshm::u32 is_leaf_; /**< Whether the node is a leaf */
+  AtomicOffsetPointer next_; /**< The right sibling of a leaf */
+
+  /** Get the version of the node. Sets \a restart if it is locked. */
+  HSHM_INLINE_CROSS_FUN hshm::u64 ReadLock(bool &restart) const {
+    hshm::u64 version = version_.load(std::memory_order_acquire);
+    restart = (version & kLocked) != 0;
+    return version;
+  }
+
+  /** Whether the node is unchanged since \a version was read */
+  HSHM_INLINE_CROSS_FUN bool Validate(hshm::u64 version) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version_.load(std::memory_order_relaxed) == version;
+  }
+
+  /** Lock the node if it is unchanged since \a version was read */
+  HSHM_INLINE_CROSS_FUN bool Upgrade(hshm::u64 version) {
+    return version_.compare_exchange_strong(version, version + kLocked,
+                                            std::memory_order_acquire);
+  }
+
+  /** Unlock the node and publish a new version */
+  HSHM_INLINE_CROSS_FUN void WriteUnlock() {
+    version_.fetch_add(kLocked, std::memory_order_release);
+  }
+};
+
+/**
+ * The btree_map iterator. Not safe while the map is being modified.
+ * */
+template <typename Key, typename T, class Compare, HSHM_CLASS_TEMPL>
+struct btree_map_iterator {
+ public:
+  using MAP_T = btree_map<Key, T, Compare, HSHM_CLASS_TEMPL_ARGS>;
+  using NODE_T = btree_map_node;
+
+ public:
+  const MAP_T *map_;
+  NODE_T *leaf_;
+  size_t idx_;
+
+ public:
+  /** Default constructor */
+  HSHM_CROSS_FUN btree_map_iterator() : map_(nullptr), leaf_(nullptr), idx_(0) {}
+
+  /** Construct an iterator at \a idx of \a leaf and skip empty leaves */
+  HSHM_INLINE_CROSS_FUN btree_map_iterator(const MAP_T &map, NODE_T *leaf,
+                                           size_t idx)
+      : map_(&map), leaf_(leaf), idx_(idx) {
+    make_correct();
+  }
+
+  /** Get the key of the entry */
+  HSHM_INLINE_CROSS_FUN const Key &GetKey() const {
+    return map_->GetKeys(leaf_)[idx_].get_ref();
+  }
+
+  /** Get the value of the entry */
+  HSHM_INLINE_CROSS_FUN T &GetVal() const {
+    return map_->GetVals(leaf_)[idx_].get_ref();
+  }
+
+  /** Get the value of the entry */
+  HSHM_INLINE_CROSS_FUN T &operator*() const { return GetVal(); }
+
+  /** Go to the next entry (in place) */
+  HSHM_INLINE_CROSS_FUN btree_map_iterator &operator++() {
+    ++idx_;
+    make_correct();
+    return *this;
+  }
+
+  /** Go to the next entry */
+  HSHM_INLINE_CROSS_FUN btree_map_iterator operator++(int) const {
+    btree_map_iterator next(*this);
+    ++next;
+    return next;
+  }
+
+  /** Whether the iterator is past the last entry */
+  HSHM_INLINE_CROSS_FUN bool is_end() const { return leaf_ == nullptr; }
+
+  /** Check if two iterators are equal */
+  HSHM_INLINE_CROSS_FUN bool operator==(const btree_map_iterator &other) const {
+    return leaf_ == other.leaf_ && (leaf_ == nullptr || idx_ == other.idx_);
+  }
+
+  /** Check if two iterators are not equal */
+  HSHM_INLINE_CROSS_FUN bool operator!=(const btree_map_iterator &other) const {
+    return !(*this == other);
+  }
+
+ private:
+  /** Move past the end of the current leaf (and empty leaves) */
+  HSHM_INLINE_CROSS_FUN void make_correct() {
+    while (leaf_ && idx_ >= leaf_->count_) {
+      OffsetPointer next_p = leaf_->next_.ToOffsetPointer();
+      leaf_ = next_p.IsNull() ? nullptr
+                              : map_->GetAllocator()->template Convert<NODE_T>(
+                                    next_p);
+      idx_ = 0;
+    }
+  }
+};
+
+/**
+ * MACROS to simplify the btree_map namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+
+#define CLASS_NAME btree_map
+#define CLASS_NEW_ARGS Key, T, Compare
+
+/**
+ * An ordered map stored as a B+tree in shared memory.
+ *
+ * Nodes are \a node_size bytes (e.g., a few cache lines or a page) and
+ * are allocated from the map's allocator. Leaves hold the entries in key
+ * order and are chained left to right, so range scans walk the leaves
+ * without revisiting inner nodes.
+ *
+ * Concurrency follows optimistic lock coupling. Writers descend with
+ * optimistic reads, lock only the nodes they modify, and split full nodes
+ * on the way down so a split never propagates upwards. When both Key and
+ * T are trivially copyable, find, contains, and scan take no locks: they
+ * validate node versions and retry on conflict. Otherwise, readers take
+ * the map's read lock and writers its write lock, since an optimistic
+ * reader could otherwise dereference a key that is being destroyed.
+ *
+ * Erased entries are removed from their leaf, but nodes are not merged;
+ * they are reused by later inserts and freed by clear() or destruction.
+ * */
+template <typename Key, typename T, class Compare, HSHM_CLASS_TEMPL>
+class btree_map : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef btree_map_iterator<Key, T, Compare, HSHM_CLASS_TEMPL_ARGS>
+      iterator_t;
+  friend iterator_t;
+  using NODE_T = btree_map_node;
+  CLS_CONST bool kOptimisticRead =
+      std::is_trivially_copyable<Key>::value &&
+      std::is_trivially_copyable<T>::value;
+  /** The number of entries scan copies per validated read */
+  CLS_CONST size_t kScanBatch = 32;
+  /** The minimum number of keys in a node */
+  CLS_CONST size_t kMinNodeKeys = 4;
+
+  /**====================================
+   * Variables
+   * ===================================*/
+  AtomicOffsetPointer root_;
+  OffsetPointer head_; /**< The leftmost leaf */
+  ipc::atomic<hshm::size_t> length_;
+  mutable RwLock lock_; /**< Only used when kOptimisticRead is false */
+  size_t node_size_;
+  size_t leaf_cap_;
+  size_t inner_cap_;
+  size_t vals_off_;
+  size_t children_off_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /**
+   * SHM constructor. Initialize the map.
+   *
+   * @param node_size the size of a node in bytes. Increased if a node
+   * would hold fewer than kMinNodeKeys keys.
+   * */
+  HSHM_CROSS_FUN
+  explicit btree_map(size_t node_size = 512) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), node_size);
+  }
+
+  /**
+   * SHM constructor. Initialize the map.
+   *
+   * @param alloc the shared-memory allocator
+   * @param node_size the size of a node in bytes
+   * */
+  HSHM_CROSS_FUN
+  explicit btree_map(const hipc::CtxAllocator<AllocT> &alloc,
+                     size_t node_size = 512) {
+    shm_init(alloc, node_size);
+  }
+
+  /** SHM constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc,
+                size_t node_size = 512) {
+    init_shm_container(alloc);
+    SetNull();
+    SetNodeSize(node_size);
+    InitRoot();
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit btree_map(const btree_map &other) {
+    init_shm_container(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit btree_map(const hipc::CtxAllocator<AllocT> &alloc,
+                     const btree_map &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  btree_map &operator=(const btree_map &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** Internal copy operation. Entries are bulk loaded in key order. */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const btree_map &other) {
+    SetNodeSize(other.node_size_);
+    InitRoot();
+    OffsetPointer tail_p = head_;
+    for (iterator_t iter = other.begin(); !iter.is_end(); ++iter) {
+      BulkAppend(tail_p, iter.GetKey(), iter.GetVal());
+    }
+    BulkFinish();
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_INLINE_CROSS_FUN btree_map(btree_map &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_INLINE_CROSS_FUN btree_map(const hipc::CtxAllocator<AllocT> &alloc,
+                                  btree_map &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  btree_map &operator=(btree_map &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  btree_map &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      root_.off_ = other.root_.off_.load();
+      head_ = other.head_;
+      length_ = other.length_.load();
+      node_size_ = other.node_size_;
+      leaf_cap_ = other.leaf_cap_;
+      inner_cap_ = other.inner_cap_;
+      vals_off_ = other.vals_off_;
+      children_off_ = other.children_off_;
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** Check if the map is empty */
+  HSHM_INLINE_CROSS_FUN bool IsNull() const { return root_.IsNull(); }
+
+  /** Sets this map as empty */
+  HSHM_INLINE_CROSS_FUN void SetNull() {
+    root_.SetNull();
+    head_.SetNull();
+    length_ = 0;
+  }
+
+  /** Destroy every node. Not safe while the map is being accessed. */
+  HSHM_CROSS_FUN void shm_destroy_main() {
+    FreeNode(GetRoot());
+  }
+
+  /**====================================
+   * Emplace Methods
+   * ===================================*/
+
+  /**
+   * Construct an object directly in the map. Overrides the object if
+   * key already exists.
+   *
+   * @param key the key to future index the map
+   * @param args the arguments to construct the object
+   * @return true
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool emplace(const Key &key, Args &&...args) {
+    if constexpr (kOptimisticRead) {
+      return emplace_templ<true>(key, std::forward<Args>(args)...);
+    } else {
+      ScopedRwWriteLock lock(lock_, 0);
+      return emplace_templ<true>(key, std::forward<Args>(args)...);
+    }
+  }
+
+  /**
+   * Construct an object directly in the map. Does not modify the key
+   * if it already exists.
+   *
+   * @param key the key to future index the map
+   * @param args the arguments to construct the object
+   * @return true if the key was inserted
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool try_emplace(const Key &key, Args &&...args) {
+    if constexpr (kOptimisticRead) {
+      return emplace_templ<false>(key, std::forward<Args>(args)...);
+    } else {
+      ScopedRwWriteLock lock(lock_, 0);
+      return emplace_templ<false>(key, std::forward<Args>(args)...);
+    }
+  }
+
+  /**
+   * Replace the contents of the map with sorted input. Leaves are filled
+   * completely and the inner levels are built bottom-up, which is much
+   * faster than inserting the entries one by one.
+   *
+   * @param first an iterator to (key, value) pairs with .first and .second,
+   * sorted by Compare. Entries whose key is not greater than the previous
+   * key are inserted with try_emplace after the tree is built.
+   * @param last the end of the input
+   * */
+  template <typename IterT>
+  HSHM_CROSS_FUN void bulk_load(IterT first, IterT last) {
+    clear();
+    OffsetPointer tail_p = head_;
+    bool sorted = true;
+    for (IterT it = first; it != last; ++it) {
+      sorted &= BulkAppend(tail_p, (*it).first, (*it).second);
+    }
+    BulkFinish();
+    if (!sorted) {
+      for (IterT it = first; it != last; ++it) {
+        try_emplace((*it).first, (*it).second);
+      }
+    }
+  }
+
+ private:
+  /**
+   * Insert a (key, value) pair in the map
+   *
+   * @param modify_existing whether or not to override an existing entry
+   * */
+  template <bool modify_existing, typename... Args>
+  HSHM_CROSS_FUN bool emplace_templ(const Key &key, Args &&...args) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    while (true) {
+      bool restart;
+      OffsetPointer node_p = GetRoot();
+      NODE_T *node = alloc->template Convert<NODE_T>(node_p);
+      hshm::u64 version = node->ReadLock(restart);
+      if (restart || GetRoot() != node_p) {
+        HSHM_THREAD_MODEL->Yield();
+        continue;
+      }
+      NODE_T *parent = nullptr;
+      hshm::u64 parent_version = 0;
+
+      // Descend to the leaf, splitting full nodes on the way down
+      while (true) {
+        if (node->count_ >= Capacity(node)) {
+          if (parent && !parent->Upgrade(parent_version)) {
+            restart = true;
+            break;
+          }
+          if (!node->Upgrade(version)) {
+            if (parent) {
+              parent->WriteUnlock();
+            }
+            restart = true;
+            break;
+          }
+          if (!parent && GetRoot() != node_p) {
+            node->WriteUnlock();
+            restart = true;
+            break;
+          }
+          Split(parent, node, node_p);
+          node->WriteUnlock();
+          if (parent) {
+            parent->WriteUnlock();
+          }
+          restart = true;
+          break;
+        }
+        if (node->is_leaf_) {
+          break;
+        }
+        OffsetPointer child_p = GetChildren(node)[ChildIndex(node, key)];
+        if (!node->Validate(version)) {
+          restart = true;
+          break;
+        }
+        NODE_T *child = alloc->template Convert<NODE_T>(child_p);
+        hshm::u64 child_version = child->ReadLock(restart);
+        if (restart || (parent && !parent->Validate(parent_version))) {
+          restart = true;
+          break;
+        }
+        parent = node;
+        parent_version = version;
+        node = child;
+        node_p = child_p;
+        version = child_version;
+      }
+      if (restart || !node->Upgrade(version)) {
+        continue;
+      }
+      if (parent && !parent->Validate(parent_version)) {
+        node->WriteUnlock();
+        continue;
+      }
+
+      // Modify the leaf
+      bool ret = LeafInsert<modify_existing>(node, key,
+                                             std::forward<Args>(args)...);
+      node->WriteUnlock();
+      return ret;
+    }
+  }
+
+ public:
+  /**====================================
+   * Erase Methods
+   * ===================================*/
+
+  /**
+   * Erase an object indexable by \a key key
+   *
+   * @return true if the key was present
+   * */
+  HSHM_CROSS_FUN
+  bool erase(const Key &key) {
+    if constexpr (kOptimisticRead) {
+      return erase_templ(key);
+    } else {
+      ScopedRwWriteLock lock(lock_, 0);
+      return erase_templ(key);
+    }
+  }
+
+  /**
+   * Erase the entire map. Not safe while the map is being accessed.
+   * */
+  HSHM_CROSS_FUN void clear() {
+    FreeNode(GetRoot());
+    InitRoot();
+  }
+
+ private:
+  /** Erase \a key from its leaf */
+  HSHM_CROSS_FUN bool erase_templ(const Key &key) {
+    while (true) {
+      hshm::u64 version;
+      NODE_T *leaf = FindLeaf(key, version);
+      if (!leaf->Upgrade(version)) {
+        continue;
+      }
+      size_t count = leaf->count_;
+      size_t i = LowerBound(leaf, count, key);
+      bool found = i < count && !Compare{}(key, GetKeys(leaf)[i].get_ref());
+      if (found) {
+        GetKeys(leaf)[i].shm_destroy();
+        GetVals(leaf)[i].shm_destroy();
+        ShiftLeft(GetKeys(leaf), i, count);
+        ShiftLeft(GetVals(leaf), i, count);
+        leaf->count_ = count - 1;
+        length_.fetch_sub(1);
+      }
+      leaf->WriteUnlock();
+      return found;
+    }
+  }
+
+ public:
+  /**====================================
+   * Index Methods
+   * ===================================*/
+
+  /**
+   * Copy the value of \a key into \a val.
+   *
+   * @return true if the key was found
+   * */
+  HSHM_CROSS_FUN
+  bool find(const Key &key, T &val) const {
+    if constexpr (kOptimisticRead) {
+      return find_optimistic(key, &val);
+    } else {
+      ScopedRwReadLock lock(lock_, 0);
+      iterator_t iter = lower_bound_templ(key);
+      if (iter.is_end() || Compare{}(key, iter.GetKey())) {
+        return false;
+      }
+      val = iter.GetVal();
+      return true;
+    }
+  }
+
+  /** Check whether \a key is in the map */
+  HSHM_CROSS_FUN
+  bool contains(const Key &key) const {
+    if constexpr (kOptimisticRead) {
+      return find_optimistic(key, nullptr);
+    } else {
+      ScopedRwReadLock lock(lock_, 0);
+      iterator_t iter = lower_bound_templ(key);
+      return !iter.is_end() && !Compare{}(key, iter.GetKey());
+    }
+  }
+
+  /**
+   * Call \a func(key, val) on every entry with lo <= key < hi, in key
+   * order. Safe under concurrent modification: with trivially copyable
+   * entries, kScanBatch entries at a time are copied out of a leaf and
+   * validated before \a func sees them, and a failed validation resumes
+   * after the last key visited.
+   *
+   * @return the number of entries visited
+   * */
+  template <typename FUNC>
+  HSHM_CROSS_FUN size_t scan(const Key &lo, const Key &hi,
+                             FUNC &&func) const {
+    if constexpr (kOptimisticRead) {
+      return scan_optimistic(lo, hi, std::forward<FUNC>(func));
+    } else {
+      ScopedRwReadLock lock(lock_, 0);
+      size_t count = 0;
+      for (iterator_t iter = lower_bound_templ(lo);
+           !iter.is_end() && Compare{}(iter.GetKey(), hi); ++iter) {
+        func(iter.GetKey(), iter.GetVal());
+        ++count;
+      }
+      return count;
+    }
+  }
+
+  /**====================================
+   * Iterators
+   * ===================================*/
+
+  /**
+   * The first entry whose key is not less than \a key.
+   * Not safe while the map is being modified.
+   * */
+  HSHM_CROSS_FUN iterator_t lower_bound(const Key &key) const {
+    return lower_bound_templ(key);
+  }
+
+  /**
+   * The entry of \a key, or end().
+   * Not safe while the map is being modified.
+   * */
+  HSHM_CROSS_FUN iterator_t find(const Key &key) const {
+    iterator_t iter = lower_bound_templ(key);
+    if (!iter.is_end() && Compare{}(key, iter.GetKey())) {
+      return end();
+    }
+    return iter;
+  }
+
+  /** Forward iterator begin */
+  HSHM_INLINE_CROSS_FUN iterator_t begin() const {
+    return iterator_t(*this, GetAllocator()->template Convert<NODE_T>(head_),
+                      0);
+  }
+
+  /** Forward iterator end */
+  HSHM_INLINE_CROSS_FUN iterator_t end() const {
+    return iterator_t(*this, nullptr, 0);
+  }
+
+  /**====================================
+   * Query Methods
+   * ===================================*/
+
+  /** The number of entries in the map */
+  HSHM_INLINE_CROSS_FUN size_t size() const { return (size_t)length_.load(); }
+
+  /** The size of a node in bytes */
+  HSHM_INLINE_CROSS_FUN size_t get_node_size() const { return node_size_; }
+
+  /** The number of entries a leaf holds */
+  HSHM_INLINE_CROSS_FUN size_t get_leaf_capacity() const { return leaf_cap_; }
+
+  /** The number of levels in the tree. Not safe under modification. */
+  HSHM_CROSS_FUN size_t get_height() const {
+    size_t height = 1;
+    NODE_T *node = GetAllocator()->template Convert<NODE_T>(
+        GetRoot());
+    while (!node->is_leaf_) {
+      node = GetAllocator()->template Convert<NODE_T>(GetChildren(node)[0]);
+      ++height;
+    }
+    return height;
+  }
+
+  /**====================================
+   * Internal Operations
+   * ===================================*/
+ private:
+  /** Get the root node */
+  HSHM_INLINE_CROSS_FUN OffsetPointer GetRoot() const {
+    return OffsetPointer(root_.off_.load(std::memory_order_acquire));
+  }
+
+  /** Get the keys of a node */
+  HSHM_INLINE_CROSS_FUN delay_ar<Key> *GetKeys(NODE_T *node) const {
+    return reinterpret_cast<delay_ar<Key> *>(reinterpret_cast<char *>(node) +
+                                             KeysOff());
+  }
+
+  /** Get the values of a leaf */
+  HSHM_INLINE_CROSS_FUN delay_ar<T> *GetVals(NODE_T *leaf) const {
+    return reinterpret_cast<delay_ar<T> *>(reinterpret_cast<char *>(leaf) +
+                                           vals_off_);
+  }
+
+  /** Get the children of an inner node */
+  HSHM_INLINE_CROSS_FUN OffsetPointer *GetChildren(NODE_T *node) const {
+    return reinterpret_cast<OffsetPointer *>(reinterpret_cast<char *>(node) +
+                                             children_off_);
+  }
+
+  /** The number of keys a node holds */
+  HSHM_INLINE_CROSS_FUN size_t Capacity(NODE_T *node) const {
+    return node->is_leaf_ ? leaf_cap_ : inner_cap_;
+  }
+
+  /** The offset of the keys in a node */
+  HSHM_INLINE_CROSS_FUN static size_t KeysOff() {
+    return AlignUp(sizeof(NODE_T), alignof(delay_ar<Key>));
+  }
+
+  /** Round \a off up to a multiple of \a align */
+  HSHM_INLINE_CROSS_FUN static size_t AlignUp(size_t off, size_t align) {
+    return (off + align - 1) / align * align;
+  }
+
+  /** Derive the node capacities and layout from the node size */
+  HSHM_CROSS_FUN void SetNodeSize(size_t node_size) {
+    while (true) {
+      leaf_cap_ = (node_size - KeysOff()) /
+                  (sizeof(delay_ar<Key>) + sizeof(delay_ar<T>));
+      vals_off_ = AlignUp(KeysOff() + leaf_cap_ * sizeof(delay_ar<Key>),
+                          alignof(delay_ar<T>));
+      if (leaf_cap_ && vals_off_ + leaf_cap_ * sizeof(delay_ar<T>) >
+                           node_size) {
+        --leaf_cap_;
+      }
+      inner_cap_ = (node_size - KeysOff() - sizeof(OffsetPointer)) /
+                   (sizeof(delay_ar<Key>) + sizeof(OffsetPointer));
+      children_off_ =
+          AlignUp(KeysOff() + inner_cap_ * sizeof(delay_ar<Key>),
+                  alignof(OffsetPointer));
+      if (inner_cap_ && children_off_ + (inner_cap_ + 1) *
+                                            sizeof(OffsetPointer) >
+                            node_size) {
+        --inner_cap_;
+      }
+      if (leaf_cap_ >= kMinNodeKeys && inner_cap_ >= kMinNodeKeys) {
+        break;
+      }
+      node_size *= 2;
+    }
+    node_size_ = node_size;
+  }
+
+  /** Allocate an empty node */
+  HSHM_CROSS_FUN OffsetPointer AllocateNode(bool is_leaf) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer node_p =
+        alloc->template Allocate<OffsetPointer>(alloc.ctx_, node_size_);
+    if (node_p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, node_size_,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    NODE_T *node = alloc->template Convert<NODE_T>(node_p);
+    new (node) NODE_T();
+    node->version_ = 0;
+    node->count_ = 0;
+    node->is_leaf_ = is_leaf;
+    node->next_.SetNull();
+    return node_p;
+  }
+
+  /** Make the root an empty leaf */
+  HSHM_CROSS_FUN void InitRoot() {
+    head_ = AllocateNode(true);
+    root_.off_ = head_.off_.load();
+    length_ = 0;
+  }
+
+  /** Destroy a subtree and return its nodes to the allocator */
+  HSHM_CROSS_FUN void FreeNode(OffsetPointer node_p) {
+    if (node_p.IsNull()) {
+      return;
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    NODE_T *node = alloc->template Convert<NODE_T>(node_p);
+    delay_ar<Key> *keys = GetKeys(node);
+    for (size_t i = 0; i < node->count_; ++i) {
+      keys[i].shm_destroy();
+    }
+    if (node->is_leaf_) {
+      delay_ar<T> *vals = GetVals(node);
+      for (size_t i = 0; i < node->count_; ++i) {
+        vals[i].shm_destroy();
+      }
+    } else {
+      OffsetPointer *children = GetChildren(node);
+      for (size_t i = 0; i <= node->count_; ++i) {
+        FreeNode(children[i]);
+      }
+    }
+    alloc->Free(alloc.ctx_, node_p);
+  }
+
+  /** The first key in a node not less than \a key */
+  HSHM_INLINE_CROSS_FUN size_t LowerBound(NODE_T *node, size_t count,
+                                          const Key &key) const {
+    delay_ar<Key> *keys = GetKeys(node);
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (Compare{}(keys[mid].get_ref(), key)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  /** The first key in a node greater than \a key */
+  HSHM_INLINE_CROSS_FUN size_t UpperBound(NODE_T *node, size_t count,
+                                          const Key &key) const {
+    delay_ar<Key> *keys = GetKeys(node);
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (Compare{}(key, keys[mid].get_ref())) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    return lo;
+  }
+
+  /**
+   * The child of an inner node that covers \a key. Separator i is the
+   * smallest key of child i + 1. The count is clamped since optimistic
+   * readers may observe a node mid-update.
+   * */
+  HSHM_INLINE_CROSS_FUN size_t ChildIndex(NODE_T *node,
+                                          const Key &key) const {
+    size_t count = node->count_;
+    return UpperBound(node, count < inner_cap_ ? count : inner_cap_, key);
+  }
+
+  /**
+   * Descend to the leaf covering \a key with optimistic lock coupling.
+   *
+   * @param version the version of the leaf when it was reached
+   * */
+  HSHM_CROSS_FUN NODE_T *FindLeaf(const Key &key, hshm::u64 &version) const {
+    auto alloc = GetAllocator();
+    while (true) {
+      bool restart;
+      OffsetPointer node_p = GetRoot();
+      NODE_T *node = alloc->template Convert<NODE_T>(node_p);
+      version = node->ReadLock(restart);
+      if (restart || GetRoot() != node_p) {
+        HSHM_THREAD_MODEL->Yield();
+        continue;
+      }
+      while (!node->is_leaf_) {
+        OffsetPointer child_p = GetChildren(node)[ChildIndex(node, key)];
+        if (!node->Validate(version)) {
+          restart = true;
+          break;
+        }
+        NODE_T *child = alloc->template Convert<NODE_T>(child_p);
+        hshm::u64 child_version = child->ReadLock(restart);
+        if (restart || !node->Validate(version)) {
+          restart = true;
+          break;
+        }
+        node = child;
+        version = child_version;
+      }
+      if (!restart) {
+        return node;
+      }
+    }
+  }
+
+  /** Lock-free lookup. Retries until a leaf read validates. */
+  HSHM_CROSS_FUN bool find_optimistic(const Key &key, T *val) const {
+    while (true) {
+      hshm::u64 version;
+      NODE_T *leaf = FindLeaf(key, version);
+      size_t count = leaf->count_;
+      count = count < leaf_cap_ ? count : leaf_cap_;
+      size_t i = LowerBound(leaf, count, key);
+      bool found = i < count && !Compare{}(key, GetKeys(leaf)[i].get_ref());
+      delay_ar<T> copy;
+      if (found && val) {
+        memcpy((void *)&copy, (const void *)&GetVals(leaf)[i], sizeof(copy));
+      }
+      if (leaf->Validate(version)) {
+        if (found && val) {
+          memcpy((void *)val, (const void *)&copy.get_ref(), sizeof(T));
+        }
+        return found;
+      }
+    }
+  }
+
+  /** Lock-free range scan. See scan. */
+  template <typename FUNC>
+  HSHM_CROSS_FUN size_t scan_optimistic(const Key &lo, const Key &hi,
+                                        FUNC &&func) const {
+    auto alloc = GetAllocator();
+    delay_ar<Key> keys[kScanBatch];
+    delay_ar<T> vals[kScanBatch];
+    delay_ar<Key> resume;
+    memcpy((void *)&resume, (const void *)&lo, sizeof(Key));
+    bool inclusive = true;
+    size_t visited = 0;
+    NODE_T *leaf = nullptr;
+    hshm::u64 version = 0;
+    while (true) {
+      if (!leaf) {
+        leaf = FindLeaf(resume.get_ref(), version);
+      }
+      // Copy the next batch of entries out of the leaf
+      size_t count = leaf->count_;
+      count = count < leaf_cap_ ? count : leaf_cap_;
+      size_t i = inclusive ? LowerBound(leaf, count, resume.get_ref())
+                           : UpperBound(leaf, count, resume.get_ref());
+      size_t n = 0;
+      bool done = false;
+      for (; i < count && n < kScanBatch; ++i, ++n) {
+        if (!Compare{}(GetKeys(leaf)[i].get_ref(), hi)) {
+          done = true;
+          break;
+        }
+        memcpy((void *)&keys[n], (const void *)&GetKeys(leaf)[i], sizeof(Key));
+        memcpy((void *)&vals[n], (const void *)&GetVals(leaf)[i], sizeof(T));
+      }
+      bool leaf_end = i >= count;
+      OffsetPointer next_p = leaf->next_.ToOffsetPointer();
+      if (!leaf->Validate(version)) {
+        leaf = nullptr;
+        continue;
+      }
+
+      // Visit the batch
+      for (size_t j = 0; j < n; ++j) {
+        func(keys[j].get_ref(), vals[j].get_ref());
+      }
+      visited += n;
+      if (n) {
+        memcpy((void *)&resume, (const void *)&keys[n - 1], sizeof(Key));
+        inclusive = false;
+      }
+      if (done || (leaf_end && next_p.IsNull())) {
+        return visited;
+      }
+      if (leaf_end) {
+        bool restart;
+        leaf = alloc->template Convert<NODE_T>(next_p);
+        version = leaf->ReadLock(restart);
+        if (restart) {
+          leaf = nullptr;
+        }
+      }
+    }
+  }
+
+  /** lower_bound without locking */
+  HSHM_CROSS_FUN iterator_t lower_bound_templ(const Key &key) const {
+    auto alloc = GetAllocator();
+    NODE_T *node =
+        alloc->template Convert<NODE_T>(GetRoot());
+    while (!node->is_leaf_) {
+      node = alloc->template Convert<NODE_T>(
+          GetChildren(node)[ChildIndex(node, key)]);
+    }
+    return iterator_t(*this, node, LowerBound(node, node->count_, key));
+  }
+
+  /** Move slot \a src to the uninitialized slot \a dst */
+  template <typename U>
+  HSHM_INLINE_CROSS_FUN void MoveSlot(delay_ar<U> &dst, delay_ar<U> &src) {
+    if constexpr (std::is_trivially_copyable<U>::value) {
+      memcpy((void *)&dst, (const void *)&src, sizeof(U));
+    } else {
+      HSHM_MAKE_AR(dst, GetCtxAllocator(), std::move(src.get_ref()))
+      src.shm_destroy();
+    }
+  }
+
+  /** Open a hole at \a i in an array of \a count slots */
+  template <typename U>
+  HSHM_INLINE_CROSS_FUN void ShiftRight(delay_ar<U> *slots, size_t i,
+                                        size_t count) {
+    if constexpr (std::is_trivially_copyable<U>::value) {
+      memmove((void *)&slots[i + 1], (const void *)&slots[i],
+              (count - i) * sizeof(slots[0]));
+    } else {
+      for (size_t j = count; j > i; --j) {
+        MoveSlot(slots[j], slots[j - 1]);
+      }
+    }
+  }
+
+  /** Close the hole at \a i in an array of \a count slots */
+  template <typename U>
+  HSHM_INLINE_CROSS_FUN void ShiftLeft(delay_ar<U> *slots, size_t i,
+                                       size_t count) {
+    if constexpr (std::is_trivially_copyable<U>::value) {
+      memmove((void *)&slots[i], (const void *)&slots[i + 1],
+              (count - i - 1) * sizeof(slots[0]));
+    } else {
+      for (size_t j = i; j + 1 < count; ++j) {
+        MoveSlot(slots[j], slots[j + 1]);
+      }
+    }
+  }
+
+  /** Insert into a locked leaf which has room for one more entry */
+  template <bool modify_existing, typename... Args>
+  HSHM_CROSS_FUN bool LeafInsert(NODE_T *leaf, const Key &key,
+                                 Args &&...args) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t count = leaf->count_;
+    size_t i = LowerBound(leaf, count, key);
+    delay_ar<Key> *keys = GetKeys(leaf);
+    delay_ar<T> *vals = GetVals(leaf);
+    if (i < count && !Compare{}(key, keys[i].get_ref())) {
+      if constexpr (!modify_existing) {
+        return false;
+      } else {
+        vals[i].shm_destroy();
+        HSHM_MAKE_AR(vals[i], alloc, std::forward<Args>(args)...)
+        return true;
+      }
+    }
+    ShiftRight(keys, i, count);
+    ShiftRight(vals, i, count);
+    HSHM_MAKE_AR(keys[i], alloc, key)
+    HSHM_MAKE_AR(vals[i], alloc, std::forward<Args>(args)...)
+    leaf->count_ = count + 1;
+    length_.fetch_add(1);
+    return true;
+  }
+
+  /**
+   * Split a full node in half. Both \a node and \a parent (if any) are
+   * locked, and \a parent is not full. Without a parent, a new root is
+   * created above \a node.
+   * */
+  HSHM_CROSS_FUN void Split(NODE_T *parent, NODE_T *node,
+                            OffsetPointer node_p) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer right_p = AllocateNode(node->is_leaf_);
+    NODE_T *right = alloc->template Convert<NODE_T>(right_p);
+    delay_ar<Key> *keys = GetKeys(node);
+    delay_ar<Key> *right_keys = GetKeys(right);
+    size_t count = node->count_;
+    size_t mid = count / 2;
+    if (node->is_leaf_) {
+      // The right leaf takes [mid, count); its first key is the separator
+      delay_ar<T> *vals = GetVals(node);
+      delay_ar<T> *right_vals = GetVals(right);
+      for (size_t i = mid; i < count; ++i) {
+        MoveSlot(right_keys[i - mid], keys[i]);
+        MoveSlot(right_vals[i - mid], vals[i]);
+      }
+      right->count_ = count - mid;
+      right->next_.off_ = node->next_.off_.load();
+      node->count_ = mid;
+      node->next_.off_.store(right_p.off_.load(), std::memory_order_release);
+      InsertSeparator(parent, node_p, right_keys[0].get_ref(), right_p);
+    } else {
+      // Key mid moves up; the right node takes the keys after it
+      OffsetPointer *children = GetChildren(node);
+      OffsetPointer *right_children = GetChildren(right);
+      for (size_t i = mid + 1; i < count; ++i) {
+        MoveSlot(right_keys[i - mid - 1], keys[i]);
+      }
+      for (size_t i = mid + 1; i <= count; ++i) {
+        right_children[i - mid - 1] = children[i];
+      }
+      right->count_ = count - mid - 1;
+      node->count_ = mid;
+      InsertSeparator(parent, node_p, keys[mid].get_ref(), right_p);
+      keys[mid].shm_destroy();
+    }
+  }
+
+  /** Link \a right after \a left in \a parent, or grow a new root */
+  HSHM_CROSS_FUN void InsertSeparator(NODE_T *parent, OffsetPointer left_p,
+                                      const Key &sep, OffsetPointer right_p) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    if (parent == nullptr) {
+      OffsetPointer root_p = AllocateNode(false);
+      NODE_T *root = alloc->template Convert<NODE_T>(root_p);
+      HSHM_MAKE_AR(GetKeys(root)[0], alloc, sep)
+      GetChildren(root)[0] = left_p;
+      GetChildren(root)[1] = right_p;
+      root->count_ = 1;
+      root_.off_.store(root_p.off_.load(), std::memory_order_release);
+      return;
+    }
+    size_t count = parent->count_;
+    size_t i = UpperBound(parent, count, sep);
+    OffsetPointer *children = GetChildren(parent);
+    ShiftRight(GetKeys(parent), i, count);
+    memmove((void *)&children[i + 2], (const void *)&children[i + 1],
+            (count - i) * sizeof(OffsetPointer));
+    HSHM_MAKE_AR(GetKeys(parent)[i], alloc, sep)
+    children[i + 1] = right_p;
+    parent->count_ = count + 1;
+  }
+
+  /**
+   * Append an entry to the rightmost leaf during a bulk load
+   *
+   * @return false if the key is not greater than the last key (the
+   * entry is then skipped)
+   * */
+  template <typename ValT>
+  HSHM_CROSS_FUN bool BulkAppend(OffsetPointer &tail_p, const Key &key,
+                                 const ValT &val) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    NODE_T *tail = alloc->template Convert<NODE_T>(tail_p);
+    if (tail->count_ &&
+        !Compare{}(GetKeys(tail)[tail->count_ - 1].get_ref(), key)) {
+      return false;
+    }
+    if (tail->count_ == leaf_cap_) {
+      OffsetPointer next_p = AllocateNode(true);
+      tail->next_.off_ = next_p.off_.load();
+      tail_p = next_p;
+      tail = alloc->template Convert<NODE_T>(tail_p);
+    }
+    HSHM_MAKE_AR(GetKeys(tail)[tail->count_], alloc, key)
+    HSHM_MAKE_AR(GetVals(tail)[tail->count_], alloc, val)
+    ++tail->count_;
+    length_.fetch_add(1);
+    return true;
+  }
+
+  /**
+   * Build the inner levels over the chain of leaves starting at head_.
+   * Each level is chained through next_ while the level above it is
+   * built; the links of inner nodes are cleared afterwards.
+   * */
+  HSHM_CROSS_FUN void BulkFinish() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer level_p = head_;
+    NODE_T *level = alloc->template Convert<NODE_T>(level_p);
+    bool is_leaf = true;
+    while (level && !level->next_.IsNull()) {
+      OffsetPointer parent_head_p = OffsetPointer::GetNull();
+      NODE_T *parent = nullptr;
+      OffsetPointer node_p = level_p;
+      while (!node_p.IsNull()) {
+        NODE_T *node = alloc->template Convert<NODE_T>(node_p);
+        OffsetPointer next_p = node->next_.ToOffsetPointer();
+        if (parent == nullptr || parent->count_ == inner_cap_) {
+          OffsetPointer parent_p = AllocateNode(false);
+          if (parent) {
+            parent->next_.off_ = parent_p.off_.load();
+          } else {
+            parent_head_p = parent_p;
+          }
+          parent = alloc->template Convert<NODE_T>(parent_p);
+          GetChildren(parent)[0] = node_p;
+        } else {
+          HSHM_MAKE_AR(GetKeys(parent)[parent->count_], alloc,
+                       MinKey(node))
+          GetChildren(parent)[parent->count_ + 1] = node_p;
+          ++parent->count_;
+        }
+        if (!is_leaf) {
+          node->next_.SetNull();
+        }
+        node_p = next_p;
+      }
+      level_p = parent_head_p;
+      level = alloc->template Convert<NODE_T>(level_p);
+      is_leaf = false;
+    }
+    root_.off_.store(level_p.off_.load(), std::memory_order_release);
+  }
+
+  /** The smallest key in the subtree of \a node */
+  HSHM_INLINE_CROSS_FUN const Key &MinKey(NODE_T *node) const {
+    while (!node->is_leaf_) {
+      node = GetAllocator()->template Convert<NODE_T>(GetChildren(node)[0]);
+    }
+    return GetKeys(node)[0].get_ref();
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename Key, typename T, class Compare = hshm::less<Key>,
+          HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using btree_map = hipc::btree_map<Key, T, Compare, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_BTREE_MAP_H_
@@ -0,0 +1,406 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_CONCURRENT_PRIORITY_QUEUE_H_
+#define HSHM_DATA_STRUCTURES_IPC_CONCURRENT_PRIORITY_QUEUE_H_
+
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/thread/lock.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/qtok.h"
+#include "priority_queue.h"
+#include "vector.h"
+
+namespace hshm::ipc {
+
+/** Forward declaration of concurrent_priority_queue */
+template <typename T, typename CmpT = hshm::less<T>, int D = 4,
+          HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class concurrent_priority_queue;
+
+/** The lock of one heap of a concurrent_priority_queue */
+struct concurrent_priority_queue_lock {
+  hshm::Mutex lock_;
+  char pad_[HSHM_CACHE_LINE_SIZE - sizeof(hshm::Mutex) % HSHM_CACHE_LINE_SIZE];
+};
+
+/**
+ * MACROS used to simplify the concurrent_priority_queue namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME concurrent_priority_queue
+#define CLASS_NEW_ARGS T, CmpT, D
+
+/**
+ * A relaxed priority queue for multiple producers and consumers (a
+ * MultiQueue). Elements are spread over several priority_queue heaps,
+ * each behind its own lock. push locks a random heap it can get without
+ * waiting. pop samples two random heaps and pops the better of their
+ * tops, so it returns one of the highest-priority elements, though not
+ * always the highest. Threads rarely touch the same heap, so the queue
+ * scales with the number of heaps.
+ *
+ * pop only reports empty after visiting every heap, so an element pushed
+ * before a pop began is never missed. CmpT follows priority_queue.
+ * */
+template <typename T, typename CmpT, int D, HSHM_CLASS_TEMPL>
+class concurrent_priority_queue : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef priority_queue<T, CmpT, D, HSHM_CLASS_TEMPL_ARGS> heap_t;
+  typedef vector<heap_t, HSHM_CLASS_TEMPL_ARGS> vector_t;
+  typedef concurrent_priority_queue_lock lock_t;
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  delay_ar<vector_t> heaps_;
+  OffsetPointer locks_;
+  hshm::u64 num_heaps_;
+  ipc::atomic<hshm::u64> rr_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit concurrent_priority_queue(size_t num_heaps = 0) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), num_heaps);
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit concurrent_priority_queue(const hipc::CtxAllocator<AllocT> &alloc,
+                                     size_t num_heaps = 0) {
+    shm_init(alloc, num_heaps);
+  }
+
+  /**
+   * SHM Constructor.
+   *
+   * @param num_heaps the number of heaps. 0 uses two per CPU.
+   * */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc,
+                size_t num_heaps = 0) {
+    init_shm_container(alloc);
+    SetNull();
+    if (num_heaps == 0) {
+      num_heaps = 2 * HSHM_SYSTEM_INFO->ncpu_;
+    }
+    HSHM_MAKE_AR(heaps_, GetCtxAllocator(), num_heaps);
+    AllocateLocks(num_heaps);
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit concurrent_priority_queue(const concurrent_priority_queue &other) {
+    init_shm_container(other.GetCtxAllocator());
+    SetNull();
+    HSHM_MAKE_AR0(heaps_, GetCtxAllocator());
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit concurrent_priority_queue(const hipc::CtxAllocator<AllocT> &alloc,
+                                     const concurrent_priority_queue &other) {
+    init_shm_container(alloc);
+    SetNull();
+    HSHM_MAKE_AR0(heaps_, GetCtxAllocator());
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  concurrent_priority_queue &operator=(const concurrent_priority_queue &other) {
+    if (this != &other) {
+      FreeLocks();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** SHM copy constructor + operator main. Not safe under modification. */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const concurrent_priority_queue &other) {
+    (*heaps_) = (*other.heaps_);
+    AllocateLocks(other.num_heaps_);
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  concurrent_priority_queue(concurrent_priority_queue &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  concurrent_priority_queue(const hipc::CtxAllocator<AllocT> &alloc,
+                            concurrent_priority_queue &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  concurrent_priority_queue &operator=(
+      concurrent_priority_queue &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  concurrent_priority_queue &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+      HSHM_MAKE_AR0(heaps_, GetCtxAllocator());
+    } else {
+      FreeLocks();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      (*heaps_) = std::move(*other.heaps_);
+      locks_ = other.locks_;
+      num_heaps_ = other.num_heaps_;
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() {
+    (*heaps_).shm_destroy();
+    FreeLocks();
+  }
+
+  /** Check if the queue is empty */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return locks_.IsNull(); }
+
+  /** Sets this queue as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {
+    locks_.SetNull();
+    num_heaps_ = 0;
+    rr_ = 0;
+  }
+
+  /**====================================
+   * Priority Queue Methods
+   * ===================================*/
+
+  /** Construct an element in the first random heap that is not locked */
+  template <typename... Args>
+  HSHM_CROSS_FUN void emplace(Args &&...args) {
+    lock_t *locks = GetLocks();
+    hshm::u64 start = NextRand();
+    for (hshm::u64 i = 0;; ++i) {
+      size_t id = (size_t)((start + i) % num_heaps_);
+      if (locks[id].lock_.TryLock(0)) {
+        (*heaps_)[id].emplace(std::forward<Args>(args)...);
+        locks[id].lock_.Unlock();
+        return;
+      }
+      if (i % num_heaps_ == num_heaps_ - 1) {
+        HSHM_THREAD_MODEL->Yield();
+      }
+    }
+  }
+
+  /** Push an element in the queue (wrapper) */
+  template <typename... Args>
+  HSHM_INLINE_CROSS_FUN void push(Args &&...args) {
+    emplace(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Pop the better top of two random heaps. If both are empty or busy,
+   * pop from the first non-empty heap.
+   *
+   * @return a null qtok if every heap was empty
+   * */
+  HSHM_CROSS_FUN
+  qtok_t pop(T &val) {
+    vector_t &heaps = *heaps_;
+    lock_t *locks = GetLocks();
+    hshm::u64 rand = NextRand();
+    size_t a = (size_t)(rand % num_heaps_);
+    size_t b = (size_t)((rand >> 32) % num_heaps_);
+    bool held_a = locks[a].lock_.TryLock(0);
+    bool held_b = a != b && locks[b].lock_.TryLock(0);
+    bool use_a = held_a && !heaps[a].empty();
+    bool use_b = held_b && !heaps[b].empty();
+    if (use_a && use_b) {
+      CmpT cmp;
+      if (cmp(heaps[a].top(), heaps[b].top())) {
+        use_a = false;
+      } else {
+        use_b = false;
+      }
+    }
+    qtok_t qtok = qtok_t::GetNull();
+    if (use_a) {
+      qtok = heaps[a].pop(val);
+    } else if (use_b) {
+      qtok = heaps[b].pop(val);
+    }
+    if (held_a) {
+      locks[a].lock_.Unlock();
+    }
+    if (held_b) {
+      locks[b].lock_.Unlock();
+    }
+    if (!qtok.IsNull()) {
+      return qtok;
+    }
+    // Visit every heap before reporting empty
+    for (size_t i = 0; i < num_heaps_; ++i) {
+      size_t id = (a + i) % num_heaps_;
+      locks[id].lock_.Lock(0);
+      qtok = heaps[id].pop(val);
+      locks[id].lock_.Unlock();
+      if (!qtok.IsNull()) {
+        return qtok;
+      }
+    }
+    return qtok_t::GetNull();
+  }
+
+  /** Pop an element and discard it */
+  HSHM_CROSS_FUN
+  qtok_t pop() {
+    T val;
+    return pop(val);
+  }
+
+  /** Get the number of heaps */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetNumHeaps() const { return (size_t)num_heaps_; }
+
+  /** Get size at this moment. Locks every heap. */
+  HSHM_CROSS_FUN
+  size_t GetSize() {
+    vector_t &heaps = *heaps_;
+    lock_t *locks = GetLocks();
+    size_t size = 0;
+    for (size_t i = 0; i < num_heaps_; ++i) {
+      locks[i].lock_.Lock(0);
+      size += heaps[i].size();
+      locks[i].lock_.Unlock();
+    }
+    return size;
+  }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() { return GetSize(); }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t Size() { return GetSize(); }
+
+ private:
+  /** Get the locks */
+  HSHM_INLINE_CROSS_FUN lock_t *GetLocks() const {
+    return GetAllocator()->template Convert<lock_t>(locks_);
+  }
+
+  /**
+   * A random number for picking heaps. Each host thread has its own
+   * xorshift state, so picking a heap touches no shared memory.
+   * */
+  HSHM_INLINE_CROSS_FUN hshm::u64 NextRand() {
+#ifdef HSHM_IS_HOST
+    static thread_local hshm::u64 state = 0;
+    if (state == 0) {
+      state = (reinterpret_cast<hshm::u64>(&state) ^ rr_.fetch_add(1)) |
+              1;
+    }
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+#else
+    hshm::u64 x = rr_.fetch_add(1) * 0x9E3779B97F4A7C15ULL;
+    return x ^ (x >> 31);
+#endif
+  }
+
+  /** Allocate one lock per heap */
+  HSHM_CROSS_FUN void AllocateLocks(size_t num_heaps) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = num_heaps * sizeof(lock_t);
+    locks_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (locks_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    lock_t *locks = GetLocks();
+    for (size_t i = 0; i < num_heaps; ++i) {
+      new (&locks[i]) lock_t();
+    }
+    num_heaps_ = num_heaps;
+  }
+
+  /** Free the locks */
+  HSHM_CROSS_FUN void FreeLocks() {
+    if (locks_.IsNull()) {
+      return;
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    alloc->Free(alloc.ctx_, locks_);
+    locks_.SetNull();
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename T, typename CmpT = hshm::less<T>, int D = 4,
+          HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using concurrent_priority_queue =
+    hipc::concurrent_priority_queue<T, CmpT, D, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_CONCURRENT_PRIORITY_QUEUE_H_
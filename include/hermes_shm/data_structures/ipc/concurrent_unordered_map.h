@@ -0,0 +1,766 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_CONCURRENT_UNORDERED_MAP_H_
+#define HSHM_DATA_STRUCTURES_CONCURRENT_UNORDERED_MAP_H_
+
+#include <type_traits>
+
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/thread/lock/rwlock.h"
+#include "hermes_shm/thread/thread_model_manager.h"
+#include "hermes_shm/types/atomic.h"
+#include "pair.h"
+
+namespace hshm::ipc {
+
+/** forward pointer for concurrent_unordered_map */
+template <typename Key, typename T, class Hash = hshm::hash<Key>,
+          HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class concurrent_unordered_map;
+
+/**
+ * An entry in a concurrent_unordered_map bucket chain.
+ * Entries are never returned to the allocator while the map is alive.
+ * Erased entries are kept in a per-shard free list and reused, so an
+ * optimistic reader that follows a stale link always lands on an entry.
+ * */
+template <typename Key, typename T, HSHM_CLASS_TEMPL>
+struct concurrent_unordered_map_entry {
+  AtomicOffsetPointer next_;
+  size_t hash_;
+  delay_ar<hipc::pair<Key, T, HSHM_CLASS_TEMPL_ARGS>> pair_;
+};
+
+/**
+ * The header of a bucket table. The bucket heads follow the header.
+ * Tables replaced by a resize are retired (not freed) until the map is
+ * destroyed, so optimistic readers never touch unmapped memory.
+ * */
+struct concurrent_unordered_map_table {
+  OffsetPointer retired_;
+  size_t num_buckets_;
+
+  /** Get the bucket heads */
+  HSHM_INLINE_CROSS_FUN AtomicOffsetPointer *GetBuckets() {
+    return reinterpret_cast<AtomicOffsetPointer *>(this + 1);
+  }
+};
+
+/**
+ * A shard of a concurrent_unordered_map. Writers serialize on \a lock_
+ * and bump \a seq_ before and after modifying the shard. Readers of
+ * trivially copyable entries validate against \a seq_ instead of locking.
+ * */
+struct concurrent_unordered_map_shard {
+  RwLock lock_;
+  ipc::atomic<hshm::size_t> seq_;
+  AtomicOffsetPointer table_;
+  OffsetPointer free_;
+  size_t length_;
+};
+
+/**
+ * MACROS to simplify the concurrent_unordered_map namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+
+#define CLASS_NAME concurrent_unordered_map
+#define CLASS_NEW_ARGS Key, T, Hash
+
+/**
+ * A hash map which is safe for concurrent emplace, find, and erase from
+ * multiple threads and processes.
+ *
+ * Keys are striped across a power-of-two number of shards, each of which
+ * owns its own bucket table and lock. Writers only lock the shard of the
+ * key, and a shard grows independently of the others, so a resize never
+ * stalls operations on other shards.
+ *
+ * When both Key and T are trivially copyable, find is lock-free: it walks
+ * the chain optimistically and retries if the shard's sequence number
+ * changed. Otherwise, find takes the shard's read lock.
+ *
+ * Shards are spaced a cache line apart to avoid false sharing.
+ * */
+template <typename Key, typename T, class Hash, HSHM_CLASS_TEMPL>
+class concurrent_unordered_map : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  using COLLISION_T = hipc::pair<Key, T, HSHM_CLASS_TEMPL_ARGS>;
+  using ENTRY_T = concurrent_unordered_map_entry<Key, T, HSHM_CLASS_TEMPL_ARGS>;
+  using TABLE_T = concurrent_unordered_map_table;
+  using SHARD_T = concurrent_unordered_map_shard;
+  CLS_CONST size_t kShardStride = (sizeof(SHARD_T) + 63) & ~(size_t)63;
+  CLS_CONST bool kOptimisticRead =
+      std::is_trivially_copyable<Key>::value &&
+      std::is_trivially_copyable<T>::value;
+
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer shards_;
+  size_t num_shards_;
+  size_t shard_shift_;
+  RealNumber max_capacity_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /**
+   * SHM constructor. Initialize the map.
+   *
+   * @param num_shards the number of independently locked shards. Rounded
+   * up to a power of two.
+   * @param num_buckets the initial number of buckets per shard. Rounded
+   * up to a power of two.
+   * @param max_capacity the load factor of a shard before it grows
+   * */
+  HSHM_CROSS_FUN
+  explicit concurrent_unordered_map(int num_shards = 64, int num_buckets = 16,
+                                    RealNumber max_capacity = RealNumber(4,
+                                                                         5)) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), num_shards,
+             num_buckets, max_capacity);
+  }
+
+  /**
+   * SHM constructor. Initialize the map.
+   *
+   * @param alloc the shared-memory allocator
+   * @param num_shards the number of independently locked shards
+   * @param num_buckets the initial number of buckets per shard
+   * @param max_capacity the load factor of a shard before it grows
+   * */
+  HSHM_CROSS_FUN
+  explicit concurrent_unordered_map(const hipc::CtxAllocator<AllocT> &alloc,
+                                    int num_shards = 64, int num_buckets = 16,
+                                    RealNumber max_capacity = RealNumber(4,
+                                                                         5)) {
+    shm_init(alloc, num_shards, num_buckets, max_capacity);
+  }
+
+  /** SHM constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc, int num_shards = 64,
+                int num_buckets = 16,
+                RealNumber max_capacity = RealNumber(4, 5)) {
+    init_shm_container(alloc);
+    SetNull();
+    max_capacity_ = max_capacity;
+    AllocateShards(RoundUpPow2(num_shards), RoundUpPow2(num_buckets));
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit concurrent_unordered_map(const concurrent_unordered_map &other) {
+    init_shm_container(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit concurrent_unordered_map(const hipc::CtxAllocator<AllocT> &alloc,
+                                    const concurrent_unordered_map &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  concurrent_unordered_map &operator=(const concurrent_unordered_map &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** Internal copy operation. Each shard of other is copied atomically. */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const concurrent_unordered_map &other) {
+    max_capacity_ = other.max_capacity_;
+    AllocateShards(other.num_shards_, 16);
+    other.for_each([this](const Key &key, const T &val) {
+      emplace(key, val);
+    });
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_INLINE_CROSS_FUN concurrent_unordered_map(
+      concurrent_unordered_map &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_INLINE_CROSS_FUN concurrent_unordered_map(
+      const hipc::CtxAllocator<AllocT> &alloc,
+      concurrent_unordered_map &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  concurrent_unordered_map &operator=(
+      concurrent_unordered_map &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  concurrent_unordered_map &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      shards_ = other.shards_;
+      num_shards_ = other.num_shards_;
+      shard_shift_ = other.shard_shift_;
+      max_capacity_ = other.max_capacity_;
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** Check if the map is empty */
+  HSHM_INLINE_CROSS_FUN bool IsNull() const { return shards_.IsNull(); }
+
+  /** Sets this map as empty */
+  HSHM_INLINE_CROSS_FUN void SetNull() {
+    shards_.SetNull();
+    num_shards_ = 0;
+    shard_shift_ = 0;
+  }
+
+  /** Destroy every shard. Not safe while the map is being accessed. */
+  HSHM_CROSS_FUN void shm_destroy_main() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    for (size_t i = 0; i < num_shards_; ++i) {
+      SHARD_T &shard = GetShard(i);
+      ClearShard(shard);
+      FreeEntryList(shard.free_);
+      OffsetPointer table_p = shard.table_.ToOffsetPointer();
+      while (!table_p.IsNull()) {
+        TABLE_T *table = alloc->template Convert<TABLE_T>(table_p);
+        OffsetPointer retired = table->retired_;
+        alloc->Free(alloc.ctx_, table_p);
+        table_p = retired;
+      }
+    }
+    alloc->Free(alloc.ctx_, shards_);
+  }
+
+  /**====================================
+   * Emplace Methods
+   * ===================================*/
+
+  /**
+   * Construct an object directly in the map. Overrides the object if
+   * key already exists.
+   *
+   * @param key the key to future index the map
+   * @param args the arguments to construct the object
+   * @return true
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool emplace(const Key &key, Args &&...args) {
+    return emplace_templ<true>(key, std::forward<Args>(args)...);
+  }
+
+  /**
+   * Construct an object directly in the map. Does not modify the key
+   * if it already exists.
+   *
+   * @param key the key to future index the map
+   * @param args the arguments to construct the object
+   * @return true if the key was inserted
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool try_emplace(const Key &key, Args &&...args) {
+    return emplace_templ<false>(key, std::forward<Args>(args)...);
+  }
+
+ private:
+  /**
+   * Insert a (key, value) pair in the map
+   *
+   * @param modify_existing whether or not to override an existing entry
+   * */
+  template <bool modify_existing, typename... Args>
+  HSHM_INLINE_CROSS_FUN bool emplace_templ(const Key &key, Args &&...args) {
+    size_t hash = HashKey(key);
+    SHARD_T &shard = GetShardOf(hash);
+    ScopedRwWriteLock lock(shard.lock_, 0);
+    TABLE_T *table = GetTable(shard);
+    AtomicOffsetPointer &head = table->GetBuckets()[BucketOf(hash, table)];
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+
+    // Override the existing entry in place
+    OffsetPointer entry_p = find_entry(key, hash, head);
+    if (!entry_p.IsNull()) {
+      if constexpr (!modify_existing) {
+        return false;
+      } else {
+        ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+        WriteBegin(shard);
+        entry->pair_.shm_destroy();
+        HSHM_MAKE_AR(entry->pair_, alloc, PiecewiseConstruct(),
+                     make_argpack(key),
+                     make_argpack(std::forward<Args>(args)...))
+        WriteEnd(shard);
+        return true;
+      }
+    }
+
+    // Construct the entry before publishing it
+    entry_p = AllocateEntry(shard);
+    ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+    entry->hash_ = hash;
+    HSHM_MAKE_AR(entry->pair_, alloc, PiecewiseConstruct(), make_argpack(key),
+                 make_argpack(std::forward<Args>(args)...))
+
+    // Link the entry at the head of the bucket
+    WriteBegin(shard);
+    entry->next_.off_.store(head.off_.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+    head.off_.store(entry_p.off_.load(), std::memory_order_release);
+    ++shard.length_;
+    if (shard.length_ > MaxLength(table->num_buckets_)) {
+      Grow(shard, table);
+    }
+    WriteEnd(shard);
+    return true;
+  }
+
+ public:
+  /**====================================
+   * Erase Methods
+   * ===================================*/
+
+  /**
+   * Erase an object indexable by \a key key
+   *
+   * @return true if the key was present
+   * */
+  HSHM_CROSS_FUN
+  bool erase(const Key &key) {
+    size_t hash = HashKey(key);
+    SHARD_T &shard = GetShardOf(hash);
+    ScopedRwWriteLock lock(shard.lock_, 0);
+    TABLE_T *table = GetTable(shard);
+    AtomicOffsetPointer *link = &table->GetBuckets()[BucketOf(hash, table)];
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    while (!link->IsNull()) {
+      OffsetPointer entry_p = link->ToOffsetPointer();
+      ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+      if (entry->hash_ == hash && entry->pair_->GetKey() == key) {
+        WriteBegin(shard);
+        link->off_.store(entry->next_.off_.load(std::memory_order_relaxed),
+                         std::memory_order_release);
+        entry->pair_.shm_destroy();
+        entry->next_.off_.store(shard.free_.off_.load(),
+                                std::memory_order_relaxed);
+        shard.free_ = entry_p;
+        --shard.length_;
+        WriteEnd(shard);
+        return true;
+      }
+      link = &entry->next_;
+    }
+    return false;
+  }
+
+  /**
+   * Erase the entire map. Each shard is cleared atomically.
+   * */
+  HSHM_CROSS_FUN void clear() {
+    for (size_t i = 0; i < num_shards_; ++i) {
+      SHARD_T &shard = GetShard(i);
+      ScopedRwWriteLock lock(shard.lock_, 0);
+      WriteBegin(shard);
+      ClearShard(shard);
+      WriteEnd(shard);
+    }
+  }
+
+  /**====================================
+   * Index Methods
+   * ===================================*/
+
+  /**
+   * Copy the value of \a key into \a val.
+   *
+   * @return true if the key was found
+   * */
+  HSHM_CROSS_FUN
+  bool find(const Key &key, T &val) const {
+    size_t hash = HashKey(key);
+    SHARD_T &shard = GetShardOf(hash);
+    if constexpr (kOptimisticRead) {
+      return find_optimistic(key, hash, shard, &val);
+    } else {
+      ScopedRwReadLock lock(shard.lock_, 0);
+      TABLE_T *table = GetTable(shard);
+      OffsetPointer entry_p =
+          find_entry(key, hash, table->GetBuckets()[BucketOf(hash, table)]);
+      if (entry_p.IsNull()) {
+        return false;
+      }
+      val = GetAllocator()->template Convert<ENTRY_T>(entry_p)->pair_->GetVal();
+      return true;
+    }
+  }
+
+  /** Check whether \a key is in the map */
+  HSHM_CROSS_FUN
+  bool contains(const Key &key) const {
+    size_t hash = HashKey(key);
+    SHARD_T &shard = GetShardOf(hash);
+    if constexpr (kOptimisticRead) {
+      return find_optimistic(key, hash, shard, nullptr);
+    } else {
+      ScopedRwReadLock lock(shard.lock_, 0);
+      TABLE_T *table = GetTable(shard);
+      return !find_entry(key, hash, table->GetBuckets()[BucketOf(hash, table)])
+                  .IsNull();
+    }
+  }
+
+  /**
+   * Call \a func(key, val) on every entry. Each shard is read-locked while
+   * it is visited, so the view is consistent per shard.
+   * */
+  template <typename FUNC>
+  HSHM_CROSS_FUN void for_each(FUNC &&func) const {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    for (size_t i = 0; i < num_shards_; ++i) {
+      SHARD_T &shard = GetShard(i);
+      ScopedRwReadLock lock(shard.lock_, 0);
+      TABLE_T *table = GetTable(shard);
+      AtomicOffsetPointer *buckets = table->GetBuckets();
+      for (size_t b = 0; b < table->num_buckets_; ++b) {
+        OffsetPointer entry_p = buckets[b].ToOffsetPointer();
+        while (!entry_p.IsNull()) {
+          ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+          func(entry->pair_->GetKey(), entry->pair_->GetVal());
+          entry_p = entry->next_.ToOffsetPointer();
+        }
+      }
+    }
+  }
+
+  /**====================================
+   * Query Methods
+   * ===================================*/
+
+  /** The number of entries in the map. Approximate under concurrency. */
+  HSHM_CROSS_FUN size_t size() const {
+    size_t length = 0;
+    for (size_t i = 0; i < num_shards_; ++i) {
+      length += GetShard(i).length_;
+    }
+    return length;
+  }
+
+  /** The number of shards in the map */
+  HSHM_INLINE_CROSS_FUN size_t get_num_shards() const { return num_shards_; }
+
+  /** The total number of buckets in the map */
+  HSHM_CROSS_FUN size_t get_num_buckets() const {
+    size_t num_buckets = 0;
+    for (size_t i = 0; i < num_shards_; ++i) {
+      num_buckets += GetTable(GetShard(i))->num_buckets_;
+    }
+    return num_buckets;
+  }
+
+  /**====================================
+   * Internal Operations
+   * ===================================*/
+ private:
+  /** Hash a key. Shards use the high bits, so they must be mixed. */
+  HSHM_INLINE_CROSS_FUN static size_t HashKey(const Key &key) {
+    return hshm::mixed_hash<Hash>(key);
+  }
+
+  /** Round \a x up to a power of two */
+  HSHM_INLINE_CROSS_FUN static size_t RoundUpPow2(int x) {
+    size_t n = 1;
+    while (n < (size_t)x) {
+      n <<= 1;
+    }
+    return n;
+  }
+
+  /** The number of entries a shard holds before growing */
+  HSHM_INLINE_CROSS_FUN size_t MaxLength(size_t num_buckets) const {
+    return (max_capacity_ * num_buckets).as_int();
+  }
+
+  /** Get a shard by index */
+  HSHM_INLINE_CROSS_FUN SHARD_T &GetShard(size_t i) const {
+    char *shards = GetAllocator()->template Convert<char>(shards_);
+    return *reinterpret_cast<SHARD_T *>(shards + i * kShardStride);
+  }
+
+  /** Get the shard a hash belongs to (uses the high bits of the hash) */
+  HSHM_INLINE_CROSS_FUN SHARD_T &GetShardOf(size_t hash) const {
+    return GetShard(shard_shift_ == 64 ? 0 : (size_t)((u64)hash >>
+                                                      shard_shift_));
+  }
+
+  /** Get the current bucket table of a shard */
+  HSHM_INLINE_CROSS_FUN TABLE_T *GetTable(SHARD_T &shard) const {
+    return GetAllocator()->template Convert<TABLE_T>(
+        OffsetPointer(shard.table_.off_.load(std::memory_order_acquire)));
+  }
+
+  /** Get the bucket a hash belongs to (uses the low bits of the hash) */
+  HSHM_INLINE_CROSS_FUN static size_t BucketOf(size_t hash, TABLE_T *table) {
+    return hash & (table->num_buckets_ - 1);
+  }
+
+  /** Mark the start of a modification to a shard */
+  HSHM_INLINE_CROSS_FUN static void WriteBegin(SHARD_T &shard) {
+    shard.seq_.fetch_add(1, std::memory_order_acq_rel);
+  }
+
+  /** Mark the end of a modification to a shard */
+  HSHM_INLINE_CROSS_FUN static void WriteEnd(SHARD_T &shard) {
+    shard.seq_.fetch_add(1, std::memory_order_release);
+  }
+
+  /** Find the entry of \a key in a bucket chain. Requires the shard lock. */
+  HSHM_INLINE_CROSS_FUN OffsetPointer find_entry(const Key &key, size_t hash,
+                                                 AtomicOffsetPointer &head)
+      const {
+    OffsetPointer entry_p = head.ToOffsetPointer();
+    while (!entry_p.IsNull()) {
+      ENTRY_T *entry = GetAllocator()->template Convert<ENTRY_T>(entry_p);
+      if (entry->hash_ == hash && entry->pair_->GetKey() == key) {
+        return entry_p;
+      }
+      entry_p = entry->next_.ToOffsetPointer();
+    }
+    return entry_p;
+  }
+
+  /**
+   * Seqlock lookup. Every link is validated against the shard sequence
+   * number before it is followed, so a concurrent writer can only cause a
+   * retry. Links always point to live or free-listed entries, which are
+   * never unmapped while the map exists.
+   * */
+  HSHM_CROSS_FUN bool find_optimistic(const Key &key, size_t hash,
+                                      SHARD_T &shard, T *val) const {
+    auto alloc = GetAllocator();
+    while (true) {
+      size_t seq = shard.seq_.load(std::memory_order_acquire);
+      if (seq & 1) {
+        HSHM_THREAD_MODEL->Yield();
+        continue;
+      }
+      TABLE_T *table = GetTable(shard);
+      size_t off = table->GetBuckets()[BucketOf(hash, table)].off_.load(
+          std::memory_order_acquire);
+      bool found = false;
+      while (shard.seq_.load(std::memory_order_acquire) == seq) {
+        if (off == (size_t)-1) {
+          return false;
+        }
+        ENTRY_T *entry = alloc->template Convert<ENTRY_T>(OffsetPointer(off));
+        if (entry->hash_ == hash && entry->pair_->GetKey() == key) {
+          if (val) {
+            *val = entry->pair_->GetVal();
+          }
+          found = true;
+          break;
+        }
+        off = entry->next_.off_.load(std::memory_order_acquire);
+      }
+      if (found) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shard.seq_.load(std::memory_order_relaxed) == seq) {
+          return true;
+        }
+      }
+    }
+  }
+
+  /** Allocate the shards and their initial tables */
+  HSHM_CROSS_FUN void AllocateShards(size_t num_shards, size_t num_buckets) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = num_shards * kShardStride;
+    shards_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (shards_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    num_shards_ = num_shards;
+    shard_shift_ = 64;
+    for (size_t n = num_shards; n > 1; n >>= 1) {
+      --shard_shift_;
+    }
+    for (size_t i = 0; i < num_shards; ++i) {
+      SHARD_T &shard = GetShard(i);
+      new (&shard) SHARD_T();
+      shard.seq_ = 0;
+      shard.free_.SetNull();
+      shard.length_ = 0;
+      shard.table_.off_ = AllocateTable(num_buckets).off_.load();
+    }
+  }
+
+  /** Allocate an empty bucket table */
+  HSHM_CROSS_FUN OffsetPointer AllocateTable(size_t num_buckets) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size =
+        sizeof(TABLE_T) + num_buckets * sizeof(AtomicOffsetPointer);
+    OffsetPointer table_p =
+        alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (table_p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    TABLE_T *table = alloc->template Convert<TABLE_T>(table_p);
+    table->retired_.SetNull();
+    table->num_buckets_ = num_buckets;
+    AtomicOffsetPointer *buckets = table->GetBuckets();
+    for (size_t i = 0; i < num_buckets; ++i) {
+      buckets[i].SetNull();
+    }
+    return table_p;
+  }
+
+  /** Take an entry from the shard's free list or the allocator */
+  HSHM_INLINE_CROSS_FUN OffsetPointer AllocateEntry(SHARD_T &shard) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    if (!shard.free_.IsNull()) {
+      OffsetPointer entry_p = shard.free_;
+      shard.free_ =
+          alloc->template Convert<ENTRY_T>(entry_p)->next_.ToOffsetPointer();
+      return entry_p;
+    }
+    OffsetPointer entry_p =
+        alloc->template Allocate<OffsetPointer>(alloc.ctx_, sizeof(ENTRY_T));
+    if (entry_p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, sizeof(ENTRY_T),
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    return entry_p;
+  }
+
+  /**
+   * Double the bucket table of one shard. Only this shard is locked.
+   * The old table is retired rather than freed.
+   * */
+  HSHM_CROSS_FUN void Grow(SHARD_T &shard, TABLE_T *old_table) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer old_table_p = shard.table_.ToOffsetPointer();
+    OffsetPointer new_table_p = AllocateTable(old_table->num_buckets_ * 2);
+    TABLE_T *new_table = alloc->template Convert<TABLE_T>(new_table_p);
+    AtomicOffsetPointer *old_buckets = old_table->GetBuckets();
+    AtomicOffsetPointer *new_buckets = new_table->GetBuckets();
+    for (size_t b = 0; b < old_table->num_buckets_; ++b) {
+      OffsetPointer entry_p = old_buckets[b].ToOffsetPointer();
+      while (!entry_p.IsNull()) {
+        ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+        OffsetPointer next_p = entry->next_.ToOffsetPointer();
+        AtomicOffsetPointer &head =
+            new_buckets[BucketOf(entry->hash_, new_table)];
+        entry->next_.off_.store(head.off_.load(), std::memory_order_relaxed);
+        head.off_.store(entry_p.off_.load(), std::memory_order_relaxed);
+        entry_p = next_p;
+      }
+    }
+    new_table->retired_ = old_table_p;
+    shard.table_.off_.store(new_table_p.off_.load(),
+                            std::memory_order_release);
+  }
+
+  /** Destroy all entries of a shard. Requires the shard lock. */
+  HSHM_CROSS_FUN void ClearShard(SHARD_T &shard) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    TABLE_T *table = GetTable(shard);
+    AtomicOffsetPointer *buckets = table->GetBuckets();
+    for (size_t b = 0; b < table->num_buckets_; ++b) {
+      OffsetPointer entry_p = buckets[b].ToOffsetPointer();
+      while (!entry_p.IsNull()) {
+        ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+        OffsetPointer next_p = entry->next_.ToOffsetPointer();
+        entry->pair_.shm_destroy();
+        entry->next_.off_.store(shard.free_.off_.load(),
+                                std::memory_order_relaxed);
+        shard.free_ = entry_p;
+        entry_p = next_p;
+      }
+      buckets[b].SetNull();
+    }
+    shard.length_ = 0;
+  }
+
+  /** Return a list of entries to the allocator */
+  HSHM_CROSS_FUN void FreeEntryList(OffsetPointer entry_p) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    while (!entry_p.IsNull()) {
+      ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+      OffsetPointer next_p = entry->next_.ToOffsetPointer();
+      alloc->Free(alloc.ctx_, entry_p);
+      entry_p = next_p;
+    }
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename Key, typename T, class Hash = hshm::hash<Key>,
+          HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using concurrent_unordered_map =
+    hipc::concurrent_unordered_map<Key, T, Hash, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_CONCURRENT_UNORDERED_MAP_H_
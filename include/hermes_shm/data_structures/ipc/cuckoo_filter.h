@@ -0,0 +1,578 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_CUCKOO_FILTER_H_
+#define HSHM_DATA_STRUCTURES_IPC_CUCKOO_FILTER_H_
+
+#include <cstring>
+
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/thread/lock/mutex.h"
+#include "hermes_shm/thread/thread_model_manager.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/striped_counter.h"
+#include "hash.h"
+
+namespace hshm::ipc {
+
+/** Forward declaration of cuckoo_filter */
+template <typename T, class Hash = hshm::hash<T>,
+          HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class cuckoo_filter;
+
+/**
+ * MACROS used to simplify the cuckoo_filter namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME cuckoo_filter
+#define CLASS_NEW_ARGS T, Hash
+
+/**
+ * A cuckoo filter: an approximate set that, unlike bloom_filter,
+ * supports erase. Each key is stored as a small fingerprint in one of
+ * two buckets, and the second bucket is derived from the first and the
+ * fingerprint alone, so fingerprints can move without the key.
+ *
+ * A bucket is one 64-bit word holding 8, 4 or 2 fingerprints of 8, 16
+ * or 32 bits. The width is the narrowest one that meets the requested
+ * false-positive rate (about 2 * slots / 2^bits).
+ *
+ * Inserting into a bucket with a free slot, contains and erase are
+ * lock-free CAS operations on the bucket word. When both buckets are
+ * full, the inserter takes \a kick_lock_ and searches for a path of
+ * evictions ending in a free slot before moving anything. Moves then run
+ * back to front, each copying a fingerprint into its other bucket before
+ * clearing the old slot, so a key is never absent from both. Readers use
+ * \a seq_ to catch the window where a move is between buckets.
+ *
+ * insert fails (returns false) only when no eviction path is found,
+ * i.e., the filter is nearly full, and in that case leaves it unchanged.
+ * Only erase keys that were inserted; erasing others may remove a
+ * colliding key's fingerprint.
+ * */
+template <typename T, class Hash, HSHM_CLASS_TEMPL>
+class cuckoo_filter : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  /** The longest eviction path searched */
+  CLS_CONST int kMaxPath = 128;
+  /** The number of eviction paths tried before giving up */
+  CLS_CONST int kMaxSearches = 16;
+  /**
+   * The fraction of slots in use at the expected key count. Two-way
+   * cuckoo tables fill to about 84%, 95% and 98% with 2, 4 and 8 slots
+   * per bucket before inserts start to fail.
+   * */
+  CLS_CONST double kLoadFactor2 = .84;
+  CLS_CONST double kLoadFactor4 = .95;
+  CLS_CONST double kLoadFactor8 = .98;
+
+  /** One step of an eviction path */
+  struct PathEntry {
+    size_t bucket_;
+    u32 slot_;
+    u64 fp_;
+  };
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer buckets_;
+  size_t num_buckets_;
+  u32 fp_bits_;
+  u32 num_slots_;
+  /** Serializes eviction paths */
+  Mutex kick_lock_;
+  /** Odd while an eviction path is being moved */
+  ipc::atomic<hshm::size_t> seq_;
+  /** Striped by bucket, so concurrent inserts do not share one line */
+  striped_counter<> count_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit cuckoo_filter(size_t num_keys = 1024, double fpr = .001) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), num_keys,
+             fpr);
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit cuckoo_filter(const hipc::CtxAllocator<AllocT> &alloc,
+                         size_t num_keys = 1024, double fpr = .001) {
+    shm_init(alloc, num_keys, fpr);
+  }
+
+  /**
+   * SHM constructor.
+   *
+   * @param num_keys the number of keys the filter must hold
+   * @param fpr the target false-positive rate
+   * */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc,
+                size_t num_keys = 1024, double fpr = .001) {
+    init_shm_container(alloc);
+    SetNull();
+    kick_lock_.Init();
+    fp_bits_ = 32;
+    for (u32 bits = 8; bits < 32; bits *= 2) {
+      double rate = 2.0 * (64 / bits) / (double)((u64)1 << bits);
+      if (rate <= fpr) {
+        fp_bits_ = bits;
+        break;
+      }
+    }
+    num_slots_ = 64 / fp_bits_;
+    double load_factor = num_slots_ == 2   ? kLoadFactor2
+                         : num_slots_ == 4 ? kLoadFactor4
+                                           : kLoadFactor8;
+    // Power-of-two buckets, so the alternate bucket is an XOR
+    size_t min_buckets =
+        (size_t)((double)num_keys / (num_slots_ * load_factor)) + 1;
+    num_buckets_ = 2;
+    while (num_buckets_ < min_buckets) {
+      num_buckets_ <<= 1;
+    }
+    AllocateBuckets();
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit cuckoo_filter(const cuckoo_filter &other) {
+    init_shm_container(other.GetCtxAllocator());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit cuckoo_filter(const hipc::CtxAllocator<AllocT> &alloc,
+                         const cuckoo_filter &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  cuckoo_filter &operator=(const cuckoo_filter &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** SHM copy constructor + operator main. Not safe under modification. */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const cuckoo_filter &other) {
+    kick_lock_.Init();
+    num_buckets_ = other.num_buckets_;
+    fp_bits_ = other.fp_bits_;
+    num_slots_ = other.num_slots_;
+    AllocateBuckets();
+    memcpy((void *)GetBuckets(), (const void *)other.GetBuckets(),
+           num_buckets_ * sizeof(u64));
+    count_ = other.count_;
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  cuckoo_filter(cuckoo_filter &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  cuckoo_filter(const hipc::CtxAllocator<AllocT> &alloc,
+                cuckoo_filter &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  cuckoo_filter &operator=(cuckoo_filter &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  cuckoo_filter &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      kick_lock_.Init();
+      buckets_ = other.buckets_;
+      num_buckets_ = other.num_buckets_;
+      fp_bits_ = other.fp_bits_;
+      num_slots_ = other.num_slots_;
+      count_ = other.count_;
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    alloc->Free(alloc.ctx_, buckets_);
+  }
+
+  /** Check if the filter has no storage */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return buckets_.IsNull(); }
+
+  /** Sets this filter as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {
+    buckets_.SetNull();
+    num_buckets_ = 0;
+    fp_bits_ = 0;
+    num_slots_ = 0;
+    seq_ = 0;
+    count_.clear();
+  }
+
+  /**====================================
+   * Cuckoo Filter Methods
+   * ===================================*/
+
+  /** Add \a key. Returns false if the filter is too full to place it. */
+  HSHM_CROSS_FUN
+  bool insert(const T &key) {
+    u64 fp;
+    size_t b1, b2;
+    Locate(key, fp, b1, b2);
+    if (TryInsert(b1, fp) || TryInsert(b2, fp)) {
+      count_.add(b1);
+      return true;
+    }
+    ScopedMutex lock(kick_lock_, 0);
+    // Another evictor may have freed a slot while we waited
+    if (TryInsert(b1, fp) || TryInsert(b2, fp) || Kick(fp, b1, b2)) {
+      count_.add(b1);
+      return true;
+    }
+    return false;
+  }
+
+  /** Check whether \a key may be present. No false negatives. */
+  HSHM_CROSS_FUN
+  bool contains(const T &key) const {
+    u64 fp;
+    size_t b1, b2;
+    Locate(key, fp, b1, b2);
+    while (true) {
+      hshm::size_t seq = BeginRead();
+      if (FindSlot(b1, fp) >= 0 || FindSlot(b2, fp) >= 0) {
+        return true;
+      }
+      if (seq_.load(std::memory_order_acquire) == seq) {
+        return false;
+      }
+    }
+  }
+
+  /** Remove one copy of \a key. Returns false if it was not found. */
+  HSHM_CROSS_FUN
+  bool erase(const T &key) {
+    u64 fp;
+    size_t b1, b2;
+    Locate(key, fp, b1, b2);
+    while (true) {
+      hshm::size_t seq = BeginRead();
+      if (TryRemove(b1, fp) || TryRemove(b2, fp)) {
+        count_.sub(b1);
+        return true;
+      }
+      if (seq_.load(std::memory_order_acquire) == seq) {
+        return false;
+      }
+    }
+  }
+
+  /** Remove every key. Not safe under concurrent access. */
+  HSHM_CROSS_FUN
+  void clear() {
+    memset((void *)GetBuckets(), 0, num_buckets_ * sizeof(u64));
+    count_.clear();
+  }
+
+  /** The number of keys in the filter. Approximate under concurrency. */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() const { return count_.load(); }
+
+  /** The number of keys in the filter (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetSize() const { return size(); }
+
+  /** The number of fingerprint slots */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetCapacity() const { return num_buckets_ * num_slots_; }
+
+  /** The number of bits per fingerprint */
+  HSHM_INLINE_CROSS_FUN
+  u32 GetFingerprintBits() const { return fp_bits_; }
+
+ private:
+  /** Get the buckets */
+  HSHM_INLINE_CROSS_FUN ipc::atomic<u64> *GetBuckets() const {
+    return GetAllocator()->template Convert<ipc::atomic<u64>>(buckets_);
+  }
+
+  /** Get bucket \a b */
+  HSHM_INLINE_CROSS_FUN ipc::atomic<u64> &GetBucket(size_t b) const {
+    return GetBuckets()[b];
+  }
+
+  /** The mask of one fingerprint */
+  HSHM_INLINE_CROSS_FUN u64 FpMask() const {
+    return ((u64)1 << fp_bits_) - 1;
+  }
+
+  /** Get the fingerprint in slot \a s of a bucket word */
+  HSHM_INLINE_CROSS_FUN u64 GetFp(u64 word, u32 s) const {
+    return (word >> (s * fp_bits_)) & FpMask();
+  }
+
+  /**
+   * Compute the fingerprint and both buckets of \a key. The bucket comes
+   * from the low bits of the hash and the fingerprint from the high bits.
+   * Fingerprint 0 marks an empty slot, so it is never used.
+   * */
+  HSHM_INLINE_CROSS_FUN void Locate(const T &key, u64 &fp, size_t &b1,
+                                    size_t &b2) const {
+    u64 hash = (u64)mixed_hash<Hash>(key);
+    fp = (hash >> (64 - fp_bits_)) & FpMask();
+    if (fp == 0) {
+      fp = 1;
+    }
+    b1 = (size_t)hash & (num_buckets_ - 1);
+    b2 = AltBucket(b1, fp);
+  }
+
+  /** The other bucket of a fingerprint in bucket \a b */
+  HSHM_INLINE_CROSS_FUN size_t AltBucket(size_t b, u64 fp) const {
+    return (b ^ (size_t)fmix64(fp)) & (num_buckets_ - 1);
+  }
+
+  /** Wait out an in-flight eviction path and return the even sequence */
+  HSHM_INLINE_CROSS_FUN hshm::size_t BeginRead() const {
+    while (true) {
+      hshm::size_t seq = seq_.load(std::memory_order_acquire);
+      if ((seq & 1) == 0) {
+        return seq;
+      }
+      HSHM_THREAD_MODEL->Yield();
+    }
+  }
+
+  /** The slot of bucket \a b holding \a fp, or -1 */
+  HSHM_INLINE_CROSS_FUN int FindSlot(size_t b, u64 fp) const {
+    u64 word = GetBucket(b).load(std::memory_order_acquire);
+    for (u32 s = 0; s < num_slots_; ++s) {
+      if (GetFp(word, s) == fp) {
+        return (int)s;
+      }
+    }
+    return -1;
+  }
+
+  /** Whether bucket \a b has an empty slot */
+  HSHM_INLINE_CROSS_FUN bool HasEmptySlot(size_t b) const {
+    return FindSlot(b, 0) >= 0;
+  }
+
+  /** Put \a fp in an empty slot of bucket \a b */
+  HSHM_CROSS_FUN bool TryInsert(size_t b, u64 fp) {
+    ipc::atomic<u64> &bucket = GetBucket(b);
+    u64 word = bucket.load(std::memory_order_acquire);
+    while (true) {
+      u32 s = 0;
+      while (s < num_slots_ && GetFp(word, s) != 0) {
+        ++s;
+      }
+      if (s == num_slots_) {
+        return false;
+      }
+      if (bucket.compare_exchange_weak(word, word | (fp << (s * fp_bits_)))) {
+        return true;
+      }
+    }
+  }
+
+  /** Clear one slot of bucket \a b holding \a fp */
+  HSHM_CROSS_FUN bool TryRemove(size_t b, u64 fp) {
+    ipc::atomic<u64> &bucket = GetBucket(b);
+    u64 word = bucket.load(std::memory_order_acquire);
+    while (true) {
+      u32 s = 0;
+      while (s < num_slots_ && GetFp(word, s) != fp) {
+        ++s;
+      }
+      if (s == num_slots_) {
+        return false;
+      }
+      u64 cleared = word & ~(FpMask() << (s * fp_bits_));
+      if (bucket.compare_exchange_weak(word, cleared)) {
+        return true;
+      }
+    }
+  }
+
+  /** Clear slot \a s of bucket \a b if it still holds \a fp */
+  HSHM_CROSS_FUN bool TryRemoveSlot(size_t b, u32 s, u64 fp) {
+    ipc::atomic<u64> &bucket = GetBucket(b);
+    u64 word = bucket.load(std::memory_order_acquire);
+    while (GetFp(word, s) == fp) {
+      u64 cleared = word & ~(FpMask() << (s * fp_bits_));
+      if (bucket.compare_exchange_weak(word, cleared)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Place \a fp by evicting along a path of full buckets. Called with
+   * kick_lock_ held. The path is found by a random walk without moving
+   * anything, then moved from its free end back to the start. Lock-free
+   * inserts and erases may change buckets on the path in the meantime;
+   * a move that finds this retries with a new search.
+   * */
+  HSHM_CROSS_FUN bool Kick(u64 fp, size_t b1, size_t b2) {
+    PathEntry path[kMaxPath];
+    u64 rng = fmix64(fp ^ ((u64)b1 << 32) ^ seq_.load());
+    for (int search = 0; search < kMaxSearches; ++search) {
+      size_t b = (rng & 1) ? b1 : b2;
+      int len = 0;
+      bool found = false;
+      while (len < kMaxPath) {
+        rng = NextRandom(rng);
+        u32 s = (u32)(rng % num_slots_);
+        u64 victim = GetFp(GetBucket(b).load(), s);
+        path[len++] = PathEntry{b, s, victim};
+        if (victim == 0) {
+          // A slot freed up under us; the path can end here
+          found = true;
+          break;
+        }
+        b = AltBucket(b, victim);
+        if (HasEmptySlot(b)) {
+          found = true;
+          break;
+        }
+      }
+      if (found && MovePath(path, len, fp)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Move each fingerprint on the path into its other bucket, last first,
+   * then put \a fp in the freed first slot.
+   * */
+  HSHM_CROSS_FUN bool MovePath(PathEntry *path, int len, u64 fp) {
+    seq_.fetch_add(1, std::memory_order_acq_rel);
+    bool moved = true;
+    for (int i = len - 1; i >= 0 && moved; --i) {
+      PathEntry &entry = path[i];
+      if (entry.fp_ == 0) {
+        continue;
+      }
+      size_t dst = AltBucket(entry.bucket_, entry.fp_);
+      if (!TryInsert(dst, entry.fp_)) {
+        moved = false;
+      } else if (!TryRemoveSlot(entry.bucket_, entry.slot_, entry.fp_)) {
+        // The fingerprint was erased meanwhile; drop the copy
+        TryRemove(dst, entry.fp_);
+        moved = false;
+      }
+    }
+    if (moved) {
+      moved = TryInsert(path[0].bucket_, fp);
+    }
+    seq_.fetch_add(1, std::memory_order_acq_rel);
+    return moved;
+  }
+
+  /** Step a xorshift generator */
+  HSHM_INLINE_CROSS_FUN static u64 NextRandom(u64 x) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+  }
+
+  /** Allocate num_buckets_ empty buckets */
+  HSHM_CROSS_FUN void AllocateBuckets() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = num_buckets_ * sizeof(u64);
+    buckets_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (buckets_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    memset((void *)GetBuckets(), 0, size);
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename T, class Hash = hshm::hash<T>,
+          HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using cuckoo_filter = hipc::cuckoo_filter<T, Hash, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_CUCKOO_FILTER_H_
@@ -7,55 +7,125 @@
 
 #include <utility>
 
+#include "hermes_shm/constants/macros.h"
 #include "hermes_shm/data_structures/internal/shm_internal.h"
-#include "hermes_shm/data_structures/ipc/functional.h"
-#include "hermes_shm/data_structures/serialization/serialize_common.h"
-#include "list.h"
-#include "ring_queue.h"
+#include "hermes_shm/thread/thread_model_manager.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/qtok.h"
 
 namespace hshm::ipc {
 
+/** Forward declaration of dynamic_queue */
+template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class dynamic_queue;
+
+/**
+ * A slot of a dynamic_queue segment.
+ *
+ * The producer and the consumer of a position race on \a state_. The
+ * producer moves it from kEmpty to kWriting to kFull. A consumer that
+ * arrives before the producer may move it from kEmpty to kTaken, which
+ * sends the producer to a new position.
+ * */
+template <typename T>
+struct dynamic_queue_cell {
+  ipc::atomic<hshm::u32> state_;
+  delay_ar<T> val_;
+};
+
+/** A fixed-size segment of the queue. The slots follow the header. */
+struct dynamic_queue_segment {
+  hshm::u64 id_;                /**< Holds positions [id_ * block, +block) */
+  AtomicOffsetPointer next_;    /**< The next segment */
+  ipc::atomic<hshm::u64> done_; /**< Producers + consumers done with slots */
+  AtomicOffsetPointer retired_; /**< The next segment in a retired list */
+};
+
 /**
- * MACROS used to simplify the ring_queue_base namespace
+ * MACROS used to simplify the dynamic_queue namespace
  * Used as inputs to the HIPC_CONTAINER_TEMPLATE
  * */
 #define CLASS_NAME dynamic_queue
 #define CLASS_NEW_ARGS T
 
 /**
- * An mpsc queue that changes in size dynamically
- */
-template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+ * An unbounded, lock-free queue for multiple producers and multiple
+ * consumers.
+ *
+ * Positions are handed out with fetch_add on tail_ and head_. Position
+ * pos lives in slot pos % block_size_ of segment pos / block_size_.
+ * Segments are linked through OffsetPointers and allocated on demand.
+ *
+ * A segment is retired once every producer and consumer of its
+ * positions is done with it. Retired segments are returned to the
+ * allocator after a grace period. Each operation registers in the
+ * current epoch, and a segment retired in epoch e is only freed once
+ * epoch e + 2 has begun and no operation of epoch e + 1 remains.
+ * */
+template <typename T, HSHM_CLASS_TEMPL>
 class dynamic_queue : public ShmContainer {
  public:
   HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
-  typedef hipc::list<T, HSHM_CLASS_TEMPL_ARGS> Vector;
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef dynamic_queue_cell<T> cell_t;
+  typedef dynamic_queue_segment segment_t;
+
+  /** Slot states */
+  CLS_CONST hshm::u32 kEmpty = 0;
+  CLS_CONST hshm::u32 kWriting = 1;
+  CLS_CONST hshm::u32 kFull = 2;
+  CLS_CONST hshm::u32 kTaken = 3;
+  /** Number of epochs tracked at once */
+  CLS_CONST int kEpochs = 4;
+  /** Times a consumer yields to a late producer before taking its slot */
+  CLS_CONST int kWaitSpins = 64;
 
  public:
-  hshm::Mutex lock_;
-  Vector splits_;
-  hipc::atomic<hshm::size_t> head_, tail_;
+  /**====================================
+   * Variables
+   * ===================================*/
+  AtomicOffsetPointer head_seg_;
+  AtomicOffsetPointer push_seg_;
+  AtomicOffsetPointer pop_seg_;
   size_t block_size_;
+  ipc::atomic<hshm::u64> epoch_;
+  ipc::atomic<hshm::u64> active_[kEpochs];
+  AtomicOffsetPointer retired_[kEpochs];
+  char pad0_[HSHM_CACHE_LINE_SIZE];
+  ipc::atomic<hshm::u64> tail_;
+  char pad1_[HSHM_CACHE_LINE_SIZE - sizeof(ipc::atomic<hshm::u64>)];
+  ipc::atomic<hshm::u64> head_;
+  char pad2_[HSHM_CACHE_LINE_SIZE - sizeof(ipc::atomic<hshm::u64>)];
 
+ public:
   /**====================================
    * Default Constructor
    * ===================================*/
- public:
-  dynamic_queue(size_t block_size = 64) : splits_() {
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit dynamic_queue(size_t block_size = 64) {
     shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), block_size);
   }
 
-  dynamic_queue(const hipc::CtxAllocator<AllocT> &alloc, size_t block_size = 64)
-      : splits_(alloc), block_size_(block_size) {
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit dynamic_queue(const hipc::CtxAllocator<AllocT> &alloc,
+                         size_t block_size = 64) {
     shm_init(alloc, block_size);
   }
 
+  /** SHM Constructor. */
+  HSHM_CROSS_FUN
   void shm_init(const hipc::CtxAllocator<AllocT> &alloc,
                 size_t block_size = 64) {
     init_shm_container(alloc);
-    block_size_ = block_size;
-    head_ = 0;
-    tail_ = 0;
+    SetNull();
+    block_size_ = block_size > 0 ? block_size : 1;
+    AllocateFirstSegment();
   }
 
   /**====================================
@@ -81,13 +151,21 @@ class dynamic_queue : public ShmContainer {
     return *this;
   }
 
-  /** SHM copy constructor + operator main */
+  /** SHM copy constructor + operator main. Not safe under modification. */
   HSHM_CROSS_FUN
   void shm_strong_copy_op(const dynamic_queue &other) {
-    splits_ = other.splits_;
-    head_ = other.head_.load();
-    tail_ = other.tail_.load();
     block_size_ = other.block_size_;
+    AllocateFirstSegment();
+    segment_t *seg = other.ToSegment(other.head_seg_.load());
+    for (hshm::u64 pos = other.head_.load(); pos < other.tail_.load(); ++pos) {
+      while (seg->id_ < pos / other.block_size_) {
+        seg = other.ToSegment(seg->next_.load());
+      }
+      cell_t &cell = GetCells(seg)[pos % other.block_size_];
+      if (cell.state_.load() == kFull) {
+        emplace(cell.val_.get_ref());
+      }
+    }
   }
 
   /**====================================
@@ -97,39 +175,47 @@ class dynamic_queue : public ShmContainer {
   /** Move constructor. */
   HSHM_CROSS_FUN
   dynamic_queue(dynamic_queue &&other) noexcept {
-    shm_move_op<false>(other.GetCtxAllocator(),
-                       std::forward<dynamic_queue>(other));
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
   }
 
   /** SHM move constructor. */
   HSHM_CROSS_FUN
   dynamic_queue(const hipc::CtxAllocator<AllocT> &alloc,
                 dynamic_queue &&other) noexcept {
-    shm_move_op<false>(alloc, std::forward<dynamic_queue>(other));
+    shm_move_op<false>(alloc, std::move(other));
   }
 
   /** SHM move assignment operator. */
   HSHM_CROSS_FUN
   dynamic_queue &operator=(dynamic_queue &&other) noexcept {
     if (this != &other) {
-      shm_move_op<true>(other.GetCtxAllocator(),
-                        std::forward<dynamic_queue>(other));
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
     }
     return *this;
   }
 
-  /** SHM move assignment operator. */
+  /** SHM move operator. Not safe while other is being accessed. */
   template <bool IS_ASSIGN>
   HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
                                   dynamic_queue &&other) noexcept {
     if constexpr (!IS_ASSIGN) {
       init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
     }
     if (GetAllocator() == other.GetAllocator()) {
-      splits_ = std::move(other.splits_);
-      head_ = other.head_.load();
-      tail_ = other.tail_.load();
+      head_seg_.off_ = other.head_seg_.load();
+      push_seg_.off_ = other.push_seg_.load();
+      pop_seg_.off_ = other.pop_seg_.load();
       block_size_ = other.block_size_;
+      epoch_ = other.epoch_.load();
+      for (int i = 0; i < kEpochs; ++i) {
+        active_[i] = other.active_[i].load();
+        retired_[i].off_ = other.retired_[i].load();
+      }
+      tail_ = other.tail_.load();
+      head_ = other.head_.load();
       other.SetNull();
     } else {
       shm_strong_copy_op(other);
@@ -141,29 +227,74 @@ class dynamic_queue : public ShmContainer {
    * Destructor
    * ===================================*/
 
-  /** SHM destructor.  */
+  /** SHM destructor. Destroys the values still in the queue. */
   HSHM_CROSS_FUN
-  void shm_destroy_main() {}
+  void shm_destroy_main() {
+    size_t seg_off = head_seg_.load();
+    while (seg_off != NullOff()) {
+      segment_t *seg = ToSegment(seg_off);
+      cell_t *cells = GetCells(seg);
+      for (size_t i = 0; i < block_size_; ++i) {
+        if (cells[i].state_.load() == kFull) {
+          cells[i].val_.shm_destroy();
+        }
+      }
+      size_t next_off = seg->next_.load();
+      FreeSegment(seg_off);
+      seg_off = next_off;
+    }
+    for (int i = 0; i < kEpochs; ++i) {
+      FreeRetired(retired_[i]);
+    }
+    SetNull();
+  }
 
-  /** Check if the list is empty */
+  /** Check if the queue is empty */
   HSHM_CROSS_FUN
-  bool IsNull() const { return false; }
+  bool IsNull() const { return head_seg_.IsNull(); }
 
-  /** Sets this list as empty */
+  /** Sets this queue as empty */
   HSHM_CROSS_FUN
-  void SetNull() {}
+  void SetNull() {
+    head_seg_.SetNull();
+    push_seg_.SetNull();
+    pop_seg_.SetNull();
+    epoch_ = 0;
+    for (int i = 0; i < kEpochs; ++i) {
+      active_[i] = 0;
+      retired_[i].SetNull();
+    }
+    tail_ = 0;
+    head_ = 0;
+  }
 
   /**====================================
-   * MPSC Queue Methods
+   * MPMC Queue Methods
    * ===================================*/
 
-  /** Construct an element at \a pos position in the list */
+  /** Construct an element at the tail of the queue */
   template <typename... Args>
   HSHM_CROSS_FUN qtok_t emplace(Args &&...args) {
-    ScopedMutex lock(lock_, 0);
-    qtok_id tail = tail_.fetch_add(1);
-    splits_.emplace_back(std::forward<Args>(args)...);
-    return qtok_t(tail);
+    hshm::u64 epoch = EnterEpoch();
+    hshm::u64 pos;
+    while (true) {
+      pos = tail_.fetch_add(1);
+      segment_t *seg = FindSegment(push_seg_, pos / block_size_);
+      cell_t &cell = GetCells(seg)[pos % block_size_];
+      hshm::u32 state = kEmpty;
+      bool claimed = cell.state_.compare_exchange_strong(state, kWriting);
+      if (claimed) {
+        HSHM_MAKE_AR(cell.val_, GetCtxAllocator(), std::forward<Args>(args)...)
+        cell.state_.store(kFull, std::memory_order_release);
+      }
+      FinishSlot(seg, epoch);
+      if (claimed) {
+        break;
+      }
+      // A consumer gave up on this position. Take a new one.
+    }
+    LeaveEpoch(epoch);
+    return qtok_t(pos);
   }
 
   /** Push an elemnt in the list (wrapper) */
@@ -172,40 +303,47 @@ class dynamic_queue : public ShmContainer {
     return emplace(std::forward<Args>(args)...);
   }
 
-  /** Consumer pops the head object */
+  /**
+   * Pop the element at the head of the queue.
+   *
+   * @return the position of the element, or a null qtok if empty
+   * */
   HSHM_CROSS_FUN
   qtok_t pop(T &val) {
-    ScopedMutex lock(lock_, 0);
-    qtok_t ret = qtok_t::GetNull();
-    if (splits_.size() > 0) {
-      ret = qtok_t(head_.fetch_add(1));
-      val = splits_.front();
-      splits_.erase(splits_.begin());
+    hshm::u64 epoch = EnterEpoch();
+    qtok_t tok = qtok_t::GetNull();
+    while (tok.IsNull() && head_.load() < tail_.load()) {
+      hshm::u64 pos = head_.fetch_add(1);
+      segment_t *seg = FindSegment(pop_seg_, pos / block_size_);
+      cell_t &cell = GetCells(seg)[pos % block_size_];
+      if (WaitForSlot(cell, pos)) {
+        val = std::move(cell.val_.get_ref());
+        cell.val_.shm_destroy();
+        cell.state_.store(kTaken, std::memory_order_relaxed);
+        tok = qtok_t(pos);
+      }
+      FinishSlot(seg, epoch);
     }
-    return ret;
+    LeaveEpoch(epoch);
+    return tok;
   }
 
-  /** Consumer pops the head object */
+  /** Pop the element at the head of the queue and discard it */
   HSHM_CROSS_FUN
   qtok_t pop() {
-    ScopedMutex lock(lock_, 0);
-    qtok_t ret = qtok_t::GetNull();
-    if (splits_.size() > 0) {
-      ret = qtok_t(head_.fetch_add(1));
-      splits_.erase(splits_.begin());
-    }
-    return ret;
+    T val;
+    return pop(val);
   }
 
-  /** Get queue depth */
+  /** Get queue depth. The queue is unbounded, so this is its size. */
   HSHM_CROSS_FUN
-  size_t GetDepth() { return splits_.size(); }
+  size_t GetDepth() const { return GetSize(); }
 
-  /** Get size at this moment */
+  /** Get size at this moment. Approximate under concurrency. */
   HSHM_CROSS_FUN
-  size_t GetSize() {
-    hshm::size_t tail = tail_.load();
-    hshm::size_t head = head_.load();
+  size_t GetSize() const {
+    hshm::u64 head = head_.load();
+    hshm::u64 tail = tail_.load();
     if (tail < head) {
       return 0;
     }
@@ -214,11 +352,223 @@ class dynamic_queue : public ShmContainer {
 
   /** Get size (wrapper) */
   HSHM_INLINE_CROSS_FUN
-  size_t size() { return GetSize(); }
+  size_t size() const { return GetSize(); }
 
   /** Get size (wrapper) */
   HSHM_INLINE_CROSS_FUN
-  size_t Size() { return GetSize(); }
+  size_t Size() const { return GetSize(); }
+
+ private:
+  /**====================================
+   * Segments
+   * ===================================*/
+
+  /** The offset of a null segment */
+  HSHM_INLINE_CROSS_FUN static size_t NullOff() {
+    return OffsetPointer::GetNull().load();
+  }
+
+  /** Convert a segment offset to a pointer */
+  HSHM_INLINE_CROSS_FUN segment_t *ToSegment(size_t off) const {
+    return GetAllocator()->template Convert<segment_t>(OffsetPointer(off));
+  }
+
+  /** Get the slots of a segment */
+  HSHM_INLINE_CROSS_FUN static cell_t *GetCells(segment_t *seg) {
+    return reinterpret_cast<cell_t *>(seg + 1);
+  }
+
+  /** Allocate an empty segment holding segment number \a id */
+  HSHM_CROSS_FUN size_t AllocateSegment(hshm::u64 id) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = sizeof(segment_t) + block_size_ * sizeof(cell_t);
+    OffsetPointer seg_p =
+        alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (seg_p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    segment_t *seg = ToSegment(seg_p.load());
+    new (seg) segment_t();
+    seg->id_ = id;
+    seg->next_.SetNull();
+    seg->done_ = 0;
+    seg->retired_.SetNull();
+    cell_t *cells = GetCells(seg);
+    for (size_t i = 0; i < block_size_; ++i) {
+      new (&cells[i]) cell_t();
+      cells[i].state_ = kEmpty;
+    }
+    return seg_p.load();
+  }
+
+  /** Allocate the segment of position 0 */
+  HSHM_CROSS_FUN void AllocateFirstSegment() {
+    size_t seg_off = AllocateSegment(0);
+    head_seg_.off_ = seg_off;
+    push_seg_.off_ = seg_off;
+    pop_seg_.off_ = seg_off;
+  }
+
+  /** Return a segment to the allocator */
+  HSHM_INLINE_CROSS_FUN void FreeSegment(size_t off) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer seg_p(off);
+    alloc->Free(alloc.ctx_, seg_p);
+  }
+
+  /**
+   * Walk from the segment at \a off to segment number \a id, appending
+   * segments that do not exist yet.
+   * */
+  HSHM_CROSS_FUN size_t WalkSegments(size_t off, hshm::u64 id) {
+    segment_t *seg = ToSegment(off);
+    while (seg->id_ < id) {
+      size_t next_off = seg->next_.load();
+      if (next_off == NullOff()) {
+        size_t new_off = AllocateSegment(seg->id_ + 1);
+        if (seg->next_.off_.compare_exchange_strong(next_off, new_off)) {
+          next_off = new_off;
+        } else {
+          FreeSegment(new_off);
+        }
+      }
+      off = next_off;
+      seg = ToSegment(off);
+    }
+    return off;
+  }
+
+  /**
+   * Find segment \a id starting from the \a hint of producers or
+   * consumers, and move the hint forward to it. The caller owns a
+   * position in the segment, so it cannot have been retired.
+   * */
+  HSHM_CROSS_FUN segment_t *FindSegment(AtomicOffsetPointer &hint,
+                                        hshm::u64 id) {
+    size_t start_off = hint.load();
+    if (ToSegment(start_off)->id_ > id) {
+      // A later position moved the hint past our segment
+      return ToSegment(WalkSegments(head_seg_.load(), id));
+    }
+    size_t off = WalkSegments(start_off, id);
+    if (off != start_off) {
+      hint.off_.compare_exchange_strong(start_off, off);
+    }
+    return ToSegment(off);
+  }
+
+  /**
+   * Wait for the producer of \a pos to publish \a cell.
+   *
+   * @return true if the value is ready, false if the consumer gave up and
+   * marked the slot taken
+   * */
+  HSHM_CROSS_FUN bool WaitForSlot(cell_t &cell, hshm::u64 pos) {
+    hshm::u32 state = cell.state_.load(std::memory_order_acquire);
+    for (int i = 0; state != kFull; ++i) {
+      if (state == kEmpty && (i >= kWaitSpins || pos >= tail_.load())) {
+        if (cell.state_.compare_exchange_strong(state, kTaken)) {
+          return false;
+        }
+        continue;
+      }
+      HSHM_THREAD_MODEL->Yield();
+      state = cell.state_.load(std::memory_order_acquire);
+    }
+    return true;
+  }
+
+  /**
+   * Record that a producer or consumer is done with a slot of \a seg.
+   * Each slot is finished twice. The last one retires the segment.
+   * */
+  HSHM_INLINE_CROSS_FUN void FinishSlot(segment_t *seg, hshm::u64 epoch) {
+    if (seg->done_.fetch_add(1) + 1 == 2 * block_size_) {
+      AdvanceHead(epoch);
+    }
+  }
+
+  /** Unlink and retire the finished segments at the head */
+  HSHM_CROSS_FUN void AdvanceHead(hshm::u64 epoch) {
+    while (true) {
+      size_t first_off = head_seg_.load();
+      segment_t *first = ToSegment(first_off);
+      if (first->done_.load() != 2 * block_size_) {
+        return;
+      }
+      size_t next_off = WalkSegments(first_off, first->id_ + 1);
+      // The hints never point behind head_seg_
+      size_t hint_off = first_off;
+      push_seg_.off_.compare_exchange_strong(hint_off, next_off);
+      hint_off = first_off;
+      pop_seg_.off_.compare_exchange_strong(hint_off, next_off);
+      if (head_seg_.off_.compare_exchange_strong(first_off, next_off)) {
+        Retire(first_off, epoch);
+      }
+    }
+  }
+
+  /**====================================
+   * Epochs
+   * ===================================*/
+
+  /** Register an operation in the current epoch */
+  HSHM_INLINE_CROSS_FUN hshm::u64 EnterEpoch() {
+    while (true) {
+      hshm::u64 epoch = epoch_.load();
+      active_[epoch % kEpochs].fetch_add(1);
+      if (epoch_.load() == epoch) {
+        return epoch;
+      }
+      active_[epoch % kEpochs].fetch_sub(1);
+    }
+  }
+
+  /** Unregister an operation */
+  HSHM_INLINE_CROSS_FUN void LeaveEpoch(hshm::u64 epoch) {
+    active_[epoch % kEpochs].fetch_sub(1);
+  }
+
+  /** Queue an unlinked segment to be freed after a grace period */
+  HSHM_CROSS_FUN void Retire(size_t seg_off, hshm::u64 epoch) {
+    AtomicOffsetPointer &list = retired_[epoch % kEpochs];
+    segment_t *seg = ToSegment(seg_off);
+    size_t head = list.load();
+    do {
+      seg->retired_.off_.store(head, std::memory_order_relaxed);
+    } while (!list.off_.compare_exchange_weak(head, seg_off));
+    TryAdvanceEpoch();
+  }
+
+  /**
+   * Begin the next epoch once the previous one has no operations left,
+   * and free the segments retired two epochs ago. Their operations have
+   * ended, and every operation that could have seen them was registered
+   * in an epoch that has since drained.
+   * */
+  HSHM_CROSS_FUN void TryAdvanceEpoch() {
+    hshm::u64 epoch = epoch_.load();
+    if (active_[(epoch - 1) % kEpochs].load() != 0) {
+      return;
+    }
+    if (!epoch_.compare_exchange_strong(epoch, epoch + 1)) {
+      return;
+    }
+    FreeRetired(retired_[(epoch - 2) % kEpochs]);
+  }
+
+  /** Free every segment of a retired list */
+  HSHM_CROSS_FUN void FreeRetired(AtomicOffsetPointer &list) {
+    size_t seg_off = list.load();
+    while (!list.off_.compare_exchange_weak(seg_off, NullOff())) {
+    }
+    while (seg_off != NullOff()) {
+      size_t next_off = ToSegment(seg_off)->retired_.load();
+      FreeSegment(seg_off);
+      seg_off = next_off;
+    }
+  }
 };
 
 }  // namespace hshm::ipc
@@ -0,0 +1,771 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_EPOCH_MANAGER_H_
+#define HSHM_DATA_STRUCTURES_IPC_EPOCH_MANAGER_H_
+
+#include <type_traits>
+
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/introspect/system_info.h"
+#include "hermes_shm/types/atomic.h"
+
+namespace hshm::ipc {
+
+/** forward pointer for epoch_manager */
+template <typename PointerT = Pointer, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class epoch_manager;
+
+/**
+ * A block of retired pointers waiting for a grace period. Every pointer
+ * in a block was retired in epoch_.
+ * */
+template <typename PointerT>
+struct epoch_limbo_block {
+  CLS_CONST size_t kCapacity = 32;
+  OffsetPointer next_;
+  hshm::u64 epoch_;
+  size_t count_;
+  PointerT ptrs_[kCapacity];
+};
+
+/**
+ * The shared-memory record of one participant. \a state_ holds the epoch
+ * the participant observed on entry, shifted left by one, with the low
+ * bit set while the participant is inside a critical section. \a owner_
+ * holds the ownership state in its low two bits and a generation that
+ * every claim advances above them. Other participants read only these,
+ * \a blocked_, \a num_pending_ and \a pid_; the remaining fields are
+ * private to the owner.
+ * */
+struct epoch_record {
+  ipc::atomic<hshm::u64> state_;
+  ipc::atomic<hshm::u32> owner_;
+  ipc::atomic<hshm::u32> blocked_;
+  ipc::atomic<size_t> num_pending_;
+  ipc::atomic<int> pid_;
+  hshm::u32 nest_;
+  size_t num_retired_;
+  OffsetPointer limbo_[3];
+  hshm::u64 limbo_epoch_[3];
+};
+
+/**
+ * MACROS used to simplify the epoch_manager namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME epoch_manager
+#define CLASS_NEW_ARGS PointerT
+
+/**
+ * Epoch-based reclamation (EBR) for lock-free containers whose nodes may
+ * still be read by other threads or processes after they are unlinked.
+ *
+ * Each participant registers once to own a record in shared memory, then
+ * wraps every access to shared nodes in an EpochGuard. Unlinked nodes are
+ * retired instead of freed. A node retired in epoch e is returned to its
+ * allocator once the global epoch reaches e + 2. The global epoch only
+ * advances when every participant inside a critical section has observed
+ * the current one, so no critical section that could have seen the node
+ * is still running.
+ *
+ * Retired pointers wait in per-participant lists, one per epoch modulo 3,
+ * so retiring needs no atomics. Lists of a participant that unregisters
+ * are handed to a shared orphan list that any participant drains as the
+ * epoch advances.
+ *
+ * A participant that stays in one critical section stalls reclamation for
+ * everyone. Memory stays safe, but retired lists keep growing, and
+ * GetNumStalled reports such participants. When a participant blocks
+ * many advances in a row and its process no longer exists, it is reaped:
+ * its record is freed and its lists are orphaned. A thread that exits
+ * without calling Unregister inside a living process cannot be detected,
+ * so participants must unregister.
+ *
+ * PointerT is Pointer to free each pointer to the allocator it came
+ * from, or OffsetPointer to free everything to the manager's allocator
+ * with half the bookkeeping. Allocators are not polymorphic, so with
+ * Pointer every allocator must still be of type AllocT; Retire checks it.
+ * */
+template <typename PointerT, HSHM_CLASS_TEMPL>
+class epoch_manager : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef epoch_limbo_block<PointerT> block_t;
+  typedef epoch_record record_t;
+
+  /** Record owner states */
+  CLS_CONST hshm::u32 kFree = 0;
+  CLS_CONST hshm::u32 kOwned = 1;
+  CLS_CONST hshm::u32 kReaping = 2;
+  CLS_CONST hshm::u32 kOwnerStateMask = 3;
+  /** The owner generation advanced by each claim */
+  CLS_CONST hshm::u32 kOwnerGeneration = 4;
+  /** Retires between attempts to advance the epoch */
+  CLS_CONST size_t kAdvanceInterval = 64;
+  /** Blocked advances before a participant counts as stalled */
+  CLS_CONST hshm::u32 kStallThreshold = 128;
+  /** Records are spaced a cache line apart */
+  CLS_CONST size_t kRecordStride = (sizeof(record_t) + 63) & ~(size_t)63;
+
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer records_;
+  size_t num_records_;
+  ipc::atomic<hshm::u64> epoch_;
+  AtomicOffsetPointer orphans_;
+  ipc::atomic<size_t> num_orphaned_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /**
+   * SHM constructor. Initialize the manager.
+   *
+   * @param max_participants the number of participant records
+   * */
+  HSHM_CROSS_FUN
+  explicit epoch_manager(int max_participants = 128) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(),
+             max_participants);
+  }
+
+  /**
+   * SHM constructor. Initialize the manager.
+   *
+   * @param alloc the shared-memory allocator
+   * @param max_participants the number of participant records
+   * */
+  HSHM_CROSS_FUN
+  explicit epoch_manager(const hipc::CtxAllocator<AllocT> &alloc,
+                         int max_participants = 128) {
+    shm_init(alloc, max_participants);
+  }
+
+  /** SHM constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc,
+                int max_participants = 128) {
+    init_shm_container(alloc);
+    SetNull();
+    AllocateRecords(max_participants > 0 ? max_participants : 1);
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit epoch_manager(const epoch_manager &other) {
+    init_shm_container(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit epoch_manager(const hipc::CtxAllocator<AllocT> &alloc,
+                         const epoch_manager &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  epoch_manager &operator=(const epoch_manager &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /**
+   * Internal copy operation. Participants and retired pointers belong to
+   * the original, so the copy only has the same number of records.
+   * */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const epoch_manager &other) {
+    AllocateRecords(other.num_records_);
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  epoch_manager(epoch_manager &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  epoch_manager(const hipc::CtxAllocator<AllocT> &alloc,
+                epoch_manager &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  epoch_manager &operator=(epoch_manager &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /**
+   * SHM move operator. Not safe while other has participants, since they
+   * refer to records by index in other.
+   * */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  epoch_manager &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      records_ = other.records_;
+      num_records_ = other.num_records_;
+      epoch_ = other.epoch_.load();
+      orphans_.off_ = other.orphans_.load();
+      num_orphaned_ = other.num_orphaned_.load();
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** Whether or not the manager is empty */
+  HSHM_INLINE_CROSS_FUN bool IsNull() const { return records_.IsNull(); }
+
+  /** Sets this manager as empty */
+  HSHM_INLINE_CROSS_FUN void SetNull() {
+    records_.SetNull();
+    num_records_ = 0;
+    epoch_ = 0;
+    orphans_.SetNull();
+    num_orphaned_ = 0;
+  }
+
+  /**
+   * Free every retired pointer, then the records.
+   * Not safe while any participant is inside a critical section.
+   * */
+  HSHM_CROSS_FUN void shm_destroy_main() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    for (size_t i = 0; i < num_records_; ++i) {
+      record_t &rec = GetRecord(i);
+      for (int slot = 0; slot < 3; ++slot) {
+        FreeBlocks(rec.limbo_[slot]);
+      }
+    }
+    FreeBlocks(orphans_.ToOffsetPointer());
+    alloc->Free(alloc.ctx_, records_);
+  }
+
+  /**====================================
+   * Participants
+   * ===================================*/
+
+  /**
+   * Claim a participant record for the calling thread. The record stays
+   * in kReaping until it is filled in, so a concurrent ReapDead never
+   * sees it owned with the pid of a previous owner.
+   *
+   * @return the id of the record, passed to every other call
+   * */
+  HSHM_CROSS_FUN int Register() {
+    for (int attempt = 0; attempt < 2; ++attempt) {
+      for (size_t i = 0; i < num_records_; ++i) {
+        record_t &rec = GetRecord(i);
+        hshm::u32 owner = rec.owner_.load(std::memory_order_relaxed);
+        if ((owner & kOwnerStateMask) != kFree) {
+          continue;
+        }
+        hshm::u32 generation = (owner & ~kOwnerStateMask) + kOwnerGeneration;
+        if (!rec.owner_.compare_exchange_strong(owner,
+                                                generation | kReaping)) {
+          continue;
+        }
+#ifdef HSHM_IS_HOST
+        rec.pid_.store(SystemInfo::GetPid(), std::memory_order_relaxed);
+#endif
+        rec.nest_ = 0;
+        rec.num_retired_ = 0;
+        rec.num_pending_.store(0, std::memory_order_relaxed);
+        rec.blocked_.store(0, std::memory_order_relaxed);
+        rec.state_.store(0, std::memory_order_relaxed);
+        rec.owner_.store(generation | kOwned, std::memory_order_release);
+        return (int)i;
+      }
+      ReapDead();
+    }
+    HSHM_THROW_ERROR(TOO_MANY_EPOCH_PARTICIPANTS, num_records_);
+    return -1;
+  }
+
+  /**
+   * Release a participant record. Pointers it retired that are not yet
+   * safe to free are handed to the orphan list.
+   * Must not be called inside a critical section.
+   * */
+  HSHM_CROSS_FUN void Unregister(int rid) {
+    Flush(rid);
+    record_t &rec = GetRecord(rid);
+    OrphanLimbo(rec);
+    rec.state_.store(0, std::memory_order_relaxed);
+    hshm::u32 owner = rec.owner_.load(std::memory_order_relaxed);
+    rec.owner_.store((owner & ~kOwnerStateMask) | kFree,
+                     std::memory_order_release);
+  }
+
+  /**
+   * Reap the records of participants whose process has exited.
+   *
+   * @return the number of records reaped
+   * */
+  HSHM_CROSS_FUN size_t ReapDead() {
+    size_t count = 0;
+#ifdef HSHM_IS_HOST
+    for (size_t i = 0; i < num_records_; ++i) {
+      record_t &rec = GetRecord(i);
+      hshm::u32 owner = rec.owner_.load(std::memory_order_acquire);
+      if ((owner & kOwnerStateMask) == kOwned &&
+          !SystemInfo::IsProcessAlive(rec.pid_.load()) && Reap(rec, owner)) {
+        ++count;
+      }
+    }
+#endif
+    return count;
+  }
+
+  /**====================================
+   * Critical Sections
+   * ===================================*/
+
+  /**
+   * Enter a critical section. Nodes reachable now will not be freed until
+   * the matching Exit. Sections may nest.
+   * */
+  HSHM_INLINE_CROSS_FUN void Enter(int rid) {
+    record_t &rec = GetRecord(rid);
+    if (rec.nest_++ > 0) {
+      return;
+    }
+    hshm::u64 epoch = epoch_.load(std::memory_order_relaxed);
+    rec.state_.store((epoch << 1) | 1, std::memory_order_relaxed);
+    // Publish the state before reading any shared node
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    rec.blocked_.store(0, std::memory_order_relaxed);
+  }
+
+  /** Exit a critical section */
+  HSHM_INLINE_CROSS_FUN void Exit(int rid) {
+    record_t &rec = GetRecord(rid);
+    if (--rec.nest_ > 0) {
+      return;
+    }
+    hshm::u64 state = rec.state_.load(std::memory_order_relaxed);
+    rec.state_.store(state & ~(hshm::u64)1, std::memory_order_release);
+  }
+
+  /**====================================
+   * Reclamation
+   * ===================================*/
+
+  /**
+   * Free \a p once no critical section can still reach it. \a p must
+   * already be unlinked from every shared structure, and must come from
+   * an allocator of type AllocT.
+   * */
+  HSHM_CROSS_FUN void Retire(int rid, const PointerT &p) {
+    if constexpr (!std::is_same_v<PointerT, OffsetPointer>) {
+      // FreeBlock frees p through AllocT
+      Allocator *owner =
+          HSHM_MEMORY_MANAGER->template GetAllocator<Allocator>(p.alloc_id_);
+      if (owner == nullptr || owner->type_ != GetAllocator()->type_) {
+        HSHM_THROW_ERROR(EPOCH_RETIRE_WRONG_ALLOCATOR, p.alloc_id_.bits_.major_,
+                         p.alloc_id_.bits_.minor_);
+      }
+    }
+    record_t &rec = GetRecord(rid);
+    hshm::u64 epoch = epoch_.load();
+    int slot = (int)(epoch % 3);
+    // The list in this slot is from epoch - 3 or earlier, so it is safe
+    if (rec.limbo_epoch_[slot] != epoch) {
+      FreeLimbo(rec, slot);
+      rec.limbo_epoch_[slot] = epoch;
+    }
+    block_t *block = nullptr;
+    if (!rec.limbo_[slot].IsNull()) {
+      block = GetAllocator()->template Convert<block_t>(rec.limbo_[slot]);
+    }
+    if (!block || block->count_ == block_t::kCapacity) {
+      OffsetPointer block_p = AllocateBlock(epoch, rec.limbo_[slot]);
+      block = GetAllocator()->template Convert<block_t>(block_p);
+      rec.limbo_[slot] = block_p;
+    }
+    block->ptrs_[block->count_++] = p;
+    rec.num_pending_.store(rec.num_pending_.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+    if (++rec.num_retired_ >= kAdvanceInterval) {
+      Flush(rid);
+    }
+  }
+
+  /**
+   * Try to advance the epoch and free the caller's pointers that became
+   * safe. Called by Retire every kAdvanceInterval retires.
+   *
+   * @return true if the epoch advanced
+   * */
+  HSHM_CROSS_FUN bool Flush(int rid) {
+    record_t &rec = GetRecord(rid);
+    rec.num_retired_ = 0;
+    bool advanced = TryAdvance();
+    hshm::u64 epoch = epoch_.load();
+    for (int slot = 0; slot < 3; ++slot) {
+      if (rec.limbo_epoch_[slot] + 2 <= epoch) {
+        FreeLimbo(rec, slot);
+      }
+    }
+    return advanced;
+  }
+
+  /**
+   * Advance the global epoch if every participant inside a critical
+   * section has observed it, then free the orphaned pointers that became
+   * safe. A participant that blocks kStallThreshold advances in a row is
+   * reaped if its process has exited.
+   *
+   * @return true if the epoch advanced
+   * */
+  HSHM_CROSS_FUN bool TryAdvance() {
+    hshm::u64 epoch = epoch_.load();
+    for (size_t i = 0; i < num_records_; ++i) {
+      record_t &rec = GetRecord(i);
+      hshm::u32 owner = rec.owner_.load(std::memory_order_acquire);
+      if ((owner & kOwnerStateMask) != kOwned) {
+        continue;
+      }
+      hshm::u64 state = rec.state_.load();
+      if (!(state & 1) || (state >> 1) == epoch) {
+        continue;
+      }
+#ifdef HSHM_IS_HOST
+      if (rec.blocked_.fetch_add(1) + 1 >= kStallThreshold &&
+          !SystemInfo::IsProcessAlive(rec.pid_.load()) && Reap(rec, owner)) {
+        continue;
+      }
+#else
+      rec.blocked_.fetch_add(1);
+#endif
+      return false;
+    }
+    if (!epoch_.compare_exchange_strong(epoch, epoch + 1)) {
+      return false;
+    }
+    FreeOrphans(epoch + 1);
+    return true;
+  }
+
+  /**====================================
+   * Query Methods
+   * ===================================*/
+
+  /** The current global epoch */
+  HSHM_INLINE_CROSS_FUN hshm::u64 GetEpoch() const { return epoch_.load(); }
+
+  /** The number of participant records */
+  HSHM_INLINE_CROSS_FUN size_t GetMaxParticipants() const {
+    return num_records_;
+  }
+
+  /** The number of registered participants */
+  HSHM_CROSS_FUN size_t GetNumParticipants() const {
+    size_t count = 0;
+    for (size_t i = 0; i < num_records_; ++i) {
+      count += (GetRecord(i).owner_.load() & kOwnerStateMask) == kOwned;
+    }
+    return count;
+  }
+
+  /**
+   * The number of retired pointers not yet freed. Approximate under
+   * concurrency. Grows without bound while a participant is stalled.
+   * */
+  HSHM_CROSS_FUN size_t GetNumPending() const {
+    size_t count = num_orphaned_.load();
+    for (size_t i = 0; i < num_records_; ++i) {
+      count += GetRecord(i).num_pending_.load(std::memory_order_relaxed);
+    }
+    return count;
+  }
+
+  /**
+   * The number of participants that blocked at least kStallThreshold
+   * epoch advances since entering their current critical section
+   * */
+  HSHM_CROSS_FUN size_t GetNumStalled() const {
+    size_t count = 0;
+    for (size_t i = 0; i < num_records_; ++i) {
+      record_t &rec = GetRecord(i);
+      count += (rec.owner_.load() & kOwnerStateMask) == kOwned &&
+               rec.blocked_.load() >= kStallThreshold;
+    }
+    return count;
+  }
+
+  /**====================================
+   * Internal Operations
+   * ===================================*/
+ private:
+  /** The null offset */
+  HSHM_INLINE_CROSS_FUN static size_t NullOff() {
+    return OffsetPointer::GetNull().off_.load();
+  }
+
+  /** Get a record by id */
+  HSHM_INLINE_CROSS_FUN record_t &GetRecord(size_t i) const {
+    char *records = GetAllocator()->template Convert<char>(records_);
+    return *reinterpret_cast<record_t *>(records + i * kRecordStride);
+  }
+
+  /** Allocate and clear the participant records */
+  HSHM_CROSS_FUN void AllocateRecords(size_t num_records) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = num_records * kRecordStride;
+    records_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (records_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    num_records_ = num_records;
+    epoch_ = 0;
+    orphans_.SetNull();
+    num_orphaned_ = 0;
+    for (size_t i = 0; i < num_records; ++i) {
+      record_t &rec = GetRecord(i);
+      new (&rec) record_t();
+      rec.state_ = 0;
+      rec.owner_ = kFree;
+      rec.blocked_ = 0;
+      rec.num_pending_ = 0;
+      rec.pid_ = 0;
+      rec.nest_ = 0;
+      rec.num_retired_ = 0;
+      for (int slot = 0; slot < 3; ++slot) {
+        rec.limbo_[slot].SetNull();
+        rec.limbo_epoch_[slot] = 0;
+      }
+    }
+  }
+
+  /**
+   * Take over the record of a dead participant and orphan its lists.
+   *
+   * @param owner the owner word read before the participant's pid was
+   * checked. The record is only taken if it was not claimed again since.
+   * @return false if another participant reaped or claimed it first
+   * */
+  HSHM_CROSS_FUN bool Reap(record_t &rec, hshm::u32 owner) {
+    hshm::u32 generation = owner & ~kOwnerStateMask;
+    if (!rec.owner_.compare_exchange_strong(owner, generation | kReaping)) {
+      return false;
+    }
+    OrphanLimbo(rec);
+    rec.state_.store(0, std::memory_order_relaxed);
+    rec.owner_.store(generation | kFree, std::memory_order_release);
+    return true;
+  }
+
+  /** Allocate an empty limbo block in front of \a next */
+  HSHM_CROSS_FUN OffsetPointer AllocateBlock(hshm::u64 epoch,
+                                             const OffsetPointer &next) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer block_p =
+        alloc->template Allocate<OffsetPointer>(alloc.ctx_, sizeof(block_t));
+    if (block_p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, sizeof(block_t),
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    block_t *block = alloc->template Convert<block_t>(block_p);
+    block->next_ = next;
+    block->epoch_ = epoch;
+    block->count_ = 0;
+    return block_p;
+  }
+
+  /** Push every block of a record's lists onto the orphan list */
+  HSHM_CROSS_FUN void OrphanLimbo(record_t &rec) {
+    auto alloc = GetAllocator();
+    for (int slot = 0; slot < 3; ++slot) {
+      OffsetPointer block_p = rec.limbo_[slot];
+      while (!block_p.IsNull()) {
+        block_t *block = alloc->template Convert<block_t>(block_p);
+        OffsetPointer next_p = block->next_;
+        PushOrphan(block_p, block);
+        block_p = next_p;
+      }
+      rec.limbo_[slot].SetNull();
+    }
+    num_orphaned_.fetch_add(rec.num_pending_.load(std::memory_order_relaxed));
+    rec.num_pending_.store(0, std::memory_order_relaxed);
+  }
+
+  /** Free one list of a record */
+  HSHM_INLINE_CROSS_FUN void FreeLimbo(record_t &rec, int slot) {
+    if (rec.limbo_[slot].IsNull()) {
+      return;
+    }
+    size_t count = FreeBlocks(rec.limbo_[slot]);
+    rec.limbo_[slot].SetNull();
+    rec.num_pending_.store(
+        rec.num_pending_.load(std::memory_order_relaxed) - count,
+        std::memory_order_relaxed);
+  }
+
+  /** Push one block onto the orphan list */
+  HSHM_INLINE_CROSS_FUN void PushOrphan(const OffsetPointer &block_p,
+                                        block_t *block) {
+    size_t head = orphans_.load();
+    do {
+      block->next_ = OffsetPointer(head);
+    } while (!orphans_.off_.compare_exchange_weak(head, block_p.off_.load()));
+  }
+
+  /**
+   * Free the orphaned blocks retired in epoch - 2 or earlier. The list is
+   * detached while it is scanned, and younger blocks are pushed back.
+   * */
+  HSHM_CROSS_FUN void FreeOrphans(hshm::u64 epoch) {
+    auto alloc = GetAllocator();
+    size_t head = orphans_.load();
+    if (head == NullOff()) {
+      return;
+    }
+    while (!orphans_.off_.compare_exchange_weak(head, NullOff())) {
+    }
+    OffsetPointer block_p(head);
+    size_t count = 0;
+    while (!block_p.IsNull()) {
+      block_t *block = alloc->template Convert<block_t>(block_p);
+      OffsetPointer next_p = block->next_;
+      if (block->epoch_ + 2 <= epoch) {
+        count += block->count_;
+        FreeBlock(block_p, block);
+      } else {
+        PushOrphan(block_p, block);
+      }
+      block_p = next_p;
+    }
+    num_orphaned_.fetch_sub(count);
+  }
+
+  /**
+   * Free a list of blocks and every pointer they hold
+   *
+   * @return the number of pointers freed
+   * */
+  HSHM_CROSS_FUN size_t FreeBlocks(OffsetPointer block_p) {
+    auto alloc = GetAllocator();
+    size_t count = 0;
+    while (!block_p.IsNull()) {
+      block_t *block = alloc->template Convert<block_t>(block_p);
+      OffsetPointer next_p = block->next_;
+      count += block->count_;
+      FreeBlock(block_p, block);
+      block_p = next_p;
+    }
+    return count;
+  }
+
+  /** Free one block and every pointer it holds */
+  HSHM_CROSS_FUN void FreeBlock(const OffsetPointer &block_p,
+                                block_t *block) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    for (size_t i = 0; i < block->count_; ++i) {
+      PointerT p = block->ptrs_[i];
+      if constexpr (std::is_same_v<PointerT, OffsetPointer>) {
+        alloc->Free(alloc.ctx_, p);
+      } else {
+        HSHM_MEMORY_MANAGER->template GetAllocator<AllocT>(p.alloc_id_)
+            ->Free(alloc.ctx_, p);
+      }
+    }
+    OffsetPointer free_p = block_p;
+    alloc->Free(alloc.ctx_, free_p);
+  }
+};
+
+/**
+ * A critical section of an epoch_manager participant. Nodes reachable
+ * while the guard is alive are not freed until it is destroyed.
+ * */
+template <typename EpochManagerT>
+struct EpochGuard {
+  EpochManagerT &ebr_;
+  int rid_;
+
+  /** Enter a critical section of participant \a rid */
+  HSHM_INLINE_CROSS_FUN explicit EpochGuard(EpochManagerT &ebr, int rid)
+      : ebr_(ebr), rid_(rid) {
+    ebr_.Enter(rid_);
+  }
+
+  /** Exit the critical section */
+  HSHM_INLINE_CROSS_FUN
+  ~EpochGuard() { ebr_.Exit(rid_); }
+
+  EpochGuard(const EpochGuard &) = delete;
+  EpochGuard &operator=(const EpochGuard &) = delete;
+
+  /** Retire a node unlinked during this critical section */
+  template <typename PointerT>
+  HSHM_INLINE_CROSS_FUN void Retire(const PointerT &p) {
+    ebr_.Retire(rid_, p);
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename PointerT = ipc::Pointer,
+          HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using epoch_manager = ipc::epoch_manager<PointerT, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_EPOCH_MANAGER_H_
@@ -0,0 +1,830 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_FLAT_MAP_H_
+#define HSHM_DATA_STRUCTURES_FLAT_MAP_H_
+
+#include "hermes_shm/constants/macros.h"
+#if defined(HSHM_IS_HOST) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define HSHM_FLAT_MAP_SSE2
+#elif defined(HSHM_IS_HOST) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HSHM_FLAT_MAP_NEON
+#endif
+
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/data_structures/ipc/hash.h"
+#include "hermes_shm/types/numbers.h"
+#include "pair.h"
+
+namespace hshm::ipc {
+
+/** forward pointer for flat_map */
+template <typename Key, typename T, class Hash = hshm::hash<Key>,
+          HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class flat_map;
+
+/**
+ * Control byte values. A full slot stores the low 7 bits of its hash.
+ * */
+struct FlatMapCtrl {
+  CLS_CONST i8 kEmpty = -128;  /**< 0b10000000 */
+  CLS_CONST i8 kDeleted = -2;  /**< 0b11111110 */
+  CLS_CONST i8 kSentinel = -1; /**< 0b11111111 (never stored) */
+
+  /** Whether a control byte refers to a live slot */
+  HSHM_INLINE_CROSS_FUN static bool IsFull(i8 ctrl) { return ctrl >= 0; }
+};
+
+/** Index of the lowest set bit of a nonzero mask */
+HSHM_INLINE_CROSS_FUN static u32 FlatMapLowestBit(u64 mask) {
+#if defined(HSHM_IS_GPU)
+  return __ffsll(mask) - 1;
+#elif defined(HSHM_COMPILER_MSVC)
+  unsigned long idx;
+  _BitScanForward64(&idx, mask);
+  return (u32)idx;
+#else
+  return (u32)__builtin_ctzll(mask);
+#endif
+}
+
+/** Index of the highest set bit of a nonzero mask */
+HSHM_INLINE_CROSS_FUN static u32 FlatMapHighestBit(u64 mask) {
+#if defined(HSHM_IS_GPU)
+  return 63 - __clzll(mask);
+#elif defined(HSHM_COMPILER_MSVC)
+  unsigned long idx;
+  _BitScanReverse64(&idx, mask);
+  return (u32)idx;
+#else
+  return 63 - (u32)__builtin_clzll(mask);
+#endif
+}
+
+/**
+ * A group of 16 control bytes probed at once. Each matching slot sets
+ * one bit of the returned mask at position (slot << kShift).
+ * */
+struct FlatMapGroup {
+  CLS_CONST size_t kWidth = 16;
+#if defined(HSHM_FLAT_MAP_SSE2)
+  CLS_CONST u32 kShift = 0;
+  __m128i ctrl_;
+
+  HSHM_INLINE_CROSS_FUN explicit FlatMapGroup(const i8 *pos) {
+    ctrl_ = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+  }
+
+  /** Slots whose control byte equals \a h2 */
+  HSHM_INLINE_CROSS_FUN u64 Match(i8 h2) const {
+    return (u64)(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_));
+  }
+
+  /** Slots which are empty or deleted */
+  HSHM_INLINE_CROSS_FUN u64 MatchEmptyOrDeleted() const {
+    __m128i special = _mm_set1_epi8(FlatMapCtrl::kSentinel);
+    return (u64)(u32)_mm_movemask_epi8(_mm_cmpgt_epi8(special, ctrl_));
+  }
+#elif defined(HSHM_FLAT_MAP_NEON)
+  CLS_CONST u32 kShift = 2;
+  int8x16_t ctrl_;
+
+  HSHM_INLINE_CROSS_FUN explicit FlatMapGroup(const i8 *pos) {
+    ctrl_ = vld1q_s8(pos);
+  }
+
+  /** Compress a byte mask to one bit per nibble */
+  HSHM_INLINE_CROSS_FUN static u64 ToMask(uint8x16_t cmp) {
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) &
+           0x8888888888888888ull;
+  }
+
+  /** Slots whose control byte equals \a h2 */
+  HSHM_INLINE_CROSS_FUN u64 Match(i8 h2) const {
+    return ToMask(vceqq_s8(vdupq_n_s8(h2), ctrl_));
+  }
+
+  /** Slots which are empty or deleted */
+  HSHM_INLINE_CROSS_FUN u64 MatchEmptyOrDeleted() const {
+    return ToMask(vcltq_s8(ctrl_, vdupq_n_s8(FlatMapCtrl::kSentinel)));
+  }
+#else
+  CLS_CONST u32 kShift = 0;
+  i8 ctrl_[kWidth];
+
+  HSHM_INLINE_CROSS_FUN explicit FlatMapGroup(const i8 *pos) {
+    memcpy(ctrl_, pos, kWidth);
+  }
+
+  /** Slots whose control byte equals \a h2 */
+  HSHM_INLINE_CROSS_FUN u64 Match(i8 h2) const {
+    u64 mask = 0;
+    for (size_t i = 0; i < kWidth; ++i) {
+      mask |= (u64)(ctrl_[i] == h2) << i;
+    }
+    return mask;
+  }
+
+  /** Slots which are empty or deleted */
+  HSHM_INLINE_CROSS_FUN u64 MatchEmptyOrDeleted() const {
+    u64 mask = 0;
+    for (size_t i = 0; i < kWidth; ++i) {
+      mask |= (u64)(ctrl_[i] < FlatMapCtrl::kSentinel) << i;
+    }
+    return mask;
+  }
+#endif
+
+  /** Slots which are empty */
+  HSHM_INLINE_CROSS_FUN u64 MatchEmpty() const {
+    return Match(FlatMapCtrl::kEmpty);
+  }
+
+  /** The slot of the lowest bit in a match mask */
+  HSHM_INLINE_CROSS_FUN static size_t Slot(u64 mask) {
+    return FlatMapLowestBit(mask) >> kShift;
+  }
+};
+
+/**
+ * The flat map iterator
+ * */
+template <typename Key, typename T, class Hash, HSHM_CLASS_TEMPL>
+struct flat_map_iterator {
+ public:
+  using COLLISION_T = hipc::pair<Key, T, HSHM_CLASS_TEMPL_ARGS>;
+
+ public:
+  flat_map<Key, T, Hash, HSHM_CLASS_TEMPL_ARGS> *map_;
+  size_t i_;
+
+  /** Default constructor */
+  HSHM_CROSS_FUN flat_map_iterator() = default;
+
+  /** Construct the iterator  */
+  HSHM_INLINE_CROSS_FUN explicit flat_map_iterator(
+      flat_map<Key, T, Hash, HSHM_CLASS_TEMPL_ARGS> &map, size_t i)
+      : map_(&map), i_(i) {}
+
+  /** Copy constructor  */
+  HSHM_INLINE_CROSS_FUN flat_map_iterator(const flat_map_iterator &other) =
+      default;
+
+  /** Assign one iterator into another */
+  HSHM_INLINE_CROSS_FUN flat_map_iterator &operator=(
+      const flat_map_iterator &other) = default;
+
+  /** Get the pointed object */
+  HSHM_INLINE_CROSS_FUN COLLISION_T &operator*() {
+    return map_->GetSlots()[i_].get_ref();
+  }
+
+  /** Get the pointed object */
+  HSHM_INLINE_CROSS_FUN const COLLISION_T &operator*() const {
+    return map_->GetSlots()[i_].get_ref();
+  }
+
+  /** Go to the next object */
+  HSHM_INLINE_CROSS_FUN flat_map_iterator &operator++() {
+    ++i_;
+    make_correct();
+    return *this;
+  }
+
+  /** Return the next iterator */
+  HSHM_INLINE_CROSS_FUN flat_map_iterator operator++(int) const {
+    flat_map_iterator next(*this);
+    ++next;
+    return next;
+  }
+
+  /** Shift the iterator forward until it points to a full slot */
+  HSHM_INLINE_CROSS_FUN void make_correct() {
+    size_t capacity = map_->get_num_buckets();
+    const i8 *ctrl = map_->GetCtrl();
+    while (i_ < capacity && !FlatMapCtrl::IsFull(ctrl[i_])) {
+      ++i_;
+    }
+  }
+
+  /** Check if two iterators are equal */
+  HSHM_INLINE_CROSS_FUN friend bool operator==(const flat_map_iterator &a,
+                                               const flat_map_iterator &b) {
+    if (a.is_end() && b.is_end()) {
+      return true;
+    }
+    return a.i_ == b.i_;
+  }
+
+  /** Check if two iterators are inequal */
+  HSHM_INLINE_CROSS_FUN friend bool operator!=(const flat_map_iterator &a,
+                                               const flat_map_iterator &b) {
+    return !(a == b);
+  }
+
+  /** Determine whether this iterator is the end iterator */
+  HSHM_INLINE_CROSS_FUN bool is_end() const {
+    return i_ >= map_->get_num_buckets();
+  }
+
+  /** Set this iterator to the end iterator */
+  HSHM_INLINE_CROSS_FUN void set_end() { i_ = map_->get_num_buckets(); }
+};
+
+/**
+ * MACROS to simplify the flat_map namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+
+#define CLASS_NAME flat_map
+#define CLASS_NEW_ARGS Key, T, Hash
+
+/**
+ * An open-addressing hash map in the style of SwissTable.
+ *
+ * Entries are stored inline in a single shared-memory table. Each slot has
+ * a one-byte control word holding either the low 7 bits of the key's hash
+ * or an empty/deleted marker. Lookups compare 16 control bytes at a time
+ * using SSE2 or NEON and only touch slots whose control byte matches.
+ *
+ * Table layout: [ctrl (capacity + 16 bytes)][slots (capacity)]
+ * The first 16 control bytes are mirrored after the last slot so that a
+ * group may be loaded at any position without wrapping.
+ * */
+template <typename Key, typename T, class Hash, HSHM_CLASS_TEMPL>
+class flat_map : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef flat_map_iterator<Key, T, Hash, HSHM_CLASS_TEMPL_ARGS> iterator_t;
+  friend iterator_t;
+  using COLLISION_T = hipc::pair<Key, T, HSHM_CLASS_TEMPL_ARGS>;
+  using SLOT_T = delay_ar<COLLISION_T>;
+  CLS_CONST size_t kGroupWidth = FlatMapGroup::kWidth;
+  CLS_CONST size_t kCtrlAlign = 64;
+
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer table_;
+  size_t capacity_;
+  size_t length_;
+  size_t growth_left_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /**
+   * SHM constructor. Initialize the map.
+   *
+   * @param num_buckets the number of elements to reserve space for
+   * */
+  HSHM_CROSS_FUN
+  explicit flat_map(int num_buckets = 16) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), num_buckets);
+  }
+
+  /**
+   * SHM constructor. Initialize the map.
+   *
+   * @param alloc the shared-memory allocator
+   * @param num_buckets the number of elements to reserve space for
+   * */
+  HSHM_CROSS_FUN
+  explicit flat_map(const hipc::CtxAllocator<AllocT> &alloc,
+                    int num_buckets = 16) {
+    shm_init(alloc, num_buckets);
+  }
+
+  /** SHM constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc, int num_buckets = 16) {
+    init_shm_container(alloc);
+    SetNull();
+    AllocateTable(CapacityFor((size_t)num_buckets));
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit flat_map(const flat_map &other) {
+    init_shm_container(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit flat_map(const hipc::CtxAllocator<AllocT> &alloc,
+                    const flat_map &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  flat_map &operator=(const flat_map &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** Internal copy operation */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const flat_map &other) {
+    AllocateTable(CapacityFor(other.size()));
+    for (COLLISION_T &entry : other) {
+      emplace_templ<true>(entry.GetKey(), entry.GetVal());
+    }
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_INLINE_CROSS_FUN flat_map(flat_map &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_INLINE_CROSS_FUN flat_map(const hipc::CtxAllocator<AllocT> &alloc,
+                                 flat_map &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  flat_map &operator=(flat_map &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  flat_map &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      table_ = other.table_;
+      capacity_ = other.capacity_;
+      length_ = other.length_;
+      growth_left_ = other.growth_left_;
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** Check if the map is empty */
+  HSHM_INLINE_CROSS_FUN bool IsNull() const { return table_.IsNull(); }
+
+  /** Sets this map as empty */
+  HSHM_INLINE_CROSS_FUN void SetNull() {
+    table_.SetNull();
+    capacity_ = 0;
+    length_ = 0;
+    growth_left_ = 0;
+  }
+
+  /** Destroy the flat_map table */
+  HSHM_INLINE_CROSS_FUN void shm_destroy_main() {
+    DestroySlots();
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    alloc->Free(alloc.ctx_, table_);
+  }
+
+  /**====================================
+   * Emplace Methods
+   * ===================================*/
+
+  /**
+   * Construct an object directly in the map. Overrides the object if
+   * key already exists.
+   *
+   * @param key the key to future index the map
+   * @param args the arguments to construct the object
+   * @return None
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool emplace(const Key &key, Args &&...args) {
+    return emplace_templ<true>(key, std::forward<Args>(args)...);
+  }
+
+  /**
+   * Construct an object directly in the map. Does not modify the key
+   * if it already exists.
+   *
+   * @param key the key to future index the map
+   * @param args the arguments to construct the object
+   * @return None
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool try_emplace(const Key &key, Args &&...args) {
+    return emplace_templ<false>(key, std::forward<Args>(args)...);
+  }
+
+ private:
+  /**
+   * Insert a (key, value) pair in the map
+   *
+   * @param modify_existing whether or not to override an existing entry
+   * */
+  template <bool modify_existing, typename... Args>
+  HSHM_INLINE_CROSS_FUN bool emplace_templ(const Key &key, Args &&...args) {
+    size_t hash = HashKey(key);
+    size_t idx = find_index(key, hash);
+    if (idx != capacity_) {
+      if constexpr (!modify_existing) {
+        return false;
+      } else {
+        GetSlots()[idx].shm_destroy();
+        ConstructSlot(idx, key, std::forward<Args>(args)...);
+        return true;
+      }
+    }
+    if (growth_left_ == 0) {
+      Rehash(GrowCapacity());
+    }
+    idx = find_insert_index(hash);
+    if (GetCtrl()[idx] == FlatMapCtrl::kEmpty) {
+      --growth_left_;
+    }
+    SetCtrl(idx, H2(hash));
+    ConstructSlot(idx, key, std::forward<Args>(args)...);
+    ++length_;
+    return true;
+  }
+
+ public:
+  /**====================================
+   * Erase Methods
+   * ===================================*/
+
+  /**
+   * Erase an object indexable by \a key key
+   * */
+  HSHM_CROSS_FUN
+  void erase(const Key &key) {
+    size_t idx = find_index(key, HashKey(key));
+    if (idx == capacity_) {
+      return;
+    }
+    erase_index(idx);
+  }
+
+  /**
+   * Erase an object at the iterator
+   * */
+  HSHM_CROSS_FUN
+  void erase(iterator_t &iter) {
+    if (iter.is_end()) return;
+    erase_index(iter.i_);
+  }
+
+  /**
+   * Erase the entire map
+   * */
+  HSHM_CROSS_FUN void clear() {
+    if (IsNull()) {
+      return;
+    }
+    DestroySlots();
+    ResetCtrl();
+    length_ = 0;
+  }
+
+  /**
+   * Reserve space for at least \a count elements
+   * */
+  HSHM_CROSS_FUN void reserve(size_t count) {
+    size_t capacity = CapacityFor(count);
+    if (capacity > capacity_) {
+      Rehash(capacity);
+    }
+  }
+
+  /**====================================
+   * Index Methods
+   * ===================================*/
+
+  /**
+   * Locate an entry in the flat_map
+   *
+   * @return the object pointed by key
+   * @exception UNORDERED_MAP_CANT_FIND the key was not in the map
+   * */
+  HSHM_INLINE_CROSS_FUN T &operator[](const Key &key) {
+    size_t idx = find_index(key, HashKey(key));
+    if (idx != capacity_) {
+      return GetSlots()[idx]->GetVal();
+    }
+    HSHM_THROW_ERROR(UNORDERED_MAP_CANT_FIND);
+  }
+
+  /** Find an object in the flat_map */
+  HSHM_CROSS_FUN
+  iterator_t find(const Key &key) {
+    return iterator_t(*this, find_index(key, HashKey(key)));
+  }
+
+  /** Check whether \a key is in the flat_map */
+  HSHM_CROSS_FUN
+  bool contains(const Key &key) {
+    return find_index(key, HashKey(key)) != capacity_;
+  }
+
+  /**====================================
+   * Query Methods
+   * ===================================*/
+
+  /** The number of entries in the map */
+  HSHM_INLINE_CROSS_FUN size_t size() const { return length_; }
+
+  /** The number of slots in the map */
+  HSHM_INLINE_CROSS_FUN size_t get_num_buckets() const { return capacity_; }
+
+ public:
+  /**====================================
+   * Iterators
+   * ===================================*/
+
+  /** Forward iterator begin */
+  HSHM_INLINE_CROSS_FUN iterator_t begin() const {
+    iterator_t iter(const_cast<flat_map &>(*this), 0);
+    iter.make_correct();
+    return iter;
+  }
+
+  /** Forward iterator end */
+  HSHM_INLINE_CROSS_FUN iterator_t end() const {
+    return iterator_t(const_cast<flat_map &>(*this), capacity_);
+  }
+
+  /** Get the control bytes */
+  HSHM_INLINE_CROSS_FUN i8 *GetCtrl() const {
+    return GetAllocator()->template Convert<i8>(table_);
+  }
+
+  /** Get the slots */
+  HSHM_INLINE_CROSS_FUN SLOT_T *GetSlots() const {
+    return reinterpret_cast<SLOT_T *>(GetCtrl() + CtrlBytes(capacity_));
+  }
+
+  /**====================================
+   * Internal Operations
+   * ===================================*/
+ private:
+  /**
+   * Hash a key. Both the slot position (h1) and the control byte (h2)
+   * need well-distributed bits, so hashes other than hshm::hash are mixed.
+   * */
+  HSHM_INLINE_CROSS_FUN static size_t HashKey(const Key &key) {
+    return hshm::mixed_hash<Hash>(key);
+  }
+
+  /** The probe start of a hash */
+  HSHM_INLINE_CROSS_FUN static size_t H1(size_t hash) { return hash >> 7; }
+
+  /** The control byte of a hash */
+  HSHM_INLINE_CROSS_FUN static i8 H2(size_t hash) {
+    return (i8)(hash & 0x7f);
+  }
+
+  /** Number of bytes used by the control bytes */
+  HSHM_INLINE_CROSS_FUN static size_t CtrlBytes(size_t capacity) {
+    size_t bytes = capacity + kGroupWidth;
+    return (bytes + kCtrlAlign - 1) & ~(kCtrlAlign - 1);
+  }
+
+  /** The number of elements a table can hold before growing (7/8) */
+  HSHM_INLINE_CROSS_FUN static size_t MaxLoad(size_t capacity) {
+    return capacity - capacity / 8;
+  }
+
+  /** The smallest power-of-two capacity which can hold \a count */
+  HSHM_INLINE_CROSS_FUN static size_t CapacityFor(size_t count) {
+    size_t capacity = kGroupWidth;
+    while (MaxLoad(capacity) < count) {
+      capacity <<= 1;
+    }
+    return capacity;
+  }
+
+  /**
+   * The capacity to use when no insertion slots remain. If more than
+   * half of the used slots are tombstones, rehash in place instead of
+   * doubling.
+   * */
+  HSHM_INLINE_CROSS_FUN size_t GrowCapacity() const {
+    if (capacity_ == 0) {
+      return kGroupWidth;
+    }
+    if (length_ * 2 <= MaxLoad(capacity_)) {
+      return capacity_;
+    }
+    return capacity_ * 2;
+  }
+
+  /** Set a control byte and its mirror */
+  HSHM_INLINE_CROSS_FUN void SetCtrl(size_t idx, i8 h) {
+    i8 *ctrl = GetCtrl();
+    ctrl[idx] = h;
+    if (idx < kGroupWidth) {
+      ctrl[capacity_ + idx] = h;
+    }
+  }
+
+  /** Mark every slot as empty */
+  HSHM_INLINE_CROSS_FUN void ResetCtrl() {
+    memset(GetCtrl(), (u8)FlatMapCtrl::kEmpty, capacity_ + kGroupWidth);
+    growth_left_ = MaxLoad(capacity_);
+  }
+
+  /** Allocate an empty table of \a capacity slots */
+  HSHM_CROSS_FUN void AllocateTable(size_t capacity) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = CtrlBytes(capacity) + capacity * sizeof(SLOT_T);
+    table_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (table_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    capacity_ = capacity;
+    length_ = 0;
+    ResetCtrl();
+  }
+
+  /** Destroy every live slot */
+  HSHM_CROSS_FUN void DestroySlots() {
+    if (length_ == 0) {
+      return;
+    }
+    i8 *ctrl = GetCtrl();
+    SLOT_T *slots = GetSlots();
+    for (size_t i = 0; i < capacity_; ++i) {
+      if (FlatMapCtrl::IsFull(ctrl[i])) {
+        slots[i].shm_destroy();
+      }
+    }
+  }
+
+  /** Construct the (key, value) pair in slot \a idx */
+  template <typename... Args>
+  HSHM_INLINE_CROSS_FUN void ConstructSlot(size_t idx, const Key &key,
+                                           Args &&...args) {
+    HSHM_MAKE_AR(GetSlots()[idx], GetCtxAllocator(), PiecewiseConstruct(),
+                 make_argpack(key), make_argpack(std::forward<Args>(args)...))
+  }
+
+  /**
+   * Find the slot containing \a key.
+   *
+   * @return the slot index or capacity_ if not found
+   * */
+  HSHM_INLINE_CROSS_FUN size_t find_index(const Key &key, size_t hash) const {
+    if (capacity_ == 0) {
+      return capacity_;
+    }
+    size_t mask = capacity_ - 1;
+    size_t pos = H1(hash) & mask;
+    i8 h2 = H2(hash);
+    const i8 *ctrl = GetCtrl();
+    SLOT_T *slots = GetSlots();
+    for (size_t stride = kGroupWidth;; stride += kGroupWidth) {
+      FlatMapGroup group(ctrl + pos);
+      for (u64 match = group.Match(h2); match; match &= match - 1) {
+        size_t idx = (pos + FlatMapGroup::Slot(match)) & mask;
+        if (slots[idx]->GetKey() == key) {
+          return idx;
+        }
+      }
+      if (group.MatchEmpty()) {
+        return capacity_;
+      }
+      pos = (pos + stride) & mask;
+    }
+  }
+
+  /** Find the first empty or deleted slot in the probe sequence */
+  HSHM_INLINE_CROSS_FUN size_t find_insert_index(size_t hash) const {
+    size_t mask = capacity_ - 1;
+    size_t pos = H1(hash) & mask;
+    const i8 *ctrl = GetCtrl();
+    for (size_t stride = kGroupWidth;; stride += kGroupWidth) {
+      FlatMapGroup group(ctrl + pos);
+      u64 match = group.MatchEmptyOrDeleted();
+      if (match) {
+        return (pos + FlatMapGroup::Slot(match)) & mask;
+      }
+      pos = (pos + stride) & mask;
+    }
+  }
+
+  /**
+   * Erase the entry at slot \a idx. A slot can be marked empty (instead of
+   * leaving a tombstone) if no probe sequence could have passed over it,
+   * which holds when the window of full slots around it is narrower than
+   * a group.
+   * */
+  HSHM_INLINE_CROSS_FUN void erase_index(size_t idx) {
+    size_t mask = capacity_ - 1;
+    const i8 *ctrl = GetCtrl();
+    GetSlots()[idx].shm_destroy();
+    u64 empty_after = FlatMapGroup(ctrl + idx).MatchEmpty();
+    u64 empty_before =
+        FlatMapGroup(ctrl + ((idx - kGroupWidth) & mask)).MatchEmpty();
+    size_t full_after =
+        empty_after ? FlatMapGroup::Slot(empty_after) : kGroupWidth;
+    size_t full_before =
+        empty_before ? kGroupWidth - 1 -
+                           (FlatMapHighestBit(empty_before) >>
+                            FlatMapGroup::kShift)
+                     : kGroupWidth;
+    if (empty_before && empty_after && full_before + full_after < kGroupWidth) {
+      SetCtrl(idx, FlatMapCtrl::kEmpty);
+      ++growth_left_;
+    } else {
+      SetCtrl(idx, FlatMapCtrl::kDeleted);
+    }
+    --length_;
+  }
+
+  /** Move every entry into a new table of \a new_capacity slots */
+  HSHM_CROSS_FUN void Rehash(size_t new_capacity) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer old_table = table_;
+    size_t old_capacity = capacity_;
+    size_t old_length = length_;
+    i8 *old_ctrl = GetCtrl();
+    SLOT_T *old_slots = GetSlots();
+    AllocateTable(new_capacity);
+    SLOT_T *slots = GetSlots();
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (!FlatMapCtrl::IsFull(old_ctrl[i])) {
+        continue;
+      }
+      COLLISION_T &entry = old_slots[i].get_ref();
+      size_t hash = HashKey(entry.GetKey());
+      size_t idx = find_insert_index(hash);
+      SetCtrl(idx, H2(hash));
+      HSHM_MAKE_AR(slots[idx], alloc, std::move(entry))
+      old_slots[i].shm_destroy();
+    }
+    length_ = old_length;
+    growth_left_ -= old_length;
+    if (!old_table.IsNull()) {
+      alloc->Free(alloc.ctx_, old_table);
+    }
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename Key, typename T, class Hash = hshm::hash<Key>,
+          HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using flat_map = hipc::flat_map<Key, T, Hash, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_FLAT_MAP_H_
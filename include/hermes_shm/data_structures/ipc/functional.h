@@ -32,6 +32,14 @@ HSHM_CROSS_FUN IterT find(IterT start, const IterT &end, T &val) {
   return end;
 }
 
+/** Compare two values with operator< (usable on host and GPU) */
+template <typename T>
+struct less {
+  HSHM_INLINE_CROSS_FUN bool operator()(const T &a, const T &b) const {
+    return a < b;
+  }
+};
+
 }  // namespace hshm
 
 #endif  // HSHM_SHM_SHM_DATA_STRUCTURES_CONTAINERS_CmpTIONAL_H_
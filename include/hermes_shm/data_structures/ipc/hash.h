@@ -6,8 +6,12 @@
 #define HSHM_SHM_INCLUDE_HSHM_SHM_DATA_STRUCTURES_CONTAINERS_HASH_H_
 
 #include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
 
 #include "hermes_shm/constants/macros.h"
+#include "hermes_shm/types/numbers.h"
 
 namespace hshm {
 
@@ -15,37 +19,196 @@ namespace hshm {
 template <typename T>
 class hash;
 
+/**====================================
+ * Hash primitives
+ * ===================================*/
+
+/** Secrets used by hash_bytes (the wyhash default primes) */
+static constexpr u64 kHashSecret0 = 0x2d358dccaa6c78a5ull;
+static constexpr u64 kHashSecret1 = 0x8bb84b93962eacc9ull;
+static constexpr u64 kHashSecret2 = 0x4b33a62ed433d4a3ull;
+static constexpr u64 kHashSecret3 = 0x4d5a2da51de1aa47ull;
+
+/** Compute the full 128-bit product of \a a and \a b into (lo, hi) */
+HSHM_INLINE_CROSS_FUN static void hash_mul128(u64 a, u64 b, u64 &lo,
+                                              u64 &hi) {
+#if defined(HSHM_IS_GPU)
+  lo = a * b;
+  hi = __umul64hi(a, b);
+#elif defined(__SIZEOF_INT128__)
+  __uint128_t r = (__uint128_t)a * b;
+  lo = (u64)r;
+  hi = (u64)(r >> 64);
+#else
+  u64 ha = a >> 32, hb = b >> 32, la = (u32)a, lb = (u32)b;
+  u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  u64 t = rl + (rm0 << 32);
+  u64 c = t < rl;
+  lo = t + (rm1 << 32);
+  c += lo < t;
+  hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/** Multiply two words and fold the 128-bit product (wyhash's mix) */
+HSHM_INLINE_CROSS_FUN static u64 hash_mix(u64 a, u64 b) {
+  u64 lo, hi;
+  hash_mul128(a, b, lo, hi);
+  return lo ^ hi;
+}
+
+/** The MurmurHash3 64-bit finalizer. A bijection with full avalanche. */
+HSHM_INLINE_CROSS_FUN static u64 fmix64(u64 k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+  return k;
+}
+
+/** Read 8 unaligned bytes */
+HSHM_INLINE_CROSS_FUN static u64 hash_read8(const u8 *p) {
+  u64 v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+/** Read 4 unaligned bytes */
+HSHM_INLINE_CROSS_FUN static u64 hash_read4(const u8 *p) {
+  u32 v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+/**
+ * Hash a byte string. This follows wyhash: inputs of up to 16 bytes
+ * are hashed with a handful of overlapping loads, and longer inputs are
+ * consumed 48 bytes per iteration across three independent lanes.
+ * */
+HSHM_INLINE_CROSS_FUN static u64 hash_bytes(const void *data, size_t len,
+                                            u64 seed = 0) {
+  const u8 *p = reinterpret_cast<const u8 *>(data);
+  seed ^= hash_mix(seed ^ kHashSecret0, kHashSecret1);
+  u64 a, b;
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (hash_read4(p) << 32) | hash_read4(p + ((len >> 3) << 2));
+      b = (hash_read4(p + len - 4) << 32) |
+          hash_read4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = ((u64)p[0] << 16) | ((u64)p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i >= 48) {
+      u64 see1 = seed, see2 = seed;
+      do {
+        seed = hash_mix(hash_read8(p) ^ kHashSecret1, hash_read8(p + 8) ^ seed);
+        see1 = hash_mix(hash_read8(p + 16) ^ kHashSecret2,
+                        hash_read8(p + 24) ^ see1);
+        see2 = hash_mix(hash_read8(p + 32) ^ kHashSecret3,
+                        hash_read8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i >= 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = hash_mix(hash_read8(p) ^ kHashSecret1, hash_read8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = hash_read8(p + i - 16);
+    b = hash_read8(p + i - 8);
+  }
+  a ^= kHashSecret1;
+  b ^= seed;
+  hash_mul128(a, b, a, b);
+  return hash_mix(a ^ kHashSecret0 ^ len, b ^ kHashSecret1);
+}
+
+/**
+ * Map a hash onto [0, n) without a division (Lemire's fastrange).
+ * fastrange consumes the high bits of the hash, so the hash is first
+ * multiplied by 2^64/phi to fold weak low bits (e.g., from an identity
+ * user hash) into the high bits.
+ * */
+HSHM_INLINE_CROSS_FUN static size_t hash_reduce(u64 hash, u64 n) {
+  u64 lo, hi;
+  hash_mul128(hash * 0x9e3779b97f4a7c15ull, n, lo, hi);
+  return (size_t)hi;
+}
+
+/**
+ * Whether \a Hash already spreads every input bit over its whole output.
+ * All hshm::hash specializations end in fmix64 or wyhash, so they do.
+ * */
+template <typename Hash>
+struct hash_is_mixed : std::false_type {};
+template <typename T>
+struct hash_is_mixed<hash<T>> : std::true_type {};
+
+/**
+ * Hash \a key for a container that uses the hash's bits directly. Hashes
+ * that are not known to be mixed (e.g., an identity std::hash) are
+ * finished with fmix64; hshm::hash is used as is.
+ * */
+template <typename Hash, typename Key>
+HSHM_INLINE_CROSS_FUN size_t mixed_hash(const Key &key) {
+  if constexpr (hash_is_mixed<Hash>::value) {
+    return (size_t)Hash{}(key);
+  } else {
+    return (size_t)fmix64((u64)Hash{}(key));
+  }
+}
+
+/**====================================
+ * Hash functions
+ * ===================================*/
+
 /** String hash function */
 template <typename StringT>
 HSHM_CROSS_FUN size_t string_hash(const StringT &text) {
-  size_t sum = 0;
-  for (size_t i = 0; i < text.size(); ++i) {
-    auto shift = static_cast<size_t>(i % sizeof(size_t));
-    auto c = static_cast<size_t>((unsigned char)text[i]);
-    sum = 31 * sum + (c << shift);
-  }
-  return sum;
+  return (size_t)hash_bytes(text.data(), text.size());
 }
 
 /** Pointer hash function */
 template <typename T>
 struct hash<T *> {
   HSHM_CROSS_FUN size_t operator()(T *const &ptr) const {
-    return reinterpret_cast<size_t>(ptr);
+    return (size_t)fmix64((u64)reinterpret_cast<size_t>(ptr));
   }
 };
 
 /** Integer hash function */
 template <typename T>
 HSHM_INLINE_CROSS_FUN static size_t number_hash(const T &val) {
+  if constexpr (std::is_floating_point_v<T>) {
+    // +0.0 and -0.0 compare equal, so they must hash equal
+    if (val == 0) {
+      return (size_t)fmix64(0);
+    }
+  }
   if constexpr (sizeof(T) == 1) {
-    return static_cast<size_t>(val);
+    u8 bits;
+    memcpy(&bits, &val, 1);
+    return (size_t)fmix64(bits);
   } else if constexpr (sizeof(T) == 2) {
-    return static_cast<size_t>(val);
+    u16 bits;
+    memcpy(&bits, &val, 2);
+    return (size_t)fmix64(bits);
   } else if constexpr (sizeof(T) == 4) {
-    return static_cast<size_t>(val);
+    u32 bits;
+    memcpy(&bits, &val, 4);
+    return (size_t)fmix64(bits);
   } else if constexpr (sizeof(T) == 8) {
-    return static_cast<size_t>(val);
+    u64 bits;
+    memcpy(&bits, &val, 8);
+    return (size_t)fmix64(bits);
   } else {
     return 0;
   }
@@ -75,6 +238,14 @@ HSHM_INTEGER_HASH(unsigned int);
 HSHM_INTEGER_HASH(unsigned long);
 HSHM_INTEGER_HASH(unsigned long long);
 
+/** std::string hash function */
+template <>
+struct hash<std::string> {
+  HSHM_HOST_FUN size_t operator()(const std::string &text) const {
+    return string_hash(text);
+  }
+};
+
 }  // namespace hshm
 
 #endif  // HSHM_SHM_INCLUDE_HSHM_SHM_DATA_STRUCTURES_CONTAINERS_HASH_H_
@@ -0,0 +1,798 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_LRU_CACHE_H_
+#define HSHM_DATA_STRUCTURES_LRU_CACHE_H_
+
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/thread/lock/rwlock.h"
+#include "hermes_shm/types/atomic.h"
+#include "pair.h"
+
+namespace hshm::ipc {
+
+/** The default eviction callback of an lru_cache. Does nothing. */
+struct lru_cache_no_evict {
+  template <typename Key, typename T>
+  HSHM_INLINE_CROSS_FUN void operator()(const Key &key, T &val) const {}
+};
+
+/** forward pointer for lru_cache */
+template <typename Key, typename T, class Hash = hshm::hash<Key>,
+          class OnEvict = lru_cache_no_evict, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class lru_cache;
+
+/**
+ * An entry in an lru_cache. An entry is linked into both a bucket chain
+ * and the circular CLOCK list of its shard.
+ * */
+template <typename Key, typename T, HSHM_CLASS_TEMPL>
+struct lru_cache_entry {
+  OffsetPointer next_;
+  OffsetPointer clock_prev_;
+  OffsetPointer clock_next_;
+  size_t hash_;
+  size_t charge_;
+  ipc::atomic<u32> ref_;
+  delay_ar<hipc::pair<Key, T, HSHM_CLASS_TEMPL_ARGS>> pair_;
+};
+
+/**
+ * A shard of an lru_cache. Lookups hold \a lock_ for reading and only
+ * set the reference bit of the entry they hit. Inserts, erases and
+ * evictions hold it for writing.
+ * */
+struct lru_cache_shard {
+  RwLock lock_;
+  OffsetPointer buckets_;
+  size_t num_buckets_;
+  OffsetPointer hand_;
+  size_t length_;
+  size_t charge_;
+};
+
+/**
+ * MACROS to simplify the lru_cache namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+
+#define CLASS_NAME lru_cache
+#define CLASS_NEW_ARGS Key, T, Hash, OnEvict
+
+/**
+ * A bounded cache which is safe for concurrent use from multiple threads
+ * and processes.
+ *
+ * Keys are striped across a power-of-two number of shards, each with its
+ * own lock, hash table and eviction state. The capacity is split evenly
+ * among the shards and may be a number of entries, a number of bytes, or
+ * both. Each entry is charged a caller-provided number of bytes.
+ *
+ * Eviction uses the CLOCK approximation of LRU. A hit only sets the
+ * entry's reference bit under the shard's read lock, so concurrent hits
+ * never reorder a list. When a shard is over capacity, its clock hand
+ * sweeps the entries, giving each referenced entry a second chance and
+ * evicting the first unreferenced one.
+ *
+ * OnEvict is default-constructed and called as OnEvict{}(key, val) for
+ * every entry evicted to make room, but not for erase or clear. Because
+ * it is a type rather than a stored function pointer, each process that
+ * maps the cache evicts with its own copy of the code. It runs under the
+ * shard's write lock and must not call back into the cache.
+ * */
+template <typename Key, typename T, class Hash, class OnEvict,
+          HSHM_CLASS_TEMPL>
+class lru_cache : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  using COLLISION_T = hipc::pair<Key, T, HSHM_CLASS_TEMPL_ARGS>;
+  using ENTRY_T = lru_cache_entry<Key, T, HSHM_CLASS_TEMPL_ARGS>;
+  using SHARD_T = lru_cache_shard;
+  CLS_CONST size_t kShardStride = (sizeof(SHARD_T) + 63) & ~(size_t)63;
+  CLS_CONST size_t kDefaultCharge = sizeof(ENTRY_T);
+
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer shards_;
+  size_t num_shards_;
+  size_t shard_shift_;
+  size_t max_entries_;
+  size_t max_bytes_;
+  size_t shard_max_entries_;
+  size_t shard_max_bytes_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /**
+   * SHM constructor. Initialize the cache.
+   *
+   * @param max_entries the maximum number of entries (0 for no limit)
+   * @param max_bytes the maximum total charge of the entries (0 for no
+   * limit)
+   * @param num_shards the number of independently locked shards. Rounded
+   * up to a power of two, and reduced so that each shard can hold at least
+   * one entry.
+   * */
+  HSHM_CROSS_FUN
+  explicit lru_cache(size_t max_entries = 1024, size_t max_bytes = 0,
+                     int num_shards = 16) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), max_entries,
+             max_bytes, num_shards);
+  }
+
+  /**
+   * SHM constructor. Initialize the cache.
+   *
+   * @param alloc the shared-memory allocator
+   * @param max_entries the maximum number of entries (0 for no limit)
+   * @param max_bytes the maximum total charge of the entries (0 for no
+   * limit)
+   * @param num_shards the number of independently locked shards
+   * */
+  HSHM_CROSS_FUN
+  explicit lru_cache(const hipc::CtxAllocator<AllocT> &alloc,
+                     size_t max_entries = 1024, size_t max_bytes = 0,
+                     int num_shards = 16) {
+    shm_init(alloc, max_entries, max_bytes, num_shards);
+  }
+
+  /** SHM constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc,
+                size_t max_entries = 1024, size_t max_bytes = 0,
+                int num_shards = 16) {
+    init_shm_container(alloc);
+    SetNull();
+    AllocateShards(max_entries, max_bytes, num_shards);
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit lru_cache(const lru_cache &other) {
+    init_shm_container(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit lru_cache(const hipc::CtxAllocator<AllocT> &alloc,
+                     const lru_cache &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  lru_cache &operator=(const lru_cache &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /**
+   * Internal copy operation. Each shard of other is copied atomically,
+   * in clock order and with the same charges.
+   * */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const lru_cache &other) {
+    AllocateShards(other.max_entries_, other.max_bytes_, other.num_shards_);
+    for (size_t i = 0; i < other.num_shards_; ++i) {
+      SHARD_T &shard = other.GetShard(i);
+      ScopedRwReadLock lock(shard.lock_, 0);
+      other.for_each_entry(shard, [this](ENTRY_T *entry) {
+        emplace_templ<true>(entry->pair_->GetKey(), entry->charge_,
+                            entry->pair_->GetVal());
+      });
+    }
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_INLINE_CROSS_FUN lru_cache(lru_cache &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_INLINE_CROSS_FUN lru_cache(const hipc::CtxAllocator<AllocT> &alloc,
+                                  lru_cache &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  lru_cache &operator=(lru_cache &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  lru_cache &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      shards_ = other.shards_;
+      num_shards_ = other.num_shards_;
+      shard_shift_ = other.shard_shift_;
+      max_entries_ = other.max_entries_;
+      max_bytes_ = other.max_bytes_;
+      shard_max_entries_ = other.shard_max_entries_;
+      shard_max_bytes_ = other.shard_max_bytes_;
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** Check if the cache is empty */
+  HSHM_INLINE_CROSS_FUN bool IsNull() const { return shards_.IsNull(); }
+
+  /** Sets this cache as empty */
+  HSHM_INLINE_CROSS_FUN void SetNull() {
+    shards_.SetNull();
+    num_shards_ = 0;
+    shard_shift_ = 0;
+  }
+
+  /**
+   * Destroy every shard. The eviction callback is not called.
+   * Not safe while the cache is being accessed.
+   * */
+  HSHM_CROSS_FUN void shm_destroy_main() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    for (size_t i = 0; i < num_shards_; ++i) {
+      SHARD_T &shard = GetShard(i);
+      ClearShard(shard);
+      alloc->Free(alloc.ctx_, shard.buckets_);
+    }
+    alloc->Free(alloc.ctx_, shards_);
+  }
+
+  /**====================================
+   * Emplace Methods
+   * ===================================*/
+
+  /**
+   * Construct an object directly in the cache, charged kDefaultCharge
+   * bytes. Overrides the object if key already exists. May evict other
+   * entries.
+   *
+   * @param key the key to future index the cache
+   * @param args the arguments to construct the object
+   * @return true
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool emplace(const Key &key, Args &&...args) {
+    return emplace_templ<true>(key, kDefaultCharge,
+                               std::forward<Args>(args)...);
+  }
+
+  /**
+   * Construct an object directly in the cache. Does not modify the key
+   * if it already exists.
+   *
+   * @param key the key to future index the cache
+   * @param args the arguments to construct the object
+   * @return true if the key was inserted
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool try_emplace(const Key &key, Args &&...args) {
+    return emplace_templ<false>(key, kDefaultCharge,
+                                std::forward<Args>(args)...);
+  }
+
+  /**
+   * Construct an object directly in the cache and charge it \a charge
+   * bytes against the byte capacity. Overrides the object if key already
+   * exists.
+   *
+   * @return false if charge exceeds the byte capacity of a shard
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool emplace_charged(const Key &key, size_t charge,
+                                      Args &&...args) {
+    return emplace_templ<true>(key, charge, std::forward<Args>(args)...);
+  }
+
+  /**
+   * Construct an object directly in the cache and charge it \a charge
+   * bytes. Does not modify the key if it already exists.
+   *
+   * @return true if the key was inserted
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool try_emplace_charged(const Key &key, size_t charge,
+                                          Args &&...args) {
+    return emplace_templ<false>(key, charge, std::forward<Args>(args)...);
+  }
+
+ private:
+  /**
+   * Insert a (key, value) pair in the cache, then evict until the shard
+   * is within capacity again. The new entry itself is never evicted.
+   *
+   * @param modify_existing whether or not to override an existing entry
+   * */
+  template <bool modify_existing, typename... Args>
+  HSHM_INLINE_CROSS_FUN bool emplace_templ(const Key &key, size_t charge,
+                                           Args &&...args) {
+    if (shard_max_bytes_ && charge > shard_max_bytes_) {
+      return false;
+    }
+    size_t hash = HashKey(key);
+    SHARD_T &shard = GetShardOf(hash);
+    ScopedRwWriteLock lock(shard.lock_, 0);
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+
+    // Override the existing entry in place
+    OffsetPointer *link = FindLink(shard, key, hash);
+    OffsetPointer entry_p = *link;
+    if (!entry_p.IsNull()) {
+      if constexpr (!modify_existing) {
+        return false;
+      } else {
+        ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+        entry->pair_.shm_destroy();
+        HSHM_MAKE_AR(entry->pair_, alloc, PiecewiseConstruct(),
+                     make_argpack(key),
+                     make_argpack(std::forward<Args>(args)...))
+        shard.charge_ = shard.charge_ - entry->charge_ + charge;
+        entry->charge_ = charge;
+        entry->ref_.store(1, std::memory_order_relaxed);
+        Evict(shard, entry_p);
+        return true;
+      }
+    }
+
+    // Link a new entry into its bucket and just behind the clock hand
+    entry_p = alloc->template Allocate<OffsetPointer>(alloc.ctx_,
+                                                      sizeof(ENTRY_T));
+    if (entry_p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, sizeof(ENTRY_T),
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+    new (&entry->ref_) ipc::atomic<u32>(0);
+    entry->hash_ = hash;
+    entry->charge_ = charge;
+    HSHM_MAKE_AR(entry->pair_, alloc, PiecewiseConstruct(), make_argpack(key),
+                 make_argpack(std::forward<Args>(args)...))
+    OffsetPointer &head = GetBuckets(shard)[BucketOf(hash, shard)];
+    entry->next_ = head;
+    head = entry_p;
+    LinkClock(shard, entry_p, entry);
+    ++shard.length_;
+    shard.charge_ += charge;
+    // Evict first, so a shard that is full at its bucket count stays put
+    Evict(shard, entry_p);
+    if (shard.length_ > shard.num_buckets_) {
+      Grow(shard);
+    }
+    return true;
+  }
+
+ public:
+  /**====================================
+   * Erase Methods
+   * ===================================*/
+
+  /**
+   * Erase an object indexable by \a key key. The eviction callback is
+   * not called.
+   *
+   * @return true if the key was present
+   * */
+  HSHM_CROSS_FUN
+  bool erase(const Key &key) {
+    size_t hash = HashKey(key);
+    SHARD_T &shard = GetShardOf(hash);
+    ScopedRwWriteLock lock(shard.lock_, 0);
+    OffsetPointer *link = FindLink(shard, key, hash);
+    if (link->IsNull()) {
+      return false;
+    }
+    RemoveEntry(shard, link);
+    return true;
+  }
+
+  /**
+   * Erase the entire cache. Each shard is cleared atomically and the
+   * eviction callback is not called.
+   * */
+  HSHM_CROSS_FUN void clear() {
+    for (size_t i = 0; i < num_shards_; ++i) {
+      SHARD_T &shard = GetShard(i);
+      ScopedRwWriteLock lock(shard.lock_, 0);
+      ClearShard(shard);
+    }
+  }
+
+  /**====================================
+   * Index Methods
+   * ===================================*/
+
+  /**
+   * Copy the value of \a key into \a val and mark the entry as recently
+   * used.
+   *
+   * @return true if the key was found
+   * */
+  HSHM_CROSS_FUN
+  bool find(const Key &key, T &val) const {
+    size_t hash = HashKey(key);
+    SHARD_T &shard = GetShardOf(hash);
+    ScopedRwReadLock lock(shard.lock_, 0);
+    OffsetPointer entry_p = *FindLink(shard, key, hash);
+    if (entry_p.IsNull()) {
+      return false;
+    }
+    ENTRY_T *entry = GetAllocator()->template Convert<ENTRY_T>(entry_p);
+    val = entry->pair_->GetVal();
+    // Skip the store when already set to keep the line clean for readers
+    if (!entry->ref_.load(std::memory_order_relaxed)) {
+      entry->ref_.store(1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  /**
+   * Check whether \a key is in the cache. Does not mark the entry as
+   * recently used.
+   * */
+  HSHM_CROSS_FUN
+  bool contains(const Key &key) const {
+    size_t hash = HashKey(key);
+    SHARD_T &shard = GetShardOf(hash);
+    ScopedRwReadLock lock(shard.lock_, 0);
+    return !FindLink(shard, key, hash)->IsNull();
+  }
+
+  /**
+   * Call \a func(key, val) on every entry. Each shard is read-locked while
+   * it is visited, so the view is consistent per shard.
+   * */
+  template <typename FUNC>
+  HSHM_CROSS_FUN void for_each(FUNC &&func) const {
+    for (size_t i = 0; i < num_shards_; ++i) {
+      SHARD_T &shard = GetShard(i);
+      ScopedRwReadLock lock(shard.lock_, 0);
+      for_each_entry(shard, [&func](ENTRY_T *entry) {
+        func(entry->pair_->GetKey(), entry->pair_->GetVal());
+      });
+    }
+  }
+
+  /**====================================
+   * Query Methods
+   * ===================================*/
+
+  /** The number of entries in the cache. Approximate under concurrency. */
+  HSHM_CROSS_FUN size_t size() const {
+    size_t length = 0;
+    for (size_t i = 0; i < num_shards_; ++i) {
+      length += GetShard(i).length_;
+    }
+    return length;
+  }
+
+  /** The total charge of the entries. Approximate under concurrency. */
+  HSHM_CROSS_FUN size_t charge() const {
+    size_t charge = 0;
+    for (size_t i = 0; i < num_shards_; ++i) {
+      charge += GetShard(i).charge_;
+    }
+    return charge;
+  }
+
+  /** The maximum number of entries (0 for no limit) */
+  HSHM_INLINE_CROSS_FUN size_t get_max_entries() const {
+    return max_entries_;
+  }
+
+  /** The maximum total charge of the entries (0 for no limit) */
+  HSHM_INLINE_CROSS_FUN size_t get_max_bytes() const { return max_bytes_; }
+
+  /** The number of shards in the cache */
+  HSHM_INLINE_CROSS_FUN size_t get_num_shards() const { return num_shards_; }
+
+  /**====================================
+   * Internal Operations
+   * ===================================*/
+ private:
+  /** Hash a key. Hashes that are not already mixed get fmix64. */
+  HSHM_INLINE_CROSS_FUN static size_t HashKey(const Key &key) {
+    return (size_t)hshm::mixed_hash<Hash>(key);
+  }
+
+  /** Get a shard by index */
+  HSHM_INLINE_CROSS_FUN SHARD_T &GetShard(size_t i) const {
+    char *shards = GetAllocator()->template Convert<char>(shards_);
+    return *reinterpret_cast<SHARD_T *>(shards + i * kShardStride);
+  }
+
+  /** Get the shard a hash belongs to (uses the high bits of the hash) */
+  HSHM_INLINE_CROSS_FUN SHARD_T &GetShardOf(size_t hash) const {
+    return GetShard(shard_shift_ == 64 ? 0 : (size_t)((u64)hash >>
+                                                      shard_shift_));
+  }
+
+  /** Get the bucket heads of a shard */
+  HSHM_INLINE_CROSS_FUN OffsetPointer *GetBuckets(SHARD_T &shard) const {
+    return GetAllocator()->template Convert<OffsetPointer>(shard.buckets_);
+  }
+
+  /** Get the bucket a hash belongs to (uses the low bits of the hash) */
+  HSHM_INLINE_CROSS_FUN static size_t BucketOf(size_t hash, SHARD_T &shard) {
+    return hash & (shard.num_buckets_ - 1);
+  }
+
+  /** Whether a shard holds more than its share of the capacity */
+  HSHM_INLINE_CROSS_FUN bool OverCapacity(SHARD_T &shard) const {
+    return (shard_max_entries_ && shard.length_ > shard_max_entries_) ||
+           (shard_max_bytes_ && shard.charge_ > shard_max_bytes_);
+  }
+
+  /**
+   * Find the link pointing to the entry of \a key, or the null link at
+   * the end of its bucket chain. Requires the shard lock.
+   * */
+  HSHM_INLINE_CROSS_FUN OffsetPointer *FindLink(SHARD_T &shard,
+                                                const Key &key,
+                                                size_t hash) const {
+    auto alloc = GetAllocator();
+    OffsetPointer *link = &GetBuckets(shard)[BucketOf(hash, shard)];
+    while (!link->IsNull()) {
+      ENTRY_T *entry = alloc->template Convert<ENTRY_T>(*link);
+      if (entry->hash_ == hash && entry->pair_->GetKey() == key) {
+        break;
+      }
+      link = &entry->next_;
+    }
+    return link;
+  }
+
+  /** Call \a func(entry) on every entry of a shard in clock order */
+  template <typename FUNC>
+  HSHM_CROSS_FUN void for_each_entry(SHARD_T &shard, FUNC &&func) const {
+    auto alloc = GetAllocator();
+    OffsetPointer entry_p = shard.hand_;
+    for (size_t i = 0; i < shard.length_; ++i) {
+      ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+      entry_p = entry->clock_next_;
+      func(entry);
+    }
+  }
+
+  /** Link an entry into the clock just behind the hand */
+  HSHM_INLINE_CROSS_FUN void LinkClock(SHARD_T &shard, OffsetPointer entry_p,
+                                       ENTRY_T *entry) {
+    if (shard.hand_.IsNull()) {
+      entry->clock_prev_ = entry_p;
+      entry->clock_next_ = entry_p;
+      shard.hand_ = entry_p;
+      return;
+    }
+    auto alloc = GetAllocator();
+    ENTRY_T *hand = alloc->template Convert<ENTRY_T>(shard.hand_);
+    ENTRY_T *prev = alloc->template Convert<ENTRY_T>(hand->clock_prev_);
+    entry->clock_prev_ = hand->clock_prev_;
+    entry->clock_next_ = shard.hand_;
+    prev->clock_next_ = entry_p;
+    hand->clock_prev_ = entry_p;
+  }
+
+  /**
+   * Unlink the entry \a link points to from its bucket and the clock,
+   * then destroy and free it. Requires the shard write lock.
+   * */
+  HSHM_CROSS_FUN void RemoveEntry(SHARD_T &shard, OffsetPointer *link) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer entry_p = *link;
+    ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+    *link = entry->next_;
+    if (entry->clock_next_ == entry_p) {
+      shard.hand_.SetNull();
+    } else {
+      alloc->template Convert<ENTRY_T>(entry->clock_prev_)->clock_next_ =
+          entry->clock_next_;
+      alloc->template Convert<ENTRY_T>(entry->clock_next_)->clock_prev_ =
+          entry->clock_prev_;
+      if (shard.hand_ == entry_p) {
+        shard.hand_ = entry->clock_next_;
+      }
+    }
+    --shard.length_;
+    shard.charge_ -= entry->charge_;
+    entry->pair_.shm_destroy();
+    alloc->Free(alloc.ctx_, entry_p);
+  }
+
+  /**
+   * Sweep the clock hand until the shard is within capacity. Referenced
+   * entries lose their reference bit and are skipped; the first
+   * unreferenced entry is evicted. \a keep is never evicted. Since a
+   * single entry always fits a shard, the sweep ends before only \a keep
+   * remains.
+   * */
+  HSHM_CROSS_FUN void Evict(SHARD_T &shard, OffsetPointer keep) {
+    auto alloc = GetAllocator();
+    while (OverCapacity(shard)) {
+      OffsetPointer victim_p = shard.hand_;
+      ENTRY_T *victim = alloc->template Convert<ENTRY_T>(victim_p);
+      shard.hand_ = victim->clock_next_;
+      if (victim_p == keep) {
+        continue;
+      }
+      if (victim->ref_.load(std::memory_order_relaxed)) {
+        victim->ref_.store(0, std::memory_order_relaxed);
+        continue;
+      }
+      OnEvict{}(victim->pair_->GetKey(), victim->pair_->GetVal());
+      RemoveEntry(shard, FindLink(shard, victim->pair_->GetKey(),
+                                  victim->hash_));
+    }
+  }
+
+  /** Allocate the shards and their initial bucket tables */
+  HSHM_CROSS_FUN void AllocateShards(size_t max_entries, size_t max_bytes,
+                                     size_t num_shards) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t n = 1;
+    while (n < num_shards) {
+      n <<= 1;
+    }
+    while (max_entries && n > 1 && n > max_entries) {
+      n >>= 1;
+    }
+    num_shards = n;
+    size_t size = num_shards * kShardStride;
+    shards_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (shards_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    num_shards_ = num_shards;
+    shard_shift_ = 64;
+    for (n = num_shards; n > 1; n >>= 1) {
+      --shard_shift_;
+    }
+    max_entries_ = max_entries;
+    max_bytes_ = max_bytes;
+    shard_max_entries_ = (max_entries + num_shards - 1) / num_shards;
+    shard_max_bytes_ = (max_bytes + num_shards - 1) / num_shards;
+    size_t num_buckets = 16;
+    while (num_buckets < shard_max_entries_) {
+      num_buckets <<= 1;
+    }
+    for (size_t i = 0; i < num_shards; ++i) {
+      SHARD_T &shard = GetShard(i);
+      new (&shard) SHARD_T();
+      shard.buckets_ = AllocateBuckets(num_buckets);
+      shard.num_buckets_ = num_buckets;
+      shard.hand_.SetNull();
+      shard.length_ = 0;
+      shard.charge_ = 0;
+    }
+  }
+
+  /** Allocate an array of empty bucket heads */
+  HSHM_CROSS_FUN OffsetPointer AllocateBuckets(size_t num_buckets) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = num_buckets * sizeof(OffsetPointer);
+    OffsetPointer buckets_p =
+        alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (buckets_p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    OffsetPointer *buckets = alloc->template Convert<OffsetPointer>(buckets_p);
+    for (size_t i = 0; i < num_buckets; ++i) {
+      buckets[i].SetNull();
+    }
+    return buckets_p;
+  }
+
+  /**
+   * Double the buckets of one shard. Only grows caches without an entry
+   * limit, since the initial table already fits shard_max_entries_.
+   * Requires the shard write lock.
+   * */
+  HSHM_CROSS_FUN void Grow(SHARD_T &shard) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer old_buckets_p = shard.buckets_;
+    OffsetPointer *old_buckets = GetBuckets(shard);
+    size_t old_num_buckets = shard.num_buckets_;
+    shard.buckets_ = AllocateBuckets(old_num_buckets * 2);
+    shard.num_buckets_ = old_num_buckets * 2;
+    OffsetPointer *new_buckets = GetBuckets(shard);
+    for (size_t b = 0; b < old_num_buckets; ++b) {
+      OffsetPointer entry_p = old_buckets[b];
+      while (!entry_p.IsNull()) {
+        ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+        OffsetPointer next_p = entry->next_;
+        OffsetPointer &head = new_buckets[BucketOf(entry->hash_, shard)];
+        entry->next_ = head;
+        head = entry_p;
+        entry_p = next_p;
+      }
+    }
+    alloc->Free(alloc.ctx_, old_buckets_p);
+  }
+
+  /** Destroy all entries of a shard. Requires the shard write lock. */
+  HSHM_CROSS_FUN void ClearShard(SHARD_T &shard) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer entry_p = shard.hand_;
+    for (size_t i = 0; i < shard.length_; ++i) {
+      ENTRY_T *entry = alloc->template Convert<ENTRY_T>(entry_p);
+      OffsetPointer next_p = entry->clock_next_;
+      entry->pair_.shm_destroy();
+      alloc->Free(alloc.ctx_, entry_p);
+      entry_p = next_p;
+    }
+    OffsetPointer *buckets = GetBuckets(shard);
+    for (size_t b = 0; b < shard.num_buckets_; ++b) {
+      buckets[b].SetNull();
+    }
+    shard.hand_.SetNull();
+    shard.length_ = 0;
+    shard.charge_ = 0;
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename Key, typename T, class Hash = hshm::hash<Key>,
+          class OnEvict = hipc::lru_cache_no_evict,
+          HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using lru_cache =
+    hipc::lru_cache<Key, T, Hash, OnEvict, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_LRU_CACHE_H_
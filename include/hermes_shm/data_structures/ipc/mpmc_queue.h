@@ -0,0 +1,461 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_MPMC_QUEUE_H_
+#define HSHM_DATA_STRUCTURES_IPC_MPMC_QUEUE_H_
+
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/qtok.h"
+
+namespace hshm::ipc {
+
+/** Forward declaration of mpmc_queue */
+template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class mpmc_queue;
+
+/**
+ * A slot of the mpmc_queue.
+ *
+ * \a seq_ tells whose turn it is. For the slot of position pos, seq_ is
+ * pos while the slot is free for the producer of pos, pos + 1 once the
+ * value is published for the consumer of pos, and pos + depth once it is
+ * free again for the next lap.
+ * */
+template <typename T>
+struct mpmc_queue_cell {
+  ipc::atomic<hshm::u64> seq_;
+  delay_ar<T> val_;
+};
+
+/**
+ * MACROS used to simplify the mpmc_queue namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME mpmc_queue
+#define CLASS_NEW_ARGS T
+
+/**
+ * A bounded queue for multiple producers and multiple consumers
+ * (Vyukov's design). Each slot carries a sequence number, so a producer
+ * only claims a slot the consumers have released and a consumer only
+ * claims a slot a producer has published. Neither side blocks the
+ * other; push fails when the queue is full and pop when it is empty.
+ *
+ * The depth is rounded up to a power of two so positions map to slots
+ * with a mask. head_ and tail_ are padded onto their own cache lines.
+ * All state lives in the allocator's memory, so processes sharing the
+ * allocator can use the queue concurrently.
+ * */
+template <typename T, HSHM_CLASS_TEMPL>
+class mpmc_queue : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef mpmc_queue_cell<T> cell_t;
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer cells_;
+  hshm::u64 mask_;
+  char pad0_[HSHM_CACHE_LINE_SIZE];
+  ipc::atomic<hshm::u64> tail_;
+  char pad1_[HSHM_CACHE_LINE_SIZE - sizeof(ipc::atomic<hshm::u64>)];
+  ipc::atomic<hshm::u64> head_;
+  char pad2_[HSHM_CACHE_LINE_SIZE - sizeof(ipc::atomic<hshm::u64>)];
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit mpmc_queue(size_t depth = 1024) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), depth);
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit mpmc_queue(const hipc::CtxAllocator<AllocT> &alloc,
+                      size_t depth = 1024) {
+    shm_init(alloc, depth);
+  }
+
+  /** SHM Constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc, size_t depth = 1024) {
+    init_shm_container(alloc);
+    SetNull();
+    AllocateCells(depth);
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit mpmc_queue(const mpmc_queue &other) {
+    init_shm_container(other.GetCtxAllocator());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit mpmc_queue(const hipc::CtxAllocator<AllocT> &alloc,
+                      const mpmc_queue &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  mpmc_queue &operator=(const mpmc_queue &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** SHM copy constructor + operator main. Not safe under modification. */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const mpmc_queue &other) {
+    AllocateCells(other.GetDepth());
+    cell_t *cells = other.GetCells();
+    for (hshm::u64 pos = other.head_.load(); pos != other.tail_.load();
+         ++pos) {
+      emplace(cells[pos & other.mask_].val_.get_ref());
+    }
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  mpmc_queue(mpmc_queue &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  mpmc_queue(const hipc::CtxAllocator<AllocT> &alloc,
+             mpmc_queue &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  mpmc_queue &operator=(mpmc_queue &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  mpmc_queue &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      cells_ = other.cells_;
+      mask_ = other.mask_;
+      tail_ = other.tail_.load();
+      head_ = other.head_.load();
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. Destroys the values still in the queue. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() {
+    cell_t *cells = GetCells();
+    for (hshm::u64 pos = head_.load(); pos != tail_.load(); ++pos) {
+      cells[pos & mask_].val_.shm_destroy();
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    alloc->Free(alloc.ctx_, cells_);
+  }
+
+  /** Check if the queue is empty */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return cells_.IsNull(); }
+
+  /** Sets this queue as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {
+    cells_.SetNull();
+    mask_ = 0;
+    tail_ = 0;
+    head_ = 0;
+  }
+
+  /**====================================
+   * MPMC Queue Methods
+   * ===================================*/
+
+  /**
+   * Construct an element at the tail of the queue.
+   *
+   * @return the position of the element, or a null qtok if full
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN qtok_t emplace(Args &&...args) {
+    cell_t *cells = GetCells();
+    hshm::u64 pos = tail_.load(std::memory_order_relaxed);
+    cell_t *cell;
+    while (true) {
+      cell = &cells[pos & mask_];
+      hshm::u64 seq = cell->seq_.load(std::memory_order_acquire);
+      hshm::i64 dif = (hshm::i64)(seq - pos);
+      if (dif == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (dif < 0) {
+        // The consumer of the previous lap has not released the slot
+        return qtok_t::GetNull();
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    HSHM_MAKE_AR(cell->val_, GetCtxAllocator(), std::forward<Args>(args)...)
+    cell->seq_.store(pos + 1, std::memory_order_release);
+    return qtok_t(pos);
+  }
+
+  /** Push an element in the queue (wrapper) */
+  template <typename... Args>
+  HSHM_INLINE_CROSS_FUN qtok_t push(Args &&...args) {
+    return emplace(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Pop the element at the head of the queue.
+   *
+   * @return the position of the element, or a null qtok if empty
+   * */
+  HSHM_CROSS_FUN
+  qtok_t pop(T &val) {
+    cell_t *cells = GetCells();
+    hshm::u64 pos = head_.load(std::memory_order_relaxed);
+    cell_t *cell;
+    while (true) {
+      cell = &cells[pos & mask_];
+      hshm::u64 seq = cell->seq_.load(std::memory_order_acquire);
+      hshm::i64 dif = (hshm::i64)(seq - (pos + 1));
+      if (dif == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (dif < 0) {
+        // The producer of this position has not published yet
+        return qtok_t::GetNull();
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    val = std::move(cell->val_.get_ref());
+    cell->val_.shm_destroy();
+    cell->seq_.store(pos + mask_ + 1, std::memory_order_release);
+    return qtok_t(pos);
+  }
+
+  /**
+   * Construct up to \a n elements at the tail, copying or moving from
+   * \a first. The run of free slots at the tail is claimed with a single
+   * CAS on tail_; each slot is then published by a store to its sequence.
+   *
+   * @return the number of elements pushed, which is less than \a n if
+   * the queue filled up
+   * */
+  template <typename IterT>
+  HSHM_CROSS_FUN size_t emplace_n(IterT first, size_t n) {
+    if (n == 0) {
+      return 0;
+    }
+    cell_t *cells = GetCells();
+    hshm::u64 pos = tail_.load(std::memory_order_relaxed);
+    size_t count;
+    while (true) {
+      count = 0;
+      while (count < n && cells[(pos + count) & mask_].seq_.load(
+                              std::memory_order_acquire) == pos + count) {
+        ++count;
+      }
+      if (count == 0) {
+        hshm::u64 seq = cells[pos & mask_].seq_.load(std::memory_order_acquire);
+        if ((hshm::i64)(seq - pos) < 0) {
+          return 0;
+        }
+        pos = tail_.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (tail_.compare_exchange_weak(pos, pos + count,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    for (size_t i = 0; i < count; ++i, ++first) {
+      cell_t &cell = cells[(pos + i) & mask_];
+      HSHM_MAKE_AR(cell.val_, GetCtxAllocator(), *first)
+      cell.seq_.store(pos + i + 1, std::memory_order_release);
+    }
+    return count;
+  }
+
+  /** Push up to \a n elements from \a vals (wrapper) */
+  HSHM_INLINE_CROSS_FUN size_t push_n(const T *vals, size_t n) {
+    return emplace_n(vals, n);
+  }
+
+  /**
+   * Pop up to \a max elements from the head into \a out. The run of
+   * published slots at the head is claimed with a single CAS on head_.
+   *
+   * @return the number of elements popped
+   * */
+  HSHM_CROSS_FUN
+  size_t pop_n(T *out, size_t max) {
+    if (max == 0) {
+      return 0;
+    }
+    cell_t *cells = GetCells();
+    hshm::u64 pos = head_.load(std::memory_order_relaxed);
+    size_t count;
+    while (true) {
+      count = 0;
+      while (count < max && cells[(pos + count) & mask_].seq_.load(
+                                std::memory_order_acquire) == pos + count + 1) {
+        ++count;
+      }
+      if (count == 0) {
+        hshm::u64 seq = cells[pos & mask_].seq_.load(std::memory_order_acquire);
+        if ((hshm::i64)(seq - (pos + 1)) < 0) {
+          return 0;
+        }
+        pos = head_.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (head_.compare_exchange_weak(pos, pos + count,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      cell_t &cell = cells[(pos + i) & mask_];
+      out[i] = std::move(cell.val_.get_ref());
+      cell.val_.shm_destroy();
+      cell.seq_.store(pos + i + mask_ + 1, std::memory_order_release);
+    }
+    return count;
+  }
+
+  /** Pop the element at the head of the queue and discard it */
+  HSHM_CROSS_FUN
+  qtok_t pop() {
+    T val;
+    return pop(val);
+  }
+
+  /** Get queue depth */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetDepth() const { return (size_t)(mask_ + 1); }
+
+  /** Get size at this moment. Approximate under concurrency. */
+  HSHM_CROSS_FUN
+  size_t GetSize() const {
+    hshm::u64 head = head_.load();
+    hshm::u64 tail = tail_.load();
+    if (tail < head) {
+      return 0;
+    }
+    return (size_t)(tail - head);
+  }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() const { return GetSize(); }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t Size() const { return GetSize(); }
+
+ private:
+  /** Get the slots */
+  HSHM_INLINE_CROSS_FUN cell_t *GetCells() const {
+    return GetAllocator()->template Convert<cell_t>(cells_);
+  }
+
+  /** Allocate at least \a depth slots, rounded up to a power of two */
+  HSHM_CROSS_FUN void AllocateCells(size_t depth) {
+    size_t pow2 = 1;
+    while (pow2 < depth) {
+      pow2 <<= 1;
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = pow2 * sizeof(cell_t);
+    cells_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (cells_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    cell_t *cells = GetCells();
+    for (size_t i = 0; i < pow2; ++i) {
+      new (&cells[i]) cell_t();
+      cells[i].seq_ = i;
+    }
+    mask_ = pow2 - 1;
+    tail_ = 0;
+    head_ = 0;
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using mpmc_queue = hipc::mpmc_queue<T, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_MPMC_QUEUE_H_
@@ -0,0 +1,481 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_MSG_RING_H_
+#define HSHM_DATA_STRUCTURES_IPC_MSG_RING_H_
+
+#include <cstring>
+
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/qtok.h"
+#include "ring_queue_flags.h"
+
+namespace hshm::ipc {
+
+/** Forward declaration of msg_ring_base */
+template <RingQueueFlag RQ_FLAGS, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class msg_ring_base;
+
+/**
+ * The header in front of each record of a msg_ring.
+ *
+ * \a size_ is the payload length. A record spans the header and the
+ * payload, rounded up to 8 bytes. Padding records fill the end of the
+ * buffer when a message does not fit before the wrap.
+ * */
+struct msg_ring_header {
+  ipc::atomic<hshm::u32> state_;
+  hshm::u32 size_;
+
+  /** The record is reserved, but the producer is still writing it */
+  CLS_CONST hshm::u32 kBusy = 1;
+  /** The record is committed and may be consumed */
+  CLS_CONST hshm::u32 kReady = 2;
+  /** The record is padding up to the end of the buffer */
+  CLS_CONST hshm::u32 kPad = 3;
+};
+
+/**
+ * MACROS used to simplify the msg_ring namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME msg_ring_base
+#define CLASS_NEW_ARGS RQ_FLAGS
+
+/**
+ * A ring of variable-length messages for a single consumer.
+ *
+ * Producers reserve() space, write the message in place and commit() it.
+ * The consumer peek()s at the oldest message and release()s it once it is
+ * done. Messages are never copied and never touch the allocator after
+ * construction. Each message is stored contiguously: when one does not
+ * fit before the end of the buffer, the rest of the buffer is skipped
+ * with a padding record. Records are limited to half the buffer, so a
+ * record and the padding in front of it always fit in an empty ring.
+ *
+ * With kPushAtomic, producers claim space with a CAS on reserve_ and then
+ * publish their claims to tail_ in claim order. A claim is published as
+ * soon as its header is written, so producers only wait for each other
+ * for the length of a header write, never for a message to be filled.
+ * Without it, a single producer keeps a cached copy of head_.
+ *
+ * Messages are consumed in reservation order, so a message that is slow
+ * to commit holds back the ones reserved after it.
+ * */
+template <RingQueueFlag RQ_FLAGS, HSHM_CLASS_TEMPL>
+class msg_ring_base : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+  RING_QUEUE_DEFS
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef msg_ring_header header_t;
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer buf_;
+  hshm::u64 mask_;
+  char pad0_[HSHM_CACHE_LINE_SIZE];
+  /** Producer line: claimed and published ends, and a copy of head_ */
+  ipc::atomic<hshm::u64> reserve_;
+  ipc::atomic<hshm::u64> tail_;
+  hshm::u64 head_cache_;
+  char pad1_[HSHM_CACHE_LINE_SIZE - 2 * sizeof(ipc::atomic<hshm::u64>) -
+             sizeof(hshm::u64)];
+  /** Consumer line: the head and a copy of tail_ */
+  ipc::atomic<hshm::u64> head_;
+  hshm::u64 tail_cache_;
+  char pad2_[HSHM_CACHE_LINE_SIZE - sizeof(ipc::atomic<hshm::u64>) -
+             sizeof(hshm::u64)];
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit msg_ring_base(size_t capacity = KILOBYTES(64)) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), capacity);
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit msg_ring_base(const hipc::CtxAllocator<AllocT> &alloc,
+                         size_t capacity = KILOBYTES(64)) {
+    shm_init(alloc, capacity);
+  }
+
+  /** SHM Constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc,
+                size_t capacity = KILOBYTES(64)) {
+    init_shm_container(alloc);
+    SetNull();
+    AllocateBuffer(capacity);
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit msg_ring_base(const msg_ring_base &other) {
+    init_shm_container(other.GetCtxAllocator());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit msg_ring_base(const hipc::CtxAllocator<AllocT> &alloc,
+                         const msg_ring_base &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  msg_ring_base &operator=(const msg_ring_base &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** SHM copy constructor + operator main. Not safe under modification. */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const msg_ring_base &other) {
+    AllocateBuffer(other.GetCapacity());
+    memcpy(GetBuffer(), other.GetBuffer(), other.GetCapacity());
+    reserve_ = other.reserve_.load();
+    tail_ = other.tail_.load();
+    head_ = other.head_.load();
+    head_cache_ = head_.load();
+    tail_cache_ = tail_.load();
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  msg_ring_base(msg_ring_base &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  msg_ring_base(const hipc::CtxAllocator<AllocT> &alloc,
+                msg_ring_base &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  msg_ring_base &operator=(msg_ring_base &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  msg_ring_base &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      buf_ = other.buf_;
+      mask_ = other.mask_;
+      reserve_ = other.reserve_.load();
+      tail_ = other.tail_.load();
+      head_ = other.head_.load();
+      head_cache_ = head_.load();
+      tail_cache_ = tail_.load();
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    alloc->Free(alloc.ctx_, buf_);
+  }
+
+  /** Check if the ring is empty */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return buf_.IsNull(); }
+
+  /** Sets this ring as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {
+    buf_.SetNull();
+    mask_ = 0;
+    reserve_ = 0;
+    tail_ = 0;
+    head_cache_ = 0;
+    head_ = 0;
+    tail_cache_ = 0;
+  }
+
+  /**====================================
+   * Producer Methods
+   * ===================================*/
+
+  /**
+   * Reserve \a size contiguous bytes for a message. The message must be
+   * passed to commit() once it is written.
+   *
+   * @return the message buffer, or nullptr if the ring lacks the space
+   * */
+  HSHM_CROSS_FUN
+  char *reserve(size_t size) {
+    hshm::u64 capacity = mask_ + 1;
+    if (size > GetMaxMessageSize()) {
+      return nullptr;
+    }
+    hshm::u64 rec = RecordSize(size);
+    hshm::u64 pos, pad, end;
+    while (true) {
+      pos = reserve_.load(std::memory_order_relaxed);
+      hshm::u64 contig = capacity - (pos & mask_);
+      pad = rec > contig ? contig : 0;
+      end = pos + pad + rec;
+      if constexpr (IsPushAtomic) {
+        if (end - head_.load(std::memory_order_acquire) > capacity) {
+          return nullptr;
+        }
+        if (reserve_.compare_exchange_weak(pos, end,
+                                           std::memory_order_relaxed)) {
+          break;
+        }
+      } else {
+        if (end - head_cache_ > capacity) {
+          head_cache_ = head_.load(std::memory_order_acquire);
+          if (end - head_cache_ > capacity) {
+            return nullptr;
+          }
+        }
+        reserve_.store(end, std::memory_order_relaxed);
+        break;
+      }
+    }
+    char *buf = GetBuffer();
+    if (pad) {
+      header_t *hdr = reinterpret_cast<header_t *>(buf + (pos & mask_));
+      hdr->size_ = (hshm::u32)(pad - sizeof(header_t));
+      hdr->state_.store(header_t::kPad, std::memory_order_relaxed);
+    }
+    header_t *hdr = reinterpret_cast<header_t *>(buf + ((pos + pad) & mask_));
+    hdr->size_ = (hshm::u32)size;
+    hdr->state_.store(header_t::kBusy, std::memory_order_relaxed);
+    if constexpr (IsPushAtomic) {
+      // Publish claims in order, so the consumer only sees written headers
+      while (tail_.load(std::memory_order_acquire) != pos) {
+        HSHM_THREAD_MODEL->Yield();
+      }
+    }
+    tail_.store(end, std::memory_order_release);
+    return reinterpret_cast<char *>(hdr + 1);
+  }
+
+  /** Make a reserved message visible to the consumer */
+  HSHM_INLINE_CROSS_FUN
+  void commit(char *msg) {
+    header_t *hdr = reinterpret_cast<header_t *>(msg) - 1;
+    hdr->state_.store(header_t::kReady, std::memory_order_release);
+  }
+
+  /**
+   * Copy \a size bytes from \a data into a new message (wrapper).
+   *
+   * @return the offset of the message, or a null qtok if it lacks space
+   * */
+  HSHM_CROSS_FUN
+  qtok_t push(const void *data, size_t size) {
+    char *msg = reserve(size);
+    if (msg == nullptr) {
+      return qtok_t::GetNull();
+    }
+    memcpy(msg, data, size);
+    commit(msg);
+    return qtok_t(GetPosition(msg));
+  }
+
+  /**====================================
+   * Consumer Methods
+   * ===================================*/
+
+  /**
+   * Get the oldest message without removing it. Consumer only.
+   *
+   * @param size the length of the message
+   * @return the message, or nullptr if there is no committed message
+   * */
+  HSHM_CROSS_FUN
+  char *peek(size_t &size) {
+    char *buf = GetBuffer();
+    hshm::u64 head = head_.load(std::memory_order_relaxed);
+    while (true) {
+      if (head == tail_cache_) {
+        tail_cache_ = tail_.load(std::memory_order_acquire);
+        if (head == tail_cache_) {
+          return nullptr;
+        }
+      }
+      header_t *hdr = reinterpret_cast<header_t *>(buf + (head & mask_));
+      hshm::u32 state = hdr->state_.load(std::memory_order_acquire);
+      if (state == header_t::kPad) {
+        head += RecordSize(hdr->size_);
+        head_.store(head, std::memory_order_release);
+        continue;
+      }
+      if (state != header_t::kReady) {
+        return nullptr;
+      }
+      size = hdr->size_;
+      return reinterpret_cast<char *>(hdr + 1);
+    }
+  }
+
+  /** Remove the message returned by the last peek(). Consumer only. */
+  HSHM_CROSS_FUN
+  void release() {
+    hshm::u64 head = head_.load(std::memory_order_relaxed);
+    header_t *hdr =
+        reinterpret_cast<header_t *>(GetBuffer() + (head & mask_));
+    head_.store(head + RecordSize(hdr->size_), std::memory_order_release);
+  }
+
+  /**====================================
+   * Getters
+   * ===================================*/
+
+  /** Get the capacity of the ring in bytes */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetCapacity() const { return (size_t)(mask_ + 1); }
+
+  /**
+   * Get the largest message that can ever be reserved. Its record is
+   * half the buffer, so it fits whatever offset the ring wraps at.
+   * */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetMaxMessageSize() const {
+    return GetCapacity() / 2 - sizeof(header_t);
+  }
+
+  /** Get the bytes in use at this moment, including headers and padding */
+  HSHM_CROSS_FUN
+  size_t GetSize() const {
+    hshm::u64 head = head_.load();
+    hshm::u64 tail = tail_.load();
+    if (tail < head) {
+      return 0;
+    }
+    return (size_t)(tail - head);
+  }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() const { return GetSize(); }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t Size() const { return GetSize(); }
+
+ private:
+  /** Get the buffer */
+  HSHM_INLINE_CROSS_FUN char *GetBuffer() const {
+    return GetAllocator()->template Convert<char>(buf_);
+  }
+
+  /** Get the offset of a message's record in the buffer */
+  HSHM_INLINE_CROSS_FUN hshm::u64 GetPosition(char *msg) const {
+    return (hshm::u64)(msg - GetBuffer()) - sizeof(header_t);
+  }
+
+  /** Get the length of the record holding a \a size byte message */
+  HSHM_INLINE_CROSS_FUN static hshm::u64 RecordSize(size_t size) {
+    return (sizeof(header_t) + size + 7) & ~(hshm::u64)7;
+  }
+
+  /** Allocate at least \a capacity bytes, rounded up to a power of two */
+  HSHM_CROSS_FUN void AllocateBuffer(size_t capacity) {
+    size_t pow2 = HSHM_CACHE_LINE_SIZE;
+    while (pow2 < capacity) {
+      pow2 <<= 1;
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    buf_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, pow2);
+    if (buf_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, pow2,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    mask_ = pow2 - 1;
+    reserve_ = 0;
+    tail_ = 0;
+    head_cache_ = 0;
+    head_ = 0;
+    tail_cache_ = 0;
+  }
+};
+
+template <HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+using spsc_msg_ring =
+    msg_ring_base<RING_BUFFER_FIXED_SPSC_FLAGS, HSHM_CLASS_TEMPL_ARGS>;
+
+template <HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+using mpsc_msg_ring =
+    msg_ring_base<RING_BUFFER_FIXED_MPMC_FLAGS, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using spsc_msg_ring =
+    hipc::msg_ring_base<RING_BUFFER_FIXED_SPSC_FLAGS, HSHM_CLASS_TEMPL_ARGS>;
+
+template <HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using mpsc_msg_ring =
+    hipc::msg_ring_base<RING_BUFFER_FIXED_MPMC_FLAGS, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_MSG_RING_H_
@@ -0,0 +1,189 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_PARALLEL_SORT_H_
+#define HSHM_DATA_STRUCTURES_IPC_PARALLEL_SORT_H_
+
+#include <vector>
+
+#include "algorithm.h"
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/introspect/system_info.h"
+#include "hermes_shm/thread/thread_model_manager.h"
+
+namespace hshm {
+
+/** Ranges smaller than this are sorted on the calling thread */
+static const size_t kParallelSortMinSize = 1 << 14;
+
+/**
+ * Run func(rank) for rank in [0, nthreads) on threads of the default
+ * thread model. The caller runs rank 0.
+ * */
+template <typename FUNC>
+HSHM_HOST_FUN void parallel_for_ranks(int nthreads, FUNC &&func) {
+  auto *thread_model = HSHM_THREAD_MODEL;
+  ThreadGroup group = thread_model->CreateThreadGroup({});
+  std::vector<hshm::thread::Thread> threads;
+  threads.reserve(nthreads);
+  for (int rank = 1; rank < nthreads; ++rank) {
+    threads.emplace_back(
+        thread_model->Spawn(group, [&func, rank]() { func(rank); }));
+  }
+  func(0);
+  for (hshm::thread::Thread &thread : threads) {
+    thread_model->Join(thread);
+  }
+}
+
+/**
+ * The number of values from the sorted run \a a (of \a na values) among
+ * the first \a k values of its stable merge with the run \a b (of \a nb
+ * values). Binary search along the merge path.
+ * */
+template <typename IterA, typename IterB, typename CmpT>
+HSHM_HOST_FUN size_t merge_path_split(IterA a, size_t na, IterB b, size_t nb,
+                                      size_t k, CmpT &cmp) {
+  size_t lo = k > nb ? k - nb : 0;
+  size_t hi = k < na ? k : na;
+  while (lo < hi) {
+    size_t i = (lo + hi) / 2;
+    // Ties go to a, so a[i] is taken before b[k - i - 1] unless smaller
+    if (!cmp(*(b + (k - i - 1)), *(a + i))) {
+      lo = i + 1;
+    } else {
+      hi = i;
+    }
+  }
+  return lo;
+}
+
+/**
+ * Move values [out_lo, out_hi) of the stable merge of src runs
+ * [lo, mid) and [mid, hi) into the same positions of dst.
+ * */
+template <typename SrcIter, typename DstIter, typename CmpT>
+HSHM_HOST_FUN void merge_slice(SrcIter src, DstIter dst, size_t lo,
+                               size_t mid, size_t hi, size_t out_lo,
+                               size_t out_hi, CmpT &cmp) {
+  SrcIter a = src + lo;
+  SrcIter b = src + mid;
+  size_t na = mid - lo;
+  size_t nb = hi - mid;
+  size_t i = merge_path_split(a, na, b, nb, out_lo - lo, cmp);
+  size_t j = (out_lo - lo) - i;
+  DstIter out = dst + out_lo;
+  for (size_t k = out_lo; k < out_hi; ++k, ++out) {
+    if (i < na && (j >= nb || !cmp(*(b + j), *(a + i)))) {
+      *out = std::move(*(a + i));
+      ++i;
+    } else {
+      *out = std::move(*(b + j));
+      ++j;
+    }
+  }
+}
+
+/**
+ * Merge neighboring pairs of the sorted runs bounded by \a bounds from
+ * src into dst. A last unpaired run is moved as is. Each thread fills an
+ * equal share of dst, splitting pairs along the merge path, so the last
+ * rounds, which have few pairs, still use every thread.
+ * */
+template <typename SrcIter, typename DstIter, typename CmpT>
+HSHM_HOST_FUN void merge_round(SrcIter src, DstIter dst,
+                               const std::vector<size_t> &bounds,
+                               int nthreads, CmpT &cmp) {
+  size_t n = bounds.back();
+  parallel_for_ranks(nthreads, [&](int rank) {
+    size_t out_lo = n * rank / nthreads;
+    size_t out_hi = n * (rank + 1) / nthreads;
+    for (size_t r = 0; r + 1 < bounds.size(); r += 2) {
+      size_t lo = bounds[r];
+      size_t mid = bounds[r + 1];
+      size_t hi = r + 2 < bounds.size() ? bounds[r + 2] : mid;
+      size_t slice_lo = out_lo > lo ? out_lo : lo;
+      size_t slice_hi = out_hi < hi ? out_hi : hi;
+      if (slice_lo < slice_hi) {
+        merge_slice(src, dst, lo, mid, hi, slice_lo, slice_hi, cmp);
+      }
+    }
+  });
+}
+
+/**
+ * Sort a set of values on \a nthreads threads of the default thread
+ * model (0 means one per CPU). The range is split into one chunk per
+ * thread, chunks are sorted with hshm::sort in parallel, and then merged
+ * pairwise in log2(nthreads) parallel rounds through a private scratch
+ * buffer of the same size as the range. Not stable.
+ * */
+template <typename IterT, typename CmpT = LessThan<iterator_type_v<IterT>>>
+HSHM_HOST_FUN void parallel_sort(IterT start, const IterT &end,
+                                 int nthreads = 0,
+                                 CmpT &&cmp = HSHM_DEFAULT_SORT_CMP) {
+  using T = std::remove_cv_t<iterator_type_v<IterT>>;
+  size_t n = end - start;
+  if (nthreads <= 0) {
+    nthreads = HSHM_SYSTEM_INFO->ncpu_;
+  }
+  if (nthreads > 1 && n / nthreads < kParallelSortMinSize / 4) {
+    nthreads = (int)(n / (kParallelSortMinSize / 4));
+  }
+  if (nthreads <= 1 || n < kParallelSortMinSize) {
+    hshm::sort(start, end, cmp);
+    return;
+  }
+
+  // Sort one chunk per thread
+  std::vector<size_t> bounds(nthreads + 1);
+  for (int rank = 0; rank <= nthreads; ++rank) {
+    bounds[rank] = n * rank / nthreads;
+  }
+  parallel_for_ranks(nthreads, [&](int rank) {
+    hshm::sort(start + bounds[rank], start + bounds[rank + 1], cmp);
+  });
+
+  // Merge runs back and forth between the range and the buffer
+  std::vector<T> buf(n);
+  bool in_buf = false;
+  while (bounds.size() > 2) {
+    if (in_buf) {
+      merge_round(buf.begin(), start, bounds, nthreads, cmp);
+    } else {
+      merge_round(start, buf.begin(), bounds, nthreads, cmp);
+    }
+    in_buf = !in_buf;
+    std::vector<size_t> merged;
+    for (size_t r = 0; r < bounds.size(); r += 2) {
+      merged.emplace_back(bounds[r]);
+    }
+    if (merged.back() != n) {
+      merged.emplace_back(n);
+    }
+    bounds.swap(merged);
+  }
+  if (in_buf) {
+    parallel_for_ranks(nthreads, [&](int rank) {
+      size_t lo = n * rank / nthreads;
+      size_t hi = n * (rank + 1) / nthreads;
+      IterT out = start + lo;
+      for (size_t i = lo; i < hi; ++i, ++out) {
+        *out = std::move(buf[i]);
+      }
+    });
+  }
+}
+
+}  // namespace hshm
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_PARALLEL_SORT_H_
@@ -0,0 +1,319 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_PRIORITY_QUEUE_H_
+#define HSHM_DATA_STRUCTURES_IPC_PRIORITY_QUEUE_H_
+
+#include "functional.h"
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/types/qtok.h"
+#include "vector.h"
+
+namespace hshm::ipc {
+
+/** Forward declaration of priority_queue */
+template <typename T, typename CmpT = hshm::less<T>, int D = 4,
+          HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class priority_queue;
+
+/**
+ * MACROS used to simplify the priority_queue namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME priority_queue
+#define CLASS_NEW_ARGS T, CmpT, D
+
+/**
+ * A D-ary heap stored in a hipc::vector. Not thread-safe; see
+ * concurrent_priority_queue for concurrent use.
+ *
+ * As with std::priority_queue, CmpT(a, b) returns true when a has lower
+ * priority than b, so the default hshm::less puts the largest element on
+ * top. CmpT is default-constructed at each use and must be stateless, so
+ * that every process sharing the queue orders it the same way.
+ *
+ * A wider heap is shallower, so push does fewer moves and pop touches
+ * fewer cache lines per level. D = 4 keeps the children of a node within
+ * one or two lines for small T.
+ * */
+template <typename T, typename CmpT, int D, HSHM_CLASS_TEMPL>
+class priority_queue : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+  static_assert(D >= 2, "A heap node needs at least two children");
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef vector<T, HSHM_CLASS_TEMPL_ARGS> vector_t;
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  delay_ar<vector_t> heap_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  priority_queue() {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>());
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit priority_queue(const hipc::CtxAllocator<AllocT> &alloc) {
+    shm_init(alloc);
+  }
+
+  /** SHM Constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc) {
+    init_shm_container(alloc);
+    HSHM_MAKE_AR0(heap_, GetCtxAllocator());
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit priority_queue(const priority_queue &other) {
+    init_shm_container(other.GetCtxAllocator());
+    HSHM_MAKE_AR0(heap_, GetCtxAllocator());
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit priority_queue(const hipc::CtxAllocator<AllocT> &alloc,
+                          const priority_queue &other) {
+    init_shm_container(alloc);
+    HSHM_MAKE_AR0(heap_, GetCtxAllocator());
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  priority_queue &operator=(const priority_queue &other) {
+    if (this != &other) {
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** SHM copy constructor + operator main */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const priority_queue &other) {
+    (*heap_) = (*other.heap_);
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  priority_queue(priority_queue &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  priority_queue(const hipc::CtxAllocator<AllocT> &alloc,
+                 priority_queue &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  priority_queue &operator=(priority_queue &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  priority_queue &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      HSHM_MAKE_AR0(heap_, GetCtxAllocator());
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      (*heap_) = std::move(*other.heap_);
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() { (*heap_).shm_destroy(); }
+
+  /** Check if the queue is empty */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return (*heap_).IsNull(); }
+
+  /** Sets this queue as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {}
+
+  /**====================================
+   * Priority Queue Methods
+   * ===================================*/
+
+  /** Construct an element and move it up to its place in the heap */
+  template <typename... Args>
+  HSHM_CROSS_FUN void emplace(Args &&...args) {
+    vector_t &heap = *heap_;
+    heap.emplace_back(std::forward<Args>(args)...);
+    SiftUp(heap, heap.size() - 1);
+  }
+
+  /** Push an element in the queue (wrapper) */
+  template <typename... Args>
+  HSHM_INLINE_CROSS_FUN void push(Args &&...args) {
+    emplace(std::forward<Args>(args)...);
+  }
+
+  /** Get the element with the highest priority. The queue is not empty. */
+  HSHM_INLINE_CROSS_FUN
+  T &top() { return (*heap_)[0]; }
+
+  /** Get the element with the highest priority. The queue is not empty. */
+  HSHM_INLINE_CROSS_FUN
+  const T &top() const { return (*heap_)[0]; }
+
+  /**
+   * Pop the element with the highest priority.
+   *
+   * @return a null qtok if the queue is empty
+   * */
+  HSHM_CROSS_FUN
+  qtok_t pop(T &val) {
+    vector_t &heap = *heap_;
+    size_t size = heap.size();
+    if (size == 0) {
+      return qtok_t::GetNull();
+    }
+    val = std::move(heap[0]);
+    if (size > 1) {
+      // Fill the hole at the root with the last leaf
+      T last(std::move(heap[size - 1]));
+      heap.pop_back();
+      SiftDown(heap, 0, last);
+    } else {
+      heap.pop_back();
+    }
+    return qtok_t(size - 1);
+  }
+
+  /** Pop the element with the highest priority and discard it */
+  HSHM_CROSS_FUN
+  qtok_t pop() {
+    T val;
+    return pop(val);
+  }
+
+  /** Reserve space for \a size elements */
+  HSHM_INLINE_CROSS_FUN
+  void reserve(size_t size) { (*heap_).reserve(size); }
+
+  /** Remove every element */
+  HSHM_INLINE_CROSS_FUN
+  void clear() { (*heap_).clear(); }
+
+  /** Check if the queue has no elements */
+  HSHM_INLINE_CROSS_FUN
+  bool empty() const { return (*heap_).size() == 0; }
+
+  /** Get size */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetSize() const { return (*heap_).size(); }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() const { return GetSize(); }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t Size() const { return GetSize(); }
+
+ private:
+  /** Move the element at \a i up until its parent has higher priority */
+  HSHM_CROSS_FUN static void SiftUp(vector_t &heap, size_t i) {
+    CmpT cmp;
+    if (i == 0 || !cmp(heap[(i - 1) / D], heap[i])) {
+      return;
+    }
+    T val(std::move(heap[i]));
+    do {
+      size_t parent = (i - 1) / D;
+      heap[i] = std::move(heap[parent]);
+      i = parent;
+    } while (i > 0 && cmp(heap[(i - 1) / D], val));
+    heap[i] = std::move(val);
+  }
+
+  /** Place \a val in the hole at \a i, moving higher children up */
+  HSHM_CROSS_FUN static void SiftDown(vector_t &heap, size_t i, T &val) {
+    CmpT cmp;
+    size_t size = heap.size();
+    while (true) {
+      size_t first = D * i + 1;
+      if (first >= size) {
+        break;
+      }
+      size_t last = first + D < size ? first + D : size;
+      size_t best = first;
+      for (size_t c = first + 1; c < last; ++c) {
+        if (cmp(heap[best], heap[c])) {
+          best = c;
+        }
+      }
+      if (!cmp(val, heap[best])) {
+        break;
+      }
+      heap[i] = std::move(heap[best]);
+      i = best;
+    }
+    heap[i] = std::move(val);
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename T, typename CmpT = hshm::less<T>, int D = 4,
+          HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using priority_queue = hipc::priority_queue<T, CmpT, D, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_PRIORITY_QUEUE_H_
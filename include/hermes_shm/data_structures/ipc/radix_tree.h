@@ -0,0 +1,1079 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_RADIX_TREE_H_
+#define HSHM_DATA_STRUCTURES_RADIX_TREE_H_
+
+#include <cstring>
+
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/data_structures/ipc/flat_map.h"
+#include "hermes_shm/types/numbers.h"
+
+namespace hshm::ipc {
+
+/** forward pointer for radix_tree */
+template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class radix_tree;
+
+/**
+ * The header shared by all inner nodes of a radix_tree.
+ *
+ * Compressed paths are stored optimistically: only the first kMaxPrefix
+ * bytes of the prefix are kept in the node. Longer prefixes are read from
+ * the smallest leaf below the node, which stores its full key.
+ * */
+struct radix_tree_node {
+  CLS_CONST u8 kLeaf = 0;
+  CLS_CONST u8 kNode4 = 1;
+  CLS_CONST u8 kNode16 = 2;
+  CLS_CONST u8 kNode48 = 3;
+  CLS_CONST u8 kNode256 = 4;
+  CLS_CONST u32 kMaxPrefix = 8;
+
+  u8 type_;
+  u8 pad_;
+  u16 count_;       /**< The number of children (excluding end_) */
+  u32 prefix_len_;  /**< The length of the compressed path */
+  u8 prefix_[kMaxPrefix];
+  OffsetPointer end_; /**< The leaf of the key that ends at this node */
+};
+
+/** An inner node with up to 4 children, with keys in sorted order */
+struct radix_tree_node4 : public radix_tree_node {
+  u8 keys_[4];
+  OffsetPointer children_[4];
+};
+
+/** An inner node with up to 16 children, searched with SIMD */
+struct radix_tree_node16 : public radix_tree_node {
+  u8 keys_[16];
+  OffsetPointer children_[16];
+};
+
+/** An inner node with up to 48 children, indexed through a byte map */
+struct radix_tree_node48 : public radix_tree_node {
+  u8 index_[256]; /**< Child slot + 1, or 0 if the byte has no child */
+  OffsetPointer children_[48];
+};
+
+/** An inner node with a child slot for every byte */
+struct radix_tree_node256 : public radix_tree_node {
+  OffsetPointer children_[256];
+};
+
+/** A leaf of a radix_tree. The full key follows the leaf. */
+template <typename T>
+struct radix_tree_leaf {
+  u8 type_;
+  u32 key_len_;
+  delay_ar<T> val_;
+
+  /** Get the key stored after the leaf */
+  HSHM_INLINE_CROSS_FUN const u8 *GetKey() const {
+    return reinterpret_cast<const u8 *>(this + 1);
+  }
+
+  /** Whether the leaf stores \a key */
+  HSHM_INLINE_CROSS_FUN bool Matches(const u8 *key, size_t len) const {
+    return key_len_ == len && memcmp(GetKey(), key, len) == 0;
+  }
+};
+
+/**
+ * MACROS to simplify the radix_tree namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+
+#define CLASS_NAME radix_tree
+#define CLASS_NEW_ARGS T
+
+/**
+ * A map from byte-string keys to T stored as an adaptive radix tree (ART)
+ * in shared memory.
+ *
+ * Keys which share a prefix share the path to it, and runs of single-child
+ * nodes are compressed into the prefix of one node. Inner nodes grow and
+ * shrink between Node4, Node16, Node48 and Node256 layouts with their
+ * number of children. Node16 is searched 16 bytes at a time with SIMD.
+ *
+ * Keys are any type with data() and size(), such as hipc::string,
+ * hipc::chararr or std::string. Entries are visited in lexicographic byte
+ * order, and for_each_prefix visits the subtree under a prefix.
+ *
+ * Not thread-safe.
+ * */
+template <typename T, HSHM_CLASS_TEMPL>
+class radix_tree : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  using NODE_T = radix_tree_node;
+  using NODE4_T = radix_tree_node4;
+  using NODE16_T = radix_tree_node16;
+  using NODE48_T = radix_tree_node48;
+  using NODE256_T = radix_tree_node256;
+  using LEAF_T = radix_tree_leaf<T>;
+
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer root_;
+  size_t length_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** SHM constructor. Default allocator. */
+  HSHM_CROSS_FUN
+  radix_tree() {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>());
+  }
+
+  /** SHM constructor */
+  HSHM_CROSS_FUN
+  explicit radix_tree(const hipc::CtxAllocator<AllocT> &alloc) {
+    shm_init(alloc);
+  }
+
+  /** SHM constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc) {
+    init_shm_container(alloc);
+    SetNull();
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit radix_tree(const radix_tree &other) {
+    init_shm_container(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit radix_tree(const hipc::CtxAllocator<AllocT> &alloc,
+                      const radix_tree &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  radix_tree &operator=(const radix_tree &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** Internal copy operation */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const radix_tree &other) {
+    other.for_each([this](const char *key, size_t len, const T &val) {
+      insert<true>(reinterpret_cast<const u8 *>(key), len, val);
+    });
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  radix_tree(radix_tree &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  radix_tree(const hipc::CtxAllocator<AllocT> &alloc,
+             radix_tree &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  radix_tree &operator=(radix_tree &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  radix_tree &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      root_ = other.root_;
+      length_ = other.length_;
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** Check if the tree is empty */
+  HSHM_INLINE_CROSS_FUN bool IsNull() const { return root_.IsNull(); }
+
+  /** Sets this tree as empty */
+  HSHM_INLINE_CROSS_FUN void SetNull() {
+    root_.SetNull();
+    length_ = 0;
+  }
+
+  /** Destroy every node and leaf */
+  HSHM_CROSS_FUN void shm_destroy_main() { FreeSubtree(root_); }
+
+  /**====================================
+   * Emplace Methods
+   * ===================================*/
+
+  /**
+   * Construct an object directly in the tree. Overrides the object if
+   * key already exists.
+   *
+   * @param key the key (any type with data() and size())
+   * @param args the arguments to construct the object
+   * @return true
+   * */
+  template <typename StringT, typename... Args>
+  HSHM_CROSS_FUN bool emplace(const StringT &key, Args &&...args) {
+    return insert<true>(reinterpret_cast<const u8 *>(key.data()), key.size(),
+                        std::forward<Args>(args)...);
+  }
+
+  /**
+   * Construct an object directly in the tree. Does not modify the key
+   * if it already exists.
+   *
+   * @return true if the key was inserted
+   * */
+  template <typename StringT, typename... Args>
+  HSHM_CROSS_FUN bool try_emplace(const StringT &key, Args &&...args) {
+    return insert<false>(reinterpret_cast<const u8 *>(key.data()), key.size(),
+                         std::forward<Args>(args)...);
+  }
+
+  /**====================================
+   * Erase Methods
+   * ===================================*/
+
+  /**
+   * Erase the object indexed by \a key
+   *
+   * @return true if the key was present
+   * */
+  template <typename StringT>
+  HSHM_CROSS_FUN bool erase(const StringT &key) {
+    return erase_key(reinterpret_cast<const u8 *>(key.data()), key.size());
+  }
+
+  /** Erase the entire tree */
+  HSHM_CROSS_FUN void clear() {
+    FreeSubtree(root_);
+    SetNull();
+  }
+
+  /**====================================
+   * Index Methods
+   * ===================================*/
+
+  /**
+   * Find the object indexed by \a key
+   *
+   * @return a pointer to the object, or nullptr
+   * */
+  template <typename StringT>
+  HSHM_CROSS_FUN T *find(const StringT &key) const {
+    LEAF_T *leaf =
+        find_leaf(reinterpret_cast<const u8 *>(key.data()), key.size());
+    return leaf ? &leaf->val_.get_ref() : nullptr;
+  }
+
+  /** Check whether \a key is in the tree */
+  template <typename StringT>
+  HSHM_CROSS_FUN bool contains(const StringT &key) const {
+    return find_leaf(reinterpret_cast<const u8 *>(key.data()), key.size()) !=
+           nullptr;
+  }
+
+  /**
+   * Locate an object in the tree
+   *
+   * @exception UNORDERED_MAP_CANT_FIND the key was not in the tree
+   * */
+  template <typename StringT>
+  HSHM_CROSS_FUN T &operator[](const StringT &key) const {
+    T *val = find(key);
+    if (val == nullptr) {
+      HSHM_THROW_ERROR(UNORDERED_MAP_CANT_FIND);
+    }
+    return *val;
+  }
+
+  /**
+   * Call \a func(key, key_len, val) on every entry in lexicographic order
+   *
+   * @return the number of entries visited
+   * */
+  template <typename FUNC>
+  HSHM_CROSS_FUN size_t for_each(FUNC &&func) const {
+    return VisitSubtree(root_, func);
+  }
+
+  /**
+   * Call \a func(key, key_len, val) on every entry whose key starts with
+   * \a prefix, in lexicographic order
+   *
+   * @return the number of entries visited
+   * */
+  template <typename StringT, typename FUNC>
+  HSHM_CROSS_FUN size_t for_each_prefix(const StringT &prefix,
+                                        FUNC &&func) const {
+    const u8 *key = reinterpret_cast<const u8 *>(prefix.data());
+    size_t len = prefix.size();
+    OffsetPointer node_p = root_;
+    size_t depth = 0;
+    while (!node_p.IsNull()) {
+      if (TypeOf(node_p) == NODE_T::kLeaf) {
+        LEAF_T *leaf = GetLeaf(node_p);
+        if (leaf->key_len_ < len || memcmp(leaf->GetKey(), key, len) != 0) {
+          return 0;
+        }
+        return VisitSubtree(node_p, func);
+      }
+      NODE_T *node = GetNode(node_p);
+      for (size_t i = 0; i < node->prefix_len_; ++i) {
+        if (depth + i >= len) {
+          return VisitSubtree(node_p, func);
+        }
+        if (PrefixByte(node, depth, i) != key[depth + i]) {
+          return 0;
+        }
+      }
+      depth += node->prefix_len_;
+      if (depth >= len) {
+        return VisitSubtree(node_p, func);
+      }
+      OffsetPointer *child = FindChild(node, key[depth]);
+      if (child == nullptr) {
+        return 0;
+      }
+      node_p = *child;
+      ++depth;
+    }
+    return 0;
+  }
+
+  /**====================================
+   * Query Methods
+   * ===================================*/
+
+  /** The number of entries in the tree */
+  HSHM_INLINE_CROSS_FUN size_t size() const { return length_; }
+
+  /**====================================
+   * Internal Operations
+   * ===================================*/
+ private:
+  /** The type of the node or leaf at \a node_p */
+  HSHM_INLINE_CROSS_FUN u8 TypeOf(OffsetPointer node_p) const {
+    return *GetAllocator()->template Convert<u8>(node_p);
+  }
+
+  /** Get an inner node */
+  HSHM_INLINE_CROSS_FUN NODE_T *GetNode(OffsetPointer node_p) const {
+    return GetAllocator()->template Convert<NODE_T>(node_p);
+  }
+
+  /** Get a leaf */
+  HSHM_INLINE_CROSS_FUN LEAF_T *GetLeaf(OffsetPointer leaf_p) const {
+    return GetAllocator()->template Convert<LEAF_T>(leaf_p);
+  }
+
+  /** Allocate \a size bytes or throw */
+  HSHM_CROSS_FUN OffsetPointer AllocateBytes(size_t size) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer p = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    return p;
+  }
+
+  /** The size of an inner node of \a type */
+  HSHM_INLINE_CROSS_FUN static size_t NodeSize(u8 type) {
+    switch (type) {
+      case NODE_T::kNode4:
+        return sizeof(NODE4_T);
+      case NODE_T::kNode16:
+        return sizeof(NODE16_T);
+      case NODE_T::kNode48:
+        return sizeof(NODE48_T);
+      default:
+        return sizeof(NODE256_T);
+    }
+  }
+
+  /** Allocate an empty inner node of \a type */
+  HSHM_CROSS_FUN OffsetPointer NewNode(u8 type) {
+    size_t size = NodeSize(type);
+    OffsetPointer node_p = AllocateBytes(size);
+    NODE_T *node = GetNode(node_p);
+    memset(reinterpret_cast<void *>(node), 0, size);
+    node->type_ = type;
+    node->end_.SetNull();
+    if (type == NODE_T::kNode48) {
+      for (OffsetPointer &child : static_cast<NODE48_T *>(node)->children_) {
+        child.SetNull();
+      }
+    } else if (type == NODE_T::kNode256) {
+      for (OffsetPointer &child : static_cast<NODE256_T *>(node)->children_) {
+        child.SetNull();
+      }
+    }
+    return node_p;
+  }
+
+  /** Allocate a leaf holding \a key and a value built from \a args */
+  template <typename... Args>
+  HSHM_CROSS_FUN OffsetPointer NewLeaf(const u8 *key, size_t len,
+                                       Args &&...args) {
+    OffsetPointer leaf_p = AllocateBytes(sizeof(LEAF_T) + len);
+    LEAF_T *leaf = GetLeaf(leaf_p);
+    leaf->type_ = NODE_T::kLeaf;
+    leaf->key_len_ = (u32)len;
+    memcpy(const_cast<u8 *>(leaf->GetKey()), key, len);
+    HSHM_MAKE_AR(leaf->val_, GetCtxAllocator(), std::forward<Args>(args)...)
+    ++length_;
+    return leaf_p;
+  }
+
+  /** Destroy a subtree and return its memory to the allocator */
+  HSHM_CROSS_FUN void FreeSubtree(OffsetPointer node_p) {
+    if (node_p.IsNull()) {
+      return;
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    if (TypeOf(node_p) == NODE_T::kLeaf) {
+      GetLeaf(node_p)->val_.shm_destroy();
+    } else {
+      NODE_T *node = GetNode(node_p);
+      FreeSubtree(node->end_);
+      ForEachChild(node, [this](u8 byte, OffsetPointer child_p) {
+        FreeSubtree(child_p);
+      });
+    }
+    alloc->Free(alloc.ctx_, node_p);
+  }
+
+  /** The smallest leaf below \a node_p */
+  HSHM_CROSS_FUN LEAF_T *MinLeaf(OffsetPointer node_p) const {
+    while (TypeOf(node_p) != NODE_T::kLeaf) {
+      NODE_T *node = GetNode(node_p);
+      if (!node->end_.IsNull()) {
+        node_p = node->end_;
+        continue;
+      }
+      switch (node->type_) {
+        case NODE_T::kNode4:
+          node_p = static_cast<NODE4_T *>(node)->children_[0];
+          break;
+        case NODE_T::kNode16:
+          node_p = static_cast<NODE16_T *>(node)->children_[0];
+          break;
+        case NODE_T::kNode48: {
+          NODE48_T *node48 = static_cast<NODE48_T *>(node);
+          size_t byte = 0;
+          while (node48->index_[byte] == 0) {
+            ++byte;
+          }
+          node_p = node48->children_[node48->index_[byte] - 1];
+          break;
+        }
+        default: {
+          NODE256_T *node256 = static_cast<NODE256_T *>(node);
+          size_t byte = 0;
+          while (node256->children_[byte].IsNull()) {
+            ++byte;
+          }
+          node_p = node256->children_[byte];
+          break;
+        }
+      }
+    }
+    return GetLeaf(node_p);
+  }
+
+  /** Byte \a i of the prefix of \a node, which starts at \a depth */
+  HSHM_INLINE_CROSS_FUN u8 PrefixByte(NODE_T *node, size_t depth,
+                                      size_t i) const {
+    if (i < NODE_T::kMaxPrefix) {
+      return node->prefix_[i];
+    }
+    OffsetPointer node_p = GetAllocator()->template Convert<NODE_T, OffsetPointer>(node);
+    return MinLeaf(node_p)->GetKey()[depth + i];
+  }
+
+  /** Set the prefix of \a node from \a len bytes of \a bytes */
+  HSHM_INLINE_CROSS_FUN static void SetPrefix(NODE_T *node, const u8 *bytes,
+                                              size_t len) {
+    node->prefix_len_ = (u32)len;
+    memcpy(node->prefix_, bytes,
+           len < NODE_T::kMaxPrefix ? len : NODE_T::kMaxPrefix);
+  }
+
+  /** Find the child slot of \a byte, or nullptr */
+  HSHM_CROSS_FUN OffsetPointer *FindChild(NODE_T *node, u8 byte) const {
+    switch (node->type_) {
+      case NODE_T::kNode4: {
+        NODE4_T *node4 = static_cast<NODE4_T *>(node);
+        for (size_t i = 0; i < node4->count_; ++i) {
+          if (node4->keys_[i] == byte) {
+            return &node4->children_[i];
+          }
+        }
+        return nullptr;
+      }
+      case NODE_T::kNode16: {
+        NODE16_T *node16 = static_cast<NODE16_T *>(node);
+        FlatMapGroup group(reinterpret_cast<const i8 *>(node16->keys_));
+        u64 mask = group.Match((i8)byte);
+        if (node16->count_ < 16) {
+          mask &= ((u64)1 << (node16->count_ << FlatMapGroup::kShift)) - 1;
+        }
+        if (mask == 0) {
+          return nullptr;
+        }
+        return &node16->children_[FlatMapGroup::Slot(mask)];
+      }
+      case NODE_T::kNode48: {
+        NODE48_T *node48 = static_cast<NODE48_T *>(node);
+        u8 idx = node48->index_[byte];
+        return idx ? &node48->children_[idx - 1] : nullptr;
+      }
+      default: {
+        NODE256_T *node256 = static_cast<NODE256_T *>(node);
+        OffsetPointer *child = &node256->children_[byte];
+        return child->IsNull() ? nullptr : child;
+      }
+    }
+  }
+
+  /** Call \a func(byte, child) on every child in byte order */
+  template <typename FUNC>
+  HSHM_CROSS_FUN static void ForEachChild(NODE_T *node, FUNC &&func) {
+    switch (node->type_) {
+      case NODE_T::kNode4: {
+        NODE4_T *node4 = static_cast<NODE4_T *>(node);
+        for (size_t i = 0; i < node4->count_; ++i) {
+          func(node4->keys_[i], node4->children_[i]);
+        }
+        break;
+      }
+      case NODE_T::kNode16: {
+        NODE16_T *node16 = static_cast<NODE16_T *>(node);
+        for (size_t i = 0; i < node16->count_; ++i) {
+          func(node16->keys_[i], node16->children_[i]);
+        }
+        break;
+      }
+      case NODE_T::kNode48: {
+        NODE48_T *node48 = static_cast<NODE48_T *>(node);
+        for (size_t byte = 0; byte < 256; ++byte) {
+          if (node48->index_[byte]) {
+            func((u8)byte, node48->children_[node48->index_[byte] - 1]);
+          }
+        }
+        break;
+      }
+      default: {
+        NODE256_T *node256 = static_cast<NODE256_T *>(node);
+        for (size_t byte = 0; byte < 256; ++byte) {
+          if (!node256->children_[byte].IsNull()) {
+            func((u8)byte, node256->children_[byte]);
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  /** Insert \a byte into a sorted key array of \a count entries */
+  HSHM_INLINE_CROSS_FUN static void InsertSorted(u8 *keys,
+                                                 OffsetPointer *children,
+                                                 size_t count, u8 byte,
+                                                 OffsetPointer child_p) {
+    size_t i = 0;
+    while (i < count && keys[i] < byte) {
+      ++i;
+    }
+    memmove(keys + i + 1, keys + i, count - i);
+    memmove((void *)(children + i + 1), (const void *)(children + i),
+            (count - i) * sizeof(OffsetPointer));
+    keys[i] = byte;
+    children[i] = child_p;
+  }
+
+  /** Copy the header of \a src into a node of a different type */
+  HSHM_INLINE_CROSS_FUN static void CopyHeader(NODE_T *dst, NODE_T *src) {
+    dst->count_ = src->count_;
+    dst->prefix_len_ = src->prefix_len_;
+    memcpy(dst->prefix_, src->prefix_, NODE_T::kMaxPrefix);
+    dst->end_ = src->end_;
+  }
+
+  /**
+   * Add a child to the node in \a slot, growing it to the next layout if
+   * it is full
+   * */
+  HSHM_CROSS_FUN void AddChild(OffsetPointer &slot, u8 byte,
+                               OffsetPointer child_p) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    NODE_T *node = GetNode(slot);
+    switch (node->type_) {
+      case NODE_T::kNode4: {
+        NODE4_T *node4 = static_cast<NODE4_T *>(node);
+        if (node4->count_ < 4) {
+          InsertSorted(node4->keys_, node4->children_, node4->count_, byte,
+                       child_p);
+          ++node4->count_;
+          return;
+        }
+        OffsetPointer grown_p = NewNode(NODE_T::kNode16);
+        NODE16_T *grown = static_cast<NODE16_T *>(GetNode(grown_p));
+        CopyHeader(grown, node4);
+        memcpy(grown->keys_, node4->keys_, 4);
+        memcpy((void *)grown->children_, (const void *)node4->children_,
+               4 * sizeof(OffsetPointer));
+        alloc->Free(alloc.ctx_, slot);
+        slot = grown_p;
+        AddChild(slot, byte, child_p);
+        return;
+      }
+      case NODE_T::kNode16: {
+        NODE16_T *node16 = static_cast<NODE16_T *>(node);
+        if (node16->count_ < 16) {
+          InsertSorted(node16->keys_, node16->children_, node16->count_, byte,
+                       child_p);
+          ++node16->count_;
+          return;
+        }
+        OffsetPointer grown_p = NewNode(NODE_T::kNode48);
+        NODE48_T *grown = static_cast<NODE48_T *>(GetNode(grown_p));
+        CopyHeader(grown, node16);
+        for (size_t i = 0; i < 16; ++i) {
+          grown->children_[i] = node16->children_[i];
+          grown->index_[node16->keys_[i]] = (u8)(i + 1);
+        }
+        alloc->Free(alloc.ctx_, slot);
+        slot = grown_p;
+        AddChild(slot, byte, child_p);
+        return;
+      }
+      case NODE_T::kNode48: {
+        NODE48_T *node48 = static_cast<NODE48_T *>(node);
+        if (node48->count_ < 48) {
+          size_t i = 0;
+          while (!node48->children_[i].IsNull()) {
+            ++i;
+          }
+          node48->children_[i] = child_p;
+          node48->index_[byte] = (u8)(i + 1);
+          ++node48->count_;
+          return;
+        }
+        OffsetPointer grown_p = NewNode(NODE_T::kNode256);
+        NODE256_T *grown = static_cast<NODE256_T *>(GetNode(grown_p));
+        CopyHeader(grown, node48);
+        for (size_t b = 0; b < 256; ++b) {
+          if (node48->index_[b]) {
+            grown->children_[b] = node48->children_[node48->index_[b] - 1];
+          }
+        }
+        alloc->Free(alloc.ctx_, slot);
+        slot = grown_p;
+        AddChild(slot, byte, child_p);
+        return;
+      }
+      default: {
+        NODE256_T *node256 = static_cast<NODE256_T *>(node);
+        node256->children_[byte] = child_p;
+        ++node256->count_;
+        return;
+      }
+    }
+  }
+
+  /**
+   * Remove the child of \a byte from the node in \a slot, shrinking it to
+   * the previous layout once it is sparse enough
+   * */
+  HSHM_CROSS_FUN void RemoveChild(OffsetPointer &slot, u8 byte) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    NODE_T *node = GetNode(slot);
+    switch (node->type_) {
+      case NODE_T::kNode4:
+      case NODE_T::kNode16: {
+        u8 *keys;
+        OffsetPointer *children;
+        if (node->type_ == NODE_T::kNode4) {
+          keys = static_cast<NODE4_T *>(node)->keys_;
+          children = static_cast<NODE4_T *>(node)->children_;
+        } else {
+          keys = static_cast<NODE16_T *>(node)->keys_;
+          children = static_cast<NODE16_T *>(node)->children_;
+        }
+        size_t i = 0;
+        while (keys[i] != byte) {
+          ++i;
+        }
+        size_t count = node->count_;
+        memmove(keys + i, keys + i + 1, count - i - 1);
+        memmove((void *)(children + i), (const void *)(children + i + 1),
+                (count - i - 1) * sizeof(OffsetPointer));
+        --node->count_;
+        if (node->type_ == NODE_T::kNode16 && node->count_ <= 3) {
+          OffsetPointer shrunk_p = NewNode(NODE_T::kNode4);
+          NODE4_T *shrunk = static_cast<NODE4_T *>(GetNode(shrunk_p));
+          CopyHeader(shrunk, node);
+          memcpy(shrunk->keys_, keys, node->count_);
+          memcpy((void *)shrunk->children_, (const void *)children,
+                 node->count_ * sizeof(OffsetPointer));
+          alloc->Free(alloc.ctx_, slot);
+          slot = shrunk_p;
+        }
+        return;
+      }
+      case NODE_T::kNode48: {
+        NODE48_T *node48 = static_cast<NODE48_T *>(node);
+        node48->children_[node48->index_[byte] - 1].SetNull();
+        node48->index_[byte] = 0;
+        --node48->count_;
+        if (node48->count_ <= 12) {
+          OffsetPointer shrunk_p = NewNode(NODE_T::kNode16);
+          NODE16_T *shrunk = static_cast<NODE16_T *>(GetNode(shrunk_p));
+          CopyHeader(shrunk, node48);
+          size_t n = 0;
+          for (size_t b = 0; b < 256; ++b) {
+            if (node48->index_[b]) {
+              shrunk->keys_[n] = (u8)b;
+              shrunk->children_[n++] = node48->children_[node48->index_[b] - 1];
+            }
+          }
+          alloc->Free(alloc.ctx_, slot);
+          slot = shrunk_p;
+        }
+        return;
+      }
+      default: {
+        NODE256_T *node256 = static_cast<NODE256_T *>(node);
+        node256->children_[byte].SetNull();
+        --node256->count_;
+        if (node256->count_ <= 37) {
+          OffsetPointer shrunk_p = NewNode(NODE_T::kNode48);
+          NODE48_T *shrunk = static_cast<NODE48_T *>(GetNode(shrunk_p));
+          CopyHeader(shrunk, node256);
+          size_t n = 0;
+          for (size_t b = 0; b < 256; ++b) {
+            if (!node256->children_[b].IsNull()) {
+              shrunk->children_[n] = node256->children_[b];
+              shrunk->index_[b] = (u8)(++n);
+            }
+          }
+          alloc->Free(alloc.ctx_, slot);
+          slot = shrunk_p;
+        }
+        return;
+      }
+    }
+  }
+
+  /** Attach \a leaf_p, whose key continues at \a depth, below \a slot */
+  HSHM_CROSS_FUN void AttachLeaf(OffsetPointer &slot, OffsetPointer leaf_p,
+                                 size_t depth) {
+    LEAF_T *leaf = GetLeaf(leaf_p);
+    if (leaf->key_len_ == depth) {
+      GetNode(slot)->end_ = leaf_p;
+    } else {
+      AddChild(slot, leaf->GetKey()[depth], leaf_p);
+    }
+  }
+
+  /**
+   * Insert a (key, value) pair in the tree
+   *
+   * @param modify_existing whether or not to override an existing entry
+   * */
+  template <bool modify_existing, typename... Args>
+  HSHM_CROSS_FUN bool insert(const u8 *key, size_t len, Args &&...args) {
+    OffsetPointer *slot = &root_;
+    size_t depth = 0;
+    while (true) {
+      if (slot->IsNull()) {
+        *slot = NewLeaf(key, len, std::forward<Args>(args)...);
+        return true;
+      }
+
+      // Replace a leaf with a node holding both keys
+      if (TypeOf(*slot) == NODE_T::kLeaf) {
+        LEAF_T *leaf = GetLeaf(*slot);
+        if (leaf->Matches(key, len)) {
+          if constexpr (!modify_existing) {
+            return false;
+          } else {
+            leaf->val_.shm_destroy();
+            HSHM_MAKE_AR(leaf->val_, GetCtxAllocator(),
+                         std::forward<Args>(args)...)
+            return true;
+          }
+        }
+        size_t max = (leaf->key_len_ < len ? leaf->key_len_ : len) - depth;
+        size_t common = 0;
+        while (common < max &&
+               leaf->GetKey()[depth + common] == key[depth + common]) {
+          ++common;
+        }
+        OffsetPointer old_p = *slot;
+        *slot = NewNode(NODE_T::kNode4);
+        SetPrefix(GetNode(*slot), key + depth, common);
+        AttachLeaf(*slot, old_p, depth + common);
+        AttachLeaf(*slot, NewLeaf(key, len, std::forward<Args>(args)...),
+                   depth + common);
+        return true;
+      }
+
+      // Split the compressed path where the key diverges from it
+      NODE_T *node = GetNode(*slot);
+      size_t plen = node->prefix_len_;
+      size_t mismatch = 0;
+      while (mismatch < plen && depth + mismatch < len &&
+             PrefixByte(node, depth, mismatch) == key[depth + mismatch]) {
+        ++mismatch;
+      }
+      if (mismatch < plen) {
+        u8 rest[NODE_T::kMaxPrefix];
+        size_t rest_len = plen - mismatch - 1;
+        u8 old_byte = PrefixByte(node, depth, mismatch);
+        for (size_t i = 0; i < rest_len && i < NODE_T::kMaxPrefix; ++i) {
+          rest[i] = PrefixByte(node, depth, mismatch + 1 + i);
+        }
+        OffsetPointer old_p = *slot;
+        SetPrefix(node, rest, rest_len);
+        *slot = NewNode(NODE_T::kNode4);
+        SetPrefix(GetNode(*slot), key + depth, mismatch);
+        AddChild(*slot, old_byte, old_p);
+        AttachLeaf(*slot, NewLeaf(key, len, std::forward<Args>(args)...),
+                   depth + mismatch);
+        return true;
+      }
+      depth += plen;
+
+      // Descend to the child of the next byte
+      if (depth == len) {
+        if (node->end_.IsNull()) {
+          node->end_ = NewLeaf(key, len, std::forward<Args>(args)...);
+          return true;
+        }
+        slot = &node->end_;
+        continue;
+      }
+      OffsetPointer *child = FindChild(node, key[depth]);
+      if (child == nullptr) {
+        AddChild(*slot, key[depth],
+                 NewLeaf(key, len, std::forward<Args>(args)...));
+        return true;
+      }
+      slot = child;
+      ++depth;
+    }
+  }
+
+  /**
+   * Find the leaf of \a key. Prefixes are compared optimistically (only
+   * the stored bytes) and the full key is checked at the leaf.
+   * */
+  HSHM_CROSS_FUN LEAF_T *find_leaf(const u8 *key, size_t len) const {
+    OffsetPointer node_p = root_;
+    size_t depth = 0;
+    while (!node_p.IsNull()) {
+      if (TypeOf(node_p) == NODE_T::kLeaf) {
+        LEAF_T *leaf = GetLeaf(node_p);
+        return leaf->Matches(key, len) ? leaf : nullptr;
+      }
+      NODE_T *node = GetNode(node_p);
+      size_t plen = node->prefix_len_;
+      if (depth + plen > len) {
+        return nullptr;
+      }
+      size_t stored = plen < NODE_T::kMaxPrefix ? plen : NODE_T::kMaxPrefix;
+      if (memcmp(node->prefix_, key + depth, stored) != 0) {
+        return nullptr;
+      }
+      depth += plen;
+      if (depth == len) {
+        node_p = node->end_;
+        continue;
+      }
+      OffsetPointer *child = FindChild(node, key[depth]);
+      if (child == nullptr) {
+        return nullptr;
+      }
+      node_p = *child;
+      ++depth;
+    }
+    return nullptr;
+  }
+
+  /** Erase the leaf of \a key and collapse nodes left with one entry */
+  HSHM_CROSS_FUN bool erase_key(const u8 *key, size_t len) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer *parent_slot = nullptr;
+    OffsetPointer *slot = &root_;
+    size_t depth = 0;
+    u8 byte = 0;
+    while (!slot->IsNull() && TypeOf(*slot) != NODE_T::kLeaf) {
+      NODE_T *node = GetNode(*slot);
+      depth += node->prefix_len_;
+      if (depth > len) {
+        return false;
+      }
+      parent_slot = slot;
+      if (depth == len) {
+        slot = &node->end_;
+        continue;
+      }
+      byte = key[depth];
+      slot = FindChild(node, byte);
+      if (slot == nullptr) {
+        return false;
+      }
+      ++depth;
+    }
+    if (slot->IsNull() || !GetLeaf(*slot)->Matches(key, len)) {
+      return false;
+    }
+
+    // Unlink and free the leaf
+    OffsetPointer leaf_p = *slot;
+    GetLeaf(leaf_p)->val_.shm_destroy();
+    alloc->Free(alloc.ctx_, leaf_p);
+    --length_;
+    if (parent_slot == nullptr) {
+      root_.SetNull();
+      return true;
+    }
+    NODE_T *parent = GetNode(*parent_slot);
+    if (slot == &parent->end_) {
+      parent->end_.SetNull();
+    } else {
+      RemoveChild(*parent_slot, byte);
+      parent = GetNode(*parent_slot);
+    }
+
+    // Collapse a Node4 which is left with a single entry
+    if (parent->type_ != NODE_T::kNode4) {
+      return true;
+    }
+    NODE4_T *node4 = static_cast<NODE4_T *>(parent);
+    if (node4->count_ == 0 && !node4->end_.IsNull()) {
+      OffsetPointer end_p = node4->end_;
+      alloc->Free(alloc.ctx_, *parent_slot);
+      *parent_slot = end_p;
+    } else if (node4->count_ == 1 && node4->end_.IsNull()) {
+      OffsetPointer child_p = node4->children_[0];
+      if (TypeOf(child_p) != NODE_T::kLeaf) {
+        // Merge the paths: parent prefix + edge byte + child prefix
+        NODE_T *child = GetNode(child_p);
+        u8 merged[NODE_T::kMaxPrefix];
+        size_t n = 0;
+        for (size_t i = 0; i < node4->prefix_len_ && n < NODE_T::kMaxPrefix;
+             ++i) {
+          merged[n++] = node4->prefix_[i];
+        }
+        if (n < NODE_T::kMaxPrefix) {
+          merged[n++] = node4->keys_[0];
+        }
+        for (size_t i = 0; i < child->prefix_len_ && n < NODE_T::kMaxPrefix;
+             ++i) {
+          merged[n++] = child->prefix_[i];
+        }
+        size_t merged_len = node4->prefix_len_ + 1 + child->prefix_len_;
+        child->prefix_len_ = (u32)merged_len;
+        memcpy(child->prefix_, merged, n);
+      }
+      alloc->Free(alloc.ctx_, *parent_slot);
+      *parent_slot = child_p;
+    }
+    return true;
+  }
+
+  /** Visit every leaf below \a node_p in order */
+  template <typename FUNC>
+  HSHM_CROSS_FUN size_t VisitSubtree(OffsetPointer node_p, FUNC &func) const {
+    if (node_p.IsNull()) {
+      return 0;
+    }
+    if (TypeOf(node_p) == NODE_T::kLeaf) {
+      LEAF_T *leaf = GetLeaf(node_p);
+      func(reinterpret_cast<const char *>(leaf->GetKey()),
+           (size_t)leaf->key_len_, leaf->val_.get_ref());
+      return 1;
+    }
+    NODE_T *node = GetNode(node_p);
+    size_t count = VisitSubtree(node->end_, func);
+    ForEachChild(node, [this, &func, &count](u8 byte, OffsetPointer child_p) {
+      count += VisitSubtree(child_p, func);
+    });
+    return count;
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using radix_tree = hipc::radix_tree<T, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_RADIX_TREE_H_
@@ -54,6 +54,8 @@ class ring_queue_base : public ShmContainer {
   hipc::opt_atomic<qtok_id, IsPushAtomic> tail_;
   hipc::opt_atomic<qtok_id, IsPopAtomic> head_;
   ibitfield flags_;
+  Futex not_empty_;
+  Futex not_full_;
 
  public:
   /**====================================
@@ -82,6 +84,8 @@ class ring_queue_base : public ShmContainer {
     init_shm_container(alloc);
     HSHM_MAKE_AR(queue_, GetCtxAllocator(), depth, std::forward<Args>(args)...);
     flags_.Clear();
+    not_empty_.Init();
+    not_full_.Init();
     SetNull();
   }
 
@@ -213,14 +217,7 @@ class ring_queue_base : public ShmContainer {
     if constexpr (WaitForSpace) {
       size_t size = tail - head + 1;
       if (size > queue.size()) {
-        while (true) {
-          head = head_.load();
-          size = tail - head + 1;
-          if (size <= GetDepth()) {
-            break;
-          }
-          HSHM_THREAD_MODEL->Yield();
-        }
+        WaitForTail(tail + 1);
       }
     } else if constexpr (ErrorOnNoSpace) {
       qtok_id size = tail - head + 1;
@@ -238,12 +235,16 @@ class ring_queue_base : public ShmContainer {
     // Emplace into queue at our slot
     uint32_t idx = tail % queue.size();
     auto iter = queue.begin() + idx;
+    WaitForSlot(*iter);
     queue.replace(iter, hshm::PiecewiseConstruct(), make_argpack(),
                   make_argpack(std::forward<Args>(args)...));
 
     // Let pop know that the data is fully prepared
     pair_t &entry = (*iter);
-    entry.GetFirst().SetBits(1);
+    Publish(entry, tail);
+    if constexpr (Notify) {
+      not_empty_.Notify();
+    }
     return qtok_t(tail);
   }
 
@@ -253,6 +254,185 @@ class ring_queue_base : public ShmContainer {
     return emplace(std::forward<Args>(args)...);
   }
 
+  /**
+   * Construct \a n elements at the tail, copying or moving from \a first.
+   * The slots are reserved with a single update of tail_, and the batch
+   * becomes visible to pop at once: the first slot is marked valid last.
+   *
+   * At most GetDepth() slots are reserved at a time, so a burst larger
+   * than a circular queue keeps its newest GetDepth() elements, as \a n
+   * single pushes would.
+   *
+   * @return the number of elements pushed. This is less than \a n only
+   * if the queue errors on no space and became full.
+   * */
+  template <typename IterT>
+  HSHM_CROSS_FUN size_t emplace_n(IterT first, size_t n) {
+    size_t pushed = 0;
+    while (pushed < n) {
+      size_t count = n - pushed;
+      qtok_id tail;
+      if constexpr (ErrorOnNoSpace) {
+        // Reserve at most the free slots
+        tail = tail_.load();
+        while (true) {
+          qtok_id head = head_.load();
+          size_t used = tail > head ? (size_t)(tail - head) : 0;
+          if (used >= GetDepth()) {
+            return pushed;
+          }
+          count = count < GetDepth() - used ? count : GetDepth() - used;
+          if (tail_.compare_exchange_weak(tail, tail + count)) {
+            break;
+          }
+        }
+      } else {
+        if constexpr (DynamicSize) {
+          size_t size = GetSize() + count;
+          if (size > GetDepth()) {
+            resize(size > 2 * GetDepth() ? size : 2 * GetDepth());
+          }
+        }
+        count = count < GetDepth() ? count : GetDepth();
+        tail = tail_.fetch_add(qtok_id(count));
+        if constexpr (WaitForSpace) {
+          WaitForTail(tail + count);
+        }
+      }
+
+      // Fill the slots. The first slot is marked valid last.
+      vector_t &queue = (*queue_);
+      size_t depth = queue.size();
+      size_t idx = tail % depth;
+      size_t first_idx = idx;
+      for (size_t i = 0; i < count; ++i, ++first) {
+        auto iter = queue.begin() + idx;
+        WaitForSlot(*iter);
+        queue.replace(iter, hshm::PiecewiseConstruct(), make_argpack(),
+                      make_argpack(*first));
+        if (i > 0) {
+          Publish(*iter, tail + i);
+        }
+        if (++idx == depth) {
+          idx = 0;
+        }
+      }
+      std::atomic_thread_fence(std::memory_order_release);
+      Publish(queue[first_idx], tail);
+      if constexpr (Notify) {
+        not_empty_.Notify((int)count);
+      }
+      pushed += count;
+    }
+    return pushed;
+  }
+
+  /** Push \a n elements from \a vals (wrapper) */
+  HSHM_INLINE_CROSS_FUN size_t push_n(const T *vals, size_t n) {
+    return emplace_n(vals, n);
+  }
+
+  /**
+   * Construct an element at the tail, sleeping while the queue is full.
+   * Requires RqFlag::kNotify so that consumers wake the sleeper.
+   *
+   * @param timeout_us the maximum time to wait. Negative waits forever.
+   * @return the token of the element, or null on timeout
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN qtok_t emplace_wait(double timeout_us, Args &&...args) {
+    static_assert(Notify, "emplace_wait requires RqFlag::kNotify");
+    qtok_t tok = qtok_t::GetNull();
+    if constexpr (ErrorOnNoSpace) {
+      not_full_.WaitUntil(
+          [&]() {
+            tok = emplace(std::forward<Args>(args)...);
+            return !tok.IsNull();
+          },
+          timeout_us);
+    } else {
+      // emplace itself sleeps once its slot is reserved, so only wait
+      // for space here to honor the timeout
+      bool has_space = not_full_.WaitUntil(
+          [&]() { return GetSize() < GetDepth(); }, timeout_us);
+      if (has_space) {
+        tok = emplace(std::forward<Args>(args)...);
+      }
+    }
+    return tok;
+  }
+
+  /** Push an element, sleeping while the queue is full (wrapper) */
+  HSHM_INLINE_CROSS_FUN qtok_t push_wait(const T &val,
+                                         double timeout_us = -1) {
+    return emplace_wait(timeout_us, val);
+  }
+
+  /**
+   * Pop up to \a max elements from the head into \a out. The run of
+   * published slots at the head is claimed with a single CAS on head_
+   * before any of them is read, so concurrent consumers never pop the
+   * same element. A slot only counts as published if it is stamped with
+   * its own token, which a stale stamp from the previous lap is not.
+   * Elements a circular queue has overwritten are skipped.
+   *
+   * @return the number of elements popped
+   * */
+  HSHM_CROSS_FUN
+  size_t pop_n(T *out, size_t max) {
+    vector_t &queue = (*queue_);
+    size_t depth = queue.size();
+    qtok_id head = head_.load();
+    size_t count;
+    while (true) {
+      qtok_id tail = tail_.load();
+      if (head >= tail) {
+        return 0;
+      }
+      if constexpr (!WaitForSpace && !ErrorOnNoSpace && !DynamicSize) {
+        if (tail - head > depth) {
+          qtok_id oldest = tail - depth;
+          if (head_.compare_exchange_weak(head, oldest)) {
+            head = oldest;
+          }
+          continue;
+        }
+      }
+      size_t avail = (size_t)(tail - head);
+      avail = avail < max ? avail : max;
+      size_t idx = head % depth;
+      for (count = 0; count < avail; ++count) {
+        if (queue[idx].GetFirst().bits_.load() != Stamp(head + count)) {
+          break;
+        }
+        if (++idx == depth) {
+          idx = 0;
+        }
+      }
+      if (count == 0) {
+        return 0;
+      }
+      if (head_.compare_exchange_weak(head, head + count)) {
+        break;
+      }
+    }
+
+    // The slots are ours. Producers wait for them to be cleared.
+    size_t idx = head % depth;
+    for (size_t i = 0; i < count; ++i) {
+      pair_t &entry = queue[idx];
+      out[i] = std::move(entry.GetSecond());
+      entry.GetFirst().Clear();
+      if (++idx == depth) {
+        idx = 0;
+      }
+    }
+    if constexpr (Notify) {
+      not_full_.NotifyAll();
+    }
+    return count;
+  }
+
   /** Consumer pops the head object */
   HSHM_CROSS_FUN
   qtok_t pop(T &val) {
@@ -270,6 +450,9 @@ class ring_queue_base : public ShmContainer {
       val = std::move(entry.GetSecond());
       entry.GetFirst().Clear();
       head_.fetch_add(1);
+      if constexpr (Notify) {
+        not_full_.NotifyAll();
+      }
       return qtok_t(head);
     } else {
       return qtok_t::GetNull();
@@ -292,12 +475,36 @@ class ring_queue_base : public ShmContainer {
     if (entry.GetFirst().Any(1)) {
       entry.GetFirst().Clear();
       head_.fetch_add(1);
+      if constexpr (Notify) {
+        not_full_.NotifyAll();
+      }
       return qtok_t(head);
     } else {
       return qtok_t::GetNull();
     }
   }
 
+  /**
+   * Pop the head object, sleeping while the queue is empty. Requires
+   * RqFlag::kNotify so that producers wake the sleeper.
+   *
+   * @param val the popped object
+   * @param timeout_us the maximum time to wait. Negative waits forever.
+   * @return the token of the popped object, or null on timeout
+   * */
+  HSHM_CROSS_FUN
+  qtok_t pop_wait(T &val, double timeout_us = -1) {
+    static_assert(Notify, "pop_wait requires RqFlag::kNotify");
+    qtok_t tok = qtok_t::GetNull();
+    not_empty_.WaitUntil(
+        [&]() {
+          tok = pop(val);
+          return !tok.IsNull();
+        },
+        timeout_us);
+    return tok;
+  }
+
   /** Consumer pops the tail object */
   HSHM_CROSS_FUN
   qtok_t pop_back(T &val) {
@@ -316,6 +523,9 @@ class ring_queue_base : public ShmContainer {
       val = std::move(entry.GetSecond());
       entry.GetFirst().Clear();
       tail_.fetch_sub(1);
+      if constexpr (Notify) {
+        not_full_.NotifyAll();
+      }
       return qtok_t(tail);
     } else {
       return qtok_t::GetNull();
@@ -389,6 +599,43 @@ class ring_queue_base : public ShmContainer {
   /** Get size (wrapper) */
   HSHM_INLINE_CROSS_FUN
   size_t Size() { return GetSize(); }
+
+ private:
+  /** The valid bits of the slot holding token \a tok */
+  HSHM_INLINE_CROSS_FUN
+  static qtok_id Stamp(qtok_id tok) { return (tok << 1) | 1; }
+
+  /** Mark \a entry, which holds token \a tok, valid for pop */
+  HSHM_INLINE_CROSS_FUN
+  void Publish(pair_t &entry, qtok_id tok) {
+    entry.GetFirst().bits_ = Stamp(tok);
+  }
+
+  /**
+   * Wait until a consumer that claimed \a entry with pop_n has moved it
+   * out. Circular queues overwrite the slot instead.
+   * */
+  HSHM_INLINE_CROSS_FUN
+  void WaitForSlot(pair_t &entry) {
+    if constexpr (WaitForSpace || ErrorOnNoSpace) {
+      while (entry.GetFirst().Any(1)) {
+        HSHM_THREAD_MODEL->Yield();
+      }
+    }
+  }
+
+  /** Wait until the slots before \a tail fit in the queue */
+  HSHM_INLINE_CROSS_FUN
+  void WaitForTail(qtok_id tail) {
+    if constexpr (Notify) {
+      not_full_.WaitUntil(
+          [&]() { return tail - head_.load() <= GetDepth(); });
+    } else {
+      while (tail - head_.load() > GetDepth()) {
+        HSHM_THREAD_MODEL->Yield();
+      }
+    }
+  }
 };
 
 template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
@@ -419,6 +666,19 @@ template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
 using ext_ring_buffer =
     ring_queue_base<T, RING_BUFFER_EXTENSIBLE_FLAGS, HSHM_CLASS_TEMPL_ARGS>;
 
+template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+using mpsc_wait_queue =
+    ring_queue_base<T, RING_BUFFER_MPSC_WAIT_FLAGS, HSHM_CLASS_TEMPL_ARGS>;
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+using spsc_wait_queue =
+    ring_queue_base<T, RING_BUFFER_SPSC_WAIT_FLAGS, HSHM_CLASS_TEMPL_ARGS>;
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using fixed_mpsc_wait_queue =
+    ring_queue_base<T, RING_BUFFER_FIXED_MPMC_WAIT_FLAGS,
+                    HSHM_CLASS_TEMPL_ARGS>;
+
 }  // namespace hshm::ipc
 
 namespace hshm {
@@ -453,6 +713,21 @@ template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
 using ext_ring_buffer = hipc::ring_queue_base<T, RING_BUFFER_EXTENSIBLE_FLAGS,
                                               HSHM_CLASS_TEMPL_ARGS>;
 
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using mpsc_wait_queue =
+    hipc::ring_queue_base<T, RING_BUFFER_MPSC_WAIT_FLAGS,
+                          HSHM_CLASS_TEMPL_ARGS>;
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using spsc_wait_queue =
+    hipc::ring_queue_base<T, RING_BUFFER_SPSC_WAIT_FLAGS,
+                          HSHM_CLASS_TEMPL_ARGS>;
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using fixed_mpsc_wait_queue =
+    hipc::ring_queue_base<T, RING_BUFFER_FIXED_MPMC_WAIT_FLAGS,
+                          HSHM_CLASS_TEMPL_ARGS>;
+
 }  // namespace hshm
 
 #undef CLASS_NAME
@@ -22,6 +22,8 @@ class RqFlag {
   CLS_CONST RingQueueFlag kErrorOnNoSpace = BIT_OPT(RingQueueFlag, 4);
   /** Queue supports dynamic resizing */
   CLS_CONST RingQueueFlag kDynamicResize = BIT_OPT(RingQueueFlag, 5);
+  /** Sleeping producers and consumers are woken. Enables the waits. */
+  CLS_CONST RingQueueFlag kNotify = BIT_OPT(RingQueueFlag, 6);
 };
 
 }  // namespace hshm::ipc
@@ -45,6 +47,10 @@ using hshm::ipc::RqFlag;
 #define RING_BUFFER_CIRCULAR_SPSC_FLAGS 0
 #define RING_BUFFER_CIRCULAR_MPMC_FLAGS RqFlag::kPushAtomic | RqFlag::kPopAtomic
 #define RING_BUFFER_EXTENSIBLE_FLAGS RqFlag::kDynamicResize
+#define RING_BUFFER_MPSC_WAIT_FLAGS RING_BUFFER_MPSC_FLAGS | RqFlag::kNotify
+#define RING_BUFFER_SPSC_WAIT_FLAGS RING_BUFFER_SPSC_FLAGS | RqFlag::kNotify
+#define RING_BUFFER_FIXED_MPMC_WAIT_FLAGS \
+  RING_BUFFER_FIXED_MPMC_FLAGS | RqFlag::kNotify
 
 #define RING_QUEUE_DEFS                                                        \
   CLS_CONST RingQueueFlag IsPopAtomic = (RQ_FLAGS & RqFlag::kPopAtomic) > 0;   \
@@ -53,6 +59,8 @@ using hshm::ipc::RqFlag;
       (RQ_FLAGS & RqFlag::kWaitForSpace) > 0;                                  \
   CLS_CONST RingQueueFlag ErrorOnNoSpace =                                     \
       (RQ_FLAGS & RqFlag::kErrorOnNoSpace) > 0;                                \
-  CLS_CONST RingQueueFlag DynamicSize = (RQ_FLAGS & RqFlag::kDynamicResize) > 0;
+  CLS_CONST RingQueueFlag DynamicSize =                                        \
+      (RQ_FLAGS & RqFlag::kDynamicResize) > 0;                                 \
+  CLS_CONST RingQueueFlag Notify = (RQ_FLAGS & RqFlag::kNotify) > 0;
 
 #endif  // HSHM_SHM_INCLUDE_HSHM_SHM_DATA_STRUCTURES_IPC_RING_QUEUE_FLAGS_H_
\ No newline at end of file
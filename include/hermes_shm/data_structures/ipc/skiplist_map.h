@@ -0,0 +1,828 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_SKIPLIST_MAP_H_
+#define HSHM_DATA_STRUCTURES_SKIPLIST_MAP_H_
+
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/data_structures/ipc/functional.h"
+#include "hermes_shm/data_structures/ipc/hash.h"
+#include "hermes_shm/types/atomic.h"
+
+namespace hshm::ipc {
+
+/** forward pointer for skiplist_map */
+template <typename Key, typename T, class Compare = hshm::less<Key>,
+          HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class skiplist_map;
+
+/**
+ * A skiplist_map node. \a height_ links follow the node.
+ *
+ * A link whose first bit is marked belongs to a node that is being
+ * erased. Marking the bottom link logically deletes the node.
+ * */
+template <typename Key, typename T>
+struct skiplist_map_node {
+  delay_ar<Key> key_;
+  delay_ar<T> val_;
+  hshm::u32 height_;         /**< The number of links */
+  AtomicOffsetPointer retired_; /**< The next node in the retired list */
+};
+
+/**
+ * The skiplist_map iterator. Walks the bottom level and skips erased
+ * nodes, so it may be used while the map is being modified: it visits
+ * keys in increasing order, at most once each, and sees every key that
+ * is present for the whole iteration.
+ * */
+template <typename Key, typename T, class Compare, HSHM_CLASS_TEMPL>
+struct skiplist_map_iterator {
+ public:
+  using MAP_T = skiplist_map<Key, T, Compare, HSHM_CLASS_TEMPL_ARGS>;
+  using NODE_T = skiplist_map_node<Key, T>;
+
+ public:
+  const MAP_T *map_;
+  NODE_T *node_;
+
+ public:
+  /** Default constructor */
+  HSHM_CROSS_FUN skiplist_map_iterator() : map_(nullptr), node_(nullptr) {}
+
+  /** Construct an iterator at \a node and skip erased nodes */
+  HSHM_INLINE_CROSS_FUN skiplist_map_iterator(const MAP_T &map, NODE_T *node)
+      : map_(&map), node_(node) {
+    make_correct();
+  }
+
+  /** Get the key of the entry */
+  HSHM_INLINE_CROSS_FUN const Key &GetKey() const {
+    return node_->key_.get_ref();
+  }
+
+  /** Get the value of the entry */
+  HSHM_INLINE_CROSS_FUN T &GetVal() const { return node_->val_.get_ref(); }
+
+  /** Get the value of the entry */
+  HSHM_INLINE_CROSS_FUN T &operator*() const { return GetVal(); }
+
+  /** Go to the next entry (in place) */
+  HSHM_INLINE_CROSS_FUN skiplist_map_iterator &operator++() {
+    node_ = map_->ToNode(
+        MAP_T::Unmark(map_->GetLinks(node_)[0].off_.load(
+            std::memory_order_acquire)));
+    make_correct();
+    return *this;
+  }
+
+  /** Go to the next entry */
+  HSHM_INLINE_CROSS_FUN skiplist_map_iterator operator++(int) const {
+    skiplist_map_iterator next(*this);
+    ++next;
+    return next;
+  }
+
+  /** Whether the iterator is past the last entry */
+  HSHM_INLINE_CROSS_FUN bool is_end() const { return node_ == nullptr; }
+
+  /** Check if two iterators are equal */
+  HSHM_INLINE_CROSS_FUN bool operator==(
+      const skiplist_map_iterator &other) const {
+    return node_ == other.node_;
+  }
+
+  /** Check if two iterators are not equal */
+  HSHM_INLINE_CROSS_FUN bool operator!=(
+      const skiplist_map_iterator &other) const {
+    return node_ != other.node_;
+  }
+
+ private:
+  /** Skip erased nodes and turn the tail into end() */
+  HSHM_INLINE_CROSS_FUN void make_correct() {
+    while (node_ != nullptr) {
+      if (node_ == map_->Tail()) {
+        node_ = nullptr;
+        break;
+      }
+      size_t next = map_->GetLinks(node_)[0].off_.load(
+          std::memory_order_acquire);
+      if (!MAP_T::IsMarked(next)) {
+        break;
+      }
+      node_ = map_->ToNode(MAP_T::Unmark(next));
+    }
+  }
+};
+
+/**
+ * MACROS to simplify the skiplist_map namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+
+#define CLASS_NAME skiplist_map
+#define CLASS_NEW_ARGS Key, T, Compare
+
+/**
+ * A lock-free ordered map stored as a skip list in shared memory.
+ *
+ * Nodes are linked by offsets, so the map works across processes. Each
+ * node is allocated with exactly as many links as its random height
+ * needs, which lets the allocator serve it from a small size class.
+ *
+ * Inserts link a node bottom-up with compare-and-swap. Erase marks the
+ * node's links top-down; marking the bottom link is the point where the
+ * key leaves the map. Marked nodes are unlinked by whichever operation
+ * passes them next. find, contains, scan, and iteration take no locks
+ * and never write.
+ *
+ * Values are never modified in place: emplace on an existing key erases
+ * the old node and inserts a new one, so a concurrent reader may briefly
+ * miss the key. Unlinked nodes are kept on a retired list until
+ * reclaim(), clear(), or destruction, so readers never touch freed
+ * memory.
+ * */
+template <typename Key, typename T, class Compare, HSHM_CLASS_TEMPL>
+class skiplist_map : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef skiplist_map_iterator<Key, T, Compare, HSHM_CLASS_TEMPL_ARGS>
+      iterator_t;
+  friend iterator_t;
+  using NODE_T = skiplist_map_node<Key, T>;
+  /** The maximum number of links in a node */
+  CLS_CONST hshm::u32 kMaxHeight = 16;
+  /** A node is promoted to the next level with probability 1/4 */
+  CLS_CONST hshm::u64 kBranchMask = 3;
+
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer head_;
+  OffsetPointer tail_;
+  ipc::atomic<hshm::size_t> length_;
+  ipc::atomic<hshm::u64> seed_;
+  AtomicOffsetPointer retired_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** SHM constructor. Default allocator. */
+  HSHM_CROSS_FUN
+  skiplist_map() {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>());
+  }
+
+  /** SHM constructor. */
+  HSHM_CROSS_FUN
+  explicit skiplist_map(const hipc::CtxAllocator<AllocT> &alloc) {
+    shm_init(alloc);
+  }
+
+  /** SHM constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc) {
+    init_shm_container(alloc);
+    SetNull();
+    InitList();
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit skiplist_map(const skiplist_map &other) {
+    init_shm_container(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit skiplist_map(const hipc::CtxAllocator<AllocT> &alloc,
+                        const skiplist_map &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  skiplist_map &operator=(const skiplist_map &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /**
+   * Internal copy operation. Entries arrive in key order, so each node
+   * is appended after the last node of every level it spans.
+   * */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const skiplist_map &other) {
+    InitList();
+    NODE_T *last[kMaxHeight];
+    for (hshm::u32 level = 0; level < kMaxHeight; ++level) {
+      last[level] = Head();
+    }
+    size_t count = 0;
+    for (iterator_t iter = other.begin(); !iter.is_end(); ++iter) {
+      hshm::u32 height = RandomHeight();
+      OffsetPointer node_p =
+          AllocateNode(height, iter.GetKey(), iter.GetVal());
+      NODE_T *node = ToNode(node_p.off_.load());
+      for (hshm::u32 level = 0; level < height; ++level) {
+        GetLinks(node)[level].off_ = tail_.off_.load();
+        GetLinks(last[level])[level].off_ = node_p.off_.load();
+        last[level] = node;
+      }
+      ++count;
+    }
+    length_ = count;
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_INLINE_CROSS_FUN skiplist_map(skiplist_map &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_INLINE_CROSS_FUN skiplist_map(const hipc::CtxAllocator<AllocT> &alloc,
+                                     skiplist_map &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  skiplist_map &operator=(skiplist_map &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  skiplist_map &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      head_ = other.head_;
+      tail_ = other.tail_;
+      length_ = other.length_.load();
+      seed_ = other.seed_.load();
+      retired_.off_ = other.retired_.off_.load();
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** Check if the map is empty */
+  HSHM_INLINE_CROSS_FUN bool IsNull() const { return head_.IsNull(); }
+
+  /** Sets this map as empty */
+  HSHM_INLINE_CROSS_FUN void SetNull() {
+    head_.SetNull();
+    tail_.SetNull();
+    length_ = 0;
+    seed_ = 0;
+    retired_.SetNull();
+  }
+
+  /** Destroy every node. Not safe while the map is being accessed. */
+  HSHM_CROSS_FUN void shm_destroy_main() {
+    FreeList();
+  }
+
+  /**====================================
+   * Emplace Methods
+   * ===================================*/
+
+  /**
+   * Construct an object directly in the map. Overrides the object if
+   * key already exists.
+   *
+   * @param key the key to future index the map
+   * @param args the arguments to construct the object
+   * @return true
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool emplace(const Key &key, Args &&...args) {
+    return emplace_templ<true>(key, std::forward<Args>(args)...);
+  }
+
+  /**
+   * Construct an object directly in the map. Does not modify the key
+   * if it already exists.
+   *
+   * @param key the key to future index the map
+   * @param args the arguments to construct the object
+   * @return true if the key was inserted
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN bool try_emplace(const Key &key, Args &&...args) {
+    return emplace_templ<false>(key, std::forward<Args>(args)...);
+  }
+
+ private:
+  /**
+   * Insert a (key, value) pair in the map
+   *
+   * @param modify_existing whether or not to override an existing entry
+   * */
+  template <bool modify_existing, typename... Args>
+  HSHM_CROSS_FUN bool emplace_templ(const Key &key, Args &&...args) {
+    NODE_T *preds[kMaxHeight];
+    size_t succs[kMaxHeight];
+    OffsetPointer node_p = OffsetPointer::GetNull();
+    NODE_T *node = nullptr;
+    hshm::u32 height = 0;
+    while (true) {
+      if (FindNode(key, preds, succs)) {
+        if constexpr (!modify_existing) {
+          if (node) {
+            FreeNode(node_p);
+          }
+          return false;
+        } else {
+          EraseNode(succs[0], key);
+          continue;
+        }
+      }
+      if (node == nullptr) {
+        height = RandomHeight();
+        node_p = AllocateNode(height, key, std::forward<Args>(args)...);
+        node = ToNode(node_p.off_.load());
+      }
+      for (hshm::u32 level = 0; level < height; ++level) {
+        GetLinks(node)[level].off_.store(succs[level],
+                                         std::memory_order_relaxed);
+      }
+      // Publishing the bottom link inserts the key
+      size_t expected = succs[0];
+      if (!GetLinks(preds[0])[0].off_.compare_exchange_strong(
+              expected, node_p.off_.load())) {
+        continue;
+      }
+      length_.fetch_add(1);
+      LinkUpperLevels(key, node_p.off_.load(), node, height, preds, succs);
+      return true;
+    }
+  }
+
+  /**
+   * Link the levels of a node above the bottom one. Stops early if the
+   * node is erased in the meantime.
+   * */
+  HSHM_CROSS_FUN void LinkUpperLevels(const Key &key, size_t node_off,
+                                      NODE_T *node, hshm::u32 height,
+                                      NODE_T **preds, size_t *succs) {
+    AtomicOffsetPointer *links = GetLinks(node);
+    for (hshm::u32 level = 1; level < height; ++level) {
+      while (true) {
+        size_t next = links[level].off_.load();
+        if (IsMarked(next)) {
+          return;
+        }
+        if (next != succs[level] &&
+            !links[level].off_.compare_exchange_strong(next, succs[level])) {
+          continue;
+        }
+        size_t expected = succs[level];
+        if (GetLinks(preds[level])[level].off_.compare_exchange_strong(
+                expected, node_off)) {
+          break;
+        }
+        FindNode(key, preds, succs);
+        if (succs[0] != node_off) {
+          return;
+        }
+      }
+    }
+    // An erase may have unlinked the node before a level was linked
+    if (IsMarked(links[0].off_.load())) {
+      FindNode(key, preds, succs);
+    }
+  }
+
+ public:
+  /**====================================
+   * Erase Methods
+   * ===================================*/
+
+  /**
+   * Erase an object indexable by \a key key
+   *
+   * @return true if this call erased the key
+   * */
+  HSHM_CROSS_FUN
+  bool erase(const Key &key) {
+    NODE_T *preds[kMaxHeight];
+    size_t succs[kMaxHeight];
+    if (!FindNode(key, preds, succs)) {
+      return false;
+    }
+    return EraseNode(succs[0], key);
+  }
+
+  /**
+   * Erase the entire map. Not safe while the map is being accessed.
+   * */
+  HSHM_CROSS_FUN void clear() {
+    FreeList();
+    InitList();
+  }
+
+  /**
+   * Free the nodes of erased entries. Not safe while the map is being
+   * accessed.
+   * */
+  HSHM_CROSS_FUN void reclaim() {
+    // Unlink erased nodes that an interrupted insert relinked
+    for (hshm::u32 level = 0; level < kMaxHeight; ++level) {
+      NODE_T *pred = Head();
+      size_t curr_off = GetLinks(pred)[level].off_.load();
+      while (curr_off != tail_.off_.load()) {
+        size_t next = GetLinks(ToNode(curr_off))[level].off_.load();
+        if (IsMarked(next)) {
+          GetLinks(pred)[level].off_ = Unmark(next);
+        } else {
+          pred = ToNode(curr_off);
+        }
+        curr_off = Unmark(next);
+      }
+    }
+    // Free the retired nodes
+    OffsetPointer node_p(retired_.off_.load());
+    while (!node_p.IsNull()) {
+      OffsetPointer next_p(ToNode(node_p.off_.load())->retired_.off_.load());
+      FreeNode(node_p);
+      node_p = next_p;
+    }
+    retired_.SetNull();
+  }
+
+ private:
+  /**
+   * Erase the node at \a node_off. Marks its links from the top down;
+   * the caller that marks the bottom link owns the erase.
+   *
+   * @return true if this call erased the node
+   * */
+  HSHM_CROSS_FUN bool EraseNode(size_t node_off, const Key &key) {
+    NODE_T *node = ToNode(node_off);
+    AtomicOffsetPointer *links = GetLinks(node);
+    for (hshm::u32 level = node->height_ - 1; level >= 1; --level) {
+      size_t next = links[level].off_.load();
+      while (!IsMarked(next) &&
+             !links[level].off_.compare_exchange_strong(next, Mark(next))) {
+      }
+    }
+    size_t next = links[0].off_.load();
+    while (true) {
+      if (IsMarked(next)) {
+        return false;
+      }
+      if (links[0].off_.compare_exchange_strong(next, Mark(next))) {
+        break;
+      }
+    }
+    length_.fetch_sub(1);
+    // Unlink the node from every level and retire it
+    NODE_T *preds[kMaxHeight];
+    size_t succs[kMaxHeight];
+    FindNode(key, preds, succs);
+    size_t head = retired_.off_.load();
+    do {
+      node->retired_.off_.store(head, std::memory_order_relaxed);
+    } while (!retired_.off_.compare_exchange_weak(head, node_off));
+    return true;
+  }
+
+ public:
+  /**====================================
+   * Index Methods
+   * ===================================*/
+
+  /**
+   * Copy the value of \a key into \a val.
+   *
+   * @return true if the key was found
+   * */
+  HSHM_CROSS_FUN
+  bool find(const Key &key, T &val) const {
+    NODE_T *node = LowerBoundNode(key);
+    if (node == nullptr || Compare{}(key, node->key_.get_ref())) {
+      return false;
+    }
+    val = node->val_.get_ref();
+    return true;
+  }
+
+  /** Check whether \a key is in the map */
+  HSHM_CROSS_FUN
+  bool contains(const Key &key) const {
+    NODE_T *node = LowerBoundNode(key);
+    return node != nullptr && !Compare{}(key, node->key_.get_ref());
+  }
+
+  /**
+   * Call \a func(key, val) on every entry with lo <= key < hi, in key
+   * order. Safe under concurrent modification (see iterator_t).
+   *
+   * @return the number of entries visited
+   * */
+  template <typename FUNC>
+  HSHM_CROSS_FUN size_t scan(const Key &lo, const Key &hi,
+                             FUNC &&func) const {
+    size_t count = 0;
+    for (iterator_t iter = lower_bound(lo);
+         !iter.is_end() && Compare{}(iter.GetKey(), hi); ++iter) {
+      func(iter.GetKey(), iter.GetVal());
+      ++count;
+    }
+    return count;
+  }
+
+  /**====================================
+   * Iterators
+   * ===================================*/
+
+  /** The first entry whose key is not less than \a key */
+  HSHM_CROSS_FUN iterator_t lower_bound(const Key &key) const {
+    return iterator_t(*this, LowerBoundNode(key));
+  }
+
+  /** The entry of \a key, or end() */
+  HSHM_CROSS_FUN iterator_t find(const Key &key) const {
+    iterator_t iter = lower_bound(key);
+    if (!iter.is_end() && Compare{}(key, iter.GetKey())) {
+      return end();
+    }
+    return iter;
+  }
+
+  /** Forward iterator begin */
+  HSHM_INLINE_CROSS_FUN iterator_t begin() const {
+    return iterator_t(*this, ToNode(Unmark(GetLinks(Head())[0].off_.load(
+                                 std::memory_order_acquire))));
+  }
+
+  /** Forward iterator end */
+  HSHM_INLINE_CROSS_FUN iterator_t end() const {
+    return iterator_t(*this, nullptr);
+  }
+
+  /**====================================
+   * Query Methods
+   * ===================================*/
+
+  /** The number of entries in the map */
+  HSHM_INLINE_CROSS_FUN size_t size() const { return (size_t)length_.load(); }
+
+  /**====================================
+   * Internal Operations
+   * ===================================*/
+ private:
+  /** Whether a link belongs to an erased node */
+  HSHM_INLINE_CROSS_FUN static bool IsMarked(size_t off) {
+    return IS_FIRST_BIT_MARKED(size_t, off);
+  }
+
+  /** Mark a link as belonging to an erased node */
+  HSHM_INLINE_CROSS_FUN static size_t Mark(size_t off) {
+    return MARK_FIRST_BIT(size_t, off);
+  }
+
+  /** Get the offset of a link */
+  HSHM_INLINE_CROSS_FUN static size_t Unmark(size_t off) {
+    return UNMARK_FIRST_BIT(size_t, off);
+  }
+
+  /** Convert an offset into a node */
+  HSHM_INLINE_CROSS_FUN NODE_T *ToNode(size_t off) const {
+    return GetAllocator()->template Convert<NODE_T>(OffsetPointer(off));
+  }
+
+  /** The head sentinel. Spans every level. */
+  HSHM_INLINE_CROSS_FUN NODE_T *Head() const {
+    return ToNode(head_.off_.load());
+  }
+
+  /** The tail sentinel. Greater than every key. */
+  HSHM_INLINE_CROSS_FUN NODE_T *Tail() const {
+    return ToNode(tail_.off_.load());
+  }
+
+  /** Get the links of a node */
+  HSHM_INLINE_CROSS_FUN static AtomicOffsetPointer *GetLinks(NODE_T *node) {
+    return reinterpret_cast<AtomicOffsetPointer *>(
+        reinterpret_cast<char *>(node) + sizeof(NODE_T));
+  }
+
+  /** Draw a height with P(height > h) = 4^-h */
+  HSHM_INLINE_CROSS_FUN hshm::u32 RandomHeight() {
+    hshm::u64 bits =
+        hshm::fmix64(seed_.fetch_add(1, std::memory_order_relaxed));
+    hshm::u32 height = 1;
+    while (height < kMaxHeight && (bits & kBranchMask) == 0) {
+      ++height;
+      bits >>= 2;
+    }
+    return height;
+  }
+
+  /** Allocate a node with \a height links. The key and value are unset. */
+  HSHM_CROSS_FUN OffsetPointer AllocateLinks(hshm::u32 height) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = sizeof(NODE_T) + height * sizeof(AtomicOffsetPointer);
+    OffsetPointer node_p =
+        alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (node_p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    NODE_T *node = alloc->template Convert<NODE_T>(node_p);
+    node->height_ = height;
+    node->retired_.SetNull();
+    return node_p;
+  }
+
+  /** Allocate a node holding (\a key, \a args) */
+  template <typename... Args>
+  HSHM_CROSS_FUN OffsetPointer AllocateNode(hshm::u32 height, const Key &key,
+                                            Args &&...args) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer node_p = AllocateLinks(height);
+    NODE_T *node = ToNode(node_p.off_.load());
+    HSHM_MAKE_AR(node->key_, alloc, key)
+    HSHM_MAKE_AR(node->val_, alloc, std::forward<Args>(args)...)
+    return node_p;
+  }
+
+  /** Destroy a node and return it to the allocator */
+  HSHM_CROSS_FUN void FreeNode(OffsetPointer node_p) {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    NODE_T *node = ToNode(node_p.off_.load());
+    node->key_.shm_destroy();
+    node->val_.shm_destroy();
+    alloc->Free(alloc.ctx_, node_p);
+  }
+
+  /** Create the sentinels of an empty list */
+  HSHM_CROSS_FUN void InitList() {
+    tail_ = AllocateLinks(0);
+    head_ = AllocateLinks(kMaxHeight);
+    AtomicOffsetPointer *links = GetLinks(Head());
+    for (hshm::u32 level = 0; level < kMaxHeight; ++level) {
+      links[level].off_ = tail_.off_.load();
+    }
+    length_ = 0;
+    retired_.SetNull();
+  }
+
+  /** Free every node, including the sentinels */
+  HSHM_CROSS_FUN void FreeList() {
+    reclaim();
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer node_p(GetLinks(Head())[0].off_.load());
+    while (!node_p.IsNull() && node_p != tail_) {
+      OffsetPointer next_p(GetLinks(ToNode(node_p.off_.load()))[0].off_.load());
+      FreeNode(node_p);
+      node_p = next_p;
+    }
+    alloc->Free(alloc.ctx_, head_);
+    alloc->Free(alloc.ctx_, tail_);
+    SetNull();
+  }
+
+  /**
+   * Find the first node not less than \a key on every level, unlinking
+   * erased nodes along the way.
+   *
+   * @param preds the last node less than \a key on each level
+   * @param succs the offset of the node after preds on each level
+   * @return whether succs[0] holds \a key
+   * */
+  HSHM_CROSS_FUN bool FindNode(const Key &key, NODE_T **preds,
+                               size_t *succs) const {
+    size_t tail_off = tail_.off_.load();
+    while (true) {
+      bool restart = false;
+      NODE_T *pred = Head();
+      for (int level = (int)kMaxHeight - 1; level >= 0 && !restart;
+           --level) {
+        size_t curr_off = Unmark(
+            GetLinks(pred)[level].off_.load(std::memory_order_acquire));
+        while (curr_off != tail_off) {
+          NODE_T *curr = ToNode(curr_off);
+          size_t succ_off =
+              GetLinks(curr)[level].off_.load(std::memory_order_acquire);
+          if (IsMarked(succ_off)) {
+            // curr is being erased: unlink it from this level
+            size_t expected = curr_off;
+            if (!GetLinks(pred)[level].off_.compare_exchange_strong(
+                    expected, Unmark(succ_off))) {
+              restart = true;
+              break;
+            }
+            curr_off = Unmark(succ_off);
+            continue;
+          }
+          if (!Compare{}(curr->key_.get_ref(), key)) {
+            break;
+          }
+          pred = curr;
+          curr_off = succ_off;
+        }
+        preds[level] = pred;
+        succs[level] = curr_off;
+      }
+      if (restart) {
+        continue;
+      }
+      return succs[0] != tail_off &&
+             !Compare{}(key, ToNode(succs[0])->key_.get_ref());
+    }
+  }
+
+  /**
+   * The first live node not less than \a key, or nullptr. Skips erased
+   * nodes without unlinking them, so readers never write.
+   * */
+  HSHM_CROSS_FUN NODE_T *LowerBoundNode(const Key &key) const {
+    size_t tail_off = tail_.off_.load();
+    NODE_T *pred = Head();
+    size_t curr_off = tail_off;
+    for (int level = (int)kMaxHeight - 1; level >= 0; --level) {
+      curr_off =
+          Unmark(GetLinks(pred)[level].off_.load(std::memory_order_acquire));
+      while (curr_off != tail_off) {
+        NODE_T *curr = ToNode(curr_off);
+        size_t succ_off =
+            GetLinks(curr)[level].off_.load(std::memory_order_acquire);
+        if (IsMarked(succ_off)) {
+          curr_off = Unmark(succ_off);
+          continue;
+        }
+        if (!Compare{}(curr->key_.get_ref(), key)) {
+          break;
+        }
+        pred = curr;
+        curr_off = succ_off;
+      }
+    }
+    return curr_off == tail_off ? nullptr : ToNode(curr_off);
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename Key, typename T, class Compare = hshm::less<Key>,
+          HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using skiplist_map =
+    hipc::skiplist_map<Key, T, Compare, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_SKIPLIST_MAP_H_
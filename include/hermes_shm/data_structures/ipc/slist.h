@@ -414,6 +414,30 @@ class slist : public ShmContainer {
     ++length_;
   }
 
+  /**
+   * Move the first element of \a other to the front of this slist
+   * without copying it. Both slists must share an allocator.
+   * */
+  HSHM_CROSS_FUN
+  void splice_front(slist &other) {
+    OffsetPointer entry_ptr = other.head_ptr_;
+    auto entry =
+        GetAllocator()->template Convert<slist_entry<T, HSHM_CLASS_TEMPL_ARGS>>(
+            entry_ptr);
+    other.head_ptr_ = entry->next_ptr_;
+    if (--other.length_ == 0) {
+      other.tail_ptr_.SetNull();
+    }
+    if (size() == 0) {
+      entry->next_ptr_.SetNull();
+      tail_ptr_ = entry_ptr;
+    } else {
+      entry->next_ptr_ = head_ptr_;
+    }
+    head_ptr_ = entry_ptr;
+    ++length_;
+  }
+
   /** Find the element prior to an slist_entry */
   HSHM_CROSS_FUN
   iterator_t find_prior(iterator_t pos) {
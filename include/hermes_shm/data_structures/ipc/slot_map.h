@@ -0,0 +1,621 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_SLOT_MAP_H_
+#define HSHM_DATA_STRUCTURES_IPC_SLOT_MAP_H_
+
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/types/atomic.h"
+
+namespace hshm::ipc {
+
+/**
+ * A handle to a slot_map entry: the slot index in the low 32 bits and
+ * the slot's generation in the high 32 bits. Generations of live entries
+ * are odd, so the all-zero handle is never valid.
+ * */
+struct slot_map_handle {
+  hshm::u64 bits_;
+
+  /** Default constructor */
+  HSHM_INLINE_CROSS_FUN slot_map_handle() = default;
+
+  /** Construct from the raw 64 bits */
+  HSHM_INLINE_CROSS_FUN explicit slot_map_handle(hshm::u64 bits)
+      : bits_(bits) {}
+
+  /** Construct from an index and a generation */
+  HSHM_INLINE_CROSS_FUN slot_map_handle(hshm::u32 idx, hshm::u32 gen)
+      : bits_(((hshm::u64)gen << 32) | idx) {}
+
+  /** Get the slot index */
+  HSHM_INLINE_CROSS_FUN hshm::u32 GetIndex() const { return (hshm::u32)bits_; }
+
+  /** Get the generation */
+  HSHM_INLINE_CROSS_FUN hshm::u32 GetGen() const {
+    return (hshm::u32)(bits_ >> 32);
+  }
+
+  /** Get the null handle */
+  HSHM_INLINE_CROSS_FUN static slot_map_handle GetNull() {
+    return slot_map_handle((hshm::u64)0);
+  }
+
+  /** Check if null */
+  HSHM_INLINE_CROSS_FUN bool IsNull() const { return bits_ == 0; }
+
+  /** Equality operator */
+  HSHM_INLINE_CROSS_FUN bool operator==(const slot_map_handle &other) const {
+    return bits_ == other.bits_;
+  }
+
+  /** Inequality operator */
+  HSHM_INLINE_CROSS_FUN bool operator!=(const slot_map_handle &other) const {
+    return bits_ != other.bits_;
+  }
+};
+
+/**
+ * A slot of a slot_map. \a gen_ is odd while the slot holds a value and
+ * even while it is free. \a next_ links free slots (index + 1, 0 ends
+ * the list).
+ * */
+template <typename T>
+struct slot_map_slot {
+  ipc::atomic<hshm::u32> gen_;
+  ipc::atomic<hshm::u32> next_;
+  delay_ar<T> val_;
+};
+
+/** Index of the highest set bit of a nonzero value */
+HSHM_INLINE_CROSS_FUN static hshm::u32 SlotMapHighestBit(hshm::u64 val) {
+#if defined(HSHM_IS_GPU)
+  return 63 - __clzll(val);
+#elif defined(HSHM_COMPILER_MSVC)
+  unsigned long idx;
+  _BitScanReverse64(&idx, val);
+  return (hshm::u32)idx;
+#else
+  return 63 - (hshm::u32)__builtin_clzll(val);
+#endif
+}
+
+/** Forward declaration of slot_map */
+template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class slot_map;
+
+/**
+ * MACROS used to simplify the slot_map namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME slot_map
+#define CLASS_NEW_ARGS T
+
+/**
+ * Stores values under generation-tagged handles. Insert, erase and
+ * lookup are O(1). A handle whose entry was erased no longer resolves,
+ * even after its slot is reused.
+ *
+ * Slots live in segments that double in size: segment k holds
+ * depth << k slots. Slots never move, so pointers to values stay valid
+ * until erase. Growing adds a segment and never fails while the
+ * allocator has memory.
+ *
+ * Free slots are kept on a lock-free stack with an ABA tag. A new value
+ * takes the most recently freed slot, and only takes a fresh slot from
+ * the high-water mark when none are free. Live values therefore stay
+ * packed at the low indices, and for_each scans a contiguous prefix of
+ * the segments.
+ *
+ * emplace, erase and find may run concurrently from any thread or
+ * process. find returns a pointer into the slot, so erasing an entry
+ * while another thread uses that entry is the caller's race to avoid.
+ * */
+template <typename T, HSHM_CLASS_TEMPL>
+class slot_map : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef slot_map_slot<T> slot_t;
+  static const int kMaxSegments = 32;
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  AtomicOffsetPointer segs_[kMaxSegments];
+  hshm::u32 log_depth_;
+  /** Free stack head: ABA tag in the high 32 bits, index + 1 in the low */
+  ipc::atomic<hshm::u64> free_;
+  /** The number of slots ever handed out */
+  ipc::atomic<hshm::u64> heap_;
+  ipc::atomic<hshm::u64> count_;
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit slot_map(size_t depth = 1024) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), depth);
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit slot_map(const hipc::CtxAllocator<AllocT> &alloc,
+                    size_t depth = 1024) {
+    shm_init(alloc, depth);
+  }
+
+  /**
+   * SHM Constructor.
+   *
+   * @param depth the number of slots in the first segment, rounded up to
+   * a power of two
+   * */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc, size_t depth = 1024) {
+    init_shm_container(alloc);
+    SetNull();
+    log_depth_ = 0;
+    while (((size_t)1 << log_depth_) < depth) {
+      ++log_depth_;
+    }
+    GetOrAllocateSegment(0);
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit slot_map(const slot_map &other) {
+    init_shm_container(other.GetCtxAllocator());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit slot_map(const hipc::CtxAllocator<AllocT> &alloc,
+                    const slot_map &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  slot_map &operator=(const slot_map &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /**
+   * SHM copy constructor + operator main. Not safe under modification.
+   * Slots are copied in place, so handles into \a other resolve in the
+   * copy too.
+   * */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const slot_map &other) {
+    log_depth_ = other.log_depth_;
+    for (int seg = 0; seg < kMaxSegments; ++seg) {
+      slot_t *src = other.GetSegment(seg);
+      if (src == nullptr) {
+        continue;
+      }
+      slot_t *dst = GetOrAllocateSegment(seg);
+      for (size_t i = 0; i < GetSegmentSize(seg); ++i) {
+        hshm::u32 gen = src[i].gen_.load();
+        dst[i].gen_ = gen;
+        dst[i].next_ = src[i].next_.load();
+        if (gen & 1) {
+          HSHM_MAKE_AR(dst[i].val_, GetCtxAllocator(), src[i].val_.get_ref())
+        }
+      }
+    }
+    free_ = other.free_.load();
+    heap_ = other.heap_.load();
+    count_ = other.count_.load();
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  slot_map(slot_map &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  slot_map(const hipc::CtxAllocator<AllocT> &alloc, slot_map &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  slot_map &operator=(slot_map &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  slot_map &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      for (int seg = 0; seg < kMaxSegments; ++seg) {
+        segs_[seg].off_ = other.segs_[seg].off_.load();
+      }
+      log_depth_ = other.log_depth_;
+      free_ = other.free_.load();
+      heap_ = other.heap_.load();
+      count_ = other.count_.load();
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. Destroys the live values and frees the segments. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    for (int seg = 0; seg < kMaxSegments; ++seg) {
+      slot_t *slots = GetSegment(seg);
+      if (slots == nullptr) {
+        continue;
+      }
+      for (size_t i = 0; i < GetSegmentSize(seg); ++i) {
+        if (slots[i].gen_.load() & 1) {
+          slots[i].val_.shm_destroy();
+        }
+      }
+      OffsetPointer seg_p(segs_[seg].off_.load());
+      alloc->Free(alloc.ctx_, seg_p);
+    }
+  }
+
+  /** Check if the map is empty */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return segs_[0].IsNull(); }
+
+  /** Sets this map as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {
+    for (int seg = 0; seg < kMaxSegments; ++seg) {
+      segs_[seg].SetNull();
+    }
+    free_ = 0;
+    heap_ = 0;
+    count_ = 0;
+  }
+
+  /**====================================
+   * Slot Map Methods
+   * ===================================*/
+
+  /**
+   * Construct a value in a free slot.
+   *
+   * @return the handle of the new entry
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN slot_map_handle emplace(Args &&...args) {
+    hshm::u32 idx = AllocateSlot();
+    slot_t &slot = GetSlot(idx);
+    hshm::u32 gen = slot.gen_.load(std::memory_order_relaxed) + 1;
+    HSHM_MAKE_AR(slot.val_, GetCtxAllocator(), std::forward<Args>(args)...)
+    slot.gen_.store(gen, std::memory_order_release);
+    count_.fetch_add(1);
+    return slot_map_handle(idx, gen);
+  }
+
+  /** Insert a value (wrapper) */
+  template <typename... Args>
+  HSHM_INLINE_CROSS_FUN slot_map_handle insert(Args &&...args) {
+    return emplace(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Find the value of \a handle.
+   *
+   * @return nullptr if the entry was erased
+   * */
+  HSHM_CROSS_FUN
+  T *find(const slot_map_handle &handle) {
+    slot_t *slot = FindSlot(handle);
+    if (slot == nullptr) {
+      return nullptr;
+    }
+    return &slot->val_.get_ref();
+  }
+
+  /** Check if \a handle refers to a live entry */
+  HSHM_CROSS_FUN
+  bool contains(const slot_map_handle &handle) {
+    return FindSlot(handle) != nullptr;
+  }
+
+  /** Get the value of \a handle, which must be live */
+  HSHM_INLINE_CROSS_FUN
+  T &operator[](const slot_map_handle &handle) {
+    return GetSlot(handle.GetIndex()).val_.get_ref();
+  }
+
+  /**
+   * Move the value of \a handle into \a val and erase the entry.
+   *
+   * @return false if the entry was already erased
+   * */
+  HSHM_CROSS_FUN
+  bool pop(const slot_map_handle &handle, T &val) {
+    slot_t *slot = ClaimSlot(handle);
+    if (slot == nullptr) {
+      return false;
+    }
+    val = std::move(slot->val_.get_ref());
+    ReleaseSlot(handle.GetIndex(), *slot);
+    return true;
+  }
+
+  /**
+   * Erase the entry of \a handle. Exactly one of several concurrent
+   * erases of the same handle succeeds.
+   *
+   * @return false if the entry was already erased
+   * */
+  HSHM_CROSS_FUN
+  bool erase(const slot_map_handle &handle) {
+    slot_t *slot = ClaimSlot(handle);
+    if (slot == nullptr) {
+      return false;
+    }
+    ReleaseSlot(handle.GetIndex(), *slot);
+    return true;
+  }
+
+  /** Erase every entry. Not safe under modification. */
+  HSHM_CROSS_FUN
+  void clear() {
+    for_each([this](const slot_map_handle &handle, T &val) {
+      (void)val;
+      erase(handle);
+    });
+  }
+
+  /**
+   * Call \a func(handle, val) on every live entry, in slot order.
+   * Entries inserted or erased during the scan may or may not be seen.
+   * */
+  template <typename FUNC>
+  HSHM_CROSS_FUN void for_each(FUNC &&func) {
+    hshm::u64 heap = heap_.load(std::memory_order_acquire);
+    hshm::u64 idx = 0;
+    for (int seg = 0; seg < kMaxSegments && idx < heap; ++seg) {
+      slot_t *slots = GetSegment(seg);
+      size_t seg_size = GetSegmentSize(seg);
+      if (slots == nullptr) {
+        idx += seg_size;
+        continue;
+      }
+      for (size_t i = 0; i < seg_size && idx < heap; ++i, ++idx) {
+        hshm::u32 gen = slots[i].gen_.load(std::memory_order_acquire);
+        if (gen & 1) {
+          func(slot_map_handle((hshm::u32)idx, gen), slots[i].val_.get_ref());
+        }
+      }
+    }
+  }
+
+  /** Check if the map has no entries */
+  HSHM_INLINE_CROSS_FUN
+  bool empty() const { return count_.load() == 0; }
+
+  /** Get the number of slots in the allocated segments */
+  HSHM_CROSS_FUN
+  size_t GetCapacity() const {
+    size_t capacity = 0;
+    for (int seg = 0; seg < kMaxSegments; ++seg) {
+      if (!segs_[seg].IsNull()) {
+        capacity += GetSegmentSize(seg);
+      }
+    }
+    return capacity;
+  }
+
+  /** Get size at this moment. Approximate under concurrency. */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetSize() const { return (size_t)count_.load(); }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() const { return GetSize(); }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t Size() const { return GetSize(); }
+
+ private:
+  /** The number of slots in segment \a seg */
+  HSHM_INLINE_CROSS_FUN size_t GetSegmentSize(int seg) const {
+    return (size_t)1 << (log_depth_ + seg);
+  }
+
+  /** Get segment \a seg, or nullptr if it is not allocated */
+  HSHM_INLINE_CROSS_FUN slot_t *GetSegment(int seg) const {
+    OffsetPointer seg_p(segs_[seg].off_.load(std::memory_order_acquire));
+    if (seg_p.IsNull()) {
+      return nullptr;
+    }
+    return GetAllocator()->template Convert<slot_t>(seg_p);
+  }
+
+  /**
+   * Get slot \a idx, or nullptr if its segment is not allocated. Index
+   * idx lives at offset (idx + depth) - (depth << k) of the segment k
+   * whose range holds idx + depth.
+   * */
+  HSHM_INLINE_CROSS_FUN slot_t *GetSlotPtr(hshm::u32 idx) const {
+    hshm::u64 pos = (hshm::u64)idx + ((hshm::u64)1 << log_depth_);
+    int seg = (int)(SlotMapHighestBit(pos) - log_depth_);
+    if (seg >= kMaxSegments) {
+      return nullptr;
+    }
+    slot_t *slots = GetSegment(seg);
+    if (slots == nullptr) {
+      return nullptr;
+    }
+    return &slots[pos - ((hshm::u64)1 << (log_depth_ + seg))];
+  }
+
+  /** Get slot \a idx, which is in an allocated segment */
+  HSHM_INLINE_CROSS_FUN slot_t &GetSlot(hshm::u32 idx) const {
+    return *GetSlotPtr(idx);
+  }
+
+  /** Get the slot of \a handle if the entry is live */
+  HSHM_CROSS_FUN slot_t *FindSlot(const slot_map_handle &handle) {
+    if (handle.IsNull()) {
+      return nullptr;
+    }
+    slot_t *slot = GetSlotPtr(handle.GetIndex());
+    if (slot == nullptr ||
+        slot->gen_.load(std::memory_order_acquire) != handle.GetGen()) {
+      return nullptr;
+    }
+    return slot;
+  }
+
+  /** Make the entry of \a handle unreachable. Only one caller wins. */
+  HSHM_CROSS_FUN slot_t *ClaimSlot(const slot_map_handle &handle) {
+    slot_t *slot = FindSlot(handle);
+    if (slot == nullptr) {
+      return nullptr;
+    }
+    hshm::u32 gen = handle.GetGen();
+    if (!slot->gen_.compare_exchange_strong(gen, gen + 1)) {
+      return nullptr;
+    }
+    return slot;
+  }
+
+  /** Destroy the value of a claimed slot and push the slot to the stack */
+  HSHM_CROSS_FUN void ReleaseSlot(hshm::u32 idx, slot_t &slot) {
+    slot.val_.shm_destroy();
+    count_.fetch_sub(1);
+    hshm::u64 head = free_.load(std::memory_order_relaxed);
+    while (true) {
+      slot.next_.store((hshm::u32)head, std::memory_order_relaxed);
+      hshm::u64 tag = (head >> 32) + 1;
+      if (free_.compare_exchange_weak(head, (tag << 32) | (idx + 1),
+                                      std::memory_order_release)) {
+        return;
+      }
+    }
+  }
+
+  /** Pop a free slot, or take a fresh one past the high-water mark */
+  HSHM_CROSS_FUN hshm::u32 AllocateSlot() {
+    hshm::u64 head = free_.load(std::memory_order_acquire);
+    while ((hshm::u32)head != 0) {
+      hshm::u32 idx = (hshm::u32)head - 1;
+      // The slot may be reused while we read next_; the tag catches that
+      hshm::u32 next = GetSlot(idx).next_.load(std::memory_order_relaxed);
+      hshm::u64 tag = (head >> 32) + 1;
+      if (free_.compare_exchange_weak(head, (tag << 32) | next,
+                                      std::memory_order_acquire)) {
+        return idx;
+      }
+    }
+    hshm::u64 idx = heap_.fetch_add(1);
+    hshm::u64 pos = idx + ((hshm::u64)1 << log_depth_);
+    GetOrAllocateSegment((int)(SlotMapHighestBit(pos) - log_depth_));
+    return (hshm::u32)idx;
+  }
+
+  /**
+   * Get segment \a seg, allocating it if needed. Threads that race to
+   * allocate the same segment CAS it in, and the losers free theirs.
+   * */
+  HSHM_CROSS_FUN slot_t *GetOrAllocateSegment(int seg) {
+    if (seg >= kMaxSegments || (log_depth_ + seg) >= 32) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, (size_t)0,
+                       GetAllocator()->GetCurrentlyAllocatedSize());
+    }
+    slot_t *slots = GetSegment(seg);
+    if (slots != nullptr) {
+      return slots;
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t seg_size = GetSegmentSize(seg);
+    size_t size = seg_size * sizeof(slot_t);
+    OffsetPointer seg_p =
+        alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (seg_p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    slots = alloc->template Convert<slot_t>(seg_p);
+    for (size_t i = 0; i < seg_size; ++i) {
+      slots[i].gen_ = 0;
+      slots[i].next_ = 0;
+    }
+    size_t expected = OffsetPointer::GetNull().off_.load();
+    if (!segs_[seg].off_.compare_exchange_strong(expected,
+                                                 seg_p.off_.load())) {
+      alloc->Free(alloc.ctx_, seg_p);
+      return GetSegment(seg);
+    }
+    return slots;
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using slot_map = hipc::slot_map<T, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_SLOT_MAP_H_
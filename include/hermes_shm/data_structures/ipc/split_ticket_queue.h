@@ -14,10 +14,14 @@
 #define HSHM_SHM__DATA_STRUCTURES_IPC_SPLIT_TICKET_QUEUE_H_
 
 #include "hermes_shm/data_structures/internal/shm_internal.h"
-#include "hermes_shm/thread/lock.h"
-#include "ticket_queue.h"
+#include "mpmc_queue.h"
 #include "vector.h"
 
+#if defined(HSHM_ENABLE_PROCFS_SYSINFO) && defined(__linux__)
+#include <sched.h>
+#define HSHM_ENABLE_SCHED_GETCPU
+#endif
+
 namespace hshm::ipc {
 
 /** Forward declaration of split_ticket_queue */
@@ -32,17 +36,26 @@ class split_ticket_queue;
 #define CLASS_NEW_ARGS T
 
 /**
- * A MPMC queue for allocating tickets. Handles concurrency
- * without blocking.
+ * A MPMC queue for allocating tickets, split into one lock-free
+ * mpmc_queue lane per CPU.
+ *
+ * A thread pushes to and pops from the lane of the CPU it is running
+ * on (sched_getcpu), or a lane fixed per thread where the CPU is not
+ * available. Threads on different CPUs therefore touch different cache
+ * lines. A push that finds its lane full spills to the next lanes, and
+ * a pop that finds its lane empty steals from the next lanes, so the
+ * lane is only a locality hint: any thread may use any lane. There is
+ * no FIFO order across lanes.
  * */
 template <typename T, HSHM_CLASS_TEMPL>
 class split_ticket_queue : public ShmContainer {
  public:
   HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
-  typedef ticket_queue<T, HSHM_CLASS_TEMPL_ARGS> ticket_queue_t;
-  typedef vector<ticket_queue_t, HSHM_CLASS_TEMPL_ARGS> vector_t;
+  typedef mpmc_queue<T, HSHM_CLASS_TEMPL_ARGS> lane_t;
+  typedef vector<lane_t, HSHM_CLASS_TEMPL_ARGS> vector_t;
   delay_ar<vector_t> splits_;
-  hipc::atomic<hshm::min_i32> rr_tail_, rr_head_;
+  /** Seeds per-thread lanes where the CPU is not available */
+  hipc::atomic<hshm::u64> rr_;
 
  public:
   /**====================================
@@ -167,26 +180,27 @@ class split_ticket_queue : public ShmContainer {
 
   /** Sets this list as empty */
   HSHM_CROSS_FUN
-  void SetNull() {
-    rr_tail_ = 0;
-    rr_head_ = 0;
-  }
+  void SetNull() { rr_ = 0; }
 
   /**====================================
    * ticket Queue Methods
    * ===================================*/
 
-  /** Construct an element at \a pos position in the queue */
+  /**
+   * Construct an element in the caller's lane, or the next lane with
+   * space if it is full.
+   *
+   * @return a null qtok if every lane is full
+   * */
   template <typename... Args>
-  HSHM_CROSS_FUN qtok_t emplace(T &tkt) {
-    uint16_t rr = rr_tail_.fetch_add(1);
-    auto &splits = (*splits_);
+  HSHM_CROSS_FUN qtok_t emplace(Args &&...args) {
+    vector_t &splits = (*splits_);
     size_t num_splits = splits.size();
-    uint16_t qid_start = rr % num_splits;
+    size_t qid_start = GetLane(num_splits);
     for (size_t i = 0; i < num_splits; ++i) {
-      uint32_t qid = (qid_start + i) % num_splits;
-      ticket_queue_t &queue = (*splits_)[qid];
-      qtok_t qtok = queue.emplace(tkt);
+      size_t qid = (qid_start + i) % num_splits;
+      // A full lane does not consume args, so they can be retried
+      qtok_t qtok = splits[qid].emplace(std::forward<Args>(args)...);
       if (!qtok.IsNull()) {
         return qtok;
       }
@@ -194,24 +208,75 @@ class split_ticket_queue : public ShmContainer {
     return qtok_t::GetNull();
   }
 
- public:
-  /** Pop an element from the queue */
+  /** Push an element in the queue (wrapper) */
+  template <typename... Args>
+  HSHM_INLINE_CROSS_FUN qtok_t push(Args &&...args) {
+    return emplace(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Pop an element from the caller's lane, or steal one from the next
+   * non-empty lane.
+   *
+   * @return a null qtok if every lane is empty
+   * */
   HSHM_CROSS_FUN
   qtok_t pop(T &tkt) {
-    uint16_t rr = rr_head_.fetch_add(1);
-    auto &splits = (*splits_);
+    vector_t &splits = (*splits_);
     size_t num_splits = splits.size();
-    uint16_t qid_start = rr % num_splits;
+    size_t qid_start = GetLane(num_splits);
     for (size_t i = 0; i < num_splits; ++i) {
-      uint32_t qid = (qid_start + i) % num_splits;
-      ticket_queue_t &queue = (*splits_)[qid];
-      qtok_t qtok = queue.pop(tkt);
+      size_t qid = (qid_start + i) % num_splits;
+      qtok_t qtok = splits[qid].pop(tkt);
       if (!qtok.IsNull()) {
         return qtok;
       }
     }
     return qtok_t::GetNull();
   }
+
+  /** Get the number of lanes */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetNumLanes() const { return (*splits_).size(); }
+
+  /** Get size at this moment. Approximate under concurrency. */
+  HSHM_CROSS_FUN
+  size_t GetSize() const {
+    const vector_t &splits = (*splits_);
+    size_t size = 0;
+    for (size_t i = 0; i < splits.size(); ++i) {
+      size += splits[i].GetSize();
+    }
+    return size;
+  }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() const { return GetSize(); }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t Size() const { return GetSize(); }
+
+ private:
+  /**
+   * The lane of the calling thread: its current CPU where the OS reports
+   * it cheaply, and otherwise a lane assigned to the thread on first use.
+   * */
+  HSHM_INLINE_CROSS_FUN size_t GetLane(size_t num_splits) {
+#ifdef HSHM_IS_HOST
+#ifdef HSHM_ENABLE_SCHED_GETCPU
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+      return (size_t)cpu % num_splits;
+    }
+#endif
+    static thread_local hshm::u64 lane = rr_.fetch_add(1);
+    return (size_t)(lane % num_splits);
+#else
+    return (size_t)(rr_.fetch_add(1) % num_splits);
+#endif
+  }
 };
 
 }  // namespace hshm::ipc
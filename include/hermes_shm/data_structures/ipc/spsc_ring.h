@@ -0,0 +1,409 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_SPSC_RING_H_
+#define HSHM_DATA_STRUCTURES_IPC_SPSC_RING_H_
+
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/qtok.h"
+
+namespace hshm::ipc {
+
+/** Forward declaration of spsc_ring */
+template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class spsc_ring;
+
+/**
+ * MACROS used to simplify the spsc_ring namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME spsc_ring
+#define CLASS_NEW_ARGS T
+
+/**
+ * A bounded queue for exactly one producer and one consumer, built for
+ * streaming between cores or processes.
+ *
+ * The producer owns tail_ and the consumer owns head_, and each index
+ * sits on its own cache line. Each side also keeps a private copy of the
+ * other side's index on its own line, and only reloads the shared index
+ * when the copy says the ring is full (producer) or empty (consumer). In
+ * steady state the only cache line traffic is the slots themselves.
+ *
+ * Slots are plain contiguous Ts with no per-slot flag: the release store
+ * of an index publishes every slot before it. The depth is rounded up to
+ * a power of two so positions map to slots with a mask. push fails when
+ * the ring is full and pop when it is empty.
+ * */
+template <typename T, HSHM_CLASS_TEMPL>
+class spsc_ring : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+
+  /**====================================
+   * Typedefs
+   * ===================================*/
+  typedef delay_ar<T> slot_t;
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  OffsetPointer slots_;
+  hshm::u64 mask_;
+  char pad0_[HSHM_CACHE_LINE_SIZE];
+  /** Producer line: the tail and the producer's copy of the head */
+  ipc::atomic<hshm::u64> tail_;
+  hshm::u64 head_cache_;
+  char pad1_[HSHM_CACHE_LINE_SIZE - sizeof(ipc::atomic<hshm::u64>) -
+             sizeof(hshm::u64)];
+  /** Consumer line: the head and the consumer's copy of the tail */
+  ipc::atomic<hshm::u64> head_;
+  hshm::u64 tail_cache_;
+  char pad2_[HSHM_CACHE_LINE_SIZE - sizeof(ipc::atomic<hshm::u64>) -
+             sizeof(hshm::u64)];
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit spsc_ring(size_t depth = 1024) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), depth);
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit spsc_ring(const hipc::CtxAllocator<AllocT> &alloc,
+                     size_t depth = 1024) {
+    shm_init(alloc, depth);
+  }
+
+  /** SHM Constructor. */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc, size_t depth = 1024) {
+    init_shm_container(alloc);
+    SetNull();
+    AllocateSlots(depth);
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit spsc_ring(const spsc_ring &other) {
+    init_shm_container(other.GetCtxAllocator());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit spsc_ring(const hipc::CtxAllocator<AllocT> &alloc,
+                     const spsc_ring &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  spsc_ring &operator=(const spsc_ring &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** SHM copy constructor + operator main. Not safe under modification. */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const spsc_ring &other) {
+    AllocateSlots(other.GetDepth());
+    slot_t *slots = other.GetSlots();
+    for (hshm::u64 pos = other.head_.load(); pos != other.tail_.load();
+         ++pos) {
+      emplace(slots[pos & other.mask_].get_ref());
+    }
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  spsc_ring(spsc_ring &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  spsc_ring(const hipc::CtxAllocator<AllocT> &alloc,
+            spsc_ring &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  spsc_ring &operator=(spsc_ring &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  spsc_ring &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      slots_ = other.slots_;
+      mask_ = other.mask_;
+      tail_ = other.tail_.load();
+      head_ = other.head_.load();
+      head_cache_ = head_.load();
+      tail_cache_ = tail_.load();
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. Destroys the values still in the ring. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() {
+    slot_t *slots = GetSlots();
+    for (hshm::u64 pos = head_.load(); pos != tail_.load(); ++pos) {
+      slots[pos & mask_].shm_destroy();
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    alloc->Free(alloc.ctx_, slots_);
+  }
+
+  /** Check if the ring is empty */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return slots_.IsNull(); }
+
+  /** Sets this ring as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {
+    slots_.SetNull();
+    mask_ = 0;
+    tail_ = 0;
+    head_cache_ = 0;
+    head_ = 0;
+    tail_cache_ = 0;
+  }
+
+  /**====================================
+   * SPSC Ring Methods
+   * ===================================*/
+
+  /**
+   * Construct an element at the tail of the ring. Producer only.
+   *
+   * @return the position of the element, or a null qtok if full
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN qtok_t emplace(Args &&...args) {
+    hshm::u64 tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) {
+        return qtok_t::GetNull();
+      }
+    }
+    slot_t &slot = GetSlots()[tail & mask_];
+    HSHM_MAKE_AR(slot, GetCtxAllocator(), std::forward<Args>(args)...)
+    tail_.store(tail + 1, std::memory_order_release);
+    return qtok_t(tail);
+  }
+
+  /** Push an element in the ring (wrapper) */
+  template <typename... Args>
+  HSHM_INLINE_CROSS_FUN qtok_t push(Args &&...args) {
+    return emplace(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Pop the element at the head of the ring. Consumer only.
+   *
+   * @return the position of the element, or a null qtok if empty
+   * */
+  HSHM_CROSS_FUN
+  qtok_t pop(T &val) {
+    hshm::u64 head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        return qtok_t::GetNull();
+      }
+    }
+    slot_t &slot = GetSlots()[head & mask_];
+    val = std::move(slot.get_ref());
+    slot.shm_destroy();
+    head_.store(head + 1, std::memory_order_release);
+    return qtok_t(head);
+  }
+
+  /** Pop the element at the head of the ring and discard it */
+  HSHM_CROSS_FUN
+  qtok_t pop() {
+    T val;
+    return pop(val);
+  }
+
+  /**
+   * Construct up to \a n elements at the tail, copying or moving from
+   * \a first. Producer only. The whole run is published by one store
+   * to tail_.
+   *
+   * @return the number of elements pushed, which is less than \a n if
+   * the ring filled up
+   * */
+  template <typename IterT>
+  HSHM_CROSS_FUN size_t emplace_n(IterT first, size_t n) {
+    hshm::u64 tail = tail_.load(std::memory_order_relaxed);
+    hshm::u64 depth = mask_ + 1;
+    if (depth - (tail - head_cache_) < n) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+    }
+    size_t count = (size_t)(depth - (tail - head_cache_));
+    if (count > n) {
+      count = n;
+    }
+    if (count == 0) {
+      return 0;
+    }
+    slot_t *slots = GetSlots();
+    for (size_t i = 0; i < count; ++i, ++first) {
+      HSHM_MAKE_AR(slots[(tail + i) & mask_], GetCtxAllocator(), *first)
+    }
+    tail_.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  /** Push up to \a n elements from \a vals (wrapper) */
+  HSHM_INLINE_CROSS_FUN size_t push_n(const T *vals, size_t n) {
+    return emplace_n(vals, n);
+  }
+
+  /**
+   * Pop up to \a max elements from the head into \a out. Consumer only.
+   * The whole run is released by one store to head_.
+   *
+   * @return the number of elements popped
+   * */
+  HSHM_CROSS_FUN
+  size_t pop_n(T *out, size_t max) {
+    hshm::u64 head = head_.load(std::memory_order_relaxed);
+    if (tail_cache_ - head < max) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+    }
+    size_t count = (size_t)(tail_cache_ - head);
+    if (count > max) {
+      count = max;
+    }
+    if (count == 0) {
+      return 0;
+    }
+    slot_t *slots = GetSlots();
+    for (size_t i = 0; i < count; ++i) {
+      slot_t &slot = slots[(head + i) & mask_];
+      out[i] = std::move(slot.get_ref());
+      slot.shm_destroy();
+    }
+    head_.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  /** Get ring depth */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetDepth() const { return (size_t)(mask_ + 1); }
+
+  /** Get size at this moment. Approximate under concurrency. */
+  HSHM_CROSS_FUN
+  size_t GetSize() const {
+    hshm::u64 head = head_.load();
+    hshm::u64 tail = tail_.load();
+    if (tail < head) {
+      return 0;
+    }
+    return (size_t)(tail - head);
+  }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() const { return GetSize(); }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t Size() const { return GetSize(); }
+
+ private:
+  /** Get the slots */
+  HSHM_INLINE_CROSS_FUN slot_t *GetSlots() const {
+    return GetAllocator()->template Convert<slot_t>(slots_);
+  }
+
+  /** Allocate at least \a depth slots, rounded up to a power of two */
+  HSHM_CROSS_FUN void AllocateSlots(size_t depth) {
+    size_t pow2 = 1;
+    while (pow2 < depth) {
+      pow2 <<= 1;
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = pow2 * sizeof(slot_t);
+    slots_ = alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (slots_.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    mask_ = pow2 - 1;
+    tail_ = 0;
+    head_cache_ = 0;
+    head_ = 0;
+    tail_cache_ = 0;
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using spsc_ring = hipc::spsc_ring<T, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_SPSC_RING_H_
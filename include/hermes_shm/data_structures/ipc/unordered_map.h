@@ -42,6 +42,7 @@ struct unordered_map_iterator {
   unordered_map<Key, T, Hash, HSHM_CLASS_TEMPL_ARGS> *map_;
   typename BUCKET_VEC_T::iterator_t bucket_;
   typename COLLISION_LIST_T::iterator_t collision_;
+  bool old_ = false; /**< Whether bucket_ is in the buckets being migrated */
 
   /** Default constructor */
   HSHM_CROSS_FUN unordered_map_iterator() = default;
@@ -72,6 +73,7 @@ struct unordered_map_iterator {
     map_ = other.map_;
     bucket_ = other.bucket_;
     collision_ = other.collision_;
+    old_ = other.old_;
   }
 
   /** Get the pointed object */
@@ -99,21 +101,29 @@ struct unordered_map_iterator {
   /**
    * Shifts bucket and collision iterator until there is a valid element.
    * Returns true if such an element is found, and false otherwise.
+   * During a rehash, the buckets being migrated are visited first.
    * */
   HSHM_INLINE_CROSS_FUN bool make_correct() {
     do {
       if (bucket_.is_end()) {
-        return false;
+        if (!old_) {
+          return false;
+        }
+        old_ = false;
+        bucket_ = map_->GetBuckets().begin();
+        if (bucket_.is_end()) {
+          return false;
+        }
+        collision_ = (*bucket_).begin();
       }
       if (!collision_.is_end()) {
         return true;
       } else {
         ++bucket_;
-        if (bucket_.is_end()) {
-          return false;
+        if (!bucket_.is_end()) {
+          BUCKET_T &bkt = *bucket_;
+          collision_ = bkt.begin();
         }
-        BUCKET_T &bkt = *bucket_;
-        collision_ = bkt.begin();
       }
     } while (true);
   }
@@ -124,7 +134,8 @@ struct unordered_map_iterator {
     if (a.is_end() && b.is_end()) {
       return true;
     }
-    return (a.bucket_ == b.bucket_) && (a.collision_ == b.collision_);
+    return (a.old_ == b.old_) && (a.bucket_ == b.bucket_) &&
+           (a.collision_ == b.collision_);
   }
 
   /** Check if two iterators are inequal */
@@ -133,14 +144,20 @@ struct unordered_map_iterator {
     if (a.is_end() && b.is_end()) {
       return false;
     }
-    return (a.bucket_ != b.bucket_) || (a.collision_ != b.collision_);
+    return (a.old_ != b.old_) || (a.bucket_ != b.bucket_) ||
+           (a.collision_ != b.collision_);
   }
 
   /** Determine whether this iterator is the end iterator */
-  HSHM_INLINE_CROSS_FUN bool is_end() const { return bucket_.is_end(); }
+  HSHM_INLINE_CROSS_FUN bool is_end() const {
+    return !old_ && bucket_.is_end();
+  }
 
   /** Set this iterator to the end iterator */
-  HSHM_INLINE_CROSS_FUN void set_end() { bucket_.set_end(); }
+  HSHM_INLINE_CROSS_FUN void set_end() {
+    old_ = false;
+    bucket_ = map_->GetBuckets().end();
+  }
 };
 
 /**
@@ -153,6 +170,14 @@ struct unordered_map_iterator {
 
 /**
  * The unordered map implementation
+ *
+ * Growth is incremental. When the load exceeds \a max_capacity_, the
+ * current buckets are set aside as \a old_buckets_ and a larger bucket
+ * vector takes their place. Each later emplace or erase migrates a few of
+ * the old buckets, and lookups consult both vectors until the migration
+ * completes. This bounds the latency of any single operation. If the load
+ * exceeds \a max_capacity_ again before the migration completes, the next
+ * growth waits for it, and emplaces migrate at twice the pace meanwhile.
  * */
 template <typename Key, typename T, class Hash, HSHM_CLASS_TEMPL>
 class unordered_map : public ShmContainer {
@@ -168,14 +193,20 @@ class unordered_map : public ShmContainer {
   using COLLISION_T = hipc::pair<Key, T, HSHM_CLASS_TEMPL_ARGS>;
   using BUCKET_T = hipc::slist<COLLISION_T, HSHM_CLASS_TEMPL_ARGS>;
   using BUCKET_VEC_T = hipc::vector<BUCKET_T, HSHM_CLASS_TEMPL_ARGS>;
+  /** The number of old buckets migrated per emplace or erase */
+  CLS_CONST size_t kRehashBuckets = 8;
+  /** The number of keys find_many keeps in flight */
+  CLS_CONST size_t kFindBatch = 16;
 
   /**====================================
    * Variables
    * ===================================*/
   delay_ar<BUCKET_VEC_T> buckets_;
+  delay_ar<BUCKET_VEC_T> old_buckets_;
   RealNumber max_capacity_;
   RealNumber growth_;
   hipc::nonatomic<hshm::size_t> length_;
+  size_t rehash_off_;
 
  public:
   /**====================================
@@ -222,9 +253,11 @@ class unordered_map : public ShmContainer {
                 RealNumber growth = RealNumber(5, 4)) {
     init_shm_container(alloc);
     HSHM_MAKE_AR(buckets_, GetCtxAllocator(), num_buckets)
+    HSHM_MAKE_AR(old_buckets_, GetCtxAllocator(), 0)
     max_capacity_ = max_capacity;
     growth_ = growth;
     length_ = 0;
+    rehash_off_ = 0;
   }
 
   /**====================================
@@ -251,6 +284,8 @@ class unordered_map : public ShmContainer {
   void shm_strong_copy_construct(const unordered_map &other) {
     SetNull();
     HSHM_MAKE_AR(buckets_, GetCtxAllocator(), other.GetBuckets())
+    HSHM_MAKE_AR(old_buckets_, GetCtxAllocator(), 0)
+    rehash_off_ = 0;
     shm_strong_copy_op(other);
   }
 
@@ -269,6 +304,7 @@ class unordered_map : public ShmContainer {
   void shm_strong_copy_op(const unordered_map &other) {
     int num_buckets = other.get_num_buckets();
     GetBuckets().resize(num_buckets);
+    length_ = 0;
     max_capacity_ = other.max_capacity_;
     growth_ = other.growth_;
     for (hipc::pair<Key, T, HSHM_CLASS_TEMPL_ARGS> &entry : other) {
@@ -310,13 +346,17 @@ class unordered_map : public ShmContainer {
     if (GetAllocator() == other.GetAllocator()) {
       if constexpr (IS_ASSIGN) {
         GetBuckets() = std::move(other.GetBuckets());
+        GetOldBuckets() = std::move(other.GetOldBuckets());
       } else {
         HSHM_MAKE_AR(buckets_, GetCtxAllocator(),
                      std::move(other.GetBuckets()));
+        HSHM_MAKE_AR(old_buckets_, GetCtxAllocator(),
+                     std::move(other.GetOldBuckets()));
       }
       max_capacity_ = other.max_capacity_;
       growth_ = other.growth_;
       length_ = other.length_.load();
+      rehash_off_ = other.rehash_off_;
       other.SetNull();
     } else {
       shm_strong_copy_op(other);
@@ -332,12 +372,16 @@ class unordered_map : public ShmContainer {
   HSHM_INLINE_CROSS_FUN bool IsNull() { return buckets_->IsNull(); }
 
   /** Sets this pair as empty */
-  HSHM_INLINE_CROSS_FUN void SetNull() { buckets_->SetNull(); }
+  HSHM_INLINE_CROSS_FUN void SetNull() {
+    buckets_->SetNull();
+    old_buckets_->SetNull();
+  }
 
   /** Destroy the unordered_map buckets */
   HSHM_INLINE_CROSS_FUN void shm_destroy_main() {
     BUCKET_VEC_T &buckets = GetBuckets();
     buckets.shm_destroy();
+    GetOldBuckets().shm_destroy();
   }
 
   /**====================================
@@ -381,18 +425,30 @@ class unordered_map : public ShmContainer {
    * */
   template <bool growth, bool modify_existing, typename... Args>
   HSHM_INLINE_CROSS_FUN bool emplace_templ(const Key &key, Args &&...args) {
+    if constexpr (growth) {
+      RehashStep();
+    }
+
     // Hash the key to a bucket
+    size_t hash = Hash{}(key);
     BUCKET_VEC_T &buckets = GetBuckets();
-    size_t bkt_id = Hash{}(key) % buckets.size();
+    size_t bkt_id = hash_reduce(hash, buckets.size());
     BUCKET_T &bkt = (buckets)[bkt_id];
 
     // Insert into the map
+    BUCKET_T *has_key_bkt = &bkt;
     auto has_key_iter = find_collision(key, bkt);
+    if (has_key_iter.is_end()) {
+      has_key_bkt = find_old_bucket(hash);
+      if (has_key_bkt) {
+        has_key_iter = find_collision(key, *has_key_bkt);
+      }
+    }
     if (!has_key_iter.is_end()) {
       if constexpr (!modify_existing) {
         return false;
       } else {
-        bkt.erase(has_key_iter);
+        has_key_bkt->erase(has_key_iter);
         --length_;
       }
     }
@@ -401,6 +457,15 @@ class unordered_map : public ShmContainer {
 
     // Increment the size of the map
     ++length_;
+    if constexpr (growth) {
+      if (length_.load() > (max_capacity_ * buckets.size()).as_int()) {
+        if (is_rehashing()) {
+          RehashStep();
+        } else {
+          RehashBegin();
+        }
+      }
+    }
     return true;
   }
 
@@ -414,17 +479,27 @@ class unordered_map : public ShmContainer {
    * */
   HSHM_CROSS_FUN
   void erase(const Key &key) {
+    RehashStep();
+
     // Get the bucket the key belongs to
+    size_t hash = Hash{}(key);
     BUCKET_VEC_T &buckets = GetBuckets();
-    size_t bkt_id = Hash{}(key) % buckets.size();
-    BUCKET_T &bkt = (buckets)[bkt_id];
+    size_t bkt_id = hash_reduce(hash, buckets.size());
+    BUCKET_T *bkt = &(buckets)[bkt_id];
 
     // Find and remove key from collision slist
-    auto iter = find_collision(key, bkt);
+    auto iter = find_collision(key, *bkt);
     if (iter.is_end()) {
-      return;
+      bkt = find_old_bucket(hash);
+      if (!bkt) {
+        return;
+      }
+      iter = find_collision(key, *bkt);
+      if (iter.is_end()) {
+        return;
+      }
     }
-    bkt.erase(iter);
+    bkt->erase(iter);
 
     // Decrement the size of the map
     --length_;
@@ -454,6 +529,8 @@ class unordered_map : public ShmContainer {
     size_t num_buckets = buckets.size();
     buckets.clear();
     buckets.resize(num_buckets);
+    GetOldBuckets().shm_destroy();
+    rehash_off_ = 0;
     length_ = 0;
   }
 
@@ -477,23 +554,138 @@ class unordered_map : public ShmContainer {
 
   /** Find an object in the unordered_map */
   HSHM_CROSS_FUN
-  iterator_t find(const Key &key) {
+  iterator_t find(const Key &key) { return find_hashed(key, Hash{}(key)); }
+
+  /**
+   * Find many objects in the unordered_map. Keys are pipelined in
+   * batches of kFindBatch: while one batch is hashed and its buckets are
+   * prefetched, the first collisions of the previous batch are
+   * prefetched, and the batch before that is compared. Each prefetch has
+   * a full batch of work to hide behind, and the cache misses of
+   * independent keys overlap instead of being paid one after another.
+   *
+   * @param keys the keys to find
+   * @param n the number of keys
+   * @param out the iterator of each key, or end() if it is not in the map
+   * */
+  HSHM_CROSS_FUN
+  void find_many(const Key *keys, size_t n, iterator_t *out) {
+    FindPipelined(keys, n, [out](size_t i, const iterator_t &iter) {
+      out[i] = iter;
+    });
+  }
+
+  /**
+   * Check whether many keys are in the unordered_map.
+   * Batched in the same way as find_many.
+   *
+   * @param keys the keys to check
+   * @param n the number of keys
+   * @param out whether each key is in the map
+   * @return the number of keys found
+   * */
+  HSHM_CROSS_FUN
+  size_t contains_many(const Key *keys, size_t n, bool *out) {
+    size_t found = 0;
+    FindPipelined(keys, n, [out, &found](size_t i, const iterator_t &iter) {
+      out[i] = !iter.is_end();
+      found += out[i];
+    });
+    return found;
+  }
+
+  /** Find an object in the unordered_map given the hash of its key */
+  HSHM_CROSS_FUN
+  iterator_t find_hashed(const Key &key, size_t hash) {
     iterator_t iter(*this);
 
     // Determine the bucket corresponding to the key
     BUCKET_VEC_T &buckets = GetBuckets();
-    size_t bkt_id = Hash{}(key) % buckets.size();
+    size_t bkt_id = hash_reduce(hash, buckets.size());
     iter.bucket_ = buckets.begin() + bkt_id;
     BUCKET_T &bkt = (*iter.bucket_);
 
     // Get the specific collision iterator
     iter.collision_ = find_collision(key, bkt);
+    if (iter.collision_.is_end() && find_old_bucket(hash)) {
+      // The key may not have been migrated yet
+      BUCKET_VEC_T &old_buckets = GetOldBuckets();
+      iter.old_ = true;
+      iter.bucket_ =
+          old_buckets.begin() + hash_reduce(hash, old_buckets.size());
+      iter.collision_ = find_collision(key, *iter.bucket_);
+    }
     if (iter.collision_.is_end()) {
       iter.set_end();
     }
     return iter;
   }
 
+  /**
+   * Find \a n keys as a three-stage pipeline over batches of kFindBatch
+   * and call \a visit(index, iterator) for each key in order.
+   * */
+  template <typename FUNC>
+  HSHM_INLINE_CROSS_FUN void FindPipelined(const Key *keys, size_t n,
+                                           FUNC &&visit) {
+    size_t hashes[3][kFindBatch];
+    size_t num_batches = (n + kFindBatch - 1) / kFindBatch;
+    for (size_t step = 0; step < num_batches + 2; ++step) {
+      if (step < num_batches) {
+        PrefetchBuckets(keys, n, step, hashes[step % 3]);
+      }
+      if (step >= 1 && step - 1 < num_batches) {
+        PrefetchCollisions(n, step - 1, hashes[(step - 1) % 3]);
+      }
+      if (step >= 2) {
+        size_t off = (step - 2) * kFindBatch;
+        size_t count = BatchSize(n, step - 2);
+        size_t *batch = hashes[(step - 2) % 3];
+        for (size_t i = 0; i < count; ++i) {
+          visit(off + i, find_hashed(keys[off + i], batch[i]));
+        }
+      }
+    }
+  }
+
+  /** The number of keys in batch \a batch of \a n keys */
+  HSHM_INLINE_CROSS_FUN static size_t BatchSize(size_t n, size_t batch) {
+    size_t off = batch * kFindBatch;
+    return n - off < kFindBatch ? n - off : kFindBatch;
+  }
+
+  /** Hash the keys of batch \a batch and prefetch their buckets */
+  HSHM_INLINE_CROSS_FUN void PrefetchBuckets(const Key *keys, size_t n,
+                                             size_t batch, size_t *hashes) {
+    BUCKET_VEC_T &buckets = GetBuckets();
+    delay_ar<BUCKET_T> *data = buckets.data_ar();
+    size_t num_buckets = buckets.size();
+    size_t off = batch * kFindBatch;
+    size_t count = BatchSize(n, batch);
+    for (size_t i = 0; i < count; ++i) {
+      hashes[i] = Hash{}(keys[off + i]);
+      HSHM_PREFETCH(&data[hash_reduce(hashes[i], num_buckets)]);
+    }
+  }
+
+  /**
+   * Prefetch the first collision of each bucket of batch \a batch. Its
+   * buckets were prefetched one batch earlier.
+   * */
+  HSHM_INLINE_CROSS_FUN void PrefetchCollisions(size_t n, size_t batch,
+                                                const size_t *hashes) {
+    BUCKET_VEC_T &buckets = GetBuckets();
+    delay_ar<BUCKET_T> *data = buckets.data_ar();
+    size_t num_buckets = buckets.size();
+    size_t count = BatchSize(n, batch);
+    for (size_t i = 0; i < count; ++i) {
+      auto iter = data[hash_reduce(hashes[i], num_buckets)].get_ref().begin();
+      if (!iter.is_end()) {
+        HSHM_PREFETCH(iter.entry_);
+      }
+    }
+  }
+
   /** Find a key in the collision slist */
   typename BUCKET_T::iterator_t HSHM_INLINE_CROSS_FUN
   find_collision(const Key &key, BUCKET_T &bkt) {
@@ -521,6 +713,18 @@ class unordered_map : public ShmContainer {
     return buckets.size();
   }
 
+  /** Whether old buckets are still being migrated */
+  HSHM_INLINE_CROSS_FUN bool is_rehashing() const {
+    return GetOldBuckets().size() != 0;
+  }
+
+  /** Migrate all remaining old buckets */
+  HSHM_CROSS_FUN void rehash_finish() {
+    while (is_rehashing()) {
+      RehashStep();
+    }
+  }
+
  public:
   /**====================================
    * Iterators
@@ -529,11 +733,12 @@ class unordered_map : public ShmContainer {
   /** Forward iterator begin */
   HSHM_INLINE_CROSS_FUN iterator_t begin() const {
     iterator_t iter(const_cast<unordered_map &>(*this));
-    BUCKET_VEC_T &buckets(GetBuckets());
+    BUCKET_VEC_T &buckets(is_rehashing() ? GetOldBuckets() : GetBuckets());
     if (buckets.size() == 0) {
       return iter;
     }
     BUCKET_T &bkt = buckets[0];
+    iter.old_ = is_rehashing();
     iter.bucket_ = buckets.cbegin();
     iter.collision_ = bkt.begin();
     iter.make_correct();
@@ -555,6 +760,74 @@ class unordered_map : public ShmContainer {
   HSHM_INLINE_CROSS_FUN BUCKET_VEC_T &GetBuckets() const {
     return const_cast<BUCKET_VEC_T &>(*buckets_);
   }
+
+  /** Get the buckets being migrated */
+  HSHM_INLINE_CROSS_FUN BUCKET_VEC_T &GetOldBuckets() const {
+    return const_cast<BUCKET_VEC_T &>(*old_buckets_);
+  }
+
+  /**====================================
+   * Rehashing
+   * ===================================*/
+ private:
+  /**
+   * Get the old bucket of a hash if it has not been migrated yet
+   *
+   * @return the bucket or nullptr
+   * */
+  HSHM_INLINE_CROSS_FUN BUCKET_T *find_old_bucket(size_t hash) {
+    if (!is_rehashing()) {
+      return nullptr;
+    }
+    BUCKET_VEC_T &old_buckets = GetOldBuckets();
+    size_t bkt_id = hash_reduce(hash, old_buckets.size());
+    if (bkt_id < rehash_off_) {
+      return nullptr;
+    }
+    return &old_buckets[bkt_id];
+  }
+
+  /**
+   * Set the current buckets aside and allocate a larger bucket vector.
+   * The previous migration must be complete.
+   * */
+  HSHM_CROSS_FUN void RehashBegin() {
+    BUCKET_VEC_T &buckets = GetBuckets();
+    size_t num_buckets = buckets.size();
+    size_t new_num_buckets = (growth_ * num_buckets).as_int();
+    if (new_num_buckets <= num_buckets) {
+      new_num_buckets = num_buckets + 1;
+    }
+    GetOldBuckets().shm_destroy();
+    GetOldBuckets() = std::move(buckets);
+    buckets.resize(new_num_buckets);
+    rehash_off_ = 0;
+  }
+
+  /** Migrate the next kRehashBuckets old buckets */
+  HSHM_CROSS_FUN void RehashStep() {
+    if (!is_rehashing()) {
+      return;
+    }
+    BUCKET_VEC_T &buckets = GetBuckets();
+    BUCKET_VEC_T &old_buckets = GetOldBuckets();
+    size_t end_off = rehash_off_ + kRehashBuckets;
+    if (end_off > old_buckets.size()) {
+      end_off = old_buckets.size();
+    }
+    for (; rehash_off_ < end_off; ++rehash_off_) {
+      BUCKET_T &old_bkt = old_buckets[rehash_off_];
+      while (old_bkt.size()) {
+        size_t bkt_id =
+            hash_reduce(Hash{}(old_bkt.front().GetKey()), buckets.size());
+        buckets[bkt_id].splice_front(old_bkt);
+      }
+    }
+    if (rehash_off_ == old_buckets.size()) {
+      old_buckets.shm_destroy();
+      rehash_off_ = 0;
+    }
+  }
 };
 
 }  // namespace hshm::ipc
@@ -0,0 +1,416 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_DATA_STRUCTURES_IPC_WS_DEQUE_H_
+#define HSHM_DATA_STRUCTURES_IPC_WS_DEQUE_H_
+
+#include <type_traits>
+
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/data_structures/internal/shm_internal.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/qtok.h"
+
+namespace hshm::ipc {
+
+/**
+ * The header of a ws_deque slot array. The slots follow the header.
+ * Arrays replaced by a grow are retired (not freed) until the deque is
+ * destroyed, since a thief may still be reading from them.
+ * */
+struct ws_deque_array {
+  OffsetPointer retired_;
+  hshm::u64 mask_;
+
+  /** Get the slots */
+  template <typename T>
+  HSHM_INLINE_CROSS_FUN T *GetSlots() {
+    return reinterpret_cast<T *>(this + 1);
+  }
+};
+
+/** Forward declaration of ws_deque */
+template <typename T, HSHM_CLASS_TEMPL_WITH_DEFAULTS>
+class ws_deque;
+
+/**
+ * MACROS used to simplify the ws_deque namespace
+ * Used as inputs to the HIPC_CONTAINER_TEMPLATE
+ * */
+#define CLASS_NAME ws_deque
+#define CLASS_NEW_ARGS T
+
+/**
+ * A Chase-Lev work-stealing deque. One owner pushes and pops at the
+ * bottom (LIFO), and any number of thieves steal from the top (FIFO).
+ * Thieves may be in other processes.
+ *
+ * The owner's push and pop touch only bottom_ unless the deque is down
+ * to its last element, where the owner races thieves with a CAS on top_.
+ * Thieves claim elements with a CAS on top_. top_ and bottom_ are on
+ * separate cache lines.
+ *
+ * The slot array grows by doubling when the owner pushes to a full
+ * deque, so push never fails. A thief copies a slot before its CAS
+ * decides whether the element was really claimed, so T must be
+ * trivially copyable. Tasks are usually pointers or small handles.
+ * */
+template <typename T, HSHM_CLASS_TEMPL>
+class ws_deque : public ShmContainer {
+ public:
+  HIPC_CONTAINER_TEMPLATE((CLASS_NAME), (CLASS_NEW_ARGS))
+  static_assert(std::is_trivially_copyable_v<T>,
+                "Thieves copy slots speculatively, so T must be trivially "
+                "copyable");
+
+ public:
+  /**====================================
+   * Variables
+   * ===================================*/
+  AtomicOffsetPointer array_;
+  OffsetPointer retired_;
+  char pad0_[HSHM_CACHE_LINE_SIZE];
+  /** Thief line */
+  ipc::atomic<hshm::i64> top_;
+  char pad1_[HSHM_CACHE_LINE_SIZE - sizeof(ipc::atomic<hshm::i64>)];
+  /** Owner line */
+  ipc::atomic<hshm::i64> bottom_;
+  char pad2_[HSHM_CACHE_LINE_SIZE - sizeof(ipc::atomic<hshm::i64>)];
+
+ public:
+  /**====================================
+   * Default Constructor
+   * ===================================*/
+
+  /** Constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit ws_deque(size_t depth = 1024) {
+    shm_init(HSHM_MEMORY_MANAGER->GetDefaultAllocator<AllocT>(), depth);
+  }
+
+  /** SHM constructor. Default. */
+  HSHM_CROSS_FUN
+  explicit ws_deque(const hipc::CtxAllocator<AllocT> &alloc,
+                    size_t depth = 1024) {
+    shm_init(alloc, depth);
+  }
+
+  /**
+   * SHM Constructor.
+   *
+   * @param depth the initial number of slots, rounded up to a power of
+   * two. The deque grows past it as needed.
+   * */
+  HSHM_CROSS_FUN
+  void shm_init(const hipc::CtxAllocator<AllocT> &alloc, size_t depth = 1024) {
+    init_shm_container(alloc);
+    SetNull();
+    array_.off_ = AllocateArray(depth).off_.load();
+  }
+
+  /**====================================
+   * Copy Constructors
+   * ===================================*/
+
+  /** Copy constructor */
+  HSHM_CROSS_FUN
+  explicit ws_deque(const ws_deque &other) {
+    init_shm_container(other.GetCtxAllocator());
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy constructor */
+  HSHM_CROSS_FUN
+  explicit ws_deque(const hipc::CtxAllocator<AllocT> &alloc,
+                    const ws_deque &other) {
+    init_shm_container(alloc);
+    SetNull();
+    shm_strong_copy_op(other);
+  }
+
+  /** SHM copy assignment operator */
+  HSHM_CROSS_FUN
+  ws_deque &operator=(const ws_deque &other) {
+    if (this != &other) {
+      shm_destroy();
+      shm_strong_copy_op(other);
+    }
+    return *this;
+  }
+
+  /** SHM copy constructor + operator main. Not safe under modification. */
+  HSHM_CROSS_FUN
+  void shm_strong_copy_op(const ws_deque &other) {
+    array_.off_ = AllocateArray(other.GetDepth()).off_.load();
+    ws_deque_array *src = other.GetArray();
+    for (hshm::i64 pos = other.top_.load(); pos < other.bottom_.load();
+         ++pos) {
+      emplace(src->template GetSlots<T>()[pos & src->mask_]);
+    }
+  }
+
+  /**====================================
+   * Move Constructors
+   * ===================================*/
+
+  /** Move constructor. */
+  HSHM_CROSS_FUN
+  ws_deque(ws_deque &&other) noexcept {
+    shm_move_op<false>(other.GetCtxAllocator(), std::move(other));
+  }
+
+  /** SHM move constructor. */
+  HSHM_CROSS_FUN
+  ws_deque(const hipc::CtxAllocator<AllocT> &alloc, ws_deque &&other) noexcept {
+    shm_move_op<false>(alloc, std::move(other));
+  }
+
+  /** SHM move assignment operator. */
+  HSHM_CROSS_FUN
+  ws_deque &operator=(ws_deque &&other) noexcept {
+    if (this != &other) {
+      shm_move_op<true>(GetCtxAllocator(), std::move(other));
+    }
+    return *this;
+  }
+
+  /** SHM move operator. Not safe while other is being accessed. */
+  template <bool IS_ASSIGN>
+  HSHM_CROSS_FUN void shm_move_op(const hipc::CtxAllocator<AllocT> &alloc,
+                                  ws_deque &&other) noexcept {
+    if constexpr (!IS_ASSIGN) {
+      init_shm_container(alloc);
+      SetNull();
+    } else {
+      shm_destroy();
+    }
+    if (GetAllocator() == other.GetAllocator()) {
+      array_.off_ = other.array_.off_.load();
+      retired_ = other.retired_;
+      top_ = other.top_.load();
+      bottom_ = other.bottom_.load();
+      other.SetNull();
+    } else {
+      shm_strong_copy_op(other);
+      other.shm_destroy();
+    }
+  }
+
+  /**====================================
+   * Destructor
+   * ===================================*/
+
+  /** SHM destructor. Frees the current and retired arrays. */
+  HSHM_CROSS_FUN
+  void shm_destroy_main() {
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    OffsetPointer array_p(array_.off_.load());
+    alloc->Free(alloc.ctx_, array_p);
+    while (!retired_.IsNull()) {
+      OffsetPointer next = GetArray(retired_)->retired_;
+      alloc->Free(alloc.ctx_, retired_);
+      retired_ = next;
+    }
+  }
+
+  /** Check if the deque is empty */
+  HSHM_CROSS_FUN
+  bool IsNull() const { return array_.IsNull(); }
+
+  /** Sets this deque as empty */
+  HSHM_CROSS_FUN
+  void SetNull() {
+    array_.SetNull();
+    retired_.SetNull();
+    top_ = 0;
+    bottom_ = 0;
+  }
+
+  /**====================================
+   * Work-Stealing Deque Methods
+   * ===================================*/
+
+  /**
+   * Construct an element at the bottom of the deque. Owner only.
+   * Doubles the slot array if the deque is full.
+   *
+   * @return the position of the element
+   * */
+  template <typename... Args>
+  HSHM_CROSS_FUN qtok_t emplace(Args &&...args) {
+    hshm::i64 bottom = bottom_.load(std::memory_order_relaxed);
+    hshm::i64 top = top_.load(std::memory_order_acquire);
+    ws_deque_array *array = GetArray();
+    if ((hshm::u64)(bottom - top) > array->mask_) {
+      array = Grow(array, top, bottom);
+    }
+    array->template GetSlots<T>()[bottom & array->mask_] =
+        T(std::forward<Args>(args)...);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return qtok_t(bottom);
+  }
+
+  /** Push an element in the deque (wrapper) */
+  template <typename... Args>
+  HSHM_INLINE_CROSS_FUN qtok_t push(Args &&...args) {
+    return emplace(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Pop the most recently pushed element from the bottom. Owner only.
+   *
+   * @return the position of the element, or a null qtok if empty or a
+   * thief took the last element
+   * */
+  HSHM_CROSS_FUN
+  qtok_t pop(T &val) {
+    hshm::i64 bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    ws_deque_array *array = GetArray();
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    hshm::i64 top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return qtok_t::GetNull();
+    }
+    val = array->template GetSlots<T>()[bottom & array->mask_];
+    if (top < bottom) {
+      return qtok_t(bottom);
+    }
+    // Last element: race the thieves for it
+    bool won = top_.compare_exchange_strong(top, top + 1,
+                                            std::memory_order_seq_cst);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return won ? qtok_t(bottom) : qtok_t::GetNull();
+  }
+
+  /** Pop an element from the bottom and discard it */
+  HSHM_CROSS_FUN
+  qtok_t pop() {
+    T val;
+    return pop(val);
+  }
+
+  /**
+   * Steal the oldest element from the top. Any thread or process.
+   *
+   * @return the position of the element, or a null qtok if empty or
+   * another thread claimed the element first
+   * */
+  HSHM_CROSS_FUN
+  qtok_t steal(T &val) {
+    hshm::i64 top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    hshm::i64 bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return qtok_t::GetNull();
+    }
+    ws_deque_array *array = GetArray(
+        OffsetPointer(array_.off_.load(std::memory_order_acquire)));
+    val = array->template GetSlots<T>()[top & array->mask_];
+    if (!top_.compare_exchange_strong(top, top + 1,
+                                      std::memory_order_seq_cst)) {
+      return qtok_t::GetNull();
+    }
+    return qtok_t(top);
+  }
+
+  /** Get the number of slots in the current array */
+  HSHM_INLINE_CROSS_FUN
+  size_t GetDepth() const { return (size_t)(GetArray()->mask_ + 1); }
+
+  /** Get size at this moment. Approximate under concurrency. */
+  HSHM_CROSS_FUN
+  size_t GetSize() const {
+    hshm::i64 top = top_.load();
+    hshm::i64 bottom = bottom_.load();
+    if (bottom < top) {
+      return 0;
+    }
+    return (size_t)(bottom - top);
+  }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t size() const { return GetSize(); }
+
+  /** Get size (wrapper) */
+  HSHM_INLINE_CROSS_FUN
+  size_t Size() const { return GetSize(); }
+
+ private:
+  /** Get the current slot array */
+  HSHM_INLINE_CROSS_FUN ws_deque_array *GetArray() const {
+    return GetArray(OffsetPointer(array_.off_.load()));
+  }
+
+  /** Convert an array pointer */
+  HSHM_INLINE_CROSS_FUN ws_deque_array *GetArray(
+      const OffsetPointer &array_p) const {
+    return GetAllocator()->template Convert<ws_deque_array>(array_p);
+  }
+
+  /** Allocate an array of at least \a depth slots, rounded to a power of 2 */
+  HSHM_CROSS_FUN OffsetPointer AllocateArray(size_t depth) {
+    size_t pow2 = 1;
+    while (pow2 < depth) {
+      pow2 <<= 1;
+    }
+    CtxAllocator<AllocT> alloc = GetCtxAllocator();
+    size_t size = sizeof(ws_deque_array) + pow2 * sizeof(T);
+    OffsetPointer array_p =
+        alloc->template Allocate<OffsetPointer>(alloc.ctx_, size);
+    if (array_p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size,
+                       alloc->GetCurrentlyAllocatedSize());
+    }
+    ws_deque_array *array = GetArray(array_p);
+    array->retired_.SetNull();
+    array->mask_ = pow2 - 1;
+    return array_p;
+  }
+
+  /**
+   * Copy the live elements into an array twice the size and publish it.
+   * The old array is retired, since thieves may still be reading it.
+   * */
+  HSHM_CROSS_FUN ws_deque_array *Grow(ws_deque_array *old, hshm::i64 top,
+                                      hshm::i64 bottom) {
+    OffsetPointer new_p = AllocateArray(2 * (old->mask_ + 1));
+    ws_deque_array *array = GetArray(new_p);
+    T *src = old->template GetSlots<T>();
+    T *dst = array->template GetSlots<T>();
+    for (hshm::i64 pos = top; pos < bottom; ++pos) {
+      dst[pos & array->mask_] = src[pos & old->mask_];
+    }
+    old->retired_ = retired_;
+    retired_ = OffsetPointer(array_.off_.load());
+    array_.off_.store(new_p.off_.load(), std::memory_order_release);
+    return array;
+  }
+};
+
+}  // namespace hshm::ipc
+
+namespace hshm {
+
+template <typename T, HSHM_CLASS_TEMPL_WITH_PRIV_DEFAULTS>
+using ws_deque = hipc::ws_deque<T, HSHM_CLASS_TEMPL_ARGS>;
+
+}  // namespace hshm
+
+#undef CLASS_NAME
+#undef CLASS_NEW_ARGS
+
+#endif  // HSHM_DATA_STRUCTURES_IPC_WS_DEQUE_H_
@@ -21,6 +21,7 @@
 #include "types/atomic.h"
 #include "types/bitfield.h"
 #include "types/real_number.h"
+#include "types/striped_counter.h"
 #include "util/auto_trace.h"
 #include "util/config_parse.h"
 #include "util/errors.h"
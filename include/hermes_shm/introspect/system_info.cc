@@ -5,12 +5,14 @@
 
 #include <dlfcn.h>
 
+#include <cerrno>
 #include <cstdlib>
 
 #include "hermes_shm/constants/macros.h"
 #if defined(HSHM_ENABLE_PROCFS_SYSINFO)
 // LINUX
 #include <fcntl.h>
+#include <signal.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
@@ -204,6 +206,21 @@ int SystemInfo::GetPid() {
 #endif
 }
 
+bool SystemInfo::IsProcessAlive(int pid) {
+#if defined(HSHM_ENABLE_PROCFS_SYSINFO)
+  // EPERM means the process exists but belongs to another user
+  return kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+#elif defined(HSHM_ENABLE_WINDOWS_SYSINFO)
+  HANDLE proc = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+  if (proc == NULL) {
+    return GetLastError() != ERROR_INVALID_PARAMETER;
+  }
+  bool alive = WaitForSingleObject(proc, 0) == WAIT_TIMEOUT;
+  CloseHandle(proc);
+  return alive;
+#endif
+}
+
 int SystemInfo::GetUid() {
 #if defined(HSHM_ENABLE_PROCFS_SYSINFO)
   return getuid();
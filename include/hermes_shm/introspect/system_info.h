@@ -122,6 +122,8 @@ class SystemInfo {
 
   HSHM_DLL static int GetPid();
 
+  HSHM_DLL static bool IsProcessAlive(int pid);
+
   HSHM_DLL static int GetUid();
 
   HSHM_DLL static int GetGid();
@@ -37,7 +37,8 @@ enum class AllocatorType {
   kFixedPageAllocator,
   kScalablePageAllocator,
   kThreadLocalAllocator,
-  kTestAllocator
+  kTestAllocator,
+  kTieredAllocator
 };
 
 /**
@@ -22,6 +22,7 @@
 #include "stack_allocator.h"
 #include "test_allocator.h"
 #include "thread_local_allocator.h"
+#include "tiered_allocator.h"
 
 namespace hshm::ipc {
 
@@ -76,6 +77,7 @@ class AllocatorFactory {
       HSHM_ALLOC_DSRL_CASE(ScalablePageAllocator)
       HSHM_ALLOC_DSRL_CASE(ThreadLocalAllocator)
       HSHM_ALLOC_DSRL_CASE(TestAllocator)
+      HSHM_ALLOC_DSRL_CASE(TieredAllocator)
       default:
         return nullptr;
     }
@@ -38,6 +38,9 @@ typedef BaseAllocator<_GpuStackAllocator> GpuStackAllocator;
 class _TestAllocator;
 typedef BaseAllocator<_TestAllocator> TestAllocator;
 
+class _TieredAllocator;
+typedef BaseAllocator<_TieredAllocator> TieredAllocator;
+
 }  // namespace hshm::ipc
 
 #endif  // HSHM_MEMORY_ALLOCATOR_ALLOCATOR_FACTORY__H_
\ No newline at end of file
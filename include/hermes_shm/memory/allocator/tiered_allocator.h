@@ -0,0 +1,422 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_MEMORY_ALLOCATOR_TIERED_ALLOCATOR_H
+#define HSHM_MEMORY_ALLOCATOR_TIERED_ALLOCATOR_H
+
+#include <cmath>
+
+#include "allocator.h"
+#include "hermes_shm/memory/allocator/stack_allocator.h"
+#include "hermes_shm/memory/backend/posix_tiered_mmap.h"
+#include "hermes_shm/thread/lock.h"
+#include "mp_page.h"
+#include "page_allocator.h"
+
+namespace hshm::ipc {
+
+/** The tiers managed by the tiered allocator */
+enum class MemoryTier {
+  kHot = 0,  /**< The fast tier (e.g., shared memory) */
+  kCold = 1, /**< The capacity tier (e.g., an mmap'ed file) */
+  kAuto = 2, /**< Let the allocator decide based on the allocation size */
+};
+
+class _TieredAllocator;
+typedef BaseAllocator<_TieredAllocator> TieredAllocator;
+
+struct _TieredAllocatorHeader : public AllocatorHeader {
+  typedef hipc::PageAllocator<_TieredAllocator, true, false> PageAllocator;
+  hshm::size_t hot_size_;
+  hshm::size_t cold_size_;
+  hshm::size_t hot_threshold_;
+  hipc::atomic<hshm::size_t> tier_alloc_[2];
+  hipc::delay_ar<PageAllocator> hot_;
+  hipc::delay_ar<PageAllocator> cold_;
+
+  HSHM_CROSS_FUN
+  _TieredAllocatorHeader() = default;
+
+  HSHM_CROSS_FUN
+  void Configure(AllocatorId alloc_id, size_t custom_header_size,
+                 size_t hot_size, size_t cold_size, size_t hot_threshold,
+                 StackAllocator *hot_alloc, StackAllocator *cold_alloc) {
+    AllocatorHeader::Configure(alloc_id, AllocatorType::kTieredAllocator,
+                               custom_header_size);
+    hot_size_ = hot_size;
+    cold_size_ = cold_size;
+    hot_threshold_ = hot_threshold;
+    tier_alloc_[0] = 0;
+    tier_alloc_[1] = 0;
+    HSHM_MAKE_AR(hot_, hot_alloc, hot_alloc);
+    HSHM_MAKE_AR(cold_, hot_alloc, cold_alloc);
+  }
+};
+
+/**
+ * An allocator spanning a hot and a cold tier of one contiguous backend.
+ * Offsets [0, hot_size) belong to the hot tier and the rest belong to the
+ * cold tier, so pointers from either tier share one namespace. Metadata
+ * always lives in the hot tier.
+ *
+ * Small allocations are placed in the hot tier and large allocations in
+ * the cold tier unless the caller provides a hint. When the preferred tier
+ * is full, the allocation spills into the other tier. Data can later be
+ * moved between tiers using Demote and Promote.
+ * */
+class _TieredAllocator : public Allocator {
+ public:
+  HSHM_ALLOCATOR(_TieredAllocator);
+
+ private:
+  typedef _TieredAllocatorHeader::PageAllocator PageAllocator;
+  _TieredAllocatorHeader *header_;
+  StackAllocator hot_alloc_;
+  StackAllocator cold_alloc_;
+
+ public:
+  /**
+   * Allocator constructor
+   * */
+  HSHM_CROSS_FUN
+  _TieredAllocator() : header_(nullptr) {}
+
+  /**
+   * Initialize the allocator in shared memory
+   *
+   * @param hot_size the size of the hot tier. If 0, the split recorded
+   * by a PosixTieredMmap backend is used. Otherwise, the backend is split
+   * in half.
+   * @param hot_threshold allocations larger than this are placed in the
+   * cold tier by default
+   * */
+  HSHM_CROSS_FUN
+  void shm_init(AllocatorId id, size_t custom_header_size,
+                MemoryBackend backend, size_t hot_size = 0,
+                size_t hot_threshold = hshm::Unit<size_t>::Megabytes(1)) {
+    type_ = AllocatorType::kTieredAllocator;
+    id_ = id;
+    buffer_ = backend.data_;
+    buffer_size_ = backend.data_size_;
+    if (hot_size == 0) {
+      if (backend.header_->type_ == MemoryBackendType::kPosixTieredMmap) {
+        hot_size =
+            reinterpret_cast<PosixTieredMmapHeader *>(backend.header_)
+                ->hot_size_;
+      } else {
+        hot_size = MemoryAlignment::AlignToPageSize(buffer_size_ / 2);
+      }
+    }
+    size_t cold_size = buffer_size_ - hot_size;
+    header_ = ConstructHeader<_TieredAllocatorHeader>(buffer_);
+    custom_header_ = reinterpret_cast<char *>(header_ + 1);
+    size_t region_off = (custom_header_ - buffer_) + custom_header_size;
+    AllocatorId hot_id(id.bits_.major_, id.bits_.minor_ + 1);
+    AllocatorId cold_id(id.bits_.major_, id.bits_.minor_ + 2);
+    hot_alloc_.shm_init(hot_id, 0,
+                        ShiftTier(backend, region_off, hot_size - region_off));
+    cold_alloc_.shm_init(cold_id, 0, ShiftTier(backend, hot_size, cold_size));
+    HSHM_MEMORY_MANAGER->RegisterSubAllocator(&hot_alloc_);
+    HSHM_MEMORY_MANAGER->RegisterSubAllocator(&cold_alloc_);
+    header_->Configure(id, custom_header_size, hot_size, cold_size,
+                       hot_threshold, &hot_alloc_, &cold_alloc_);
+    hot_alloc_.Align();
+    cold_alloc_.Align();
+  }
+
+  /**
+   * Attach an existing allocator from shared memory
+   * */
+  HSHM_CROSS_FUN
+  void shm_deserialize(MemoryBackend backend) {
+    buffer_ = backend.data_;
+    buffer_size_ = backend.data_size_;
+    header_ = reinterpret_cast<_TieredAllocatorHeader *>(buffer_);
+    type_ = header_->allocator_type_;
+    id_ = header_->alloc_id_;
+    custom_header_ = reinterpret_cast<char *>(header_ + 1);
+    size_t region_off =
+        (custom_header_ - buffer_) + header_->custom_header_size_;
+    size_t hot_size = header_->hot_size_;
+    hot_alloc_.shm_deserialize(
+        ShiftTier(backend, region_off, hot_size - region_off));
+    cold_alloc_.shm_deserialize(
+        ShiftTier(backend, hot_size, header_->cold_size_));
+    HSHM_MEMORY_MANAGER->RegisterSubAllocator(&hot_alloc_);
+    HSHM_MEMORY_MANAGER->RegisterSubAllocator(&cold_alloc_);
+  }
+
+  /**
+   * Allocate a memory of \a size size. The tier is chosen by size.
+   * */
+  HSHM_CROSS_FUN
+  OffsetPointer AllocateOffset(const hipc::MemContext &ctx, size_t size) {
+    return AllocateOffsetHint(ctx, size, MemoryTier::kAuto);
+  }
+
+  /**
+   * Allocate a memory of \a size size, preferring the \a tier tier.
+   * Spills into the other tier if the preferred tier is full.
+   * */
+  HSHM_CROSS_FUN
+  OffsetPointer AllocateOffsetHint(const hipc::MemContext &ctx, size_t size,
+                                   MemoryTier tier) {
+    tier = ResolveTier(size, tier);
+    OffsetPointer p = AllocateTierOffset(size, tier);
+    if (p.IsNull()) {
+      p = AllocateTierOffset(size, OtherTier(tier));
+    }
+    if (p.IsNull()) {
+      HSHM_THROW_ERROR(OUT_OF_MEMORY, size, GetCurrentlyAllocatedSize());
+    }
+    return p;
+  }
+
+  /**
+   * Allocate a memory of \a size size, preferring the \a tier tier.
+   * */
+  template <typename PointerT = Pointer>
+  HSHM_INLINE_CROSS_FUN PointerT AllocateHint(const hipc::MemContext &ctx,
+                                              size_t size, MemoryTier tier) {
+    return PointerT(GetId(), AllocateOffsetHint(ctx, size, tier).load());
+  }
+
+  /**
+   * Allocate a memory of \a size size, which is aligned to \a
+   * alignment.
+   * */
+  HSHM_CROSS_FUN
+  OffsetPointer AlignedAllocateOffset(const hipc::MemContext &ctx, size_t size,
+                                      size_t alignment) {
+    HSHM_THROW_ERROR(NOT_IMPLEMENTED, "AlignedAllocateOffset");
+    return OffsetPointer::GetNull();
+  }
+
+  /**
+   * Reallocate \a p pointer to \a new_size new size. The new block is
+   * placed in the same tier as the old block when possible.
+   *
+   * @return whether or not the pointer p was changed
+   * */
+  HSHM_CROSS_FUN
+  OffsetPointer ReallocateOffsetNoNullCheck(const hipc::MemContext &ctx,
+                                            OffsetPointer p, size_t new_size) {
+    OffsetPointer new_p = AllocateOffsetHint(ctx, new_size, GetTierOffset(p));
+    MpPage *old_hdr = Convert<MpPage>(p - sizeof(MpPage));
+    size_t old_size = old_hdr->page_size_ - sizeof(MpPage);
+    memcpy(Convert<char>(new_p), Convert<char>(p),
+           old_size < new_size ? old_size : new_size);
+    FreeOffsetNoNullCheck(ctx, p);
+    return new_p;
+  }
+
+  /**
+   * Free \a ptr pointer. Null check is performed elsewhere.
+   * */
+  HSHM_CROSS_FUN
+  void FreeOffsetNoNullCheck(const hipc::MemContext &ctx, OffsetPointer p) {
+    // Mark as free
+    auto hdr_offset = p - sizeof(MpPage);
+    MpPage *hdr = Convert<MpPage>(hdr_offset);
+    if (!hdr->IsAllocated()) {
+      HSHM_THROW_ERROR(DOUBLE_FREE, hdr);
+    }
+    hdr->UnsetAllocated();
+    MemoryTier tier = GetTierOffset(p);
+    header_->SubSize(hdr->page_size_);
+    header_->tier_alloc_[(int)tier].fetch_sub(hdr->page_size_);
+    PageAllocator &page_alloc = GetPageAllocator(tier);
+    page_alloc.Free(hdr_offset, hdr);
+  }
+
+  /**====================================
+   * Tier Management
+   * ===================================*/
+
+  /** Get the tier containing the offset \a p */
+  HSHM_INLINE_CROSS_FUN
+  MemoryTier GetTierOffset(const OffsetPointer &p) const {
+    return p.load() < header_->hot_size_ ? MemoryTier::kHot
+                                         : MemoryTier::kCold;
+  }
+
+  /** Get the tier containing the pointer \a p */
+  template <typename PointerT = Pointer>
+  HSHM_INLINE_CROSS_FUN MemoryTier GetTier(const PointerT &p) const {
+    return GetTierOffset(OffsetPointer(p.off_.load()));
+  }
+
+  /**
+   * Move the data pointed to by \a p into the \a tier tier. kAuto
+   * picks the tier by the size of the data, as allocation does.
+   *
+   * @return the new offset, or null if \a tier has no space.
+   * If the data is already in \a tier, \a p is returned.
+   * */
+  HSHM_CROSS_FUN
+  OffsetPointer MoveOffset(const hipc::MemContext &ctx, OffsetPointer p,
+                           MemoryTier tier) {
+    MpPage *old_hdr = Convert<MpPage>(p - sizeof(MpPage));
+    size_t size = old_hdr->page_size_ - sizeof(MpPage);
+    tier = ResolveTier(size, tier);
+    if (GetTierOffset(p) == tier) {
+      return p;
+    }
+    OffsetPointer new_p = AllocateTierOffset(size, tier);
+    if (new_p.IsNull()) {
+      return new_p;
+    }
+    memcpy(Convert<char>(new_p), Convert<char>(p), size);
+    FreeOffsetNoNullCheck(ctx, p);
+    return new_p;
+  }
+
+  /**
+   * Move the data pointed to by \a p into the cold tier.
+   *
+   * @return true if \a p was modified.
+   * */
+  template <typename PointerT = Pointer>
+  HSHM_INLINE_CROSS_FUN bool Demote(const hipc::MemContext &ctx, PointerT &p) {
+    return MoveTier(ctx, p, MemoryTier::kCold);
+  }
+
+  /**
+   * Move the data pointed to by \a p into the hot tier.
+   *
+   * @return true if \a p was modified.
+   * */
+  template <typename PointerT = Pointer>
+  HSHM_INLINE_CROSS_FUN bool Promote(const hipc::MemContext &ctx,
+                                     PointerT &p) {
+    return MoveTier(ctx, p, MemoryTier::kHot);
+  }
+
+  /**
+   * Get the amount of data allocated, but not freed, in \a tier.
+   * kAuto counts both tiers.
+   * */
+  HSHM_CROSS_FUN
+  size_t GetTierAllocatedSize(MemoryTier tier) {
+    if (tier == MemoryTier::kAuto) {
+      return GetTierAllocatedSize(MemoryTier::kHot) +
+             GetTierAllocatedSize(MemoryTier::kCold);
+    }
+    return (size_t)header_->tier_alloc_[(int)tier].load();
+  }
+
+  /**
+   * Get the current amount of data allocated. Can be used for leak
+   * checking.
+   * */
+  HSHM_CROSS_FUN
+  size_t GetCurrentlyAllocatedSize() {
+    return (size_t)header_->GetCurrentlyAllocatedSize();
+  }
+
+  /**
+   * Create a globally-unique thread ID
+   * */
+  HSHM_CROSS_FUN
+  void CreateTls(MemContext &ctx) {}
+
+  /**
+   * Free a thread-local memory storage
+   * */
+  HSHM_CROSS_FUN
+  void FreeTls(const MemContext &ctx) {}
+
+ private:
+  /** Restrict a backend to the region [off, off + size) */
+  HSHM_INLINE_CROSS_FUN
+  static MemoryBackend ShiftTier(MemoryBackend &backend, size_t off,
+                                 size_t size) {
+    MemoryBackend tier = backend.Shift(off);
+    tier.data_size_ = size;
+    return tier;
+  }
+
+  /** Replace kAuto with the tier chosen for data of \a size bytes */
+  HSHM_INLINE_CROSS_FUN
+  MemoryTier ResolveTier(size_t size, MemoryTier tier) const {
+    if (tier != MemoryTier::kAuto) {
+      return tier;
+    }
+    return size <= header_->hot_threshold_ ? MemoryTier::kHot
+                                           : MemoryTier::kCold;
+  }
+
+  /** Get the opposite tier */
+  HSHM_INLINE_CROSS_FUN
+  static MemoryTier OtherTier(MemoryTier tier) {
+    return tier == MemoryTier::kHot ? MemoryTier::kCold : MemoryTier::kHot;
+  }
+
+  /** Get the page cache of a tier */
+  HSHM_INLINE_CROSS_FUN
+  PageAllocator &GetPageAllocator(MemoryTier tier) {
+    return tier == MemoryTier::kHot ? *header_->hot_ : *header_->cold_;
+  }
+
+  /** Get the heap of a tier */
+  HSHM_INLINE_CROSS_FUN
+  StackAllocator &GetStackAllocator(MemoryTier tier) {
+    return tier == MemoryTier::kHot ? hot_alloc_ : cold_alloc_;
+  }
+
+  /** Allocate from exactly one tier. Returns null if the tier is full. */
+  HSHM_CROSS_FUN
+  OffsetPointer AllocateTierOffset(size_t size, MemoryTier tier) {
+    MpPage *page = nullptr;
+    PageId page_id(size + sizeof(MpPage));
+
+    // Case 1: Can we re-use an existing page?
+    page = GetPageAllocator(tier).Allocate(page_id);
+
+    // Case 2: Allocate from the tier's heap if no page found
+    if (page == nullptr) {
+      StackAllocator &alloc = GetStackAllocator(tier);
+      OffsetPointer off = alloc.SubAllocateOffset(page_id.round_);
+      if (!off.IsNull()) {
+        page = alloc.Convert<MpPage>(off);
+      }
+    }
+    if (page == nullptr) {
+      return OffsetPointer::GetNull();
+    }
+
+    // Mark as allocated
+    header_->AddSize(page_id.round_);
+    header_->tier_alloc_[(int)tier].fetch_add(page_id.round_);
+    OffsetPointer p = Convert<MpPage, OffsetPointer>(page);
+    page->page_size_ = page_id.round_;
+    page->SetAllocated();
+    return p + sizeof(MpPage);
+  }
+
+  /** Move \a p to \a tier, updating it in place */
+  template <typename PointerT>
+  HSHM_INLINE_CROSS_FUN bool MoveTier(const hipc::MemContext &ctx, PointerT &p,
+                                      MemoryTier tier) {
+    OffsetPointer old_p(p.off_.load());
+    OffsetPointer new_p = MoveOffset(ctx, old_p, tier);
+    if (new_p.IsNull() || new_p == old_p) {
+      return false;
+    }
+    p.off_ = new_p.load();
+    return true;
+  }
+};
+
+}  // namespace hshm::ipc
+
+#endif  // HSHM_MEMORY_ALLOCATOR_TIERED_ALLOCATOR_H
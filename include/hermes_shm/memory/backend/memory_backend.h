@@ -31,6 +31,7 @@ enum class MemoryBackendType {
   kPosixMmap,
   kGpuMalloc,
   kGpuShmMmap,
+  kPosixTieredMmap,
 };
 
 /** ID for memory backend */
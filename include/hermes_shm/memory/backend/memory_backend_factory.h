@@ -20,6 +20,7 @@
 #include "memory_backend.h"
 #include "posix_mmap.h"
 #include "posix_shm_mmap.h"
+#include "posix_tiered_mmap.h"
 #if defined(HSHM_ENABLE_CUDA) or defined(HSHM_ENABLE_ROCM)
 #include "gpu_malloc.h"
 #include "gpu_shm_mmap.h"
@@ -54,6 +55,7 @@ class MemoryBackendFactory {
   static MemoryBackend *shm_init(const MemoryBackendId &backend_id, size_t size,
                                  Args... args) {
     HSHM_CREATE_BACKEND(PosixShmMmap)
+    HSHM_CREATE_BACKEND(PosixTieredMmap)
 #if defined(HSHM_ENABLE_CUDA) or defined(HSHM_ENABLE_ROCM)
     HSHM_CREATE_BACKEND(GpuShmMmap)
     HSHM_CREATE_BACKEND(GpuMalloc)
@@ -72,6 +74,7 @@ class MemoryBackendFactory {
                                         const hshm::chararr &url) {
     switch (type) {
       HSHM_DESERIALIZE_BACKEND(PosixShmMmap)
+      HSHM_DESERIALIZE_BACKEND(PosixTieredMmap)
 #if defined(HSHM_ENABLE_CUDA) or defined(HSHM_ENABLE_ROCM)
       HSHM_DESERIALIZE_BACKEND(GpuShmMmap)
       HSHM_DESERIALIZE_BACKEND(GpuMalloc)
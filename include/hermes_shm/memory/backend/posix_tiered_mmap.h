@@ -0,0 +1,301 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_INCLUDE_MEMORY_BACKEND_POSIX_TIERED_MMAP_H
+#define HSHM_INCLUDE_MEMORY_BACKEND_POSIX_TIERED_MMAP_H
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "hermes_shm/constants/macros.h"
+#ifdef HSHM_ENABLE_PROCFS_SYSINFO
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "hermes_shm/introspect/system_info.h"
+#include "hermes_shm/util/errors.h"
+#include "hermes_shm/util/logging.h"
+#include "memory_backend.h"
+
+namespace hshm::ipc {
+
+/**
+ * Header of a tiered backend. Records where the hot tier ends and which
+ * file backs the cold tier so that other processes can reattach.
+ * */
+struct PosixTieredMmapHeader : public MemoryBackendHeader {
+  size_t hot_size_;
+  size_t cold_size_;
+  hshm::chararr cold_path_;
+};
+
+/**
+ * A backend made of two tiers mapped back-to-back in one virtual address
+ * range. The hot tier is a POSIX shared memory object and the cold tier
+ * is an mmap'ed file. Because both tiers live in one contiguous range,
+ * a single allocator (and a single Pointer namespace) can span them.
+ *
+ * Layout of data_: [hot tier (hot_size_)][cold tier (cold_size_)]
+ * */
+class PosixTieredMmap : public MemoryBackend, public UrlMemoryBackend {
+ public:
+  CLS_CONST MemoryBackendType EnumType = MemoryBackendType::kPosixTieredMmap;
+  /** The longest cold tier path the header can record */
+  CLS_CONST size_t kMaxColdPath = sizeof(hshm::chararr::buf_) - 1;
+
+ protected:
+  File fd_;
+  File cold_fd_;
+  hshm::chararr url_;
+  CLS_CONST int hdr_size_ = KILOBYTES(16);
+
+ public:
+  /** Constructor */
+  HSHM_CROSS_FUN
+  PosixTieredMmap() {}
+
+  /** Destructor */
+  HSHM_CROSS_FUN
+  ~PosixTieredMmap() {
+#ifdef HSHM_IS_HOST
+    if (IsOwned()) {
+      _Destroy();
+    } else {
+      _Detach();
+    }
+#endif
+  }
+
+  /**
+   * Initialize backend
+   *
+   * @param backend_id the id of this backend
+   * @param size the size of the hot (shared memory) tier
+   * @param url the name of the shared memory object
+   * @param cold_size the size of the cold (file) tier. Defaults to \a size.
+   * @param cold_path the file backing the cold tier. Defaults to a file
+   * in /tmp named after \a url. Must be at most kMaxColdPath bytes.
+   * */
+  bool shm_init(const MemoryBackendId &backend_id, size_t size,
+                const hshm::chararr &url, size_t cold_size = 0,
+                const hshm::chararr &cold_path = hshm::chararr()) {
+    std::string url_s = url.str();
+    std::string cold_path_s = cold_path.str();
+    if (cold_path_s.empty()) {
+      cold_path_s = "/tmp/" + url_s + ".cold";
+    }
+    if (cold_path_s.size() > kMaxColdPath) {
+      HILOG(kError, "cold tier path is {} bytes, but at most {} fit",
+            cold_path_s.size(), kMaxColdPath);
+      return false;
+    }
+    SetInitialized();
+    Own();
+    size_t hot_size = MemoryAlignment::AlignToPageSize(size);
+    if (cold_size == 0) {
+      cold_size = hot_size;
+    }
+    cold_size = MemoryAlignment::AlignToPageSize(cold_size);
+
+    // Create the hot tier
+    SystemInfo::DestroySharedMemory(url_s);
+    if (!SystemInfo::CreateNewSharedMemory(fd_, url_s, hot_size + hdr_size_)) {
+      char *err_buf = strerror(errno);
+      HILOG(kError, "shm_open failed: {}", err_buf);
+      UnsetInitialized();
+      return false;
+    }
+    url_ = url;
+
+    // Create the cold tier
+    if (!_OpenColdFile(cold_path_s, cold_size, true)) {
+      SystemInfo::CloseSharedMemory(fd_);
+      SystemInfo::DestroySharedMemory(url_s);
+      UnsetInitialized();
+      return false;
+    }
+
+    // Initialize the header
+    auto header = (PosixTieredMmapHeader *)_ShmMap(hdr_size_, 0);
+    new (header) PosixTieredMmapHeader();
+    header->type_ = MemoryBackendType::kPosixTieredMmap;
+    header->id_ = backend_id;
+    header->data_size_ = hot_size + cold_size;
+    header->hot_size_ = hot_size;
+    header->cold_size_ = cold_size;
+    header->cold_path_ = hshm::chararr(cold_path_s);
+    header_ = header;
+    data_size_ = hot_size + cold_size;
+    data_ = _TierMap(hot_size, cold_size);
+    return true;
+  }
+
+  /** Deserialize the backend */
+  bool shm_deserialize(const hshm::chararr &url) {
+    SetInitialized();
+    Disown();
+    std::string url_s = url.str();
+    if (!SystemInfo::OpenSharedMemory(fd_, url_s)) {
+      const char *err_buf = strerror(errno);
+      HILOG(kError, "shm_open failed: {}", err_buf);
+      return false;
+    }
+    url_ = url;
+    auto header = (PosixTieredMmapHeader *)_ShmMap(hdr_size_, 0);
+    header_ = header;
+    if (!_OpenColdFile(header->cold_path_.str(), header->cold_size_, false)) {
+      SystemInfo::UnmapMemory(reinterpret_cast<void *>(header_), hdr_size_);
+      SystemInfo::CloseSharedMemory(fd_);
+      UnsetInitialized();
+      return false;
+    }
+    data_size_ = header->data_size_;
+    data_ = _TierMap(header->hot_size_, header->cold_size_);
+    return true;
+  }
+
+  /** Detach the mapped memory */
+  void shm_detach() { _Detach(); }
+
+  /** Destroy the mapped memory */
+  void shm_destroy() { _Destroy(); }
+
+  /** Get the size of the hot tier */
+  size_t GetHotSize() const {
+    return reinterpret_cast<PosixTieredMmapHeader *>(header_)->hot_size_;
+  }
+
+  /** Get the size of the cold tier */
+  size_t GetColdSize() const {
+    return reinterpret_cast<PosixTieredMmapHeader *>(header_)->cold_size_;
+  }
+
+ protected:
+  /** Open (and optionally create) the file backing the cold tier */
+  bool _OpenColdFile(const std::string &path, size_t size, bool create) {
+#ifdef HSHM_ENABLE_PROCFS_SYSINFO
+    int flags = create ? (O_CREAT | O_TRUNC | O_RDWR) : O_RDWR;
+    cold_fd_.posix_fd_ = open(path.c_str(), flags, 0666);
+    if (cold_fd_.posix_fd_ < 0) {
+      char *err_buf = strerror(errno);
+      HILOG(kError, "open({}) failed: {}", path, err_buf);
+      return false;
+    }
+    if (create && ftruncate(cold_fd_.posix_fd_, size) < 0) {
+      char *err_buf = strerror(errno);
+      HILOG(kError, "ftruncate({}) failed: {}", path, err_buf);
+      close(cold_fd_.posix_fd_);
+      unlink(path.c_str());
+      return false;
+    }
+    return true;
+#else
+    HILOG(kError, "Tiered backends are only supported on POSIX systems");
+    return false;
+#endif
+  }
+
+  /** Map shared memory */
+  char *_ShmMap(size_t size, i64 off) {
+    char *ptr =
+        reinterpret_cast<char *>(SystemInfo::MapSharedMemory(fd_, size, off));
+    if (!ptr) {
+      HSHM_THROW_ERROR(SHMEM_CREATE_FAILED);
+    }
+    return ptr;
+  }
+
+  /**
+   * Reserve one contiguous address range and map the hot tier followed
+   * by the cold tier into it.
+   * */
+  char *_TierMap(size_t hot_size, size_t cold_size) {
+#ifdef HSHM_ENABLE_PROCFS_SYSINFO
+    void *base = mmap(nullptr, hot_size + cold_size, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+      _CloseOnError();
+      HSHM_THROW_ERROR(SHMEM_RESERVE_FAILED);
+    }
+    char *ptr = reinterpret_cast<char *>(base);
+    void *hot = mmap(ptr, hot_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_FIXED, fd_.posix_fd_, hdr_size_);
+    void *cold = mmap(ptr + hot_size, cold_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_FIXED, cold_fd_.posix_fd_, 0);
+    if (hot == MAP_FAILED || cold == MAP_FAILED) {
+      munmap(base, hot_size + cold_size);
+      _CloseOnError();
+      HSHM_THROW_ERROR(SHMEM_CREATE_FAILED);
+    }
+    return ptr;
+#else
+    HSHM_THROW_ERROR(SHMEM_NOT_SUPPORTED);
+    return nullptr;
+#endif
+  }
+
+  /**
+   * Release the header and both files when the tiers could not be
+   * mapped. An owner also removes the objects it created.
+   * */
+  void _CloseOnError() {
+    std::string cold_path =
+        reinterpret_cast<PosixTieredMmapHeader *>(header_)->cold_path_.str();
+    SystemInfo::UnmapMemory(reinterpret_cast<void *>(header_), hdr_size_);
+    SystemInfo::CloseSharedMemory(fd_);
+    SystemInfo::CloseSharedMemory(cold_fd_);
+    if (IsOwned()) {
+      SystemInfo::DestroySharedMemory(url_.c_str());
+#ifdef HSHM_ENABLE_PROCFS_SYSINFO
+      unlink(cold_path.c_str());
+#endif
+    }
+    UnsetInitialized();
+  }
+
+  /** Unmap shared memory */
+  void _Detach() {
+    if (!IsInitialized()) {
+      return;
+    }
+    SystemInfo::UnmapMemory(data_, data_size_);
+    SystemInfo::UnmapMemory(reinterpret_cast<void *>(header_), hdr_size_);
+    SystemInfo::CloseSharedMemory(fd_);
+    SystemInfo::CloseSharedMemory(cold_fd_);
+    UnsetInitialized();
+  }
+
+  /** Destroy shared memory */
+  void _Destroy() {
+    if (!IsInitialized()) {
+      return;
+    }
+    std::string cold_path =
+        reinterpret_cast<PosixTieredMmapHeader *>(header_)->cold_path_.str();
+    _Detach();
+    SystemInfo::DestroySharedMemory(url_.c_str());
+#ifdef HSHM_ENABLE_PROCFS_SYSINFO
+    unlink(cold_path.c_str());
+#endif
+    UnsetInitialized();
+  }
+};
+
+}  // namespace hshm::ipc
+
+#endif  // HSHM_INCLUDE_MEMORY_BACKEND_POSIX_TIERED_MMAP_H
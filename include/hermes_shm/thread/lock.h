@@ -13,6 +13,7 @@
 #ifndef HSHM_THREAD_LOCK_H_
 #define HSHM_THREAD_LOCK_H_
 
+#include "lock/futex.h"
 #include "lock/mutex.h"
 #include "lock/rwlock.h"
 #include "thread_model_manager.h"
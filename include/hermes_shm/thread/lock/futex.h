@@ -0,0 +1,168 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_THREAD_FUTEX_H_
+#define HSHM_THREAD_FUTEX_H_
+
+#include <climits>
+
+#include "hermes_shm/thread/thread_model_manager.h"
+#include "hermes_shm/types/atomic.h"
+#include "hermes_shm/types/numbers.h"
+#include "hermes_shm/util/timer.h"
+
+#if defined(HSHM_ENABLE_PROCFS_SYSINFO) && defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#define HSHM_ENABLE_FUTEX
+#endif
+
+namespace hshm {
+
+/**
+ * A wait/notify word that can live in shared memory.
+ *
+ * Waiters spin on their condition briefly and then sleep in the kernel
+ * on word_. The futex is not process-private, so waiters and notifiers
+ * may be in different processes that map the same memory. Notifiers only
+ * enter the kernel when waiters_ says someone is asleep.
+ * */
+struct Futex {
+  ipc::atomic<hshm::u32> word_;
+  ipc::atomic<hshm::u32> waiters_;
+
+#ifdef HSHM_ENABLE_FUTEX
+  static_assert(sizeof(ipc::atomic<hshm::u32>) == sizeof(hshm::u32),
+                "The futex word must be a plain 32-bit integer");
+#endif
+
+  /** Number of times the condition is polled before sleeping */
+  CLS_CONST int kSpinCount = 64;
+
+  /** Default constructor */
+  HSHM_INLINE_CROSS_FUN
+  Futex() : word_(0), waiters_(0) {}
+
+  /** Copy constructor. Waiters are never copied. */
+  HSHM_INLINE_CROSS_FUN
+  Futex(const Futex &other) : word_(0), waiters_(0) {}
+
+  /** Copy assignment. Waiters are never copied. */
+  HSHM_INLINE_CROSS_FUN
+  Futex &operator=(const Futex &other) { return *this; }
+
+  /** Explicit initialization */
+  HSHM_INLINE_CROSS_FUN
+  void Init() {
+    word_ = 0;
+    waiters_ = 0;
+  }
+
+  /**
+   * Wait until \a try_op returns true.
+   *
+   * @param try_op a callable attempting the operation being waited on
+   * @param timeout_us the maximum time to wait. Negative waits forever.
+   * @return true if try_op succeeded, false on timeout
+   * */
+  template <typename TryT>
+  HSHM_CROSS_FUN bool WaitUntil(TryT &&try_op, double timeout_us = -1) {
+    for (int i = 0; i < kSpinCount; ++i) {
+      if (try_op()) {
+        return true;
+      }
+    }
+    Timer t;
+    t.Resume();
+    while (true) {
+      // Register before the final check, so a notifier that missed the
+      // check is guaranteed to see the registration
+      hshm::u32 word = word_.load();
+      waiters_.fetch_add(1);
+      if (try_op()) {
+        waiters_.fetch_sub(1);
+        return true;
+      }
+      double left_us = -1;
+      if (timeout_us >= 0) {
+        left_us = timeout_us - t.GetUsecFromStart();
+        if (left_us <= 0) {
+          waiters_.fetch_sub(1);
+          return false;
+        }
+      }
+      Sleep(word, left_us);
+      waiters_.fetch_sub(1);
+    }
+  }
+
+  /** Wake up to \a count waiters */
+  HSHM_INLINE_CROSS_FUN
+  void Notify(int count = 1) {
+    // Order the caller's update before the check of waiters_
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+    word_.fetch_add(1);
+    Wake(count);
+  }
+
+  /** Wake every waiter */
+  HSHM_INLINE_CROSS_FUN
+  void NotifyAll() { Notify(INT_MAX); }
+
+ private:
+  /** Sleep while word_ is \a word, for at most \a timeout_us */
+  HSHM_INLINE_CROSS_FUN
+  void Sleep(hshm::u32 word, double timeout_us) {
+#if defined(HSHM_ENABLE_FUTEX) && defined(HSHM_IS_HOST)
+    struct timespec ts;
+    struct timespec *tsp = nullptr;
+    if (timeout_us >= 0) {
+      hshm::u64 ns = (hshm::u64)(timeout_us * 1000);
+      ts.tv_sec = (time_t)(ns / 1000000000);
+      ts.tv_nsec = (long)(ns % 1000000000);
+      tsp = &ts;
+    }
+    syscall(SYS_futex, reinterpret_cast<hshm::u32 *>(&word_.x), FUTEX_WAIT,
+            word, tsp, nullptr, 0);
+#else
+    (void)word;
+    (void)timeout_us;
+    HSHM_THREAD_MODEL->Yield();
+#endif
+  }
+
+  /** Wake up to \a count sleepers */
+  HSHM_INLINE_CROSS_FUN
+  void Wake(int count) {
+#if defined(HSHM_ENABLE_FUTEX) && defined(HSHM_IS_HOST)
+    syscall(SYS_futex, reinterpret_cast<hshm::u32 *>(&word_.x), FUTEX_WAKE,
+            count, nullptr, nullptr, 0);
+#else
+    (void)count;
+#endif
+  }
+};
+
+}  // namespace hshm
+
+namespace hshm::ipc {
+
+using hshm::Futex;
+
+}  // namespace hshm::ipc
+
+#endif  // HSHM_THREAD_FUTEX_H_
@@ -13,14 +13,13 @@ namespace hshm {
 struct SpinLock {
   ipc::atomic<hshm::min_u64> lock_;
   ipc::atomic<hshm::min_u64> head_;
-  ipc::atomic<hshm::min_u32> try_lock_;
 #ifdef HSHM_DEBUG_LOCK
   u32 owner_;
 #endif
 
   /** Default constructor */
   HSHM_INLINE_CROSS_FUN
-  SpinLock() : lock_(0), head_(0), try_lock_(0) {}
+  SpinLock() : lock_(0), head_(0) {}
 
   /** Copy constructor */
   HSHM_INLINE_CROSS_FUN
@@ -37,6 +36,9 @@ struct SpinLock {
     do {
       for (int i = 0; i < 1; ++i) {
         if (tkt == head_.load()) {
+#ifdef HSHM_DEBUG_LOCK
+          owner_ = owner;
+#endif
           return;
         }
       }
@@ -46,11 +48,15 @@ struct SpinLock {
   /** Try to acquire the lock */
   HSHM_INLINE_CROSS_FUN
   bool TryLock(u32 owner) {
-    if (try_lock_.fetch_add(1) > 0 || lock_.load() > head_.load()) {
-      try_lock_.fetch_sub(1);
+    // Take the next ticket only if it is already being served
+    min_u64 head = head_.load();
+    min_u64 tkt = head;
+    if (!lock_.compare_exchange_strong(tkt, head + 1)) {
       return false;
     }
-    Lock(owner);
+#ifdef HSHM_DEBUG_LOCK
+    owner_ = owner;
+#endif
     return true;
   }
 
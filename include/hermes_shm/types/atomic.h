@@ -86,6 +86,26 @@ struct nonatomic {
     return orig_x;
   }
 
+  /** Atomic fetch_or wrapper*/
+  template <typename U>
+  HSHM_INLINE_CROSS_FUN T
+  fetch_or(U bits, std::memory_order order = std::memory_order_seq_cst) {
+    (void)order;
+    T orig_x = x;
+    x |= (T)bits;
+    return orig_x;
+  }
+
+  /** Atomic fetch_and wrapper*/
+  template <typename U>
+  HSHM_INLINE_CROSS_FUN T
+  fetch_and(U bits, std::memory_order order = std::memory_order_seq_cst) {
+    (void)order;
+    T orig_x = x;
+    x &= (T)bits;
+    return orig_x;
+  }
+
   /** Atomic load wrapper */
   HSHM_INLINE_CROSS_FUN T
   load(std::memory_order order = std::memory_order_seq_cst) const {
@@ -101,10 +121,12 @@ struct nonatomic {
 
   /** Atomic exchange wrapper */
   template <typename U>
-  HSHM_INLINE_CROSS_FUN void exchange(
+  HSHM_INLINE_CROSS_FUN T exchange(
       U count, std::memory_order order = std::memory_order_seq_cst) {
     (void)order;
+    T old = x;
     x = count;
+    return old;
   }
 
   /** Atomic compare exchange weak wrapper */
@@ -295,6 +317,20 @@ struct rocm_atomic {
     return atomicAdd(&x, -count);
   }
 
+  /** Atomic fetch_or wrapper*/
+  template <typename U>
+  HSHM_INLINE_CROSS_FUN T
+  fetch_or(U bits, std::memory_order order = std::memory_order_seq_cst) {
+    return atomicOr(&x, (T)bits);
+  }
+
+  /** Atomic fetch_and wrapper*/
+  template <typename U>
+  HSHM_INLINE_CROSS_FUN T
+  fetch_and(U bits, std::memory_order order = std::memory_order_seq_cst) {
+    return atomicAnd(&x, (T)bits);
+  }
+
   /** Atomic load wrapper */
   HSHM_INLINE_CROSS_FUN T
   load(std::memory_order order = std::memory_order_seq_cst) const {
@@ -507,6 +543,20 @@ struct std_atomic {
     return x.fetch_sub(count, order);
   }
 
+  /** Atomic fetch_or wrapper*/
+  template <typename U>
+  HSHM_INLINE T fetch_or(U bits,
+                         std::memory_order order = std::memory_order_seq_cst) {
+    return x.fetch_or((T)bits, order);
+  }
+
+  /** Atomic fetch_and wrapper*/
+  template <typename U>
+  HSHM_INLINE T fetch_and(U bits,
+                          std::memory_order order = std::memory_order_seq_cst) {
+    return x.fetch_and((T)bits, order);
+  }
+
   /** Atomic load wrapper */
   HSHM_INLINE T
   load(std::memory_order order = std::memory_order_seq_cst) const {
@@ -522,9 +572,9 @@ struct std_atomic {
 
   /** Atomic exchange wrapper */
   template <typename U>
-  HSHM_INLINE void exchange(
+  HSHM_INLINE T exchange(
       U count, std::memory_order order = std::memory_order_seq_cst) {
-    x.exchange(count, order);
+    return x.exchange(count, order);
   }
 
   /** Atomic compare exchange weak wrapper */
@@ -0,0 +1,86 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HSHM_INCLUDE_HSHM_TYPES_STRIPED_COUNTER_H_
+#define HSHM_INCLUDE_HSHM_TYPES_STRIPED_COUNTER_H_
+
+#include "hermes_shm/constants/macros.h"
+#include "hermes_shm/types/atomic.h"
+
+namespace hshm {
+
+/**
+ * A counter split into \a STRIPES atomics a cache line apart. Updates go
+ * to the stripe picked by a caller-provided hint (e.g., bits of a key's
+ * hash), so threads updating different keys rarely share a line. Reading
+ * sums the stripes, so it is exact when quiescent and approximate under
+ * concurrent updates. Holds no pointers and can live in shared memory.
+ * */
+template <size_t STRIPES = 8>
+struct striped_counter {
+  static_assert((STRIPES & (STRIPES - 1)) == 0,
+                "STRIPES must be a power of two");
+
+  /** One stripe, on its own cache line */
+  struct stripe {
+    hipc::atomic<hshm::size_t> count_;
+    char pad_[HSHM_CACHE_LINE_SIZE - sizeof(hipc::atomic<hshm::size_t>)];
+  };
+  stripe stripes_[STRIPES];
+
+  /** Default constructor */
+  HSHM_INLINE_CROSS_FUN striped_counter() { clear(); }
+
+  /** Copy constructor */
+  HSHM_INLINE_CROSS_FUN striped_counter(const striped_counter &other) {
+    (*this) = other;
+  }
+
+  /** Copy assignment operator. Not safe under concurrent updates. */
+  HSHM_INLINE_CROSS_FUN striped_counter &operator=(
+      const striped_counter &other) {
+    for (size_t i = 0; i < STRIPES; ++i) {
+      stripes_[i].count_ = other.stripes_[i].count_.load();
+    }
+    return *this;
+  }
+
+  /** Add \a n to the stripe of \a hint */
+  HSHM_INLINE_CROSS_FUN void add(hshm::u64 hint, hshm::size_t n = 1) {
+    stripes_[hint & (STRIPES - 1)].count_.fetch_add(n);
+  }
+
+  /** Subtract \a n from the stripe of \a hint */
+  HSHM_INLINE_CROSS_FUN void sub(hshm::u64 hint, hshm::size_t n = 1) {
+    stripes_[hint & (STRIPES - 1)].count_.fetch_sub(n);
+  }
+
+  /** Sum the stripes. Stripes may wrap individually, but not the sum. */
+  HSHM_INLINE_CROSS_FUN size_t load() const {
+    hshm::size_t sum = 0;
+    for (size_t i = 0; i < STRIPES; ++i) {
+      sum += stripes_[i].count_.load();
+    }
+    return (size_t)sum;
+  }
+
+  /** Reset every stripe to zero */
+  HSHM_INLINE_CROSS_FUN void clear() {
+    for (size_t i = 0; i < STRIPES; ++i) {
+      stripes_[i].count_ = 0;
+    }
+  }
+};
+
+}  // namespace hshm
+
+#endif  // HSHM_INCLUDE_HSHM_TYPES_STRIPED_COUNTER_H_
@@ -38,6 +38,11 @@ const Error IPC_ARGS_NOT_SHM_COMPATIBLE("Args are not compatible with SHM");
 
 const Error UNORDERED_MAP_CANT_FIND("Could not find key in unordered_map");
 const Error KEY_SET_OUT_OF_BOUNDS("Too many keys in the key set");
+const Error TOO_MANY_EPOCH_PARTICIPANTS(
+    "Too many epoch participants (max {})");
+const Error EPOCH_RETIRE_WRONG_ALLOCATOR(
+    "Retired a pointer of allocator {}.{}, which is not of the epoch "
+    "manager's allocator type");
 
 const Error ARGPACK_INDEX_OUT_OF_BOUNDS("Argpack index out of bounds");
 }  // namespace hshm
@@ -83,6 +83,74 @@ TEST_CASE("ThreadLocalAllocator") {
   Posttest();
 }
 
+TEST_CASE("TieredAllocator") {
+  auto alloc = Pretest<hipc::PosixTieredMmap, hipc::TieredAllocator>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  Workloads<hipc::TieredAllocator>::PageAllocationTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  Workloads<hipc::TieredAllocator>::MultiPageAllocationTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  Workloads<hipc::TieredAllocator>::ReallocationTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
+  // Placement by size and by hint
+  size_t small_size = hshm::Unit<size_t>::Kilobytes(4);
+  size_t large_size = hshm::Unit<size_t>::Megabytes(4);
+  Pointer small = alloc->Allocate(HSHM_DEFAULT_MEM_CTX, small_size);
+  Pointer large = alloc->Allocate(HSHM_DEFAULT_MEM_CTX, large_size);
+  Pointer hinted =
+      alloc->AllocateHint(HSHM_DEFAULT_MEM_CTX, small_size, hipc::MemoryTier::kCold);
+  REQUIRE(alloc->GetTier(small) == hipc::MemoryTier::kHot);
+  REQUIRE(alloc->GetTier(large) == hipc::MemoryTier::kCold);
+  REQUIRE(alloc->GetTier(hinted) == hipc::MemoryTier::kCold);
+
+  // Demote and promote while preserving data
+  memset(alloc->Convert<char>(small), 7, small_size);
+  REQUIRE(alloc->Demote(HSHM_DEFAULT_MEM_CTX, small));
+  REQUIRE(alloc->GetTier(small) == hipc::MemoryTier::kCold);
+  REQUIRE(VerifyBuffer(alloc->Convert<char>(small), small_size, 7));
+  REQUIRE(!alloc->Demote(HSHM_DEFAULT_MEM_CTX, small));
+  REQUIRE(alloc->Promote(HSHM_DEFAULT_MEM_CTX, small));
+  REQUIRE(alloc->GetTier(small) == hipc::MemoryTier::kHot);
+  REQUIRE(VerifyBuffer(alloc->Convert<char>(small), small_size, 7));
+
+  // kAuto moves data to the tier its size would be allocated in
+  REQUIRE(alloc->Demote(HSHM_DEFAULT_MEM_CTX, small));
+  hipc::OffsetPointer small_off(small.off_.load());
+  small_off = alloc->MoveOffset(HSHM_DEFAULT_MEM_CTX, small_off,
+                                hipc::MemoryTier::kAuto);
+  small.off_ = small_off.load();
+  REQUIRE(alloc->GetTier(small) == hipc::MemoryTier::kHot);
+  REQUIRE(VerifyBuffer(alloc->Convert<char>(small), small_size, 7));
+  REQUIRE(alloc->GetTierAllocatedSize(hipc::MemoryTier::kAuto) ==
+          alloc->GetTierAllocatedSize(hipc::MemoryTier::kHot) +
+              alloc->GetTierAllocatedSize(hipc::MemoryTier::kCold));
+
+  // Pointers from both tiers resolve through the memory manager
+  REQUIRE(HSHM_MEMORY_MANAGER->Convert(alloc->Convert<char>(large)) == large);
+
+  alloc->Free(HSHM_DEFAULT_MEM_CTX, small);
+  alloc->Free(HSHM_DEFAULT_MEM_CTX, large);
+  alloc->Free(HSHM_DEFAULT_MEM_CTX, hinted);
+  REQUIRE(alloc->GetTierAllocatedSize(hipc::MemoryTier::kHot) == 0);
+  REQUIRE(alloc->GetTierAllocatedSize(hipc::MemoryTier::kCold) == 0);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
+  Posttest();
+}
+
+TEST_CASE("TieredAllocatorColdPathTooLong") {
+  // The default cold path is /tmp/<url>.cold, which does not fit
+  hipc::PosixTieredMmap backend;
+  std::string url(hipc::PosixTieredMmap::kMaxColdPath - 4, 'c');
+  REQUIRE(!backend.shm_init(hipc::MemoryBackendId::Get(0),
+                            hshm::Unit<size_t>::Megabytes(1), url));
+}
+
 TEST_CASE("LocaFullPtrs") {
   auto alloc = Pretest<hipc::PosixShmMmap, hipc::ScalablePageAllocator>();
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
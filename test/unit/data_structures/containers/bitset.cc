@@ -0,0 +1,155 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <thread>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/bitset.h"
+
+using hshm::ipc::bitset;
+using hshm::ipc::bitset_templ;
+
+template<bool ATOMIC>
+void BitsetOpTest(size_t nbits) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  bitset_templ<ATOMIC> bits(alloc, nbits);
+  size_t npos = bitset_templ<ATOMIC>::npos;
+
+  // A new bitset is all clear
+  PAGE_DIVIDE("Empty") {
+    REQUIRE(bits.size() == nbits);
+    REQUIRE(bits.none());
+    REQUIRE(bits.popcount() == 0);
+    REQUIRE(bits.find_first_set() == npos);
+    REQUIRE(bits.find_first_clear() == 0);
+  }
+
+  // Single bits, including both ends and word boundaries
+  PAGE_DIVIDE("Single bits") {
+    std::vector<size_t> positions = {0, 63, 64, 255, 256, nbits / 2,
+                                     nbits - 1};
+    for (size_t pos : positions) {
+      REQUIRE(!bits.test_and_set(pos));
+      REQUIRE(bits.test_and_set(pos));
+      REQUIRE(bits.test(pos));
+    }
+    REQUIRE(bits.popcount() == positions.size());
+    REQUIRE(bits.find_first_set() == 0);
+    REQUIRE(bits.find_first_set(1) == 63);
+    REQUIRE(bits.find_first_set(65) == 255);
+    REQUIRE(bits.find_first_set(257) == nbits / 2);
+    REQUIRE(bits.find_first_set(nbits / 2 + 1) == nbits - 1);
+    REQUIRE(bits.find_first_clear() == 1);
+    for (size_t pos : positions) {
+      REQUIRE(bits.test_and_clear(pos));
+      REQUIRE(!bits.test_and_clear(pos));
+    }
+    REQUIRE(bits.none());
+  }
+
+  // Range ops with unaligned ends
+  PAGE_DIVIDE("Ranges") {
+    bits.set_range(3, nbits - 5);
+    REQUIRE(bits.popcount() == nbits - 8);
+    REQUIRE(bits.popcount(0, 64) == 61);
+    REQUIRE(bits.popcount(100, 1000) == 900);
+    REQUIRE(bits.find_first_clear() == 0);
+    REQUIRE(bits.find_first_clear(3) == nbits - 5);
+    bits.clear_range(10, 20);
+    REQUIRE(bits.find_first_clear(3) == 10);
+    REQUIRE(bits.popcount() == nbits - 18);
+    bits.set_all();
+    REQUIRE(bits.popcount() == nbits);
+    REQUIRE(bits.find_first_clear() == npos);
+    bits.clear_all();
+    REQUIRE(bits.none());
+  }
+
+  // Bulk ops split across threads
+  PAGE_DIVIDE("Bulk and/or") {
+    bitset_templ<ATOMIC> evens(alloc, nbits);
+    bitset_templ<ATOMIC> low(alloc, nbits);
+    for (size_t i = 0; i < nbits; i += 2) {
+      evens.set(i);
+    }
+    low.set_range(0, nbits / 2);
+    bits.or_with(evens, 4);
+    REQUIRE(bits.popcount() == (nbits + 1) / 2);
+    bits.and_with(low, 4);
+    REQUIRE(bits.popcount() == (nbits / 2 + 1) / 2);
+    REQUIRE(bits.find_first_set(nbits / 2) == npos);
+  }
+
+  // Copies, moves and resizes keep the bits
+  PAGE_DIVIDE("Copy, move and resize") {
+    bits.clear_all();
+    bits.set(7);
+    bits.set(nbits - 1);
+    bitset_templ<ATOMIC> copy(alloc, bits);
+    REQUIRE(copy.popcount() == 2);
+    bitset_templ<ATOMIC> moved(std::move(copy));
+    REQUIRE(moved.test(nbits - 1));
+    moved.resize(nbits - 1);
+    REQUIRE(moved.popcount() == 1);
+    moved.resize(nbits * 2);
+    REQUIRE(moved.popcount() == 1);
+    REQUIRE(!moved.test(nbits - 1));
+    REQUIRE(moved.find_first_set(8) == npos);
+  }
+}
+
+/** Threads race to claim bits. Each bit is claimed exactly once. */
+void BitsetConcurrentTest(int nthreads, size_t nbits) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  bitset<> bits(alloc, nbits);
+  std::vector<std::thread> threads;
+  hipc::atomic<size_t> claimed(0);
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&]() {
+      size_t pos = 0;
+      while ((pos = bits.find_first_clear(pos)) != bitset<>::npos) {
+        if (!bits.test_and_set(pos)) {
+          claimed.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(claimed.load() == nbits);
+  REQUIRE(bits.popcount() == nbits);
+}
+
+TEST_CASE("BitsetAtomic") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BitsetOpTest<true>(1000003);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("BitsetNonAtomic") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BitsetOpTest<false>(4099);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("BitsetConcurrent") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("Claim bits") {
+    BitsetConcurrentTest(8, 1 << 16);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
@@ -0,0 +1,99 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <thread>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/bloom_filter.h"
+
+using hshm::ipc::bloom_filter;
+
+/** Inserted keys are always found, and misses stay near the target rate */
+template<typename T>
+void BloomFilterOpTest(size_t count, double fpr) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  bloom_filter<T> filter(alloc, count, fpr);
+
+  PAGE_DIVIDE("Insert") {
+    REQUIRE(filter.GetNumBits() >= count * 9);
+    for (size_t i = 0; i < count; ++i) {
+      filter.insert((T)i);
+    }
+    REQUIRE(filter.size() == count);
+    for (size_t i = 0; i < count; ++i) {
+      REQUIRE(filter.contains((T)i));
+    }
+  }
+
+  PAGE_DIVIDE("False positives") {
+    size_t false_positives = 0;
+    for (size_t i = count; i < 2 * count; ++i) {
+      false_positives += filter.contains((T)i);
+    }
+    REQUIRE((double)false_positives / count < 2 * fpr);
+  }
+
+  PAGE_DIVIDE("Copy, move and clear") {
+    bloom_filter<T> copy(alloc, filter);
+    REQUIRE(copy.contains((T)0));
+    bloom_filter<T> moved(std::move(copy));
+    REQUIRE(moved.contains((T)(count - 1)));
+    moved.clear();
+    REQUIRE(moved.size() == 0);
+    REQUIRE(!moved.contains((T)0));
+  }
+}
+
+/** Threads insert disjoint keys at once. None of them are lost. */
+void BloomFilterConcurrentTest(int nthreads, size_t count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  bloom_filter<size_t> filter(alloc, nthreads * count, .01);
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&, rank]() {
+      for (size_t i = 0; i < count; ++i) {
+        filter.insert(rank * count + i);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(filter.size() == nthreads * count);
+  for (size_t i = 0; i < nthreads * count; ++i) {
+    REQUIRE(filter.contains(i));
+  }
+}
+
+TEST_CASE("BloomFilterOfInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BloomFilterOpTest<int>(100000, .01);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("BloomFilterOfU64") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BloomFilterOpTest<hshm::u64>(100000, .001);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("BloomFilterConcurrent") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("Insert") {
+    BloomFilterConcurrentTest(8, 8192);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
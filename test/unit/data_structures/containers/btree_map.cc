@@ -0,0 +1,249 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/btree_map.h"
+#include "hermes_shm/data_structures/ipc/string.h"
+
+using hshm::ipc::btree_map;
+using hshm::ipc::string;
+
+#define GET_INT_FROM_VAL(VAR) CREATE_GET_INT_FROM_VAR(Val, val_ret, VAR)
+
+#define CREATE_KV_PAIR(KEY_NAME, KEY, VAL_NAME, VAL)\
+  CREATE_SET_VAR_TO_INT_OR_STRING(Key, KEY_NAME, KEY); \
+  CREATE_SET_VAR_TO_INT_OR_STRING(Val, VAL_NAME, VAL);
+
+/** Keys are zero-padded so strings sort like the integers they encode */
+template<typename Key>
+Key MakeKey(int i) {
+  if constexpr (std::is_same_v<Key, int>) {
+    return i;
+  } else {
+    std::string text = std::to_string(i);
+    return Key(std::string(8 - text.size(), '0') + text);
+  }
+}
+
+template<typename Key>
+int KeyToInt(const Key &key) {
+  if constexpr (std::is_same_v<Key, int>) {
+    return key;
+  } else {
+    return std::stoi(key.str());
+  }
+}
+
+template<typename Key, typename Val>
+void BtreeMapOpTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  // Small nodes, so 1000 entries span several levels
+  btree_map<Key, Val> map(alloc, 64);
+  int count = 1000;
+  std::vector<int> order(count);
+  for (int i = 0; i < count; ++i) {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(7));
+
+  // Insert entries in random order
+  PAGE_DIVIDE("Insert entries") {
+    for (int i : order) {
+      CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, i);
+      REQUIRE(map.emplace(MakeKey<Key>(i), val));
+    }
+    REQUIRE(map.size() == (size_t)count);
+    REQUIRE(map.get_height() > 2);
+  }
+
+  // Check if the entries are findable
+  PAGE_DIVIDE("Check if entries are findable") {
+    for (int i = 0; i < count; ++i) {
+      CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, i);
+      Val found;
+      REQUIRE(map.find(MakeKey<Key>(i), found));
+      REQUIRE(found == val);
+      REQUIRE(map.contains(MakeKey<Key>(i)));
+    }
+    REQUIRE(!map.contains(MakeKey<Key>(count)));
+  }
+
+  // Iterate in key order
+  PAGE_DIVIDE("Forward iterate") {
+    int i = 0;
+    for (auto iter = map.begin(); iter != map.end(); ++iter) {
+      REQUIRE(KeyToInt(iter.GetKey()) == i);
+      GET_INT_FROM_VAL(iter.GetVal());
+      REQUIRE(val_ret == i);
+      ++i;
+    }
+    REQUIRE(i == count);
+  }
+
+  // lower_bound and range scans
+  PAGE_DIVIDE("Range queries") {
+    auto iter = map.lower_bound(MakeKey<Key>(500));
+    REQUIRE(KeyToInt(iter.GetKey()) == 500);
+    REQUIRE(map.lower_bound(MakeKey<Key>(count)).is_end());
+    std::vector<int> keys;
+    size_t n = map.scan(MakeKey<Key>(250), MakeKey<Key>(750),
+                        [&keys](const Key &key, const Val &val) {
+                          keys.emplace_back(KeyToInt(key));
+                        });
+    REQUIRE(n == 500);
+    REQUIRE(keys.size() == 500);
+    for (int i = 0; i < 500; ++i) {
+      REQUIRE(keys[i] == 250 + i);
+    }
+  }
+
+  // try_emplace does not modify existing entries, emplace does
+  PAGE_DIVIDE("Modify existing entries") {
+    CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, 1005);
+    REQUIRE(!map.try_emplace(MakeKey<Key>(5), val));
+    REQUIRE(map.emplace(MakeKey<Key>(5), val));
+    Val found;
+    REQUIRE(map.find(MakeKey<Key>(5), found));
+    REQUIRE(found == val);
+    REQUIRE(map.size() == (size_t)count);
+  }
+
+  // Erase the even entries
+  PAGE_DIVIDE("Erase entries") {
+    for (int i = 0; i < count; i += 2) {
+      REQUIRE(map.erase(MakeKey<Key>(i)));
+      REQUIRE(!map.erase(MakeKey<Key>(i)));
+    }
+    REQUIRE(map.size() == (size_t)count / 2);
+    int i = 1;
+    for (auto iter = map.begin(); !iter.is_end(); ++iter, i += 2) {
+      REQUIRE(KeyToInt(iter.GetKey()) == i);
+    }
+    REQUIRE(i == count + 1);
+  }
+
+  // Copy and move the map
+  PAGE_DIVIDE("Copy and move") {
+    btree_map<Key, Val> copy(map);
+    REQUIRE(copy.size() == (size_t)count / 2);
+    btree_map<Key, Val> moved(std::move(copy));
+    REQUIRE(moved.size() == (size_t)count / 2);
+    REQUIRE(moved.contains(MakeKey<Key>(7)));
+    REQUIRE(!moved.contains(MakeKey<Key>(8)));
+  }
+
+  // Bulk load sorted input
+  PAGE_DIVIDE("Bulk load") {
+    std::vector<std::pair<Key, Val>> entries;
+    for (int i = 0; i < count; ++i) {
+      CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, i);
+      entries.emplace_back(MakeKey<Key>(2 * i), val);
+    }
+    map.bulk_load(entries.begin(), entries.end());
+    REQUIRE(map.size() == (size_t)count);
+    REQUIRE(map.get_height() > 2);
+    for (int i = 0; i < 2 * count; ++i) {
+      REQUIRE(map.contains(MakeKey<Key>(i)) == (i % 2 == 0));
+    }
+    CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, 0);
+    REQUIRE(map.emplace(MakeKey<Key>(1), val));
+    REQUIRE(KeyToInt(map.lower_bound(MakeKey<Key>(1)).GetKey()) == 1);
+  }
+
+  // Erase the entire map
+  PAGE_DIVIDE("Clear") {
+    map.clear();
+    REQUIRE(map.size() == 0);
+    REQUIRE(map.begin().is_end());
+    CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, 1);
+    REQUIRE(map.emplace(MakeKey<Key>(1), val));
+    REQUIRE(map.size() == 1);
+  }
+}
+
+void BtreeMapMultiThreadedTest(int nthreads, int count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  btree_map<int, int> map(alloc, 256);
+  std::vector<std::thread> threads;
+  hipc::atomic<int> errors(0);
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&map, &errors, rank, nthreads, count]() {
+      // Interleave the keys of all threads so they share leaves
+      for (int i = 0; i < count; ++i) {
+        int key = i * nthreads + rank;
+        map.emplace(key, key);
+        int found;
+        if (!map.find(key, found) || found != key) {
+          errors.fetch_add(1);
+        }
+        if (i % 64 == 0) {
+          // Scans must see keys in increasing order with their values
+          int last = -1;
+          map.scan(0, nthreads * count, [&](const int &k, const int &v) {
+            if (k <= last || k != v) {
+              errors.fetch_add(1);
+            }
+            last = k;
+          });
+        }
+      }
+      // Erase the odd keys
+      for (int i = 0; i < count; ++i) {
+        int key = i * nthreads + rank;
+        if (key % 2 == 1 && !map.erase(key)) {
+          errors.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(errors.load() == 0);
+  REQUIRE(map.size() == (size_t)(nthreads * count / 2));
+  for (int i = 0; i < nthreads * count; ++i) {
+    REQUIRE(map.contains(i) == (i % 2 == 0));
+  }
+}
+
+TEST_CASE("BtreeMapOfIntInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BtreeMapOpTest<int, int>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("BtreeMapOfIntString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BtreeMapOpTest<int, string>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("BtreeMapOfStringString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BtreeMapOpTest<string, string>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("BtreeMapMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BtreeMapMultiThreadedTest(8, 4096);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
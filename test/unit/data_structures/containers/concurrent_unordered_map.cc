@@ -0,0 +1,182 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <thread>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/concurrent_unordered_map.h"
+#include "hermes_shm/data_structures/ipc/string.h"
+
+using hshm::ipc::concurrent_unordered_map;
+using hshm::ipc::string;
+
+#define GET_INT_FROM_VAL(VAR) CREATE_GET_INT_FROM_VAR(Val, val_ret, VAR)
+
+#define CREATE_KV_PAIR(KEY_NAME, KEY, VAL_NAME, VAL)\
+  CREATE_SET_VAR_TO_INT_OR_STRING(Key, KEY_NAME, KEY); \
+  CREATE_SET_VAR_TO_INT_OR_STRING(Val, VAL_NAME, VAL);
+
+template<typename Key, typename Val>
+void ConcurrentUnorderedMapOpTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  concurrent_unordered_map<Key, Val> map(alloc, 4, 2);
+
+  // Insert 100 entries into the map (forces per-shard growth)
+  PAGE_DIVIDE("Insert entries") {
+    for (int i = 0; i < 100; ++i) {
+      CREATE_KV_PAIR(key, i, val, i);
+      REQUIRE(map.emplace(key, val));
+    }
+    REQUIRE(map.size() == 100);
+    REQUIRE(map.get_num_buckets() > 8);
+  }
+
+  // Check if the entries are findable
+  PAGE_DIVIDE("Check if entries are findable") {
+    for (int i = 0; i < 100; ++i) {
+      CREATE_KV_PAIR(key, i, val, i);
+      Val found;
+      REQUIRE(map.find(key, found));
+      REQUIRE(found == val);
+      REQUIRE(map.contains(key));
+    }
+  }
+
+  // Visit every entry
+  PAGE_DIVIDE("Visit every entry") {
+    std::vector<int> vals;
+    map.for_each([&vals](const Key &key, const Val &val) {
+      GET_INT_FROM_VAL(val);
+      vals.emplace_back(val_ret);
+    });
+    std::sort(vals.begin(), vals.end());
+    REQUIRE(vals.size() == 100);
+    for (int i = 0; i < 100; ++i) {
+      REQUIRE(vals[i] == i);
+    }
+  }
+
+  // try_emplace does not modify existing entries, emplace does
+  PAGE_DIVIDE("Modify existing entries") {
+    CREATE_KV_PAIR(key, 5, val, 105);
+    REQUIRE(!map.try_emplace(key, val));
+    Val found;
+    REQUIRE(map.find(key, found));
+    GET_INT_FROM_VAL(found);
+    REQUIRE(val_ret == 5);
+    REQUIRE(map.emplace(key, val));
+    REQUIRE(map.find(key, found));
+    REQUIRE(found == val);
+    REQUIRE(map.size() == 100);
+  }
+
+  // Erase the even entries
+  PAGE_DIVIDE("Erase entries") {
+    for (int i = 0; i < 100; i += 2) {
+      CREATE_KV_PAIR(key, i, val, i);
+      REQUIRE(map.erase(key));
+      REQUIRE(!map.erase(key));
+    }
+    REQUIRE(map.size() == 50);
+    for (int i = 0; i < 100; ++i) {
+      CREATE_KV_PAIR(key, i, val, i);
+      REQUIRE(map.contains(key) == (i % 2 == 1));
+    }
+  }
+
+  // Copy and move the map
+  PAGE_DIVIDE("Copy and move") {
+    concurrent_unordered_map<Key, Val> copy(map);
+    REQUIRE(copy.size() == 50);
+    concurrent_unordered_map<Key, Val> moved(std::move(copy));
+    REQUIRE(moved.size() == 50);
+    CREATE_KV_PAIR(key, 7, val, 7);
+    REQUIRE(moved.contains(key));
+  }
+
+  // Erase the entire map
+  PAGE_DIVIDE("Clear") {
+    map.clear();
+    REQUIRE(map.size() == 0);
+    CREATE_KV_PAIR(key, 1, val, 1);
+    REQUIRE(!map.contains(key));
+    REQUIRE(map.emplace(key, val));
+    REQUIRE(map.size() == 1);
+  }
+}
+
+template<typename Val>
+void ConcurrentUnorderedMapMultiThreadedTest(int nthreads, int count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  concurrent_unordered_map<int, Val> map(alloc, 8, 2);
+  std::vector<std::thread> threads;
+  hipc::atomic<int> errors(0);
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&map, &errors, rank, count]() {
+      int base = rank * count;
+      // Insert this thread's keys while reading the others' keys
+      for (int i = 0; i < count; ++i) {
+        CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, base + i);
+        map.emplace(base + i, val);
+        Val found;
+        if (!map.find(base + i, found) || !(found == val)) {
+          errors.fetch_add(1);
+        }
+        map.contains((base + count + i) % (count * 4));
+      }
+      // Erase the odd keys
+      for (int i = 1; i < count; i += 2) {
+        if (!map.erase(base + i)) {
+          errors.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(errors.load() == 0);
+  REQUIRE(map.size() == (size_t)(nthreads * ((count + 1) / 2)));
+  for (int i = 0; i < nthreads * count; ++i) {
+    REQUIRE(map.contains(i) == (i % count % 2 == 0));
+  }
+}
+
+TEST_CASE("ConcurrentUnorderedMapOfIntInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ConcurrentUnorderedMapOpTest<int, int>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("ConcurrentUnorderedMapOfIntString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ConcurrentUnorderedMapOpTest<int, string>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("ConcurrentUnorderedMapOfStringString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ConcurrentUnorderedMapOpTest<string, string>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("ConcurrentUnorderedMapMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ConcurrentUnorderedMapMultiThreadedTest<int>(8, 4096);
+  ConcurrentUnorderedMapMultiThreadedTest<string>(4, 1024);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
@@ -0,0 +1,179 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <thread>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/cuckoo_filter.h"
+
+using hshm::ipc::cuckoo_filter;
+
+/**
+ * Fill to the sized capacity, check misses stay near the target rate,
+ * then erase half of the keys.
+ * */
+template<typename T>
+void CuckooFilterOpTest(size_t count, double fpr, hshm::u32 fp_bits) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  cuckoo_filter<T> filter(alloc, count, fpr);
+  REQUIRE(filter.GetFingerprintBits() == fp_bits);
+
+  PAGE_DIVIDE("Insert") {
+    for (size_t i = 0; i < count; ++i) {
+      REQUIRE(filter.insert((T)i));
+    }
+    REQUIRE(filter.size() == count);
+    for (size_t i = 0; i < count; ++i) {
+      REQUIRE(filter.contains((T)i));
+    }
+  }
+
+  PAGE_DIVIDE("False positives") {
+    size_t false_positives = 0;
+    for (size_t i = count; i < 2 * count; ++i) {
+      false_positives += filter.contains((T)i);
+    }
+    REQUIRE((double)false_positives / count < 2 * fpr);
+  }
+
+  PAGE_DIVIDE("Erase") {
+    for (size_t i = 0; i < count; i += 2) {
+      REQUIRE(filter.erase((T)i));
+    }
+    REQUIRE(filter.size() == count / 2);
+    for (size_t i = 1; i < count; i += 2) {
+      REQUIRE(filter.contains((T)i));
+    }
+  }
+
+  PAGE_DIVIDE("Copy, move and clear") {
+    cuckoo_filter<T> copy(alloc, filter);
+    REQUIRE(copy.contains((T)1));
+    cuckoo_filter<T> moved(std::move(copy));
+    REQUIRE(moved.contains((T)(count - 1)));
+    moved.clear();
+    REQUIRE(moved.size() == 0);
+  }
+}
+
+/**
+ * Every key the filter is sized for fits, including counts just below a
+ * doubling of the bucket array, where the table is fullest.
+ * */
+void CuckooFilterSizingTest(double fpr, hshm::u32 fp_bits) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  size_t slots = 64 / fp_bits;
+  for (size_t num_keys : {(size_t)7370, (size_t)14743, (size_t)29489,
+                          (size_t)(8191 * slots * .84),
+                          (size_t)(8191 * slots * .95)}) {
+    cuckoo_filter<size_t> filter(alloc, num_keys, fpr);
+    REQUIRE(filter.GetFingerprintBits() == fp_bits);
+    size_t failures = 0;
+    for (size_t i = 0; i < num_keys; ++i) {
+      failures += !filter.insert(i);
+    }
+    REQUIRE(failures == 0);
+    REQUIRE(filter.size() == num_keys);
+  }
+}
+
+/** Inserting well past capacity fails cleanly and loses nothing */
+void CuckooFilterOverflowTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  cuckoo_filter<int> filter(alloc, 1000, .001);
+  int inserted = 0;
+  while (filter.insert(inserted)) {
+    ++inserted;
+  }
+  REQUIRE((size_t)inserted >= filter.GetCapacity() * 9 / 10);
+  for (int i = 0; i < inserted; ++i) {
+    REQUIRE(filter.contains(i));
+  }
+}
+
+/**
+ * Threads insert and erase their own keys while the filter is near full,
+ * so inserts take the eviction path. Live keys are always found.
+ * */
+void CuckooFilterConcurrentTest(int nthreads, size_t count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  cuckoo_filter<size_t> filter(alloc, nthreads * count, .001);
+  std::vector<std::thread> threads;
+  hipc::atomic<int> failures(0);
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&, rank]() {
+      size_t base = rank * count;
+      for (size_t i = 0; i < count; ++i) {
+        if (!filter.insert(base + i)) {
+          failures.fetch_add(1);
+        }
+        if (i % 4 == 3 && !filter.erase(base + i - 3)) {
+          failures.fetch_add(1);
+        }
+        if (!filter.contains(base + i)) {
+          failures.fetch_add(1);
+        }
+      }
+      for (size_t i = 0; i < count; ++i) {
+        if (i % 4 != 0 && !filter.contains(base + i)) {
+          failures.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(failures.load() == 0);
+  REQUIRE(filter.size() == nthreads * (count - count / 4));
+}
+
+TEST_CASE("CuckooFilterOfInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  CuckooFilterOpTest<int>(100000, .001, 16);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("CuckooFilterFingerprintWidth") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  CuckooFilterOpTest<hshm::u64>(50000, .1, 8);
+  CuckooFilterOpTest<hshm::u64>(50000, 1e-6, 32);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("CuckooFilterSizing") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  CuckooFilterSizingTest(1e-5, 32);
+  CuckooFilterSizingTest(.001, 16);
+  CuckooFilterSizingTest(.1, 8);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("CuckooFilterOverflow") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  CuckooFilterOverflowTest();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("CuckooFilterConcurrent") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("Insert and erase") {
+    CuckooFilterConcurrentTest(8, 8192);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
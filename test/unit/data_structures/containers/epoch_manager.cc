@@ -0,0 +1,228 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/epoch_manager.h"
+
+using hshm::ipc::EpochGuard;
+using hshm::ipc::epoch_manager;
+
+/** A node that readers check for use after free */
+struct EpochNode {
+  size_t magic_;
+  size_t val_;
+};
+static const size_t kEpochNodeMagic = 0x5eed5eed5eed5eed;
+
+/** Allocate a node with a value */
+template <typename AllocT>
+hipc::Pointer NewEpochNode(AllocT *alloc, size_t val) {
+  hipc::Pointer p = alloc->Allocate(HSHM_DEFAULT_MEM_CTX, sizeof(EpochNode));
+  EpochNode *node = alloc->template Convert<EpochNode>(p);
+  node->magic_ = kEpochNodeMagic;
+  node->val_ = val;
+  return p;
+}
+
+void EpochManagerOpTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  epoch_manager<> ebr(alloc, 8);
+  int writer = ebr.Register();
+  int reader = ebr.Register();
+  REQUIRE(ebr.GetNumParticipants() == 2);
+
+  // Retired nodes are freed only after a grace period
+  PAGE_DIVIDE("Grace period") {
+    hipc::Pointer p = NewEpochNode(alloc, 1);
+    {
+      EpochGuard guard(ebr, writer);
+      guard.Retire(p);
+    }
+    REQUIRE(ebr.GetNumPending() == 1);
+    REQUIRE(ebr.Flush(writer));
+    REQUIRE(ebr.Flush(writer));
+    REQUIRE(ebr.GetNumPending() == 0);
+  }
+
+  // A reader inside a critical section holds back reclamation
+  PAGE_DIVIDE("Reader blocks reclamation") {
+    hipc::Pointer p = NewEpochNode(alloc, 2);
+    hshm::u64 epoch = ebr.GetEpoch();
+    ebr.Enter(reader);
+    ebr.Enter(reader);
+    ebr.Retire(writer, p);
+    for (int i = 0; i < 8; ++i) {
+      ebr.Flush(writer);
+    }
+    REQUIRE(ebr.GetEpoch() == epoch + 1);
+    REQUIRE(ebr.GetNumPending() == 1);
+    REQUIRE(alloc->template Convert<EpochNode>(p)->magic_ == kEpochNodeMagic);
+    ebr.Exit(reader);
+    for (int i = 0; i < 8; ++i) {
+      ebr.Flush(writer);
+    }
+    REQUIRE(ebr.GetNumPending() == 1);
+    ebr.Exit(reader);
+    for (int i = 0; i < 2; ++i) {
+      ebr.Flush(writer);
+    }
+    REQUIRE(ebr.GetNumPending() == 0);
+  }
+
+  // Pointers pending at Unregister are orphaned and freed by others
+  PAGE_DIVIDE("Orphaned pointers") {
+    int temp = ebr.Register();
+    ebr.Enter(reader);
+    for (size_t i = 0; i < 100; ++i) {
+      ebr.Retire(temp, NewEpochNode(alloc, i));
+    }
+    ebr.Unregister(temp);
+    REQUIRE(ebr.GetNumParticipants() == 2);
+    REQUIRE(ebr.GetNumPending() == 100);
+    ebr.Exit(reader);
+    for (int i = 0; i < 3; ++i) {
+      ebr.Flush(writer);
+    }
+    REQUIRE(ebr.GetNumPending() == 0);
+  }
+
+  // Records are reused and limited
+  PAGE_DIVIDE("Participant limit") {
+    std::vector<int> rids;
+    for (int i = 0; i < 6; ++i) {
+      rids.emplace_back(ebr.Register());
+    }
+    REQUIRE(ebr.GetNumParticipants() == 8);
+    REQUIRE_THROWS(ebr.Register());
+    for (int rid : rids) {
+      ebr.Unregister(rid);
+    }
+    REQUIRE(ebr.GetNumParticipants() == 2);
+  }
+
+  // Pointers are freed through the manager's allocator type
+  PAGE_DIVIDE("Retire from another allocator type") {
+    hipc::Pointer p(HSHM_ROOT_ALLOC->GetId(), 0);
+    REQUIRE_THROWS(ebr.Retire(writer, p));
+    REQUIRE(ebr.GetNumPending() == 0);
+  }
+
+  ebr.Unregister(writer);
+  ebr.Unregister(reader);
+}
+
+/** A participant whose process dies inside a critical section is reaped */
+void EpochManagerDeadTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  // The records live in the shared backend, so the child's copy of the
+  // manager refers to the same records
+  epoch_manager<> ebr(alloc, 4);
+  int self = ebr.Register();
+  pid_t pid = fork();
+  if (pid == 0) {
+    int rid = ebr.Register();
+    ebr.Enter(rid);
+    _exit(0);
+  }
+  waitpid(pid, nullptr, 0);
+  REQUIRE(ebr.GetNumParticipants() == 2);
+
+  ebr.Retire(self, NewEpochNode(alloc, 0));
+  size_t flushes = 0;
+  while (ebr.GetNumPending() != 0) {
+    ebr.Flush(self);
+    REQUIRE(++flushes < 1000);
+  }
+  REQUIRE(flushes > 3);
+  REQUIRE(ebr.GetNumParticipants() == 1);
+  ebr.Unregister(self);
+}
+
+/**
+ * Writers swap nodes in and out of shared slots while readers check them.
+ * A node must never be freed while a reader can still see it.
+ * */
+void EpochManagerConcurrentTest(int nreaders, int nwriters, int count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  epoch_manager<> ebr(alloc, nreaders + nwriters);
+  hipc::AllocatorId alloc_id = alloc->GetId();
+  std::vector<hipc::atomic<size_t>> slots(16);
+  for (size_t i = 0; i < slots.size(); ++i) {
+    slots[i] = NewEpochNode(alloc, i).off_.load();
+  }
+  hipc::atomic<int> errors(0);
+  hipc::atomic<int> writers_left(nwriters);
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank < nwriters; ++rank) {
+    threads.emplace_back([&, rank]() {
+      int rid = ebr.Register();
+      for (int i = 0; i < count; ++i) {
+        EpochGuard guard(ebr, rid);
+        hipc::atomic<size_t> &slot = slots[(rank + i) % slots.size()];
+        hipc::Pointer p = NewEpochNode(alloc, i);
+        guard.Retire(hipc::Pointer(alloc_id, slot.exchange(p.off_.load())));
+      }
+      ebr.Unregister(rid);
+      writers_left.fetch_sub(1);
+    });
+  }
+  for (int rank = 0; rank < nreaders; ++rank) {
+    threads.emplace_back([&, rank]() {
+      int rid = ebr.Register();
+      for (size_t i = rank; writers_left.load() > 0; ++i) {
+        EpochGuard guard(ebr, rid);
+        EpochNode *node = alloc->template Convert<EpochNode>(
+            hipc::Pointer(alloc_id, slots[i % slots.size()].load()));
+        if (node->magic_ != kEpochNodeMagic) {
+          errors.fetch_add(1);
+        }
+      }
+      ebr.Unregister(rid);
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(errors.load() == 0);
+  REQUIRE(ebr.GetNumParticipants() == 0);
+  for (hipc::atomic<size_t> &slot : slots) {
+    hipc::Pointer p(alloc_id, slot.load());
+    alloc->Free(HSHM_DEFAULT_MEM_CTX, p);
+  }
+}
+
+TEST_CASE("EpochManager") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  EpochManagerOpTest();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("EpochManagerDeadParticipant") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  EpochManagerDeadTest();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("EpochManagerConcurrent") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  EpochManagerConcurrentTest(4, 4, 4096);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
@@ -0,0 +1,254 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <thread>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/lru_cache.h"
+#include "hermes_shm/data_structures/ipc/string.h"
+
+using hshm::ipc::lru_cache;
+using hshm::ipc::string;
+
+#define GET_INT_FROM_KEY(VAR) CREATE_GET_INT_FROM_VAR(Key, key_ret, VAR)
+#define GET_INT_FROM_VAL(VAR) CREATE_GET_INT_FROM_VAR(Val, val_ret, VAR)
+
+#define CREATE_KV_PAIR(KEY_NAME, KEY, VAL_NAME, VAL)\
+  CREATE_SET_VAR_TO_INT_OR_STRING(Key, KEY_NAME, KEY); \
+  CREATE_SET_VAR_TO_INT_OR_STRING(Val, VAL_NAME, VAL);
+
+/** Counts evictions and sums the evicted values */
+static hipc::atomic<int> evicted_count(0);
+static hipc::atomic<int> evicted_sum(0);
+
+struct CountEvict {
+  template <typename Key, typename Val>
+  void operator()(const Key &key, Val &val) const {
+    GET_INT_FROM_VAL(val);
+    evicted_count.fetch_add(1);
+    evicted_sum.fetch_add(val_ret);
+  }
+};
+
+template<typename Key, typename Val>
+void LruCacheOpTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  lru_cache<Key, Val, hshm::hash<Key>, CountEvict> cache(alloc, 64, 0, 1);
+  evicted_count = 0;
+  evicted_sum = 0;
+
+  // Fill the cache to capacity
+  PAGE_DIVIDE("Insert entries") {
+    for (int i = 0; i < 64; ++i) {
+      CREATE_KV_PAIR(key, i, val, i);
+      REQUIRE(cache.emplace(key, val));
+    }
+    REQUIRE(cache.size() == 64);
+    REQUIRE(evicted_count.load() == 0);
+  }
+
+  // Hits mark entries, so the unmarked half is evicted first
+  PAGE_DIVIDE("Referenced entries survive") {
+    for (int i = 0; i < 32; ++i) {
+      CREATE_KV_PAIR(key, i, val, i);
+      Val found;
+      REQUIRE(cache.find(key, found));
+      REQUIRE(found == val);
+    }
+    for (int i = 64; i < 96; ++i) {
+      CREATE_KV_PAIR(key, i, val, i);
+      REQUIRE(cache.emplace(key, val));
+    }
+    REQUIRE(cache.size() == 64);
+    REQUIRE(evicted_count.load() == 32);
+    REQUIRE(evicted_sum.load() == (32 + 63) * 32 / 2);
+    for (int i = 0; i < 96; ++i) {
+      CREATE_KV_PAIR(key, i, val, i);
+      REQUIRE(cache.contains(key) == (i < 32 || i >= 64));
+    }
+  }
+
+  // try_emplace does not modify existing entries, emplace does
+  PAGE_DIVIDE("Modify existing entries") {
+    CREATE_KV_PAIR(key, 5, val, 105);
+    REQUIRE(!cache.try_emplace(key, val));
+    Val found;
+    REQUIRE(cache.find(key, found));
+    GET_INT_FROM_VAL(found);
+    REQUIRE(val_ret == 5);
+    REQUIRE(cache.emplace(key, val));
+    REQUIRE(cache.find(key, found));
+    REQUIRE(found == val);
+    REQUIRE(cache.size() == 64);
+  }
+
+  // Visit every entry
+  PAGE_DIVIDE("Visit every entry") {
+    int count = 0;
+    cache.for_each([&count](const Key &key, const Val &val) {
+      GET_INT_FROM_KEY(key);
+      REQUIRE((key_ret < 32 || key_ret >= 64));
+      ++count;
+    });
+    REQUIRE(count == 64);
+  }
+
+  // Erase does not call the eviction callback
+  PAGE_DIVIDE("Erase entries") {
+    int evicted = evicted_count.load();
+    for (int i = 64; i < 96; ++i) {
+      CREATE_KV_PAIR(key, i, val, i);
+      REQUIRE(cache.erase(key));
+      REQUIRE(!cache.erase(key));
+    }
+    REQUIRE(cache.size() == 32);
+    REQUIRE(evicted_count.load() == evicted);
+  }
+
+  // Copy and move the cache
+  PAGE_DIVIDE("Copy and move") {
+    lru_cache<Key, Val, hshm::hash<Key>, CountEvict> copy(cache);
+    REQUIRE(copy.size() == 32);
+    REQUIRE(copy.get_max_entries() == 64);
+    lru_cache<Key, Val, hshm::hash<Key>, CountEvict> moved(std::move(copy));
+    REQUIRE(moved.size() == 32);
+    CREATE_KV_PAIR(key, 7, val, 7);
+    REQUIRE(moved.contains(key));
+  }
+
+  // Erase the entire cache
+  PAGE_DIVIDE("Clear") {
+    cache.clear();
+    REQUIRE(cache.size() == 0);
+    CREATE_KV_PAIR(key, 1, val, 1);
+    REQUIRE(!cache.contains(key));
+    REQUIRE(cache.emplace(key, val));
+    REQUIRE(cache.size() == 1);
+  }
+}
+
+/** A cache bounded by bytes instead of entries */
+void LruCacheBytesTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  lru_cache<int, int, hshm::hash<int>, CountEvict> cache(alloc, 0, 1000, 1);
+  evicted_count = 0;
+  evicted_sum = 0;
+
+  // Ten entries of 100 bytes fit
+  PAGE_DIVIDE("Fill by charge") {
+    for (int i = 0; i < 10; ++i) {
+      REQUIRE(cache.emplace_charged(i, 100, i));
+    }
+    REQUIRE(cache.charge() == 1000);
+    REQUIRE(cache.size() == 10);
+  }
+
+  // A large entry displaces several small ones, but is never evicted
+  // itself even though it is the least recently referenced
+  PAGE_DIVIDE("Large entry") {
+    for (int i = 0; i < 10; ++i) {
+      int found;
+      REQUIRE(cache.find(i, found));
+    }
+    REQUIRE(cache.emplace_charged(100, 550, 100));
+    REQUIRE(cache.contains(100));
+    REQUIRE(cache.charge() <= 1000);
+    REQUIRE(cache.size() == 5);
+    REQUIRE(evicted_count.load() == 6);
+  }
+
+  // Entries larger than the capacity are rejected
+  PAGE_DIVIDE("Oversized entry") {
+    REQUIRE(!cache.emplace_charged(200, 1001, 200));
+    REQUIRE(!cache.contains(200));
+  }
+
+  // Growing the charge of an entry evicts others
+  PAGE_DIVIDE("Update charge") {
+    REQUIRE(cache.emplace_charged(100, 1000, 100));
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.charge() == 1000);
+  }
+}
+
+template<typename Val>
+void LruCacheMultiThreadedTest(int nthreads, int count, size_t capacity) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  lru_cache<int, Val> cache(alloc, capacity, 0, 8);
+  std::vector<std::thread> threads;
+  hipc::atomic<int> errors(0);
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&cache, &errors, rank, count]() {
+      // Insert overlapping keys and read them back. A hit must always
+      // return the value its key was inserted with.
+      for (int i = 0; i < count; ++i) {
+        int key = (rank * count / 2 + i) % (count * 2);
+        CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, key);
+        cache.emplace(key, val);
+        for (int j = 0; j < 4; ++j) {
+          int other = (key + j * 17) % (count * 2);
+          CREATE_SET_VAR_TO_INT_OR_STRING(Val, expect, other);
+          Val found{};
+          if (cache.find(other, found) && !(found == expect)) {
+            errors.fetch_add(1);
+          }
+        }
+        if (i % 7 == 0) {
+          cache.erase(key);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(errors.load() == 0);
+  REQUIRE(cache.size() <= capacity);
+  REQUIRE(cache.size() > 0);
+}
+
+TEST_CASE("LruCacheOfIntInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  LruCacheOpTest<int, int>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("LruCacheOfIntString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  LruCacheOpTest<int, string>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("LruCacheOfStringString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  LruCacheOpTest<string, string>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("LruCacheBytes") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  LruCacheBytesTest();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("LruCacheMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  LruCacheMultiThreadedTest<int>(8, 4096, 1024);
+  LruCacheMultiThreadedTest<string>(4, 1024, 256);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
@@ -0,0 +1,219 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/concurrent_priority_queue.h"
+#include "hermes_shm/data_structures/ipc/priority_queue.h"
+#include "hermes_shm/data_structures/ipc/string.h"
+
+using hshm::ipc::concurrent_priority_queue;
+using hshm::ipc::priority_queue;
+using hshm::ipc::string;
+
+/** Orders a min-heap: the smallest element has the highest priority */
+template<typename T>
+struct PriorityQueueGreater {
+  bool operator()(const T &a, const T &b) const { return b < a; }
+};
+
+/** Values are zero-padded so strings sort like the integers they encode */
+template<typename T>
+static T MakePriorityVal(int i) {
+  if constexpr (std::is_same_v<T, int>) {
+    return i;
+  } else {
+    std::string text = std::to_string(i);
+    return T(std::string(8 - text.size(), '0') + text);
+  }
+}
+
+template<typename T, int D>
+void PriorityQueueOpTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  priority_queue<T, hshm::less<T>, D> queue(alloc);
+  int count = 1000;
+  std::vector<int> order(count);
+  for (int i = 0; i < count; ++i) {
+    order[i] = i % 500;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(7));
+
+  // Push in random order, with every value twice
+  PAGE_DIVIDE("Push") {
+    REQUIRE(queue.empty());
+    for (int i : order) {
+      queue.push(MakePriorityVal<T>(i));
+    }
+    REQUIRE(queue.size() == (size_t)count);
+    REQUIRE(queue.top() == MakePriorityVal<T>(499));
+  }
+
+  // Copy and move the queue
+  PAGE_DIVIDE("Copy and move") {
+    priority_queue<T, hshm::less<T>, D> copy(queue);
+    REQUIRE(copy.size() == (size_t)count);
+    priority_queue<T, hshm::less<T>, D> moved(std::move(copy));
+    REQUIRE(moved.size() == (size_t)count);
+    REQUIRE(moved.top() == MakePriorityVal<T>(499));
+  }
+
+  // Pop in priority order, interleaved with pushes of low values
+  PAGE_DIVIDE("Pop") {
+    T val;
+    for (int i = count - 1; i >= count / 2; --i) {
+      REQUIRE(!queue.pop(val).IsNull());
+      REQUIRE(val == MakePriorityVal<T>(i / 2));
+      queue.push(MakePriorityVal<T>(0));
+    }
+    REQUIRE(queue.size() == (size_t)count);
+    for (int i = count / 2 - 1; i >= 0; --i) {
+      REQUIRE(!queue.pop(val).IsNull());
+      REQUIRE(val == MakePriorityVal<T>(i / 2));
+    }
+    for (int i = 0; i < count / 2; ++i) {
+      REQUIRE(!queue.pop(val).IsNull());
+      REQUIRE(val == MakePriorityVal<T>(0));
+    }
+    REQUIRE(queue.pop(val).IsNull());
+    REQUIRE(queue.empty());
+  }
+
+  // Values left in the queue are destroyed with it
+  PAGE_DIVIDE("Clear") {
+    queue.push(MakePriorityVal<T>(1));
+    queue.push(MakePriorityVal<T>(2));
+    queue.clear();
+    REQUIRE(queue.empty());
+    queue.push(MakePriorityVal<T>(3));
+  }
+}
+
+/** A comparator makes a min-heap */
+void PriorityQueueComparatorTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  priority_queue<int, PriorityQueueGreater<int>, 2> queue(alloc);
+  std::vector<int> order(100);
+  for (int i = 0; i < 100; ++i) {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(3));
+  for (int i : order) {
+    queue.emplace(i);
+  }
+  int val;
+  for (int i = 0; i < 100; ++i) {
+    REQUIRE(!queue.pop(val).IsNull());
+    REQUIRE(val == i);
+  }
+}
+
+/**
+ * Producers push disjoint ranges while consumers pop. Every value comes
+ * out exactly once.
+ * */
+void ConcurrentPriorityQueueTest(int nthreads, int count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  concurrent_priority_queue<int> queue(alloc, 4);
+  std::vector<std::thread> threads;
+  std::vector<hipc::atomic<int>> seen(nthreads * count);
+  hipc::atomic<int> popped(0);
+  int total = nthreads * count;
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&, rank]() {
+      for (int i = 0; i < count; ++i) {
+        queue.push(rank * count + i);
+      }
+    });
+    threads.emplace_back([&]() {
+      int val;
+      while (popped.load() < total) {
+        if (queue.pop(val).IsNull()) {
+          HSHM_THREAD_MODEL->Yield();
+          continue;
+        }
+        seen[val].fetch_add(1);
+        popped.fetch_add(1);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (int i = 0; i < total; ++i) {
+    REQUIRE(seen[i].load() == 1);
+  }
+  REQUIRE(queue.size() == 0);
+  int val;
+  REQUIRE(queue.pop(val).IsNull());
+}
+
+/** Two-choice pops return values close to the maximum */
+void ConcurrentPriorityQueueRankTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  concurrent_priority_queue<int> queue(alloc, 4);
+  int count = 1000;
+  for (int i = 0; i < count; ++i) {
+    queue.push(i);
+  }
+  REQUIRE(queue.size() == (size_t)count);
+  concurrent_priority_queue<int> copy(alloc, queue);
+  REQUIRE(copy.size() == (size_t)count);
+  // Each pop is the top of one of the heaps, so on average few of the
+  // remaining values have a higher priority
+  std::vector<bool> seen(count, false);
+  size_t rank_sum = 0;
+  int remaining = count;
+  int val;
+  while (!queue.pop(val).IsNull()) {
+    REQUIRE(!seen[val]);
+    seen[val] = true;
+    for (int i = val + 1; i < count; ++i) {
+      rank_sum += !seen[i];
+    }
+    --remaining;
+  }
+  REQUIRE(rank_sum / count < 4 * queue.GetNumHeaps());
+  REQUIRE(remaining == 0);
+}
+
+TEST_CASE("PriorityQueueOfInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PriorityQueueOpTest<int, 4>();
+  PriorityQueueOpTest<int, 2>();
+  PriorityQueueComparatorTest();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("PriorityQueueOfString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PriorityQueueOpTest<string, 8>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("PriorityQueueConcurrent") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("Relaxed order") {
+    ConcurrentPriorityQueueRankTest();
+  }
+  PAGE_DIVIDE("Producers and consumers") {
+    ConcurrentPriorityQueueTest(4, 2048);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
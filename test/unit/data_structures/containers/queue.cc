@@ -49,6 +49,60 @@ TEST_CASE("TestSplitTicketQueueIntMultiThreaded") {
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
 }
 
+TEST_CASE("TestSplitTicketQueueSpillAndSteal") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("A thread keeps to its lane while it has room") {
+    hipc::split_ticket_queue<int> queue(alloc, 4, 4);
+    REQUIRE(queue.GetNumLanes() == 4);
+    REQUIRE(!queue.push(1).IsNull());
+    size_t used = 0;
+    for (size_t i = 0; i < queue.GetNumLanes(); ++i) {
+      used += (*queue.splits_)[i].GetSize() != 0;
+    }
+    REQUIRE(used == 1);
+    int val;
+    REQUIRE(!queue.pop(val).IsNull());
+    REQUIRE(val == 1);
+  }
+  PAGE_DIVIDE("Pushes spill into every lane and pops steal from them") {
+    hipc::split_ticket_queue<int> queue(alloc, 4, 4);
+    for (int i = 0; i < 16; ++i) {
+      REQUIRE(!queue.push(i).IsNull());
+    }
+    REQUIRE(queue.push(16).IsNull());
+    for (size_t i = 0; i < queue.GetNumLanes(); ++i) {
+      REQUIRE((*queue.splits_)[i].GetSize() == 4);
+    }
+    std::vector<int> popped;
+    int val;
+    while (!queue.pop(val).IsNull()) {
+      popped.emplace_back(val);
+    }
+    std::sort(popped.begin(), popped.end());
+    REQUIRE(popped.size() == 16);
+    for (int i = 0; i < 16; ++i) {
+      REQUIRE(popped[i] == i);
+    }
+  }
+  PAGE_DIVIDE("A thread steals what another thread pushed") {
+    hipc::split_ticket_queue<int> queue(alloc, 4, 4);
+    std::thread producer([&]() {
+      for (int i = 0; i < 3; ++i) {
+        REQUIRE(!queue.push(i).IsNull());
+      }
+    });
+    producer.join();
+    int sum = 0, val;
+    while (!queue.pop(val).IsNull()) {
+      sum += val;
+    }
+    REQUIRE(sum == 3);
+    REQUIRE(queue.size() == 0);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
 /**
  * TEST DYNAMIC QUEUE
  * */
@@ -83,6 +137,48 @@ TEST_CASE("TestDynamicQueueStringMultiThreaded") {
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
 }
 
+TEST_CASE("TestDynamicQueueIntMpmc") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ProduceAndConsume<hipc::dynamic_queue<int>, int>(4, 4, 4096, 16);
+  ProduceAndConsume<hipc::dynamic_queue<hipc::string>, hipc::string>(4, 4, 2048,
+                                                                     16);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestDynamicQueueGrowth") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    // Bursts far larger than a segment grow and then shrink the queue
+    hipc::dynamic_queue<hipc::string> queue(alloc, 16);
+    int count = 1000;
+    for (int lap = 0; lap < 3; ++lap) {
+      for (int i = 0; i < count; ++i) {
+        REQUIRE(!queue.emplace(std::to_string(i)).IsNull());
+      }
+      REQUIRE(queue.size() == (size_t)count);
+      hipc::string val;
+      for (int i = 0; i < count / 2; ++i) {
+        REQUIRE(!queue.pop(val).IsNull());
+        REQUIRE(val == std::to_string(i));
+      }
+      hipc::dynamic_queue<hipc::string> copy(alloc, queue);
+      REQUIRE(copy.size() == (size_t)count / 2);
+      for (int i = count / 2; i < count; ++i) {
+        REQUIRE(!queue.pop(val).IsNull());
+        REQUIRE(val == std::to_string(i));
+        REQUIRE(!copy.pop(val).IsNull());
+        REQUIRE(val == std::to_string(i));
+      }
+      REQUIRE(queue.pop(val).IsNull());
+    }
+    // Values left in the queue are destroyed with it
+    queue.emplace("left");
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
 /**
  * TEST SPSC LIST QUEUE
  * */
@@ -168,6 +264,94 @@ TEST_CASE("TestMpscQueuePeek") {
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
 }
 
+/**
+ * TEST WAIT QUEUES
+ * */
+
+TEST_CASE("TestMpscWaitQueueIntMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ProduceThenConsume<hipc::mpsc_wait_queue<int>, int>(1, 1, 32, 32);
+  ProduceAndConsume<hipc::mpsc_wait_queue<int>, int>(8, 1, 4096, 32);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestMpscWaitQueuePopWait") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("Timeout on an empty queue") {
+    hipc::mpsc_wait_queue<int> queue(alloc, 4);
+    int val;
+    hshm::Timer t;
+    t.Resume();
+    REQUIRE(queue.pop_wait(val, 2000).IsNull());
+    t.Pause();
+    REQUIRE(t.GetUsec() >= 2000);
+  }
+  PAGE_DIVIDE("Producers and the consumer sleep") {
+    // The queue is much smaller than the number of entries, so producers
+    // sleep on a full queue while the consumer sleeps on an empty one
+    hipc::mpsc_wait_queue<int> queue(alloc, 4);
+    int nprod = 4, count = 2048;
+    std::vector<std::thread> threads;
+    for (int rank = 0; rank < nprod; ++rank) {
+      threads.emplace_back([&queue, rank, count]() {
+        for (int i = 0; i < count; ++i) {
+          queue.push_wait(rank * count + i);
+        }
+      });
+    }
+    hshm::u64 sum = 0;
+    int val;
+    for (int i = 0; i < nprod * count; ++i) {
+      REQUIRE(!queue.pop_wait(val).IsNull());
+      sum += val;
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    int total = nprod * count;
+    REQUIRE(sum == (hshm::u64)total * (total - 1) / 2);
+    REQUIRE(queue.pop_wait(val, 0).IsNull());
+  }
+  PAGE_DIVIDE("Push times out on a full fixed queue") {
+    hipc::fixed_mpsc_wait_queue<int> queue(alloc, 2);
+    REQUIRE(!queue.push_wait(1, 0).IsNull());
+    REQUIRE(!queue.push_wait(2, 0).IsNull());
+    REQUIRE(queue.push_wait(3, 2000).IsNull());
+    std::thread consumer([&queue]() {
+      int val;
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      queue.pop(val);
+    });
+    REQUIRE(!queue.push_wait(3).IsNull());
+    consumer.join();
+    REQUIRE(queue.size() == 2);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestSpscWaitQueuePopWait") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    hipc::spsc_wait_queue<hipc::string> queue(alloc, 8);
+    int count = 1024;
+    std::thread producer([&queue, count]() {
+      for (int i = 0; i < count; ++i) {
+        queue.emplace_wait(-1, std::to_string(i));
+      }
+    });
+    hipc::string val;
+    for (int i = 0; i < count; ++i) {
+      REQUIRE(!queue.pop_wait(val).IsNull());
+      REQUIRE(val == std::to_string(i));
+    }
+    producer.join();
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
 /**
  * MPSC Pointer Queue
  * */
@@ -204,6 +388,70 @@ TEST_CASE("TestMpscPointerQueueCompile") {
   REQUIRE(off_p == hipc::Pointer(AllocatorId(5, 2), 1));
 }
 
+/**
+ * TEST MPMC QUEUE
+ * */
+
+TEST_CASE("TestMpmcQueueInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ProduceThenConsume<hipc::mpmc_queue<int>, int>(1, 1, 32, 32);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestMpmcQueueString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ProduceThenConsume<hipc::mpmc_queue<hipc::string>, hipc::string>(1, 1, 32,
+                                                                   32);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestMpmcQueueIntMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ProduceAndConsume<hipc::mpmc_queue<int>, int>(8, 1, 8192, 32);
+  ProduceAndConsume<hipc::mpmc_queue<int>, int>(8, 8, 8192, 32);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestMpmcQueueStringMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ProduceAndConsume<hipc::mpmc_queue<hipc::string>, hipc::string>(4, 4, 4096,
+                                                                   32);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestMpmcQueueFull") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    // The depth is rounded up to a power of two
+    hshm::mpmc_queue<hipc::string> queue(alloc, 6);
+    REQUIRE(queue.GetDepth() == 8);
+    // Wrap around the ring a few times
+    for (int lap = 0; lap < 3; ++lap) {
+      for (int i = 0; i < 8; ++i) {
+        REQUIRE(!queue.emplace(std::to_string(i)).IsNull());
+      }
+      REQUIRE(queue.emplace("full").IsNull());
+      REQUIRE(queue.size() == 8);
+      hipc::string val;
+      for (int i = 0; i < 8; ++i) {
+        REQUIRE(!queue.pop(val).IsNull());
+        REQUIRE(val == std::to_string(i));
+      }
+      REQUIRE(queue.pop(val).IsNull());
+    }
+    // Values left in the queue are destroyed with it
+    queue.emplace("left");
+    hshm::mpmc_queue<hipc::string> copy(alloc, queue);
+    REQUIRE(copy.size() == 1);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
 /**
  * TEST SPSC QUEUE
  * */
@@ -243,6 +491,217 @@ TEST_CASE("TestSpscQueuePopBack") {
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
 }
 
+/**
+ * TEST SPSC RING
+ * */
+
+TEST_CASE("TestSpscRingInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ProduceThenConsume<hipc::spsc_ring<int>, int>(1, 1, 32, 32);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestSpscRingString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ProduceThenConsume<hipc::spsc_ring<hipc::string>, hipc::string>(1, 1, 32,
+                                                                  32);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestSpscRingIntMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  ProduceAndConsume<hipc::spsc_ring<int>, int>(1, 1, 8192, 32);
+  ProduceAndConsume<hipc::spsc_ring<hipc::string>, hipc::string>(1, 1, 4096,
+                                                                 16);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestSpscRingFull") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    // The depth is rounded up to a power of two
+    hshm::spsc_ring<hipc::string> queue(alloc, 6);
+    REQUIRE(queue.GetDepth() == 8);
+    // Wrap around the ring a few times, refreshing the cached indices
+    for (int lap = 0; lap < 3; ++lap) {
+      for (int i = 0; i < 8; ++i) {
+        REQUIRE(!queue.emplace(std::to_string(i)).IsNull());
+      }
+      REQUIRE(queue.emplace("full").IsNull());
+      REQUIRE(queue.size() == 8);
+      hipc::string val;
+      for (int i = 0; i < 5; ++i) {
+        REQUIRE(!queue.pop(val).IsNull());
+        REQUIRE(val == std::to_string(i));
+      }
+      REQUIRE(!queue.emplace("8").IsNull());
+      for (int i = 5; i < 9; ++i) {
+        REQUIRE(!queue.pop(val).IsNull());
+        REQUIRE(val == std::to_string(i));
+      }
+      REQUIRE(queue.pop(val).IsNull());
+    }
+    // Values left in the ring are destroyed with it
+    queue.emplace("left");
+    hshm::spsc_ring<hipc::string> copy(alloc, queue);
+    REQUIRE(copy.size() == 1);
+    hshm::spsc_ring<hipc::string> moved(std::move(copy));
+    REQUIRE(moved.size() == 1);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+/**
+ * TEST BATCH OPERATIONS
+ * */
+
+/**
+ * Push and pop bursts that wrap the ring. Queues that do not wait for
+ * space are also overrun to check that partial bursts are pushed.
+ * */
+template <typename QueueT, bool OVERRUN>
+void BatchQueueTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  QueueT queue(alloc, 8);
+  std::vector<hipc::string> in, out(16);
+  for (int i = 0; i < 16; ++i) {
+    in.emplace_back(std::to_string(i));
+  }
+  for (int lap = 0; lap < 3; ++lap) {
+    REQUIRE(queue.push_n(in.data(), 5) == 5);
+    REQUIRE(queue.pop_n(out.data(), 3) == 3);
+    for (int i = 0; i < 3; ++i) {
+      REQUIRE(out[i] == in[i]);
+    }
+    REQUIRE(queue.emplace_n(in.begin() + 5, 3) == 3);
+    REQUIRE(queue.pop_n(out.data(), 16) == 5);
+    for (int i = 0; i < 5; ++i) {
+      REQUIRE(out[i] == in[i + 3]);
+    }
+    REQUIRE(queue.pop_n(out.data(), 16) == 0);
+  }
+  // Bursts larger than the free space push what fits
+  if constexpr (OVERRUN) {
+    REQUIRE(queue.push_n(in.data(), 16) == 8);
+    REQUIRE(queue.push_n(in.data(), 1) == 0);
+    REQUIRE(queue.pop_n(out.data(), 16) == 8);
+    for (int i = 0; i < 8; ++i) {
+      REQUIRE(out[i] == in[i]);
+    }
+  }
+}
+
+/** A burst larger than a circular queue keeps its newest elements */
+template <typename QueueT>
+void BatchCircularOverrunTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  QueueT queue(alloc, 8);
+  std::vector<int> in(20), out(20);
+  for (int i = 0; i < 20; ++i) {
+    in[i] = i;
+  }
+  REQUIRE(queue.push_n(in.data(), 20) == 20);
+  REQUIRE(queue.pop_n(out.data(), 20) == 8);
+  for (int i = 0; i < 8; ++i) {
+    REQUIRE(out[i] == in[i + 12]);
+  }
+}
+
+/** Producers and consumers exchange bursts of up to \a burst values */
+template <typename QueueT>
+void BatchProduceAndConsume(int nthreads, int count, size_t burst) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  QueueT queue(alloc, 64);
+  std::vector<std::thread> threads;
+  hipc::atomic<hshm::u64> popped_sum(0);
+  hipc::atomic<int> popped(0);
+  int total = nthreads * count;
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&, rank]() {
+      std::vector<int> vals(burst);
+      int next = 0;
+      while (next < count) {
+        size_t n = std::min(burst, (size_t)(count - next));
+        for (size_t i = 0; i < n; ++i) {
+          vals[i] = rank * count + next + (int)i;
+        }
+        next += (int)queue.push_n(vals.data(), n);
+        HSHM_THREAD_MODEL->Yield();
+      }
+    });
+    threads.emplace_back([&]() {
+      std::vector<int> vals(burst);
+      while (popped.load() < total) {
+        size_t n = queue.pop_n(vals.data(), burst);
+        for (size_t i = 0; i < n; ++i) {
+          popped_sum.fetch_add(vals[i]);
+        }
+        popped.fetch_add((int)n);
+        HSHM_THREAD_MODEL->Yield();
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(popped.load() == total);
+  REQUIRE(popped_sum.load() == (hshm::u64)total * (total - 1) / 2);
+  REQUIRE(queue.size() == 0);
+}
+
+TEST_CASE("TestSpscQueueBatch") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    BatchQueueTest<hipc::spsc_queue<hipc::string>, false>();
+    BatchQueueTest<hipc::fixed_spsc_queue<hipc::string>, true>();
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestMpscQueueBatch") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    BatchQueueTest<hipc::mpsc_queue<hipc::string>, false>();
+    BatchQueueTest<hipc::fixed_mpsc_queue<hipc::string>, true>();
+  }
+  PAGE_DIVIDE("Overrun a circular queue") {
+    BatchCircularOverrunTest<hipc::circular_spsc_queue<int>>();
+    BatchCircularOverrunTest<hipc::circular_mpsc_queue<int>>();
+  }
+  PAGE_DIVIDE("Consumers with atomic pop never pop the same element") {
+    BatchProduceAndConsume<hipc::mpsc_queue<int>>(4, 4096, 32);
+    BatchProduceAndConsume<hipc::fixed_mpsc_queue<int>>(4, 4096, 32);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestMpmcQueueBatch") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    BatchQueueTest<hipc::mpmc_queue<hipc::string>, true>();
+  }
+  PAGE_DIVIDE("Bursty producers and consumers") {
+    BatchProduceAndConsume<hipc::mpmc_queue<int>>(4, 4096, 32);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestSpscRingBatch") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    BatchQueueTest<hipc::spsc_ring<hipc::string>, true>();
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
 template <typename T>
 void PointerQueueTest(T base_val) {
   auto *alloc = HSHM_DEFAULT_ALLOC;
@@ -271,3 +730,411 @@ TEST_CASE("TestSpscPtrQueuePopBack") {
       hipc::FullPtr<char>(nullptr, hipc::Pointer(alloc->id_, 0)));
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
 }
+
+/**
+ * TEST MESSAGE RING
+ * */
+
+/**
+ * Messages of rank \a rank are \a i % 23 bytes long and filled with a
+ * byte derived from rank and i, so the consumer can check each one.
+ * */
+static size_t MsgRingFill(int rank, int i, char *msg) {
+  size_t size = (size_t)(i % 23);
+  memset(msg, (char)(rank * 31 + i), size);
+  return size;
+}
+
+/** Producers push variable-length messages to one consumer */
+template <typename RingT>
+void MsgRingProduceAndConsume(int nproducers, int count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  RingT ring(alloc, 256);
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank < nproducers; ++rank) {
+    threads.emplace_back([&, rank]() {
+      char expected[32];
+      for (int i = 0; i < count; ++i) {
+        size_t size = MsgRingFill(rank, i, expected);
+        char *msg;
+        while ((msg = ring.reserve(size + sizeof(int))) == nullptr) {
+          HSHM_THREAD_MODEL->Yield();
+        }
+        memcpy(msg, &rank, sizeof(int));
+        memcpy(msg + sizeof(int), expected, size);
+        ring.commit(msg);
+      }
+    });
+  }
+  // Each producer's messages arrive in order and intact
+  std::vector<int> next(nproducers, 0);
+  char expected[32];
+  for (int total = 0; total < nproducers * count;) {
+    size_t size;
+    char *msg = ring.peek(size);
+    if (msg == nullptr) {
+      HSHM_THREAD_MODEL->Yield();
+      continue;
+    }
+    int rank;
+    memcpy(&rank, msg, sizeof(int));
+    REQUIRE(rank < nproducers);
+    size_t exp_size = MsgRingFill(rank, next[rank]++, expected);
+    REQUIRE(size == exp_size + sizeof(int));
+    REQUIRE(memcmp(msg + sizeof(int), expected, exp_size) == 0);
+    ring.release();
+    ++total;
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  size_t size;
+  REQUIRE(ring.peek(size) == nullptr);
+  REQUIRE(ring.size() == 0);
+}
+
+TEST_CASE("TestMsgRingSpsc") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    // The capacity is rounded up to a power of two
+    hshm::spsc_msg_ring<> ring(alloc, 200);
+    REQUIRE(ring.GetCapacity() == 256);
+    REQUIRE(ring.reserve(ring.GetMaxMessageSize() + 1) == nullptr);
+    size_t size;
+    REQUIRE(ring.peek(size) == nullptr);
+    // The largest message fits an empty ring at any wrap offset
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(!ring.push("abc", 3).IsNull());
+      REQUIRE(ring.peek(size) != nullptr);
+      ring.release();
+      char *big = ring.reserve(ring.GetMaxMessageSize());
+      REQUIRE(big != nullptr);
+      ring.commit(big);
+      REQUIRE(ring.peek(size) == big);
+      REQUIRE(size == ring.GetMaxMessageSize());
+      ring.release();
+      REQUIRE(ring.peek(size) == nullptr);
+    }
+    // Messages of 20 bytes take 32-byte records. Each lap takes 136 bytes,
+    // so the laps wrap the ring and pad its end at different offsets
+    for (int lap = 0; lap < 8; ++lap) {
+      std::string base = "msg" + std::to_string(lap) + "-";
+      for (int i = 0; i < 3; ++i) {
+        std::string msg = base + std::to_string(i) + std::string(14, 'x');
+        REQUIRE(!ring.push(msg.data(), msg.size()).IsNull());
+      }
+      // A reserved message holds back the ones after it until committed
+      char *msg = ring.reserve(20);
+      REQUIRE(msg != nullptr);
+      for (int i = 0; i < 3; ++i) {
+        std::string exp = base + std::to_string(i) + std::string(14, 'x');
+        char *data = ring.peek(size);
+        REQUIRE(data != nullptr);
+        REQUIRE(std::string(data, size) == exp);
+        ring.release();
+      }
+      REQUIRE(ring.peek(size) == nullptr);
+      memset(msg, 'y', 20);
+      ring.commit(msg);
+      char *data = ring.peek(size);
+      REQUIRE(data == msg);
+      REQUIRE(std::string(data, size) == std::string(20, 'y'));
+      ring.release();
+      // Empty messages are allowed
+      REQUIRE(!ring.push(nullptr, 0).IsNull());
+      REQUIRE(ring.peek(size) != nullptr);
+      REQUIRE(size == 0);
+      ring.release();
+      REQUIRE(ring.peek(size) == nullptr);
+    }
+    // Fill the ring with 16-byte records, less one if the end is padded
+    int pushed = 0;
+    while (!ring.push("abcdefgh", 8).IsNull()) {
+      ++pushed;
+    }
+    REQUIRE(pushed >= 15);
+    REQUIRE(ring.size() > 256 - 16);
+    hshm::spsc_msg_ring<> copy(alloc, ring);
+    for (int i = 0; i < pushed; ++i) {
+      char *data = copy.peek(size);
+      REQUIRE(data != nullptr);
+      REQUIRE(std::string(data, size) == "abcdefgh");
+      copy.release();
+    }
+    REQUIRE(copy.peek(size) == nullptr);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestMsgRingMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("SPSC") {
+    MsgRingProduceAndConsume<hipc::spsc_msg_ring<>>(1, 8192);
+  }
+  PAGE_DIVIDE("MPSC") {
+    MsgRingProduceAndConsume<hipc::mpsc_msg_ring<>>(4, 4096);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+/**
+ * TEST BROADCAST RING
+ * */
+
+/**
+ * One producer pushes 0..count-1 to \a nsubs subscriber threads. Each
+ * subscriber checks it sees the values in order. A lossy ring may skip
+ * values, but only ones its subscriber was told it lost.
+ * */
+template <typename RingT>
+void BroadcastProduceAndConsume(int nsubs, int count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  RingT ring(alloc, 32, 4);
+  std::vector<int> subs;
+  for (int i = 0; i < nsubs; ++i) {
+    subs.emplace_back(ring.join());
+    REQUIRE(subs.back() >= 0);
+  }
+  std::vector<std::thread> threads;
+  hipc::atomic<int> failures(0);
+  for (int i = 0; i < nsubs; ++i) {
+    threads.emplace_back([&, i]() {
+      int sub = subs[i];
+      size_t received = 0;
+      int last = -1;
+      int val;
+      while (last < count - 1) {
+        hshm::qtok_t qtok = ring.pop(sub, val);
+        if (qtok.IsNull()) {
+          HSHM_THREAD_MODEL->Yield();
+          continue;
+        }
+        if (val <= last || (size_t)val != qtok.id_) {
+          failures.fetch_add(1);
+        }
+        last = val;
+        ++received;
+      }
+      if (received + ring.GetLost(sub) != (size_t)count) {
+        failures.fetch_add(1);
+      }
+      ring.leave(sub);
+    });
+  }
+  for (int i = 0; i < count; ++i) {
+    while (ring.push(i).IsNull()) {
+      HSHM_THREAD_MODEL->Yield();
+    }
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(failures.load() == 0);
+  REQUIRE(ring.GetNumSubscribers() == 0);
+}
+
+TEST_CASE("TestBroadcastRingBackpressure") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    hshm::broadcast_ring<hipc::string> ring(alloc, 8, 2);
+    // Without subscribers the producer is never held back
+    for (int i = 0; i < 20; ++i) {
+      REQUIRE(!ring.push(std::to_string(i)).IsNull());
+    }
+    int fast = ring.join();
+    int slow = ring.join();
+    REQUIRE(fast >= 0);
+    REQUIRE(slow >= 0);
+    REQUIRE(ring.join() == -1);
+    hipc::string val;
+    REQUIRE(ring.pop(fast, val).IsNull());
+    // The slow subscriber holds back the producer once the ring is full
+    for (int i = 20; i < 28; ++i) {
+      REQUIRE(!ring.push(std::to_string(i)).IsNull());
+      REQUIRE(!ring.pop(fast, val).IsNull());
+      REQUIRE(val == std::to_string(i));
+    }
+    REQUIRE(ring.push("28").IsNull());
+    REQUIRE(ring.GetSize(slow) == 8);
+    for (int i = 20; i < 24; ++i) {
+      hshm::qtok_t qtok = ring.pop(slow, val);
+      REQUIRE(qtok.id_ == (size_t)i);
+      REQUIRE(val == std::to_string(i));
+    }
+    for (int i = 28; i < 32; ++i) {
+      REQUIRE(!ring.push(std::to_string(i)).IsNull());
+    }
+    REQUIRE(ring.push("32").IsNull());
+    // A subscriber that leaves no longer holds back the producer
+    ring.leave(slow);
+    REQUIRE(!ring.push("32").IsNull());
+    for (int i = 28; i < 33; ++i) {
+      REQUIRE(!ring.pop(fast, val).IsNull());
+      REQUIRE(val == std::to_string(i));
+    }
+    REQUIRE(ring.pop(fast, val).IsNull());
+    REQUIRE(ring.GetLost(fast) == 0);
+    // A new subscriber starts at the tail
+    int late = ring.join();
+    REQUIRE(late >= 0);
+    REQUIRE(ring.GetSize(late) == 0);
+    ring.push("33");
+    REQUIRE(!ring.pop(late, val).IsNull());
+    REQUIRE(val == "33");
+    // Elements and cursors are copied
+    hshm::broadcast_ring<hipc::string> copy(alloc, ring);
+    REQUIRE(copy.GetNumSubscribers() == 2);
+    REQUIRE(!copy.pop(fast, val).IsNull());
+    REQUIRE(val == "33");
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestBroadcastRingOverrun") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    hshm::circular_broadcast_ring<int> ring(alloc, 8, 2);
+    int sub = ring.join();
+    int val;
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(!ring.push(i).IsNull());
+    }
+    REQUIRE(!ring.pop(sub, val).IsNull());
+    REQUIRE(val == 0);
+    // The producer laps the subscriber, which skips to the oldest element
+    for (int i = 4; i < 20; ++i) {
+      REQUIRE(!ring.push(i).IsNull());
+    }
+    hshm::qtok_t qtok = ring.pop(sub, val);
+    REQUIRE(!qtok.IsNull());
+    REQUIRE(qtok.id_ == 13);
+    REQUIRE(val == 13);
+    REQUIRE(ring.GetLost(sub) == 12);
+    for (int i = 14; i < 20; ++i) {
+      REQUIRE(!ring.pop(sub, val).IsNull());
+      REQUIRE(val == i);
+    }
+    REQUIRE(ring.pop(sub, val).IsNull());
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestBroadcastRingMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("Backpressure") {
+    BroadcastProduceAndConsume<hipc::broadcast_ring<int>>(3, 8192);
+  }
+  PAGE_DIVIDE("Overrun") {
+    BroadcastProduceAndConsume<hipc::circular_broadcast_ring<int>>(3, 8192);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+/**
+ * TEST WORK-STEALING DEQUE
+ * */
+
+/**
+ * The owner pushes 0..count-1 in bursts and pops part of each burst back
+ * while \a nthieves threads steal. Every value is taken exactly once.
+ * */
+void WsDequeOwnerAndThieves(int nthieves, int count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  hipc::ws_deque<int> deque(alloc, 16);
+  std::vector<hipc::atomic<int>> seen(count);
+  hipc::atomic<int> taken(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < nthieves; ++i) {
+    threads.emplace_back([&]() {
+      int val;
+      while (taken.load() < count) {
+        if (deque.steal(val).IsNull()) {
+          HSHM_THREAD_MODEL->Yield();
+          continue;
+        }
+        seen[val].fetch_add(1);
+        taken.fetch_add(1);
+      }
+    });
+  }
+  int val;
+  for (int i = 0; i < count;) {
+    for (int j = 0; j < 64 && i < count; ++j, ++i) {
+      deque.push(i);
+    }
+    for (int j = 0; j < 16; ++j) {
+      if (deque.pop(val).IsNull()) {
+        break;
+      }
+      seen[val].fetch_add(1);
+      taken.fetch_add(1);
+    }
+  }
+  while (!deque.pop(val).IsNull()) {
+    seen[val].fetch_add(1);
+    taken.fetch_add(1);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (int i = 0; i < count; ++i) {
+    REQUIRE(seen[i].load() == 1);
+  }
+  REQUIRE(deque.size() == 0);
+}
+
+TEST_CASE("TestWsDequeInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("TEST") {
+    hipc::ws_deque<int> deque(alloc, 8);
+    int val;
+    REQUIRE(deque.pop(val).IsNull());
+    REQUIRE(deque.steal(val).IsNull());
+    // Pushing past the depth grows the array
+    for (int i = 0; i < 100; ++i) {
+      REQUIRE(deque.push(i).id_ == (size_t)i);
+    }
+    REQUIRE(deque.size() == 100);
+    REQUIRE(deque.GetDepth() == 128);
+    // The owner pops the newest and thieves steal the oldest
+    REQUIRE(!deque.pop(val).IsNull());
+    REQUIRE(val == 99);
+    REQUIRE(!deque.steal(val).IsNull());
+    REQUIRE(val == 0);
+    hipc::ws_deque<int> copy(alloc, deque);
+    REQUIRE(copy.size() == 98);
+    for (int i = 1; i < 50; ++i) {
+      REQUIRE(!deque.steal(val).IsNull());
+      REQUIRE(val == i);
+    }
+    for (int i = 98; i >= 50; --i) {
+      REQUIRE(!deque.pop(val).IsNull());
+      REQUIRE(val == i);
+    }
+    REQUIRE(deque.pop(val).IsNull());
+    REQUIRE(deque.steal(val).IsNull());
+    REQUIRE(deque.size() == 0);
+    // The copy is independent of the original
+    REQUIRE(!copy.steal(val).IsNull());
+    REQUIRE(val == 1);
+    hipc::ws_deque<int> moved(std::move(copy));
+    REQUIRE(moved.size() == 97);
+    REQUIRE(!moved.pop(val).IsNull());
+    REQUIRE(val == 98);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("TestWsDequeMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("One thief") { WsDequeOwnerAndThieves(1, 16384); }
+  PAGE_DIVIDE("Many thieves") { WsDequeOwnerAndThieves(4, 16384); }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
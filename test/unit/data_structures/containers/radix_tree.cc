@@ -0,0 +1,246 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <algorithm>
+#include <random>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/chararr.h"
+#include "hermes_shm/data_structures/ipc/radix_tree.h"
+#include "hermes_shm/data_structures/ipc/string.h"
+#include "hermes_shm/data_structures/ipc/unordered_map.h"
+
+using hshm::ipc::radix_tree;
+using hshm::ipc::string;
+using hshm::ipc::unordered_map;
+
+#define GET_INT_FROM_VAL(VAR) CREATE_GET_INT_FROM_VAR(Val, val_ret, VAR)
+
+/** Path-like keys with long shared prefixes (and keys that are prefixes) */
+static std::vector<std::string> MakePaths(int count) {
+  std::vector<std::string> paths;
+  for (int i = 0; i < count; ++i) {
+    std::string dir = "/home/user/projects/dataset_" + std::to_string(i % 7) +
+                      "/run_" + std::to_string(i % 61);
+    paths.emplace_back(dir + "/chunk_" + std::to_string(i) + ".bin");
+    if (i % 61 == i % 7 && i < 427) {
+      paths.emplace_back(dir);
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+  paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+  return paths;
+}
+
+template<typename Key, typename Val>
+void RadixTreeOpTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  radix_tree<Val> tree(alloc);
+  std::vector<std::string> paths = MakePaths(2000);
+  std::vector<int> order(paths.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = (int)i;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(11));
+
+  // Insert entries in random order
+  PAGE_DIVIDE("Insert entries") {
+    for (int i : order) {
+      CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, i);
+      REQUIRE(tree.emplace(Key(paths[i]), val));
+    }
+    REQUIRE(tree.size() == paths.size());
+  }
+
+  // Check if the entries are findable
+  PAGE_DIVIDE("Check if entries are findable") {
+    for (size_t i = 0; i < paths.size(); ++i) {
+      CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, i);
+      Val *found = tree.find(Key(paths[i]));
+      REQUIRE(found != nullptr);
+      REQUIRE(*found == val);
+      REQUIRE(tree.contains(Key(paths[i])));
+    }
+    REQUIRE(!tree.contains(Key(std::string("/home/user"))));
+    REQUIRE(!tree.contains(Key(paths[0] + "x")));
+    REQUIRE(!tree.contains(Key(std::string(""))));
+  }
+
+  // Ordered traversal
+  PAGE_DIVIDE("Ordered traversal") {
+    size_t i = 0;
+    size_t n = tree.for_each([&](const char *key, size_t len, Val &val) {
+      REQUIRE(std::string(key, len) == paths[i]);
+      GET_INT_FROM_VAL(val);
+      REQUIRE(val_ret == (int)i);
+      ++i;
+    });
+    REQUIRE(n == paths.size());
+  }
+
+  // Prefix iteration
+  PAGE_DIVIDE("Prefix iteration") {
+    for (std::string prefix :
+         {std::string("/home/user/projects/dataset_3/run_1"),
+          std::string("/home/user/projects/dataset_3/run_17/"),
+          std::string("/home/"), std::string("/nope"), std::string("")}) {
+      std::vector<std::string> expected;
+      for (const std::string &path : paths) {
+        if (path.compare(0, prefix.size(), prefix) == 0) {
+          expected.emplace_back(path);
+        }
+      }
+      std::vector<std::string> got;
+      size_t n = tree.for_each_prefix(
+          Key(prefix), [&got](const char *key, size_t len, Val &val) {
+            got.emplace_back(key, len);
+          });
+      REQUIRE(n == expected.size());
+      REQUIRE(got == expected);
+    }
+  }
+
+  // try_emplace does not modify existing entries, emplace does
+  PAGE_DIVIDE("Modify existing entries") {
+    CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, 100000);
+    REQUIRE(!tree.try_emplace(Key(paths[5]), val));
+    REQUIRE(tree.emplace(Key(paths[5]), val));
+    REQUIRE(*tree.find(Key(paths[5])) == val);
+    REQUIRE(tree.size() == paths.size());
+  }
+
+  // Copy and move the tree
+  PAGE_DIVIDE("Copy and move") {
+    radix_tree<Val> copy(tree);
+    REQUIRE(copy.size() == paths.size());
+    radix_tree<Val> moved(std::move(copy));
+    REQUIRE(moved.size() == paths.size());
+    REQUIRE(moved.contains(Key(paths[7])));
+  }
+
+  // Erase half of the entries (nodes shrink and paths re-merge)
+  PAGE_DIVIDE("Erase entries") {
+    for (size_t i = 0; i < paths.size(); i += 2) {
+      REQUIRE(tree.erase(Key(paths[i])));
+      REQUIRE(!tree.erase(Key(paths[i])));
+    }
+    REQUIRE(tree.size() == paths.size() / 2);
+    for (size_t i = 0; i < paths.size(); ++i) {
+      REQUIRE(tree.contains(Key(paths[i])) == (i % 2 == 1));
+    }
+    size_t i = 1;
+    tree.for_each([&](const char *key, size_t len, Val &val) {
+      REQUIRE(std::string(key, len) == paths[i]);
+      i += 2;
+    });
+  }
+
+  // Erase the rest and reinsert
+  PAGE_DIVIDE("Erase all") {
+    for (size_t i = 1; i < paths.size(); i += 2) {
+      REQUIRE(tree.erase(Key(paths[i])));
+    }
+    REQUIRE(tree.size() == 0);
+    CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, 1);
+    REQUIRE(tree.emplace(Key(paths[1]), val));
+    REQUIRE(tree.contains(Key(paths[1])));
+    tree.clear();
+    REQUIRE(tree.size() == 0);
+  }
+}
+
+TEST_CASE("RadixTreeOfStringInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  RadixTreeOpTest<string, int>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("RadixTreeOfStringString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  RadixTreeOpTest<string, string>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("RadixTreeOfStdStringInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  RadixTreeOpTest<std::string, int>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("RadixTreeNodeLayouts") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  {
+    // Every byte value below one node: 4 -> 16 -> 48 -> 256 and back
+    radix_tree<int> tree(alloc);
+    for (int b = 255; b >= 0; --b) {
+      hshm::chararr key;
+      key.resize(2);
+      key[0] = 'k';
+      key[1] = (char)b;
+      REQUIRE(tree.emplace(key, b));
+    }
+    int expected = 0;
+    tree.for_each([&](const char *key, size_t len, int &val) {
+      REQUIRE(len == 2);
+      REQUIRE((hshm::u8)key[1] == expected);
+      REQUIRE(val == expected);
+      ++expected;
+    });
+    REQUIRE(expected == 256);
+    for (int b = 0; b < 256; ++b) {
+      hshm::chararr key;
+      key.resize(2);
+      key[0] = 'k';
+      key[1] = (char)b;
+      if (b % 5) {
+        REQUIRE(tree.erase(key));
+      }
+      REQUIRE(tree.contains(key) == (b % 5 == 0));
+    }
+    REQUIRE(tree.size() == 52);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+/** Compare the footprint of path keys (requires HSHM_ALLOC_TRACK_SIZE) */
+TEST_CASE("RadixTreeMemory") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  std::vector<std::string> paths = MakePaths(5000);
+  size_t tree_bytes, map_bytes;
+  {
+    radix_tree<int> tree(alloc);
+    for (size_t i = 0; i < paths.size(); ++i) {
+      tree.emplace(paths[i], (int)i);
+    }
+    tree_bytes = alloc->GetCurrentlyAllocatedSize();
+  }
+  {
+    unordered_map<string, int> map(alloc, paths.size());
+    size_t buckets = alloc->GetCurrentlyAllocatedSize();
+    for (size_t i = 0; i < paths.size(); ++i) {
+      map.emplace(string(paths[i]), (int)i);
+    }
+    map_bytes = alloc->GetCurrentlyAllocatedSize() - buckets;
+  }
+  HILOG(kInfo, "radix_tree: {} bytes, unordered_map entries: {} bytes",
+        tree_bytes, map_bytes);
+#ifdef HSHM_ALLOC_TRACK_SIZE
+  REQUIRE(tree_bytes < map_bytes);
+#endif
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
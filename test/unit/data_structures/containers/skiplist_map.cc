@@ -0,0 +1,270 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/skiplist_map.h"
+#include "hermes_shm/data_structures/ipc/string.h"
+
+using hshm::ipc::skiplist_map;
+using hshm::ipc::string;
+
+#define GET_INT_FROM_VAL(VAR) CREATE_GET_INT_FROM_VAR(Val, val_ret, VAR)
+
+/** Keys are zero-padded so strings sort like the integers they encode */
+template<typename Key>
+static Key MakeSkiplistKey(int i) {
+  if constexpr (std::is_same_v<Key, int>) {
+    return i;
+  } else {
+    std::string text = std::to_string(i);
+    return Key(std::string(8 - text.size(), '0') + text);
+  }
+}
+
+template<typename Key>
+static int SkiplistKeyToInt(const Key &key) {
+  if constexpr (std::is_same_v<Key, int>) {
+    return key;
+  } else {
+    return std::stoi(key.str());
+  }
+}
+
+template<typename Key, typename Val>
+void SkiplistMapOpTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  skiplist_map<Key, Val> map(alloc);
+  int count = 1000;
+  std::vector<int> order(count);
+  for (int i = 0; i < count; ++i) {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(7));
+
+  // Insert entries in random order
+  PAGE_DIVIDE("Insert entries") {
+    for (int i : order) {
+      CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, i);
+      REQUIRE(map.emplace(MakeSkiplistKey<Key>(i), val));
+    }
+    REQUIRE(map.size() == (size_t)count);
+  }
+
+  // Check if the entries are findable
+  PAGE_DIVIDE("Check if entries are findable") {
+    for (int i = 0; i < count; ++i) {
+      CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, i);
+      Val found;
+      REQUIRE(map.find(MakeSkiplistKey<Key>(i), found));
+      REQUIRE(found == val);
+      REQUIRE(map.contains(MakeSkiplistKey<Key>(i)));
+    }
+    REQUIRE(!map.contains(MakeSkiplistKey<Key>(count)));
+  }
+
+  // Iterate in key order
+  PAGE_DIVIDE("Forward iterate") {
+    int i = 0;
+    for (auto iter = map.begin(); iter != map.end(); ++iter) {
+      REQUIRE(SkiplistKeyToInt(iter.GetKey()) == i);
+      GET_INT_FROM_VAL(iter.GetVal());
+      REQUIRE(val_ret == i);
+      ++i;
+    }
+    REQUIRE(i == count);
+  }
+
+  // lower_bound and range scans
+  PAGE_DIVIDE("Range queries") {
+    auto iter = map.lower_bound(MakeSkiplistKey<Key>(500));
+    REQUIRE(SkiplistKeyToInt(iter.GetKey()) == 500);
+    REQUIRE(map.lower_bound(MakeSkiplistKey<Key>(count)).is_end());
+    REQUIRE(map.find(MakeSkiplistKey<Key>(count)).is_end());
+    std::vector<int> keys;
+    size_t n = map.scan(MakeSkiplistKey<Key>(250), MakeSkiplistKey<Key>(750),
+                        [&keys](const Key &key, const Val &val) {
+                          keys.emplace_back(SkiplistKeyToInt(key));
+                        });
+    REQUIRE(n == 500);
+    REQUIRE(keys.size() == 500);
+    for (int i = 0; i < 500; ++i) {
+      REQUIRE(keys[i] == 250 + i);
+    }
+  }
+
+  // try_emplace does not modify existing entries, emplace does
+  PAGE_DIVIDE("Modify existing entries") {
+    CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, 1005);
+    REQUIRE(!map.try_emplace(MakeSkiplistKey<Key>(5), val));
+    REQUIRE(map.emplace(MakeSkiplistKey<Key>(5), val));
+    Val found;
+    REQUIRE(map.find(MakeSkiplistKey<Key>(5), found));
+    REQUIRE(found == val);
+    REQUIRE(map.size() == (size_t)count);
+  }
+
+  // Erase the even entries
+  PAGE_DIVIDE("Erase entries") {
+    for (int i = 0; i < count; i += 2) {
+      REQUIRE(map.erase(MakeSkiplistKey<Key>(i)));
+      REQUIRE(!map.erase(MakeSkiplistKey<Key>(i)));
+    }
+    REQUIRE(map.size() == (size_t)count / 2);
+    map.reclaim();
+    int i = 1;
+    for (auto iter = map.begin(); !iter.is_end(); ++iter, i += 2) {
+      REQUIRE(SkiplistKeyToInt(iter.GetKey()) == i);
+    }
+    REQUIRE(i == count + 1);
+  }
+
+  // Copy and move the map
+  PAGE_DIVIDE("Copy and move") {
+    skiplist_map<Key, Val> copy(map);
+    REQUIRE(copy.size() == (size_t)count / 2);
+    skiplist_map<Key, Val> moved(std::move(copy));
+    REQUIRE(moved.size() == (size_t)count / 2);
+    REQUIRE(moved.contains(MakeSkiplistKey<Key>(7)));
+    REQUIRE(!moved.contains(MakeSkiplistKey<Key>(8)));
+    int i = 1;
+    for (auto iter = moved.begin(); !iter.is_end(); ++iter, i += 2) {
+      REQUIRE(SkiplistKeyToInt(iter.GetKey()) == i);
+    }
+    REQUIRE(i == count + 1);
+  }
+
+  // Erase the entire map
+  PAGE_DIVIDE("Clear") {
+    map.clear();
+    REQUIRE(map.size() == 0);
+    REQUIRE(map.begin().is_end());
+    CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, 1);
+    REQUIRE(map.emplace(MakeSkiplistKey<Key>(1), val));
+    REQUIRE(map.size() == 1);
+  }
+}
+
+void SkiplistMapMultiThreadedTest(int nthreads, int count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  skiplist_map<int, int> map(alloc);
+  std::vector<std::thread> threads;
+  hipc::atomic<int> errors(0);
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&map, &errors, rank, nthreads, count]() {
+      // Interleave the keys of all threads so they are neighbors
+      for (int i = 0; i < count; ++i) {
+        int key = i * nthreads + rank;
+        if (!map.try_emplace(key, key)) {
+          errors.fetch_add(1);
+        }
+        int found;
+        if (!map.find(key, found) || found != key) {
+          errors.fetch_add(1);
+        }
+        if (i % 64 == 0) {
+          // Scans must see keys in increasing order with their values
+          int last = -1;
+          map.scan(0, nthreads * count, [&](const int &k, const int &v) {
+            if (k <= last || k != v) {
+              errors.fetch_add(1);
+            }
+            last = k;
+          });
+        }
+      }
+      // Erase the odd keys
+      for (int i = 0; i < count; ++i) {
+        int key = i * nthreads + rank;
+        if (key % 2 == 1 && !map.erase(key)) {
+          errors.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(errors.load() == 0);
+  REQUIRE(map.size() == (size_t)(nthreads * count / 2));
+  map.reclaim();
+  for (int i = 0; i < nthreads * count; ++i) {
+    REQUIRE(map.contains(i) == (i % 2 == 0));
+  }
+}
+
+void SkiplistMapContendedKeysTest(int nthreads, int count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  skiplist_map<int, int> map(alloc);
+  std::vector<std::thread> threads;
+  hipc::atomic<int> inserted(0);
+  hipc::atomic<int> erased(0);
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&map, &inserted, &erased, rank, count]() {
+      // Every thread races on the same small set of keys
+      std::mt19937 rng(rank);
+      for (int i = 0; i < count; ++i) {
+        int key = (int)(rng() % 64);
+        if (rng() % 2) {
+          inserted.fetch_add(map.try_emplace(key, key));
+        } else {
+          erased.fetch_add(map.erase(key));
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  // Each key is inserted once more than it is erased, or equally often
+  REQUIRE(map.size() == (size_t)(inserted.load() - erased.load()));
+  size_t n = 0;
+  int last = -1;
+  for (auto iter = map.begin(); !iter.is_end(); ++iter, ++n) {
+    REQUIRE(iter.GetKey() > last);
+    last = iter.GetKey();
+  }
+  REQUIRE(n == map.size());
+}
+
+TEST_CASE("SkiplistMapOfIntInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  SkiplistMapOpTest<int, int>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("SkiplistMapOfIntString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  SkiplistMapOpTest<int, string>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("SkiplistMapOfStringString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  SkiplistMapOpTest<string, string>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("SkiplistMapMultiThreaded") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  SkiplistMapMultiThreadedTest(8, 1024);
+  SkiplistMapContendedKeysTest(4, 8192);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
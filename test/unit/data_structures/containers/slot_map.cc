@@ -0,0 +1,162 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+* Distributed under BSD 3-Clause license.                                   *
+* Copyright by The HDF Group.                                               *
+* Copyright by the Illinois Institute of Technology.                        *
+* All rights reserved.                                                      *
+*                                                                           *
+* This file is part of Hermes. The full Hermes copyright notice, including  *
+* terms governing use, modification, and redistribution, is contained in    *
+* the COPYING file, which can be found at the top directory. If you do not  *
+* have access to the file, you may request a copy from help@hdfgroup.org.   *
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <thread>
+
+#include "basic_test.h"
+#include "test_init.h"
+#include "hermes_shm/data_structures/ipc/slot_map.h"
+#include "hermes_shm/data_structures/ipc/string.h"
+
+using hshm::ipc::slot_map;
+using hshm::ipc::slot_map_handle;
+using hshm::ipc::string;
+
+template<typename T>
+static T MakeSlotVal(int i) {
+  if constexpr (std::is_same_v<T, int>) {
+    return i;
+  } else {
+    return T(std::to_string(i));
+  }
+}
+
+template<typename T>
+void SlotMapOpTest() {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  slot_map<T> map(alloc, 8);
+  int count = 100;
+  std::vector<slot_map_handle> handles;
+
+  // Inserting past the first segment adds segments
+  PAGE_DIVIDE("Insert") {
+    REQUIRE(map.empty());
+    for (int i = 0; i < count; ++i) {
+      handles.emplace_back(map.emplace(MakeSlotVal<T>(i)));
+      REQUIRE(!handles.back().IsNull());
+    }
+    REQUIRE(map.size() == (size_t)count);
+    REQUIRE(map.GetCapacity() == 8 + 16 + 32 + 64);
+    for (int i = 0; i < count; ++i) {
+      REQUIRE(map.contains(handles[i]));
+      REQUIRE(*map.find(handles[i]) == MakeSlotVal<T>(i));
+      REQUIRE(map[handles[i]] == MakeSlotVal<T>(i));
+    }
+  }
+
+  // Erased handles stop resolving, even once their slot is reused
+  PAGE_DIVIDE("Erase and reuse") {
+    for (int i = 0; i < count; i += 2) {
+      REQUIRE(map.erase(handles[i]));
+      REQUIRE(!map.erase(handles[i]));
+      REQUIRE(map.find(handles[i]) == nullptr);
+    }
+    REQUIRE(map.size() == (size_t)count / 2);
+    size_t capacity = map.GetCapacity();
+    for (int i = 0; i < count; i += 2) {
+      slot_map_handle handle = map.emplace(MakeSlotVal<T>(count + i));
+      REQUIRE(handle.GetIndex() < (hshm::u32)count);
+      REQUIRE(handle != handles[i]);
+      REQUIRE(map.find(handles[i]) == nullptr);
+      handles[i] = handle;
+    }
+    REQUIRE(map.GetCapacity() == capacity);
+    REQUIRE(map.find(slot_map_handle::GetNull()) == nullptr);
+  }
+
+  // Copies keep the handles valid
+  PAGE_DIVIDE("Copy and move") {
+    slot_map<T> copy(alloc, map);
+    REQUIRE(copy.size() == (size_t)count);
+    REQUIRE(*copy.find(handles[0]) == MakeSlotVal<T>(count));
+    REQUIRE(*copy.find(handles[1]) == MakeSlotVal<T>(1));
+    slot_map<T> moved(std::move(copy));
+    REQUIRE(moved.size() == (size_t)count);
+    REQUIRE(*moved.find(handles[1]) == MakeSlotVal<T>(1));
+  }
+
+  // Visit every entry, then pop them all
+  PAGE_DIVIDE("Iterate and pop") {
+    size_t visited = 0;
+    map.for_each([&](const slot_map_handle &handle, T &val) {
+      REQUIRE(map.find(handle) == &val);
+      ++visited;
+    });
+    REQUIRE(visited == (size_t)count);
+    T val;
+    REQUIRE(map.pop(handles[1], val));
+    REQUIRE(val == MakeSlotVal<T>(1));
+    REQUIRE(!map.pop(handles[1], val));
+    map.clear();
+    REQUIRE(map.empty());
+  }
+}
+
+/**
+ * Threads insert and erase their own entries at the same time. Each
+ * handle resolves to the value it was inserted with until it is erased.
+ * */
+void SlotMapConcurrentTest(int nthreads, int count) {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  slot_map<int> map(alloc, 16);
+  std::vector<std::thread> threads;
+  hipc::atomic<int> failures(0);
+  for (int rank = 0; rank < nthreads; ++rank) {
+    threads.emplace_back([&, rank]() {
+      std::vector<slot_map_handle> handles;
+      for (int i = 0; i < count; ++i) {
+        handles.emplace_back(map.emplace(rank * count + i));
+        // Erase every other entry soon after inserting it
+        if (i % 2 == 1 && !map.erase(handles[i - 1])) {
+          failures.fetch_add(1);
+        }
+      }
+      for (int i = 0; i < count; ++i) {
+        int *val = map.find(handles[i]);
+        bool live = i % 2 == 1;
+        if (live != (val != nullptr) || (live && *val != rank * count + i)) {
+          failures.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(failures.load() == 0);
+  REQUIRE(map.size() == (size_t)(nthreads * count / 2));
+  // Freed slots were reused, so the map did not grow to every insert
+  REQUIRE(map.GetCapacity() < (size_t)(nthreads * count));
+}
+
+TEST_CASE("SlotMapOfInt") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  SlotMapOpTest<int>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("SlotMapOfString") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  SlotMapOpTest<string>();
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("SlotMapConcurrent") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("Insert and erase") {
+    SlotMapConcurrentTest(8, 4096);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
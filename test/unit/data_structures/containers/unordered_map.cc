@@ -37,7 +37,7 @@ void UnorderedMapOpTest() {
   auto *alloc = HSHM_DEFAULT_ALLOC;
   unordered_map<Key, Val> map(alloc, 5);
 
-  // Insert 20 entries into the map (no growth trigger)
+  // Insert 20 entries into the map (triggers an incremental growth)
   PAGE_DIVIDE("Insert entries") {
     for (int i = 0; i < 20; ++i) {
       CREATE_KV_PAIR(key, i, val, i);
@@ -147,6 +147,28 @@ void UnorderedMapOpTest() {
     }
   }
 
+  // Look up several batches of keys at once
+  PAGE_DIVIDE("Find many entries") {
+    std::vector<Key> keys;
+    for (int i = 0; i < 40; ++i) {
+      CREATE_SET_VAR_TO_INT_OR_STRING(Key, key, i);
+      keys.emplace_back(key);
+    }
+    std::vector<typename unordered_map<Key, Val>::iterator_t> iters(40);
+    std::unique_ptr<bool[]> has(new bool[40]);
+    map.find_many(keys.data(), keys.size(), iters.data());
+    REQUIRE(map.contains_many(keys.data(), keys.size(), has.get()) == 5);
+    for (int i = 0; i < 40; ++i) {
+      bool exists = 15 <= i && i < 20;
+      REQUIRE(has[i] == exists);
+      REQUIRE(iters[i].is_end() == !exists);
+      if (exists) {
+        CREATE_SET_VAR_TO_INT_OR_STRING(Val, val, i + 100);
+        REQUIRE((*iters[i]).GetVal() == val);
+      }
+    }
+  }
+
   // Attempt to replace an existing key
   PAGE_DIVIDE("Try emplace on an existing key") {
     for (int i = 15; i < 20; ++i) {
@@ -246,3 +268,91 @@ TEST_CASE("UnorderedMapOfStringString") {
   UnorderedMapOpTest<string, string>();
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
 }
+
+TEST_CASE("UnorderedMapIncrementalRehash") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  {
+    unordered_map<int, int> map(alloc, 16);
+    bool saw_rehash = false;
+
+    // Entries must stay visible while buckets are migrated
+    PAGE_DIVIDE("Insert while rehashing") {
+      for (int i = 0; i < 4096; ++i) {
+        map.emplace(i, i);
+        if (map.is_rehashing()) {
+          saw_rehash = true;
+          size_t count = 0;
+          for (auto iter = map.begin(); iter != map.end(); ++iter) {
+            ++count;
+          }
+          REQUIRE(count == map.size());
+          for (int j = 0; j <= i; j += 61) {
+            auto iter = map.find(j);
+            REQUIRE(!iter.is_end());
+            REQUIRE((*iter).GetVal() == j);
+          }
+          int keys[3] = {0, i, i + 1};
+          bool has[3];
+          REQUIRE(map.contains_many(keys, 3, has) == 2);
+          REQUIRE((has[0] && has[1] && !has[2]));
+        }
+      }
+      REQUIRE(saw_rehash);
+      REQUIRE(map.size() == 4096);
+      REQUIRE(map.get_num_buckets() > 16);
+    }
+
+    // Overwrite and erase keys that may still be in old buckets
+    PAGE_DIVIDE("Modify while rehashing") {
+      for (int i = 0; i < 4096; i += 2) {
+        map.emplace(i, i + 1);
+      }
+      for (int i = 1; i < 4096; i += 2) {
+        map.erase(i);
+      }
+      REQUIRE(map.size() == 2048);
+      map.rehash_finish();
+      REQUIRE(!map.is_rehashing());
+      for (int i = 0; i < 4096; ++i) {
+        auto iter = map.find(i);
+        REQUIRE(iter.is_end() == (i % 2 == 1));
+        if (!iter.is_end()) {
+          REQUIRE((*iter).GetVal() == i + 1);
+        }
+      }
+    }
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("UnorderedMapChainedRehash") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  {
+    // A small growth factor fills the new buckets before the old ones are
+    // migrated, so growths are triggered while a rehash is in progress
+    unordered_map<int, int> map(alloc, 64, hshm::RealNumber(4, 5),
+                                hshm::RealNumber(11, 10));
+    size_t max_step = 2 * unordered_map<int, int>::kRehashBuckets;
+    int num_rehashes = 0;
+    for (int i = 0; i < 8192; ++i) {
+      size_t old_size = map.GetOldBuckets().size();
+      size_t remaining = old_size - (old_size ? map.rehash_off_ : 0);
+      map.emplace(i, i);
+      if (map.is_rehashing() && map.GetOldBuckets().size() != old_size) {
+        // A new rehash only starts once the previous one nearly finished
+        REQUIRE(remaining <= max_step);
+        ++num_rehashes;
+      }
+    }
+    REQUIRE(num_rehashes > 1);
+    REQUIRE(map.size() == 8192);
+    for (int i = 0; i < 8192; i += 37) {
+      auto iter = map.find(i);
+      REQUIRE(!iter.is_end());
+      REQUIRE((*iter).GetVal() == i);
+    }
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
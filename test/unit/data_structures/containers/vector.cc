@@ -12,8 +12,12 @@
 
 #include "hermes_shm/data_structures/ipc/vector.h"
 
+#include <algorithm>
+#include <random>
+
 #include "basic_test.h"
 #include "hermes_shm/data_structures/ipc/list.h"
+#include "hermes_shm/data_structures/ipc/parallel_sort.h"
 #include "hermes_shm/data_structures/ipc/string.h"
 #include "test_init.h"
 #include "vector.h"
@@ -186,4 +190,126 @@ TEST_CASE("VectorOfIntQuickSortLambda") {
                    [](const int &a, const int &b) { return a < b; });
   REQUIRE(hshm::is_sorted(vec.begin(), vec.end()));
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
-}
\ No newline at end of file
+}
+
+/** Fill \a vec with \a length values in one of the patterns sorts trip on */
+static void FillSortPattern(hshm::vector<int> &vec, int length,
+                            const std::string &pattern) {
+  std::mt19937 rng(length);
+  vec.resize(length);
+  for (int i = 0; i < length; ++i) {
+    if (pattern == "random") {
+      vec[i] = (int)rng();
+    } else if (pattern == "sorted") {
+      vec[i] = i;
+    } else if (pattern == "reversed") {
+      vec[i] = length - i;
+    } else if (pattern == "equal") {
+      vec[i] = 7;
+    } else if (pattern == "few_unique") {
+      vec[i] = (int)(rng() % 4) - 2;
+    } else if (pattern == "organ_pipe") {
+      vec[i] = i < length / 2 ? i : length - i;
+    }
+  }
+}
+
+/** Check \a vec is sorted by \a cmp and holds the values of \a orig */
+template <typename T, typename CmpT>
+static void RequireSortedCopy(hshm::vector<T> &vec, std::vector<T> orig,
+                              CmpT cmp) {
+  std::sort(orig.begin(), orig.end(), cmp);
+  REQUIRE(vec.size() == orig.size());
+  for (size_t i = 0; i < orig.size(); ++i) {
+    REQUIRE(vec[i] == orig[i]);
+  }
+}
+
+TEST_CASE("VectorOfIntPdqSort") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  for (const std::string pattern : {"random", "sorted", "reversed", "equal",
+                                    "few_unique", "organ_pipe"}) {
+    hshm::vector<int> vec(alloc);
+    FillSortPattern(vec, 100000, pattern);
+    std::vector<int> orig = vec.vec();
+    hshm::sort(vec.begin(), vec.end());
+    REQUIRE(hshm::is_sorted(vec.begin(), vec.end()));
+    RequireSortedCopy(vec, orig, std::less<int>());
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("VectorOfStringPdqSort") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  {
+    hshm::vector<string> vec(alloc);
+    std::mt19937 rng(0);
+    for (int i = 0; i < 5000; ++i) {
+      vec.emplace_back(std::to_string(rng() % 1000));
+    }
+    hshm::sort(vec.begin(), vec.end(),
+               [](const string &a, const string &b) { return a < b; });
+    for (size_t i = 1; i < vec.size(); ++i) {
+      REQUIRE(!(vec[i] < vec[i - 1]));
+    }
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("VectorOfIntRadixSort") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PAGE_DIVIDE("Signed integers") {
+    hshm::vector<int> vec(alloc);
+    FillSortPattern(vec, 100000, "random");
+    vec[0] = INT32_MIN;
+    vec[1] = INT32_MAX;
+    std::vector<int> orig = vec.vec();
+    hshm::radix_sort(vec.begin(), vec.end());
+    RequireSortedCopy(vec, orig, std::less<int>());
+  }
+  PAGE_DIVIDE("Floating point") {
+    hshm::vector<double> vec(alloc);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> dist(-1e6, 1e6);
+    for (int i = 0; i < 10000; ++i) {
+      vec.emplace_back(dist(rng));
+    }
+    vec.emplace_back(-0.0);
+    vec.emplace_back(0.0);
+    std::vector<double> orig = vec.vec();
+    hshm::radix_sort(vec.begin(), vec.end());
+    RequireSortedCopy(vec, orig, std::less<double>());
+  }
+  PAGE_DIVIDE("Keyed and stable") {
+    // Sort (key, index) pairs by key; equal keys keep their index order
+    hshm::vector<hshm::u64> vec(alloc);
+    std::mt19937 rng(2);
+    for (hshm::u64 i = 0; i < 10000; ++i) {
+      vec.emplace_back(((rng() % 16) << 32) | i);
+    }
+    std::vector<hshm::u64> orig = vec.vec();
+    hshm::radix_sort(vec.begin(), vec.end(),
+                     [](const hshm::u64 &val) { return (hshm::u32)(val >> 32); });
+    RequireSortedCopy(vec, orig, std::less<hshm::u64>());
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
+
+TEST_CASE("VectorOfIntParallelSort") {
+  auto *alloc = HSHM_DEFAULT_ALLOC;
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  for (const std::string pattern : {"random", "reversed", "few_unique"}) {
+    for (int nthreads : {2, 3, 8}) {
+      hshm::vector<int> vec(alloc);
+      FillSortPattern(vec, 1 << 18, pattern);
+      std::vector<int> orig = vec.vec();
+      hshm::parallel_sort(vec.begin(), vec.end(), nthreads,
+                          [](const int &a, const int &b) { return a > b; });
+      RequireSortedCopy(vec, orig, std::greater<int>());
+    }
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+}
@@ -16,6 +16,7 @@
 
 using hshm::Mutex;
 using hshm::RwLock;
+using hshm::SpinLock;
 
 void MutexTest(int nthreads) {
   size_t loop_count = 10000;
@@ -38,6 +39,24 @@ void MutexTest(int nthreads) {
   }
 }
 
+template <typename LockT>
+void TryLockTest() {
+  LockT lock;
+  for (int i = 0; i < 4; ++i) {
+    REQUIRE(lock.TryLock(i + 1));
+#ifdef HSHM_DEBUG_LOCK
+    REQUIRE(lock.owner_ == (hshm::u32)(i + 1));
+#endif
+    REQUIRE(!lock.TryLock(0));
+    lock.Unlock();
+  }
+  lock.Lock(0);
+  REQUIRE(!lock.TryLock(0));
+  lock.Unlock();
+  REQUIRE(lock.TryLock(0));
+  lock.Unlock();
+}
+
 void RwLockTest(int producers, int consumers, size_t loop_count) {
   size_t nthreads = producers + consumers;
   size_t count = 0;
@@ -72,7 +91,14 @@ void RwLockTest(int producers, int consumers, size_t loop_count) {
   }
 }
 
-TEST_CASE("Mutex") { MutexTest(8); }
+TEST_CASE("Mutex") {
+  MutexTest(8);
+  TryLockTest<Mutex>();
+}
+
+TEST_CASE("SpinLock") {
+  TryLockTest<SpinLock>();
+}
 
 TEST_CASE("RwLock") {
   RwLockTest(8, 0, 1000000);
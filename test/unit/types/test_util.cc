@@ -13,6 +13,8 @@
 
 #include "basic_test.h"
 #include "hermes_shm/data_structures/internal/shm_archive.h"
+#include "hermes_shm/data_structures/ipc/chararr.h"
+#include "hermes_shm/data_structures/ipc/hash.h"
 #include "hermes_shm/thread/thread_model_manager.h"
 #include "hermes_shm/util/auto_trace.h"
 #include "hermes_shm/util/config_parse.h"
@@ -145,3 +147,59 @@ TEST_CASE("TestFormatter") {
     REQUIRE(name == "bucket00");
   }
 }
+
+TEST_CASE("Hash") {
+  PAGE_DIVIDE("Strings of equal content hash equally") {
+    for (size_t len = 0; len < 200; ++len) {
+      std::string text(len, 'a');
+      for (size_t i = 0; i < len; ++i) {
+        text[i] = (char)('a' + (i * 7) % 26);
+      }
+      size_t h = hshm::hash<std::string>{}(text);
+      REQUIRE(h == hshm::hash_bytes(text.data(), text.size()));
+      if (len < 64) {
+        REQUIRE(h == hshm::hash<hshm::chararr>{}(hshm::chararr(text)));
+      }
+      if (len > 0) {
+        std::string other = text;
+        other[len / 2] ^= 1;
+        REQUIRE(h != hshm::hash<std::string>{}(other));
+      }
+    }
+  }
+
+  PAGE_DIVIDE("Equal floats hash equally") {
+    REQUIRE(hshm::hash<double>{}(0.0) == hshm::hash<double>{}(-0.0));
+    REQUIRE(hshm::hash<double>{}(1.5) != hshm::hash<double>{}(1.0));
+  }
+
+  PAGE_DIVIDE("Sequential and aligned keys spread over buckets") {
+    size_t num_buckets = 1000;
+    std::vector<size_t> ints(num_buckets), ptrs(num_buckets);
+    for (size_t i = 0; i < num_buckets * 8; ++i) {
+      size_t h = hshm::hash<size_t>{}(i);
+      ++ints[hshm::hash_reduce(h, num_buckets)];
+      void *ptr = reinterpret_cast<void *>(i * 4096);
+      ++ptrs[hshm::hash_reduce(hshm::hash<void *>{}(ptr), num_buckets)];
+    }
+    REQUIRE(*std::max_element(ints.begin(), ints.end()) < 24);
+    REQUIRE(*std::max_element(ptrs.begin(), ptrs.end()) < 24);
+  }
+
+  PAGE_DIVIDE("Identity hashes still spread with hash_reduce") {
+    size_t num_buckets = 100;
+    std::vector<size_t> counts(num_buckets);
+    for (size_t i = 0; i < num_buckets * 8; ++i) {
+      size_t bkt = hshm::hash_reduce(i, num_buckets);
+      REQUIRE(bkt < num_buckets);
+      ++counts[bkt];
+    }
+    REQUIRE(*std::max_element(counts.begin(), counts.end()) < 24);
+  }
+
+  PAGE_DIVIDE("mixed_hash mixes only hashes that are not already mixed") {
+    REQUIRE(hshm::mixed_hash<hshm::hash<int>>(7) == hshm::hash<int>{}(7));
+    REQUIRE(hshm::mixed_hash<std::hash<size_t>>((size_t)7) ==
+            hshm::fmix64(std::hash<size_t>{}(7)));
+  }
+}